@@ -63,6 +63,28 @@
 #include <err.h>
 #include "net/netstack.h"
 #include "net/packetbuf.h"
+#include "tun6-net.h"
+
+/* The most packets read from the tun device per wake-up */
+#ifdef TUN_CONF_BATCH
+#define TUN_BATCH TUN_CONF_BATCH
+#else
+#define TUN_BATCH 16
+#endif
+
+/* The number of tun queues to open, if the kernel supports multi-queue */
+#ifdef TUN_CONF_QUEUES
+#define TUN_QUEUES TUN_CONF_QUEUES
+#else
+#define TUN_QUEUES 1
+#endif
+
+/* Have the kernel use NAPI for the tun device, if it supports it */
+#ifdef TUN_CONF_NAPI
+#define TUN_NAPI TUN_CONF_NAPI
+#else
+#define TUN_NAPI 0
+#endif
 
 static const char *config_ipaddr = "fd00::1/64";
 /* Allocate some bytes in RAM and copy the string */
@@ -71,6 +93,12 @@ static char config_tundev[64] = "tun0";
 
 #ifndef __CYGWIN__
 static int tunfd = -1;
+/* All queues of the tun device, the first of which is the one returned
+   by tun6_net_open(). Shared with the native border router. */
+static int tun_queue_fds[TUN_QUEUES];
+static int tun_queue_count;
+
+static struct tun6_net_stats stats;
 
 static int set_fd(fd_set *rset, fd_set *wset);
 static void handle_fd(fd_set *rset, fd_set *wset);
@@ -157,10 +185,23 @@ tun_alloc(char *dev)
    *        IFF_NO_PI - Do not provide packet information
    */
   ifr.ifr_flags = IFF_TUN | IFF_NO_PI;
+#if TUN_QUEUES > 1 && defined(IFF_MULTI_QUEUE)
+  ifr.ifr_flags |= IFF_MULTI_QUEUE;
+#endif
+#if TUN_NAPI && defined(IFF_NAPI)
+  ifr.ifr_flags |= IFF_NAPI;
+#endif
   if(*dev != 0) {
     strncpy(ifr.ifr_name, dev, IFNAMSIZ);
   }
-  if((err = ioctl(fd, TUNSETIFF, (void *) &ifr)) < 0 ) {
+  if((err = ioctl(fd, TUNSETIFF, (void *) &ifr)) < 0 &&
+     ifr.ifr_flags != (IFF_TUN | IFF_NO_PI)) {
+    /* Older kernels lack the multi-queue and NAPI options */
+    LOG_WARN("Tun options not supported, using the defaults\n");
+    ifr.ifr_flags = IFF_TUN | IFF_NO_PI;
+    err = ioctl(fd, TUNSETIFF, (void *) &ifr);
+  }
+  if(err < 0) {
     /* Error message handled by caller */
     close(fd);
     return err;
@@ -189,6 +230,114 @@ tun_alloc(char *dev)
 }
 #endif
 
+#ifndef __CYGWIN__
+/*---------------------------------------------------------------------------*/
+int
+tun6_net_open(char *dev, const struct select_callback *callback)
+{
+  int fd;
+  int i;
+
+  fd = tun_alloc(dev);
+  if(fd < 0) {
+    return -1;
+  }
+
+  tun_queue_fds[0] = fd;
+  tun_queue_count = 1;
+#if TUN_QUEUES > 1 && defined(IFF_MULTI_QUEUE)
+  /* Attach the remaining queues to the interface that was just created */
+  while(tun_queue_count < TUN_QUEUES) {
+    fd = tun_alloc(dev);
+    if(fd < 0) {
+      LOG_WARN("Failed to open tun queue %d\n", tun_queue_count);
+      break;
+    }
+    tun_queue_fds[tun_queue_count++] = fd;
+  }
+#endif
+
+  for(i = 0; i < tun_queue_count; i++) {
+    /* Reads stop at the first empty queue instead of blocking */
+    fcntl(tun_queue_fds[i], F_SETFL,
+          fcntl(tun_queue_fds[i], F_GETFL) | O_NONBLOCK);
+    select_set_callback(tun_queue_fds[i], callback);
+  }
+  return tun_queue_fds[0];
+}
+/*---------------------------------------------------------------------------*/
+int
+tun6_net_set_fd(fd_set *rset)
+{
+  int i;
+
+  for(i = 0; i < tun_queue_count; i++) {
+    FD_SET(tun_queue_fds[i], rset);
+  }
+  return tun_queue_count > 0;
+}
+/*---------------------------------------------------------------------------*/
+static int
+tun_input(int fd, unsigned char *data, int maxlen)
+{
+  int size;
+
+  if((size = read(fd, data, maxlen)) == -1) {
+    if(errno == EAGAIN || errno == EWOULDBLOCK) {
+      /* Nothing left in this queue */
+      return 0;
+    }
+    err(1, "tun_input: read");
+  }
+  return size;
+}
+/*---------------------------------------------------------------------------*/
+void
+tun6_net_read(fd_set *rset, int (*input)(void))
+{
+  int size;
+  unsigned count;
+  int more = 1;
+  int i;
+
+  for(i = 0; i < tun_queue_count && more; i++) {
+    if(!FD_ISSET(tun_queue_fds[i], rset)) {
+      continue;
+    }
+
+    /* Drain the queue straight into uip_buf, as the input function is
+       done with it once it returns, but bound the work done before the
+       timers get to run */
+    for(count = 0; count < TUN_BATCH && more; count++) {
+      size = tun_input(tun_queue_fds[i], uip_buf, sizeof(uip_buf));
+      if(size <= 0) {
+        break;
+      }
+      LOG_DBG("TUN data incoming read:%d\n", size);
+      uip_len = size;
+      more = input();
+    }
+
+    if(count > 0) {
+      stats.wakeups++;
+      stats.packets += count;
+      if(count > stats.max_batch) {
+        stats.max_batch = count;
+      }
+      if(count == TUN_BATCH) {
+        stats.full_batches++;
+      }
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+const struct tun6_net_stats *
+tun6_net_get_stats(void)
+{
+  return &stats;
+}
+#endif /* __CYGWIN__ */
+
 #ifdef __CYGWIN__
 /*wpcap process is used to connect to host interface */
 static void
@@ -208,7 +357,7 @@ tun_init()
 
   LOG_INFO("Initializing tun interface\n");
 
-  tunfd = tun_alloc(config_tundev);
+  tunfd = tun6_net_open(config_tundev, &tun_select_callback);
   if(tunfd == -1) {
     LOG_WARN("Failed to open tun device (you may be lacking permission). Running without network.\n");
     /* err(1, "failed to allocate tun device ``%s''", config_tundev); */
@@ -217,8 +366,6 @@ tun_init()
 
   LOG_INFO("Tun open:%d\n", tunfd);
 
-  select_set_callback(tunfd, &tun_select_callback);
-
   fprintf(stderr, "opened %s device ``/dev/%s''\n",
           "tun", config_tundev);
 
@@ -240,23 +387,6 @@ tun_output(uint8_t *data, int len)
   }
   return 0;
 }
-/*---------------------------------------------------------------------------*/
-static int
-tun_input(unsigned char *data, int maxlen)
-{
-  int size;
-
-  if(tunfd == -1) {
-    /* tun is not open */
-    return 0;
-  }
-
-  if((size = read(tunfd, data, maxlen)) == -1) {
-    err(1, "tun_input: read");
-  }
-  return size;
-}
-
 /*---------------------------------------------------------------------------*/
 static uint8_t
 output(const linkaddr_t *localdest)
@@ -278,17 +408,21 @@ set_fd(fd_set *rset, fd_set *wset)
     return 0;
   }
 
-  FD_SET(tunfd, rset);
-  return 1;
+  return tun6_net_set_fd(rset);
 }
 
 /*---------------------------------------------------------------------------*/
 
+static int
+input_packet(void)
+{
+  tcpip_input();
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
 static void
 handle_fd(fd_set *rset, fd_set *wset)
 {
-  int size;
-
   if(tunfd == -1) {
     /* tun is not open */
     return;
@@ -296,12 +430,7 @@ handle_fd(fd_set *rset, fd_set *wset)
 
   LOG_INFO("Tun6-handle FD\n");
 
-  if(FD_ISSET(tunfd, rset)) {
-    size = tun_input(uip_buf, sizeof(uip_buf));
-    LOG_DBG("TUN data incoming read:%d\n", size);
-    uip_len = size;
-    tcpip_input();
-  }
+  tun6_net_read(rset, input_packet);
 }
 #endif /*  __CYGWIN_ */
 
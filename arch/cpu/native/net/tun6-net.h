@@ -0,0 +1,81 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*---------------------------------------------------------------------------*/
+/**
+ * \file
+ *         The tun device of the native platform, shared by the tun network
+ *         driver and the native border router
+ */
+/*---------------------------------------------------------------------------*/
+#ifndef TUN6_NET_H_
+#define TUN6_NET_H_
+/*---------------------------------------------------------------------------*/
+#include "contiki.h"
+/*---------------------------------------------------------------------------*/
+/* Packets read from the tun device, per wake-up of the main loop */
+struct tun6_net_stats {
+  unsigned long wakeups;      /* wake-ups that read at least one packet */
+  unsigned long packets;      /* packets read in total */
+  unsigned long full_batches; /* wake-ups that stopped at TUN_CONF_BATCH */
+  unsigned max_batch;         /* the most packets read in one wake-up */
+};
+/*---------------------------------------------------------------------------*/
+/**
+ * \brief          Open the tun device, with TUN_CONF_QUEUES queues if the
+ *                 kernel supports it, and have the main loop watch them
+ * \param dev      The name of the device, updated with the name the
+ *                 kernel gave it
+ * \param callback The select callback of all queues
+ * \return         The file descriptor of the first queue, -1 on failure
+ */
+int tun6_net_open(char *dev, const struct select_callback *callback);
+
+/**
+ * \brief      Add the queues of the tun device to a read set, from the
+ *             set_fd() of the select callback
+ * \return     Non-zero if the tun device is open
+ */
+int tun6_net_set_fd(fd_set *rset);
+
+/**
+ * \brief       Read up to TUN_CONF_BATCH packets from each queue ready in
+ *              rset, from the handle_fd() of the select callback
+ * \param input Called with each packet in uip_buf. Reading stops when
+ *              it returns 0.
+ *
+ *              Packets are read straight into uip_buf, which input must
+ *              be done with when it returns.
+ */
+void tun6_net_read(fd_set *rset, int (*input)(void));
+
+/**
+ * \brief      Get the statistics of the reads from the tun device
+ */
+const struct tun6_net_stats *tun6_net_get_stats(void);
+/*---------------------------------------------------------------------------*/
+#endif /* TUN6_NET_H_ */
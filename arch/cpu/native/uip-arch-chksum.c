@@ -0,0 +1,152 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*---------------------------------------------------------------------------*/
+/**
+ * \file
+ *         Word-wise Internet checksum for the native platform
+ *
+ *         The buffer is summed in native byte order, 64 bits at a time
+ *         (or in SSE2/AVX2 registers when the compiler targets them),
+ *         and the result is swapped to host order at the end. This gives
+ *         the same one's complement sum as summing network-order 16-bit
+ *         words (RFC 1071, section 2).
+ */
+/*---------------------------------------------------------------------------*/
+#include "contiki.h"
+#include "net/ipv6/uip.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+/*---------------------------------------------------------------------------*/
+#if UIP_ARCH_CHKSUM_ADD
+/*---------------------------------------------------------------------------*/
+static inline uint64_t
+add_carry(uint64_t acc, uint64_t word)
+{
+  acc += word;
+  return acc + (acc < word);
+}
+/*---------------------------------------------------------------------------*/
+#if defined(__AVX2__)
+/* 32 bytes per iteration, as 32-bit words added into 64-bit lanes */
+static uint64_t
+sum_vector(const uint8_t **data, uint16_t *len)
+{
+  const __m256i zero = _mm256_setzero_si256();
+  __m256i acc = _mm256_setzero_si256();
+  uint64_t lanes[4];
+  uint64_t sum;
+
+  while(*len >= 32) {
+    __m256i v = _mm256_loadu_si256((const __m256i *)*data);
+    acc = _mm256_add_epi64(acc, _mm256_unpacklo_epi32(v, zero));
+    acc = _mm256_add_epi64(acc, _mm256_unpackhi_epi32(v, zero));
+    *data += 32;
+    *len -= 32;
+  }
+
+  _mm256_storeu_si256((__m256i *)lanes, acc);
+  sum = add_carry(lanes[0], lanes[1]);
+  sum = add_carry(sum, lanes[2]);
+  return add_carry(sum, lanes[3]);
+}
+#elif defined(__SSE2__)
+/* 16 bytes per iteration, as 32-bit words added into 64-bit lanes */
+static uint64_t
+sum_vector(const uint8_t **data, uint16_t *len)
+{
+  const __m128i zero = _mm_setzero_si128();
+  __m128i acc = _mm_setzero_si128();
+  uint64_t lanes[2];
+
+  while(*len >= 16) {
+    __m128i v = _mm_loadu_si128((const __m128i *)*data);
+    acc = _mm_add_epi64(acc, _mm_unpacklo_epi32(v, zero));
+    acc = _mm_add_epi64(acc, _mm_unpackhi_epi32(v, zero));
+    *data += 16;
+    *len -= 16;
+  }
+
+  _mm_storeu_si128((__m128i *)lanes, acc);
+  return add_carry(lanes[0], lanes[1]);
+}
+#endif /* __SSE2__ */
+/*---------------------------------------------------------------------------*/
+uint16_t
+uip_arch_chksum_add(uint16_t sum, const uint8_t *data, uint16_t len)
+{
+  uint64_t acc = 0;
+  uint64_t word;
+  uint32_t folded;
+
+#if defined(__SSE2__) || defined(__AVX2__)
+  /* Not worth setting up the vector registers for short headers */
+  if(len >= 64) {
+    acc = sum_vector(&data, &len);
+  }
+#endif /* __SSE2__ || __AVX2__ */
+
+  while(len >= sizeof(word)) {
+    memcpy(&word, data, sizeof(word));
+    acc = add_carry(acc, word);
+    data += sizeof(word);
+    len -= sizeof(word);
+  }
+
+  if(len > 0) {
+    /* The tail starts on a word boundary, so zero padding after it
+       also pads an odd last byte as the checksum requires */
+    word = 0;
+    memcpy(&word, data, len);
+    acc = add_carry(acc, word);
+  }
+
+  /* Fold 64 bits down to 16 */
+  acc = (acc >> 32) + (acc & 0xffffffff);
+  acc = (acc >> 32) + (acc & 0xffffffff);
+  folded = (uint32_t)acc;
+  folded = (folded >> 16) + (folded & 0xffff);
+  folded = (folded >> 16) + (folded & 0xffff);
+
+#if UIP_BYTE_ORDER == UIP_LITTLE_ENDIAN
+  folded = ((folded & 0xff) << 8) | (folded >> 8);
+#endif /* UIP_BYTE_ORDER == UIP_LITTLE_ENDIAN */
+
+  /* Add the running sum, in host byte order */
+  folded += sum;
+  folded = (folded >> 16) + (folded & 0xffff);
+
+  return (uint16_t)folded;
+}
+/*---------------------------------------------------------------------------*/
+#endif /* UIP_ARCH_CHKSUM_ADD */
+/*---------------------------------------------------------------------------*/
@@ -50,6 +50,10 @@ struct select_callback {
   void (* handle_fd)(fd_set *fdr, fd_set *fdw);
 };
 int select_set_callback(int fd, const struct select_callback *callback);
+/* Tells the main loop that the callback of fd waits for other events
+   now, without having handled any. Needed when the main loop uses epoll
+   and set_fd() depends on more than the state left by handle_fd(). */
+void select_update_fd(int fd);
 
 #define CC_CONF_REGISTER_ARGS          1
 #define CC_CONF_FUNCTION_POINTER_ARGS  1
@@ -93,6 +97,9 @@ typedef unsigned int uip_stats_t;
 
 #define UIP_CONF_IPV6_QUEUE_PKT  1
 #define UIP_ARCH_IPCHKSUM        1
+#ifndef UIP_ARCH_CHKSUM_ADD
+#define UIP_ARCH_CHKSUM_ADD      1
+#endif /* UIP_ARCH_CHKSUM_ADD */
 
 #endif /* NETSTACK_CONF_WITH_IPV6 */
 
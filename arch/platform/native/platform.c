@@ -43,6 +43,7 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <sys/select.h>
@@ -91,7 +92,7 @@
 #endif
 
 /*
- * Defines the timeout (in msec) of the select operation if no monitored file
+ * Defines the timeout (in usec) of the select operation if no monitored file
  * descriptors becomes ready.
  */
 #ifdef SELECT_CONF_TIMEOUT
@@ -108,12 +109,44 @@
 #else
 #define SELECT_STDIN 1
 #endif
+
+/*
+ * Waits for the monitored file descriptors with epoll instead of select.
+ * The main loop then sleeps until the next etimer expires, and the
+ * callbacks are only asked for the events they are interested in when
+ * they are set, after they handled an event, and after
+ * select_update_fd().
+ */
+#ifdef SELECT_CONF_EPOLL
+#define SELECT_EPOLL SELECT_CONF_EPOLL
+#elif defined(__linux__)
+#define SELECT_EPOLL 1
+#else
+#define SELECT_EPOLL 0
+#endif
 /** @} */
 /*---------------------------------------------------------------------------*/
+#if SELECT_EPOLL
+#include <sys/epoll.h>
+#endif /* SELECT_EPOLL */
 
 static const struct select_callback *select_callback[SELECT_MAX];
 static int select_max = 0;
 
+#if SELECT_EPOLL
+static int epoll_fd = -1;
+/* The events each file descriptor is registered for, 0 if none */
+static uint32_t epoll_registered[SELECT_MAX];
+/* Regular files cannot be waited for: as with select, they are always
+   ready */
+static uint8_t epoll_always_ready[SELECT_MAX];
+/* The file descriptors whose callbacks may wait for other events now */
+static uint8_t epoll_changed[SELECT_MAX];
+static uint8_t epoll_any_changed;
+/* The timeout of epoll, in msec rather than usec as for select */
+#define EPOLL_TIMEOUT MAX(SELECT_TIMEOUT / 1000, 1)
+#endif /* SELECT_EPOLL */
+
 #ifdef PLATFORM_CONF_MAC_ADDR
 static uint8_t mac_addr[] = PLATFORM_CONF_MAC_ADDR;
 #else /* PLATFORM_CONF_MAC_ADDR */
@@ -134,6 +167,17 @@ select_set_callback(int fd, const struct select_callback *callback)
 
     select_callback[fd] = callback;
 
+#if SELECT_EPOLL
+    select_update_fd(fd);
+    if(callback == NULL) {
+      if(epoll_registered[fd] != 0 && !epoll_always_ready[fd]) {
+        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+      }
+      epoll_registered[fd] = 0;
+      epoll_always_ready[fd] = 0;
+    }
+#endif /* SELECT_EPOLL */
+
     /* Update fd max */
     if(callback != NULL) {
       if(fd > select_max) {
@@ -153,6 +197,17 @@ select_set_callback(int fd, const struct select_callback *callback)
   return 0;
 }
 /*---------------------------------------------------------------------------*/
+void
+select_update_fd(int fd)
+{
+#if SELECT_EPOLL
+  if(fd >= 0 && fd < SELECT_MAX) {
+    epoll_changed[fd] = 1;
+    epoll_any_changed = 1;
+  }
+#endif /* SELECT_EPOLL */
+}
+/*---------------------------------------------------------------------------*/
 #if SELECT_STDIN
 static int
 stdin_set_fd(fd_set *rset, fd_set *wset)
@@ -164,9 +219,14 @@ static void
 stdin_handle_fd(fd_set *rset, fd_set *wset)
 {
   char c;
+  ssize_t len;
   if(FD_ISSET(STDIN_FILENO, rset)) {
-    if(read(STDIN_FILENO, &c, 1) > 0) {
+    len = read(STDIN_FILENO, &c, 1);
+    if(len > 0) {
       serial_line_input_byte(c);
+    } else if(len == 0) {
+      /* End of input: stop monitoring it instead of spinning on it */
+      select_set_callback(STDIN_FILENO, NULL);
     }
   }
 }
@@ -275,12 +335,162 @@ platform_init_stage_three()
   setvbuf(stdout, (char *)NULL, _IONBF, 0);
 }
 /*---------------------------------------------------------------------------*/
+#if SELECT_EPOLL
+/* Milliseconds until the next etimer expires, at most EPOLL_TIMEOUT */
+static int
+epoll_timeout(void)
+{
+  clock_time_t remaining;
+
+  if(!etimer_pending()) {
+    return EPOLL_TIMEOUT;
+  }
+
+  remaining = etimer_next_expiration_time() - clock_time();
+  if(remaining > (clock_time_t)-1 / 2) {
+    /* Expired already, the difference wrapped around */
+    return 0;
+  }
+  return MIN(remaining * 1000 / CLOCK_SECOND, EPOLL_TIMEOUT);
+}
+/*---------------------------------------------------------------------------*/
+/* Let the callbacks that may have changed tell which events they wait
+   for, as they would with select, and bring the epoll registrations up
+   to date. Returns non-zero if a descriptor that is always ready is
+   waited for. */
+static int
+epoll_update(void)
+{
+  static fd_set fdr;
+  static fd_set fdw;
+  struct epoll_event ev;
+  int always_ready = 0;
+  int i;
+
+  for(i = 0; i <= select_max; i++) {
+    if(select_callback[i] == NULL) {
+      continue;
+    }
+    if(!epoll_any_changed || !epoll_changed[i]) {
+      if(epoll_always_ready[i] && epoll_registered[i] != 0) {
+        always_ready = 1;
+      }
+      continue;
+    }
+    epoll_changed[i] = 0;
+
+    FD_CLR(i, &fdr);
+    FD_CLR(i, &fdw);
+    ev.events = 0;
+    if(select_callback[i]->set_fd(&fdr, &fdw)) {
+      ev.events |= FD_ISSET(i, &fdr) ? EPOLLIN : 0;
+      ev.events |= FD_ISSET(i, &fdw) ? EPOLLOUT : 0;
+    }
+
+    if(ev.events != epoll_registered[i] && !epoll_always_ready[i]) {
+      ev.data.fd = i;
+      if(ev.events == 0) {
+        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, i, NULL);
+      } else if(epoll_registered[i] == 0 ||
+                (epoll_ctl(epoll_fd, EPOLL_CTL_MOD, i, &ev) < 0 &&
+                 errno == ENOENT)) {
+        /* New, or closed and reopened since it was registered */
+        if(epoll_ctl(epoll_fd, EPOLL_CTL_ADD, i, &ev) < 0) {
+          if(errno == EPERM) {
+            epoll_always_ready[i] = 1;
+          } else {
+            perror("epoll_ctl");
+            ev.events = 0;
+          }
+        }
+      }
+    }
+    epoll_registered[i] = ev.events;
+
+    if(epoll_always_ready[i] && ev.events != 0) {
+      always_ready = 1;
+    }
+  }
+  epoll_any_changed = 0;
+
+  return always_ready;
+}
+/*---------------------------------------------------------------------------*/
+static void
+epoll_handle_fd(int fd, uint32_t events)
+{
+  fd_set fdr;
+  fd_set fdw;
+
+  if(select_callback[fd] == NULL) {
+    return;
+  }
+
+  FD_ZERO(&fdr);
+  FD_ZERO(&fdw);
+  if((events & (EPOLLIN | EPOLLHUP | EPOLLERR)) &&
+     (epoll_registered[fd] & EPOLLIN)) {
+    FD_SET(fd, &fdr);
+  }
+  if((events & (EPOLLOUT | EPOLLERR)) &&
+     (epoll_registered[fd] & EPOLLOUT)) {
+    FD_SET(fd, &fdw);
+  }
+  select_callback[fd]->handle_fd(&fdr, &fdw);
+  /* Handling the events may change the ones waited for */
+  select_update_fd(fd);
+}
+/*---------------------------------------------------------------------------*/
+static void
+epoll_main_loop(void)
+{
+  struct epoll_event events[SELECT_MAX];
+  int always_ready;
+  int i;
+  int retval;
+
+  epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  if(epoll_fd < 0) {
+    perror("epoll_create1");
+    exit(1);
+  }
+
+  while(1) {
+    retval = process_run();
+
+    always_ready = epoll_update();
+
+    retval = epoll_wait(epoll_fd, events, SELECT_MAX,
+                        retval || always_ready ? 0 : epoll_timeout());
+    if(retval < 0 && errno != EINTR) {
+      perror("epoll_wait");
+    }
+
+    for(i = 0; i < retval; i++) {
+      epoll_handle_fd(events[i].data.fd, events[i].events);
+    }
+    if(always_ready) {
+      for(i = 0; i <= select_max; i++) {
+        if(epoll_always_ready[i]) {
+          epoll_handle_fd(i, EPOLLIN | EPOLLOUT);
+        }
+      }
+    }
+
+    etimer_request_poll();
+  }
+}
+#endif /* SELECT_EPOLL */
+/*---------------------------------------------------------------------------*/
 void
 platform_main_loop()
 {
 #if SELECT_STDIN
   select_set_callback(STDIN_FILENO, &stdin_fd);
 #endif /* SELECT_STDIN */
+#if SELECT_EPOLL
+  epoll_main_loop();
+#endif /* SELECT_EPOLL */
   while(1) {
     fd_set fdr;
     fd_set fdw;
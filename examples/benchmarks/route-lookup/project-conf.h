@@ -0,0 +1,8 @@
+#ifndef PROJECT_CONF_H_
+#define PROJECT_CONF_H_
+
+/* Room for the largest routing table benchmarked */
+#define NETSTACK_MAX_ROUTE_ENTRIES 10000
+#define NBR_TABLE_CONF_MAX_NEIGHBORS 16
+
+#endif /* PROJECT_CONF_H_ */
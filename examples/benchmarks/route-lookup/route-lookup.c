@@ -0,0 +1,284 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * \file
+ *         Benchmark for uip_ds6_route_lookup() with large routing tables
+ */
+
+#include "contiki.h"
+#include "net/ipv6/uip-ds6.h"
+#include "net/ipv6/uip-ds6-nbr.h"
+#include "net/ipv6/uip-ds6-route.h"
+#include "lib/random.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NUM_NEXTHOPS    4
+#define BATCH_SIZE      1000
+#define NUM_CHECKS      1000
+#define BENCH_DURATION  CLOCK_SECOND
+
+static const int table_sizes[] = { 100, 1000, 10000 };
+
+/* Every site has a /48, a /64 and a /96 prefix nested in each other and
+   a /128 host route within them */
+#define ROUTES_PER_SITE 4
+static const uint8_t route_lengths[ROUTES_PER_SITE] = { 48, 64, 96, 128 };
+
+PROCESS(route_lookup_process, "Route lookup benchmark");
+AUTOSTART_PROCESSES(&route_lookup_process);
+/*---------------------------------------------------------------------------*/
+static void
+site_addr(uip_ipaddr_t *addr, int site, uint16_t subnet,
+          uint16_t iid0, uint16_t iid1)
+{
+  uip_ip6addr(addr, 0xfd00, 0, site, subnet, 0x0212, 0x4b00, iid0, iid1);
+}
+/*---------------------------------------------------------------------------*/
+static uint8_t
+route_addr(uip_ipaddr_t *addr, int i)
+{
+  int site;
+  int kind;
+
+  /* Rotate the order in which the routes of a site are added, so that
+     shorter prefixes are also added after longer ones */
+  site = i / ROUTES_PER_SITE;
+  kind = (i + site) % ROUTES_PER_SITE;
+  site_addr(addr, site, 1, (site * 40503) & 0xffff, site & 0xffff);
+  memset(&addr->u8[route_lengths[kind] / 8], 0,
+         sizeof(*addr) - route_lengths[kind] / 8);
+  return route_lengths[kind];
+}
+/*---------------------------------------------------------------------------*/
+/* An address matching any of the routes of a site, or none of them */
+static void
+target_addr(uip_ipaddr_t *addr, int num_routes)
+{
+  int site;
+
+  site = random_rand() % ((num_routes + ROUTES_PER_SITE - 1) / ROUTES_PER_SITE);
+  switch(random_rand() % 5) {
+  case 0:
+    site_addr(addr, site, 1, (site * 40503) & 0xffff, site & 0xffff);
+    break;
+  case 1:
+    site_addr(addr, site, 1, random_rand(), random_rand());
+    break;
+  case 2:
+    site_addr(addr, site, 1, random_rand(), random_rand());
+    addr->u16[4] = random_rand();
+    break;
+  case 3:
+    site_addr(addr, site, 2, random_rand(), random_rand());
+    break;
+  default:
+    site_addr(addr, site, 1, random_rand(), random_rand());
+    addr->u16[1] = random_rand() | 1;
+    break;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+nexthop_addr(uip_ipaddr_t *addr, uip_lladdr_t *lladdr, int i)
+{
+  memset(lladdr, 0, sizeof(*lladdr));
+  lladdr->addr[0] = 0x02;
+  lladdr->addr[sizeof(*lladdr) - 1] = i + 1;
+  uip_ip6addr(addr, 0xfe80, 0, 0, 0, 0, 0, 0, 0);
+  uip_ds6_set_addr_iid(addr, lladdr);
+}
+/*---------------------------------------------------------------------------*/
+static uip_ds6_route_t *
+add_route(const uip_ipaddr_t *addr, uint8_t length, int nexthop)
+{
+  uip_ipaddr_t nexthop_ipaddr;
+  uip_lladdr_t lladdr;
+
+  nexthop_addr(&nexthop_ipaddr, &lladdr, nexthop);
+  return uip_ds6_route_add(addr, length, &nexthop_ipaddr);
+}
+/*---------------------------------------------------------------------------*/
+static int
+add_routes(int from, int to)
+{
+  uip_ipaddr_t addr;
+  uint8_t length;
+  int i;
+
+  for(i = from; i < to; i++) {
+    length = route_addr(&addr, i);
+    if(add_route(&addr, length, i % NUM_NEXTHOPS) == NULL) {
+      printf("Failed to add route %d\n", i);
+      return 0;
+    }
+  }
+  if(uip_ds6_route_num_routes() != to) {
+    printf("%d routes instead of %d\n", uip_ds6_route_num_routes(), to);
+    return 0;
+  }
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+/* The longest matching route, found by walking the whole route list */
+static uip_ds6_route_t *
+walk_routes(const uip_ipaddr_t *addr)
+{
+  uip_ds6_route_t *r;
+  uip_ds6_route_t *found;
+
+  found = NULL;
+  for(r = uip_ds6_route_head(); r != NULL; r = uip_ds6_route_next(r)) {
+    if((found == NULL || r->length > found->length) &&
+       uip_ipaddr_prefixcmp(addr, &r->ipaddr, r->length)) {
+      found = r;
+    }
+  }
+  return found;
+}
+/*---------------------------------------------------------------------------*/
+static int
+check_lookups(int num_routes)
+{
+  uip_ipaddr_t addr;
+  int i;
+
+  for(i = 0; i < NUM_CHECKS; i++) {
+    target_addr(&addr, num_routes);
+    if(uip_ds6_route_lookup(&addr) != walk_routes(&addr)) {
+      printf("Lookup returned the wrong route\n");
+      return 0;
+    }
+  }
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+/* A route added for a prefix within a longer route is a route of its
+   own, and replaces only a route for the same prefix */
+static int
+check_covered_prefix(void)
+{
+  uip_ipaddr_t host;
+  uip_ipaddr_t other;
+  uip_ds6_route_t *host_route;
+  uip_ds6_route_t *prefix_route;
+  int num_routes;
+  int success;
+
+  num_routes = uip_ds6_route_num_routes();
+  uip_ip6addr(&host, 0xfd01, 0, 0, 1, 0x0212, 0x4b00, 1, 1);
+  uip_ip6addr(&other, 0xfd01, 0, 0, 1, 0x0212, 0x4b00, 2, 2);
+  host_route = add_route(&host, 128, 0);
+  prefix_route = add_route(&host, 64, 1);
+  prefix_route = add_route(&host, 64, 2);
+
+  success = host_route != NULL && prefix_route != NULL
+    && uip_ds6_route_num_routes() == num_routes + 2
+    && uip_ds6_route_lookup(&host) == host_route
+    && uip_ds6_route_lookup(&other) == prefix_route
+    && walk_routes(&other) == prefix_route;
+
+  uip_ds6_route_rm(host_route);
+  uip_ds6_route_rm(prefix_route);
+  success &= uip_ds6_route_num_routes() == num_routes
+    && uip_ds6_route_lookup(&host) == NULL;
+  if(!success) {
+    printf("A route for a covered prefix replaced the wrong route\n");
+  }
+  return success;
+}
+/*---------------------------------------------------------------------------*/
+static int
+run_lookups(int num_routes)
+{
+  uip_ipaddr_t addr;
+  clock_time_t start;
+  clock_time_t elapsed;
+  unsigned long lookups;
+  int i;
+
+  if(!check_lookups(num_routes)) {
+    return 0;
+  }
+
+  lookups = 0;
+  start = clock_time();
+  do {
+    for(i = 0; i < BATCH_SIZE; i++) {
+      target_addr(&addr, num_routes);
+      uip_ds6_route_lookup(&addr);
+    }
+    lookups += BATCH_SIZE;
+    elapsed = clock_time() - start;
+  } while(elapsed < BENCH_DURATION);
+
+  printf("%5d routes: %lu lookups/s\n", num_routes,
+         (unsigned long)(lookups * CLOCK_SECOND / elapsed));
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(route_lookup_process, ev, data)
+{
+  static int i;
+  static int num_routes;
+  uip_ipaddr_t nexthop;
+  uip_lladdr_t lladdr;
+
+  PROCESS_BEGIN();
+
+  printf("Route lookup benchmark (%s)\n",
+         UIP_DS6_ROUTE_TRIE ? "route trie" : "route list");
+
+  for(i = 0; i < NUM_NEXTHOPS; i++) {
+    nexthop_addr(&nexthop, &lladdr, i);
+    uip_ds6_nbr_add(&nexthop, &lladdr, 1, NBR_REACHABLE,
+                    NBR_TABLE_REASON_UNDEFINED, NULL);
+  }
+
+  if(!check_covered_prefix()) {
+    exit(1);
+  }
+
+  num_routes = 0;
+  for(i = 0; i < sizeof(table_sizes) / sizeof(table_sizes[0]); i++) {
+    if(!add_routes(num_routes, table_sizes[i])) {
+      exit(1);
+    }
+    num_routes = table_sizes[i];
+    if(!run_lookups(num_routes)) {
+      exit(1);
+    }
+    PROCESS_PAUSE();
+  }
+
+  exit(0);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
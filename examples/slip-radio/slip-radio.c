@@ -41,6 +41,7 @@
 #include <string.h>
 #include "net/netstack.h"
 #include "net/packetbuf.h"
+#include "net/queuebuf.h"
 
 #include "cmd.h"
 #include "slip-radio.h"
@@ -56,9 +57,17 @@
 extern const struct slip_radio_sensors SLIP_RADIO_CONF_SENSORS;
 #endif
 
-/* max 16 packets at the same time??? */
-uint8_t packet_ids[16];
-int packet_pos;
+/* The number of frames that the host may have in flight at once, which
+   is advertised to it as credits. The MAC can not queue more than this. */
+#ifdef SLIP_RADIO_CONF_WINDOW
+#define SLIP_RADIO_WINDOW SLIP_RADIO_CONF_WINDOW
+#else
+#define SLIP_RADIO_WINDOW MIN(QUEUEBUF_NUM, 16)
+#endif
+
+/* Session ids of the frames in flight, and which slots are taken */
+static uint8_t packet_ids[SLIP_RADIO_WINDOW];
+static uint8_t packet_used[SLIP_RADIO_WINDOW];
 
 static int slip_radio_cmd_handler(const uint8_t *data, int len);
 
@@ -110,16 +119,11 @@ parse_frame(void)
 }
 /*---------------------------------------------------------------------------*/
 static void
-packet_sent(void *ptr, int status, int transmissions)
+send_report(uint8_t sid, int status, int transmissions)
 {
   uint8_t buf[20];
-  uint8_t sid;
   int pos;
-  sid = *((uint8_t *)ptr);
-  LOG_DBG("Slip-radio: packet sent! sid: %d, status: %d, tx: %d\n",
-          sid, status, transmissions);
-  /* packet callback from lower layers */
-  /*  neighbor_info_packet_sent(status, transmissions); */
+
   pos = 0;
   buf[pos++] = '!';
   buf[pos++] = 'R';
@@ -129,6 +133,19 @@ packet_sent(void *ptr, int status, int transmissions)
   cmd_send(buf, pos);
 }
 /*---------------------------------------------------------------------------*/
+static void
+packet_sent(void *ptr, int status, int transmissions)
+{
+  uint8_t sid;
+  sid = *((uint8_t *)ptr);
+  packet_used[(uint8_t *)ptr - packet_ids] = 0;
+  LOG_DBG("Slip-radio: packet sent! sid: %d, status: %d, tx: %d\n",
+          sid, status, transmissions);
+  /* packet callback from lower layers */
+  /*  neighbor_info_packet_sent(status, transmissions); */
+  send_report(sid, status, transmissions);
+}
+/*---------------------------------------------------------------------------*/
 static int
 slip_radio_cmd_handler(const uint8_t *data, int len)
 {
@@ -138,7 +155,19 @@ slip_radio_cmd_handler(const uint8_t *data, int len)
     /* --- s e n d --- */
     if(data[1] == 'S') {
       int pos;
-      packet_ids[packet_pos] = data[2];
+      int slot;
+
+      slot = 0;
+      while(slot < SLIP_RADIO_WINDOW && packet_used[slot]) {
+        slot++;
+      }
+      if(slot == SLIP_RADIO_WINDOW) {
+        /* The host sent more than it had credits for */
+        LOG_WARN("no credits left for %u\n", data[2]);
+        send_report(data[2], MAC_TX_ERR, 0);
+        return 1;
+      }
+      packet_ids[slot] = data[2];
 
       packetbuf_clear();
       pos = packetutils_deserialize_atts(&data[3], len - 3);
@@ -159,12 +188,8 @@ slip_radio_cmd_handler(const uint8_t *data, int len)
 
       /* parse frame before sending to get addresses, etc. */
       parse_frame();
-      NETSTACK_MAC.send(packet_sent, &packet_ids[packet_pos]);
-
-      packet_pos++;
-      if(packet_pos >= sizeof(packet_ids)) {
-        packet_pos = 0;
-      }
+      packet_used[slot] = 1;
+      NETSTACK_MAC.send(packet_sent, &packet_ids[slot]);
 
       return 1;
     } else if(data[1] == 'V') {
@@ -189,7 +214,15 @@ slip_radio_cmd_handler(const uint8_t *data, int len)
     }
   } else if(data[0] == '?') {
     LOG_DBG("Got request message of type %c\n", data[1]);
-    if(data[1] == 'M') {
+    if(data[1] == 'W') {
+      /* advertise how many frames the host may send without waiting */
+      uip_buf[0] = '!';
+      uip_buf[1] = 'W';
+      uip_buf[2] = SLIP_RADIO_WINDOW;
+      uip_len = 3;
+      cmd_send(uip_buf, uip_len);
+      return 1;
+    } else if(data[1] == 'M') {
       /* this is just a test so far... just to see if it works */
       uip_buf[0] = '!';
       uip_buf[1] = 'M';
@@ -239,7 +272,6 @@ init(void)
   slip_arch_init();
   process_start(&slip_process, NULL);
   slip_set_input_callback(slip_input_callback);
-  packet_pos = 0;
 }
 /*---------------------------------------------------------------------------*/
 PROCESS(slip_radio_process, "Slip radio process");
@@ -95,8 +95,9 @@
     whether implemented as RPL Lite or RPL Classic */
 #define UIP_CONF_IPV6_RPL (ROUTING_CONF_RPL_LITE || ROUTING_CONF_RPL_CLASSIC)
 
-/* If RPL is enabled also enable the RPL NBR Policy */
-#if UIP_CONF_IPV6_RPL
+/* If RPL is enabled also enable the RPL NBR Policy, unless a neighbor
+ * table eviction policy is configured (see nbr-table.h) */
+#if UIP_CONF_IPV6_RPL && !defined(NBR_TABLE_CONF_POLICY)
 #ifndef NBR_TABLE_FIND_REMOVABLE
 #define NBR_TABLE_FIND_REMOVABLE rpl_nbr_policy_find_removable
 #endif /* NBR_TABLE_FIND_REMOVABLE */
@@ -101,6 +101,21 @@
 #define HEAPMEM_ALIGNMENT sizeof(int)
 #endif /* HEAPMEM_CONF_ALIGNMENT */
 
+/*
+ * The HEAPMEM_CONF_TLSF parameter selects a Two-Level Segregated Fit
+ * allocator instead of the default first-fit free list. Free chunks are
+ * kept in segregated lists indexed by size class, and bitmaps of the
+ * non-empty lists make both allocation and deallocation run in
+ * bounded, constant time. Adjacent free chunks are coalesced
+ * immediately when freed, at the cost of one extra pointer in each
+ * chunk header.
+ */
+#ifdef HEAPMEM_CONF_TLSF
+#define HEAPMEM_TLSF HEAPMEM_CONF_TLSF
+#else
+#define HEAPMEM_TLSF 0
+#endif /* HEAPMEM_CONF_TLSF */
+
 #define ALIGN(size)						\
   (((size) + (HEAPMEM_ALIGNMENT - 1)) & ~(HEAPMEM_ALIGNMENT - 1))
 
@@ -133,6 +148,10 @@
 typedef struct chunk {
   struct chunk *prev;
   struct chunk *next;
+#if HEAPMEM_TLSF
+  /* The chunk that immediately precedes this one in memory. */
+  struct chunk *prev_phys;
+#endif /* HEAPMEM_TLSF */
   size_t size;
   uint8_t flags;
 #if HEAPMEM_DEBUG
@@ -147,7 +166,40 @@ static char heap_base[HEAPMEM_ARENA_SIZE];
 static size_t heap_usage;
 
 static chunk_t *first_chunk = (chunk_t *)heap_base;
+
+#if HEAPMEM_TLSF
+/*
+ * Each power-of-two size range (the first level) is split into
+ * TLSF_SL_COUNT linearly spaced size classes (the second level). The
+ * number of first-level ranges is chosen so that every chunk that
+ * fits in the arena has a size class.
+ */
+#define TLSF_SL_LOG2  3
+#define TLSF_SL_COUNT (1 << TLSF_SL_LOG2)
+
+#if HEAPMEM_ARENA_SIZE <= (1UL << 8)
+#define TLSF_FL_COUNT 8
+#elif HEAPMEM_ARENA_SIZE <= (1UL << 12)
+#define TLSF_FL_COUNT 12
+#elif HEAPMEM_ARENA_SIZE <= (1UL << 16)
+#define TLSF_FL_COUNT 16
+#elif HEAPMEM_ARENA_SIZE <= (1UL << 20)
+#define TLSF_FL_COUNT 20
+#elif HEAPMEM_ARENA_SIZE <= (1UL << 24)
+#define TLSF_FL_COUNT 24
+#else
+#define TLSF_FL_COUNT 32
+#endif
+
+static chunk_t *free_lists[TLSF_FL_COUNT][TLSF_SL_COUNT];
+static uint32_t fl_bitmap;
+static uint8_t sl_bitmap[TLSF_FL_COUNT];
+
+/* The chunk closest to the end of the heap footprint. */
+static chunk_t *last_chunk;
+#else /* HEAPMEM_TLSF */
 static chunk_t *free_list;
+#endif /* HEAPMEM_TLSF */
 
 /* extend_space: Increases the current footprint used in the heap, and
    returns a pointer to the old end. */
@@ -166,6 +218,253 @@ extend_space(size_t size)
   return old_usage;
 }
 
+#if HEAPMEM_TLSF
+/* tlsf_msb: Return the index of the most significant bit that is set. */
+static unsigned
+tlsf_msb(uint32_t x)
+{
+  unsigned bit;
+
+  bit = 0;
+  if(x >= (1UL << 16)) {
+    x >>= 16;
+    bit += 16;
+  }
+  if(x >= (1UL << 8)) {
+    x >>= 8;
+    bit += 8;
+  }
+  if(x >= (1UL << 4)) {
+    x >>= 4;
+    bit += 4;
+  }
+  if(x >= (1UL << 2)) {
+    x >>= 2;
+    bit += 2;
+  }
+  if(x >= (1UL << 1)) {
+    bit += 1;
+  }
+  return bit;
+}
+
+/* tlsf_lsb: Return the index of the least significant bit that is set. */
+static unsigned
+tlsf_lsb(uint32_t x)
+{
+  return tlsf_msb(x & -x);
+}
+
+/* tlsf_mapping: Get the size class of a chunk size. */
+static void
+tlsf_mapping(size_t size, unsigned *fl, unsigned *sl)
+{
+  *fl = tlsf_msb(size);
+  if(*fl < TLSF_SL_LOG2) {
+    *sl = 0;
+  } else {
+    *sl = (size >> (*fl - TLSF_SL_LOG2)) - TLSF_SL_COUNT;
+  }
+}
+
+/* tlsf_insert: Put a free chunk on the list of its size class. */
+static void
+tlsf_insert(chunk_t * const chunk)
+{
+  unsigned fl, sl;
+
+  tlsf_mapping(chunk->size, &fl, &sl);
+
+  chunk->prev = NULL;
+  chunk->next = free_lists[fl][sl];
+  if(chunk->next != NULL) {
+    chunk->next->prev = chunk;
+  }
+  free_lists[fl][sl] = chunk;
+
+  fl_bitmap |= 1UL << fl;
+  sl_bitmap[fl] |= 1 << sl;
+}
+
+/* tlsf_remove: Take a free chunk off the list of its size class. */
+static void
+tlsf_remove(chunk_t * const chunk)
+{
+  unsigned fl, sl;
+
+  tlsf_mapping(chunk->size, &fl, &sl);
+
+  if(chunk->prev != NULL) {
+    chunk->prev->next = chunk->next;
+  } else {
+    free_lists[fl][sl] = chunk->next;
+    if(chunk->next == NULL) {
+      sl_bitmap[fl] &= ~(1 << sl);
+      if(sl_bitmap[fl] == 0) {
+        fl_bitmap &= ~(1UL << fl);
+      }
+    }
+  }
+
+  if(chunk->next != NULL) {
+    chunk->next->prev = chunk->prev;
+  }
+}
+
+/* tlsf_find: Find a free chunk of at least the given size. The size
+   is rounded up to the next size class, so that any chunk in that
+   class or in a larger one is big enough. */
+static chunk_t *
+tlsf_find(size_t size)
+{
+  unsigned fl, sl;
+  uint32_t bits;
+
+  if(size >= HEAPMEM_ARENA_SIZE) {
+    return NULL;
+  }
+
+  fl = tlsf_msb(size);
+  if(fl < TLSF_SL_LOG2) {
+    if(size & (size - 1)) {
+      size = (size_t)1 << (fl + 1);
+    }
+  } else {
+    size += ((size_t)1 << (fl - TLSF_SL_LOG2)) - 1;
+  }
+  tlsf_mapping(size, &fl, &sl);
+  if(fl >= TLSF_FL_COUNT) {
+    return NULL;
+  }
+
+  bits = sl_bitmap[fl] & (~0UL << sl);
+  if(bits == 0) {
+    /* Nothing left in this range, use the smallest larger one. */
+    if(fl + 1 >= TLSF_FL_COUNT) {
+      return NULL;
+    }
+    bits = fl_bitmap & (~0UL << (fl + 1));
+    if(bits == 0) {
+      return NULL;
+    }
+    fl = tlsf_lsb(bits);
+    bits = sl_bitmap[fl];
+  }
+  sl = tlsf_lsb(bits);
+
+  return free_lists[fl][sl];
+}
+
+/* link_next_chunk: Update the physical link of the chunk that follows
+   a chunk whose size has changed. */
+static void
+link_next_chunk(chunk_t * const chunk)
+{
+  if(IS_LAST_CHUNK(chunk)) {
+    last_chunk = chunk;
+  } else {
+    NEXT_CHUNK(chunk)->prev_phys = chunk;
+  }
+}
+
+/* free_chunk: Mark a chunk as being free, merge it with its free
+   neighbors, and put it on the free list of its size class. */
+static void
+free_chunk(chunk_t *chunk)
+{
+  chunk_t *neighbor;
+
+  chunk->flags &= ~CHUNK_FLAG_ALLOCATED;
+
+  if(!IS_LAST_CHUNK(chunk)) {
+    neighbor = NEXT_CHUNK(chunk);
+    if(CHUNK_FREE(neighbor)) {
+      tlsf_remove(neighbor);
+      chunk->size += sizeof(chunk_t) + neighbor->size;
+    }
+  }
+
+  neighbor = chunk->prev_phys;
+  if(neighbor != NULL && CHUNK_FREE(neighbor)) {
+    tlsf_remove(neighbor);
+    neighbor->size += sizeof(chunk_t) + chunk->size;
+    chunk = neighbor;
+  }
+
+  if(IS_LAST_CHUNK(chunk)) {
+    /* Release the chunk back into the wilderness. */
+    heap_usage -= sizeof(chunk_t) + chunk->size;
+    last_chunk = chunk->prev_phys;
+  } else {
+    NEXT_CHUNK(chunk)->prev_phys = chunk;
+    tlsf_insert(chunk);
+  }
+}
+
+/* allocate_chunk: Mark a chunk as being allocated, and remove it
+   from the free list. */
+static void
+allocate_chunk(chunk_t * const chunk)
+{
+  chunk->flags |= CHUNK_FLAG_ALLOCATED;
+  tlsf_remove(chunk);
+}
+
+/*
+ * split_chunk: When allocating a chunk, we may have found one that is
+ * larger than needed, so this function is called to keep the rest of
+ * the original chunk free.
+ */
+static void
+split_chunk(chunk_t * const chunk, size_t offset)
+{
+  chunk_t *new_chunk;
+
+  offset = ALIGN(offset);
+
+  if(offset + sizeof(chunk_t) < chunk->size) {
+    new_chunk = (chunk_t *)(GET_PTR(chunk) + offset);
+    new_chunk->size = chunk->size - sizeof(chunk_t) - offset;
+    new_chunk->flags = CHUNK_FLAG_ALLOCATED;
+    new_chunk->prev_phys = chunk;
+    chunk->size = offset;
+
+    link_next_chunk(new_chunk);
+    free_chunk(new_chunk);
+  }
+}
+
+/* coalesce_chunks: Merge an allocated chunk with the free chunk that
+   follows it, if any. Free chunks are never adjacent to each other. */
+static void
+coalesce_chunks(chunk_t *chunk)
+{
+  chunk_t *next;
+
+  next = NEXT_CHUNK(chunk);
+  if((char *)next < &heap_base[heap_usage] && CHUNK_FREE(next)) {
+    tlsf_remove(next);
+    chunk->size += sizeof(chunk_t) + next->size;
+    link_next_chunk(chunk);
+  }
+}
+
+/* get_free_chunk: Take a chunk from the smallest size class that is
+   guaranteed to satisfy an allocation request. */
+static chunk_t *
+get_free_chunk(const size_t size)
+{
+  chunk_t *chunk;
+
+  chunk = tlsf_find(size);
+  if(chunk != NULL) {
+    allocate_chunk(chunk);
+    split_chunk(chunk, size);
+  }
+
+  return chunk;
+}
+#else /* HEAPMEM_TLSF */
 /* free_chunk: Mark a chunk as being free, and put it on the free list. */
 static void
 free_chunk(chunk_t * const chunk)
@@ -305,6 +604,7 @@ get_free_chunk(const size_t size)
 
   return best;
 }
+#endif /* HEAPMEM_TLSF */
 
 /*
  * heapmem_alloc: Allocate an object of the specified size, returning
@@ -315,7 +615,9 @@ get_free_chunk(const size_t size)
  * find, we pick a larger chunk that is as close in size as possible,
  * and possibly split it so that the remaining part becomes a chunk
  * available for allocation.  At most CHUNK_SEARCH_MAX chunks on the
- * free list will be examined.
+ * free list will be examined. With HEAPMEM_CONF_TLSF, the chunk is
+ * instead taken directly from the smallest non-empty size class that
+ * is large enough.
  *
  * As a last resort, heapmem_alloc() will try to extend the heap
  * space, and thereby create a new chunk available for use.
@@ -338,6 +640,10 @@ heapmem_alloc(size_t size)
       return NULL;
     }
     chunk->size = size;
+#if HEAPMEM_TLSF
+    chunk->prev_phys = last_chunk;
+    last_chunk = chunk;
+#endif /* HEAPMEM_TLSF */
   }
 
   chunk->flags = CHUNK_FLAG_ALLOCATED;
@@ -497,12 +803,28 @@ heapmem_stats(heapmem_stats_t *stats)
     if(CHUNK_ALLOCATED(chunk)) {
       stats->allocated += chunk->size;
     } else {
+#if !HEAPMEM_TLSF
       coalesce_chunks(chunk);
+#endif /* !HEAPMEM_TLSF */
       stats->available += chunk->size;
+      stats->free_chunks++;
+      if(chunk->size > stats->largest_free) {
+        stats->largest_free = chunk->size;
+      }
     }
     stats->overhead += sizeof(chunk_t);
   }
   stats->available += HEAPMEM_ARENA_SIZE - heap_usage;
+  if(HEAPMEM_ARENA_SIZE - heap_usage > stats->largest_free) {
+    stats->largest_free = HEAPMEM_ARENA_SIZE - heap_usage;
+  }
   stats->footprint = heap_usage;
   stats->chunks = stats->overhead / sizeof(chunk_t);
+
+  /* The share of the free space that lies outside the largest free
+     block, and thus cannot serve a single large allocation. */
+  if(stats->available > 0) {
+    stats->fragmentation = 100 -
+      (unsigned)((stats->largest_free * 100) / stats->available);
+  }
 }
@@ -47,6 +47,10 @@
  * adds some memory overhead compared to a single-linked list, it
  * improves the performance of list management.
  *
+ * By setting HEAPMEM_CONF_TLSF, the free chunks are instead kept in
+ * segregated lists per size class (Two-Level Segregated Fit), which
+ * bounds the time of every allocation and deallocation.
+ *
  * Internally, allocated chunks can be retrieved using the pointer to
  * the allocated memory returned by heapmem_alloc() and
  * heapmem_realloc(), because the chunk structure immediately precedes
@@ -82,6 +86,13 @@ typedef struct heapmem_stats {
   size_t available;
   size_t footprint;
   size_t chunks;
+  /* The number of free chunks, not counting the unused end of the heap. */
+  size_t free_chunks;
+  /* The size of the largest contiguous free block. */
+  size_t largest_free;
+  /* The percentage of the available memory that lies outside the
+     largest free block. */
+  unsigned fragmentation;
 } heapmem_stats_t;
 
 #if HEAPMEM_DEBUG
@@ -154,8 +165,10 @@ void heapmem_free(void *ptr);
  * This function makes it possible to gain visibility into the internal
  * structure of the heap. One can thus obtain information regarding
  * the amount of memory allocated, overhead used for memory management,
- * and the number of chunks allocated. By using this information, developers
- * can tune their software to use the heapmem allocator more efficiently.
+ * and the number of chunks allocated. The largest free block and the
+ * fragmentation percentage tell how large an allocation can still
+ * succeed. By using this information, developers can tune their
+ * software to use the heapmem allocator more efficiently.
  *
  */
 
@@ -0,0 +1,420 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * \file
+ *      Pipelined blockwise transfers for CoAP. The client requests several
+ *      Block2 blocks at once, each with its own message, and retransmits
+ *      only the blocks whose response is lost. The blocks are handed over
+ *      in the order they arrive.
+ */
+
+/**
+ * \addtogroup coap
+ * @{
+ */
+
+#include "coap-block-window.h"
+#include "lib/list.h"
+#include "sys/cc.h"
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+/* Log configuration */
+#include "coap-log.h"
+#define LOG_MODULE "coap"
+#define LOG_LEVEL  LOG_LEVEL_COAP
+
+LIST(requests_list);
+
+static void send_blocks(coap_block_window_request_t *r);
+
+/*---------------------------------------------------------------------------*/
+/*- Block tracking ----------------------------------------------------------*/
+/*---------------------------------------------------------------------------*/
+void
+coap_block_tracker_init(coap_block_tracker_t *tracker)
+{
+  memset(tracker, 0, sizeof(coap_block_tracker_t));
+}
+/*---------------------------------------------------------------------------*/
+int
+coap_block_tracker_add(coap_block_tracker_t *tracker, uint32_t num,
+                       uint8_t more)
+{
+  uint32_t bit;
+
+  if(num < tracker->base) {
+    return 0;
+  }
+  if(num - tracker->base >= COAP_BLOCK_TRACKER_WINDOW) {
+    return -1;
+  }
+  bit = (uint32_t)1 << (num - tracker->base);
+  if(tracker->received & bit) {
+    return 0;
+  }
+  tracker->received |= bit;
+  if(!more) {
+    tracker->last = num;
+    tracker->has_last = 1;
+  }
+  /* Slide the window past the blocks received without gap */
+  while(tracker->received & 1) {
+    tracker->received >>= 1;
+    tracker->base++;
+  }
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+int
+coap_block_tracker_is_complete(const coap_block_tracker_t *tracker)
+{
+  return tracker->has_last && tracker->base > tracker->last;
+}
+/*---------------------------------------------------------------------------*/
+/*- Client Part -------------------------------------------------------------*/
+/*---------------------------------------------------------------------------*/
+static void
+stop_slot(coap_block_window_slot_t *slot)
+{
+  coap_timer_stop(&slot->retrans_timer);
+  if(slot->transaction != NULL) {
+    coap_clear_transaction(slot->transaction);
+    slot->transaction = NULL;
+  }
+  slot->active = 0;
+}
+/*---------------------------------------------------------------------------*/
+static void
+finish(coap_block_window_request_t *r, coap_request_status_t status)
+{
+  coap_block_window_cancel(r);
+  LOG_DBG("Blockwise transfer ended (%u), %"PRIu32" blocks\n",
+          status, r->blocks);
+  r->status = status;
+  r->callback(r, 0, NULL, 0);
+}
+/*---------------------------------------------------------------------------*/
+static void transaction_callback(void *data, coap_message_t *response);
+static void retransmit_block(coap_timer_t *timer);
+
+static int
+send_block(coap_block_window_slot_t *slot)
+{
+  coap_block_window_request_t *r = slot->request;
+  coap_message_t request[1];
+  coap_transaction_t *t;
+
+  coap_init_message(request, r->type, COAP_GET, coap_get_mid());
+  coap_set_header_uri_path(request, r->path);
+  coap_set_token(request, r->token, sizeof(r->token));
+  coap_set_header_block2(request, slot->num, 0, r->block_size);
+
+  if((t = coap_new_transaction(request->mid, &r->endpoint)) == NULL) {
+    return 0;
+  }
+  t->message_len = coap_serialize_message(request, t->message);
+  if(r->type == COAP_TYPE_CON) {
+    t->callback = transaction_callback;
+    t->callback_data = slot;
+    slot->transaction = t;
+    coap_send_transaction(t);
+  } else {
+    /* Sent and freed right away, the slot keeps track of the timeout */
+    coap_send_transaction(t);
+    coap_timer_set_callback(&slot->retrans_timer, retransmit_block);
+    coap_timer_set_user_data(&slot->retrans_timer, slot);
+    coap_timer_set(&slot->retrans_timer, slot->retrans_interval);
+  }
+  LOG_DBG("Requested block %"PRIu32" (MID %u)\n", slot->num, request->mid);
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static void
+retransmit_block(coap_timer_t *timer)
+{
+  coap_block_window_slot_t *slot = coap_timer_get_user_data(timer);
+  coap_block_window_request_t *r = slot->request;
+
+  if(++(slot->retrans_counter) > COAP_MAX_RETRANSMIT) {
+    LOG_WARN("Block %"PRIu32" timed out\n", slot->num);
+    finish(r, COAP_REQUEST_STATUS_TIMEOUT);
+    return;
+  }
+#if COAP_WITH_COCOA
+  slot->retrans_interval = coap_cocoa_backoff(slot->retrans_interval,
+                                              slot->retrans_interval);
+#else /* COAP_WITH_COCOA */
+  slot->retrans_interval <<= 1;
+#endif /* COAP_WITH_COCOA */
+  r->retransmissions++;
+  if(!send_block(slot)) {
+    /* No transaction buffer for now, try again later */
+    coap_timer_set(&slot->retrans_timer, slot->retrans_interval);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+handle_response(coap_block_window_slot_t *slot, coap_message_t *response)
+{
+  coap_block_window_request_t *r = slot->request;
+  uint32_t num = 0;
+  uint8_t more = 0;
+  uint16_t size = r->block_size;
+  uint32_t base = r->tracker.base;
+  const uint8_t *payload;
+  int len;
+
+  if(response->code == 0) {
+    /* Empty ACK, the response will be sent separately: wait as long as
+     * the last retransmission would */
+    slot->transaction = NULL;
+    slot->retrans_counter = COAP_MAX_RETRANSMIT;
+    coap_timer_set_callback(&slot->retrans_timer, retransmit_block);
+    coap_timer_set_user_data(&slot->retrans_timer, slot);
+    coap_timer_set(&slot->retrans_timer,
+                   (uint32_t)COAP_RESPONSE_TIMEOUT_TICKS << COAP_MAX_RETRANSMIT);
+    return;
+  }
+
+  slot->transaction = NULL;
+  stop_slot(slot);
+
+  if(response->code >= BAD_REQUEST_4_00) {
+    if(response->code == BAD_OPTION_4_02 && slot->num > 0) {
+      /* Requested past the end of the resource */
+      if(slot->num < r->end) {
+        r->end = slot->num;
+      }
+    } else {
+      LOG_WARN("Block %"PRIu32" failed: %u\n", slot->num, response->code);
+      r->response_code = response->code;
+      finish(r, COAP_REQUEST_STATUS_BLOCK_ERROR);
+      return;
+    }
+  } else {
+    coap_get_header_block2(response, &num, &more, &size, NULL);
+    if(num == 0 && base == 0 && size < r->block_size) {
+      /* The server asks for smaller blocks */
+      r->block_size = size;
+    }
+    if(num != slot->num || size != r->block_size) {
+      LOG_WARN("WRONG BLOCK %"PRIu32"/%"PRIu32"\n", num, slot->num);
+      finish(r, COAP_REQUEST_STATUS_BLOCK_ERROR);
+      return;
+    }
+    if(coap_block_tracker_add(&r->tracker, num, more) == 1) {
+      r->blocks++;
+      if(num != base) {
+        r->out_of_order++;
+      }
+      len = coap_get_payload(response, &payload);
+      r->status = COAP_REQUEST_STATUS_MORE;
+      r->callback(r, num * r->block_size, payload, len);
+      if(!r->active) {
+        /* Cancelled from the callback */
+        return;
+      }
+    } else {
+      r->duplicates++;
+    }
+    if(!more && num + 1 < r->end) {
+      r->end = num + 1;
+    }
+  }
+
+  if(coap_block_tracker_is_complete(&r->tracker)) {
+    finish(r, COAP_REQUEST_STATUS_FINISHED);
+  } else {
+    send_blocks(r);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+transaction_callback(void *data, coap_message_t *response)
+{
+  coap_block_window_slot_t *slot = data;
+
+  /* The transaction is freed by the caller */
+  slot->transaction = NULL;
+  if(response == NULL) {
+    LOG_WARN("Block %"PRIu32" timed out\n", slot->num);
+    finish(slot->request, COAP_REQUEST_STATUS_TIMEOUT);
+    return;
+  }
+  handle_response(slot, response);
+}
+/*---------------------------------------------------------------------------*/
+/* Request the next block in a free slot */
+static int
+start_slot(coap_block_window_request_t *r, coap_block_window_slot_t *slot)
+{
+  slot->num = r->next_num;
+  slot->retrans_counter = 0;
+#if COAP_WITH_COCOA
+  /* Only confirmable blocks feed the estimate back, see
+     coap_block_window_get() */
+  slot->retrans_interval = coap_cocoa_initial_interval(&r->endpoint);
+#else /* COAP_WITH_COCOA */
+  slot->retrans_interval = COAP_RESPONSE_TIMEOUT_TICKS
+    + (rand() % COAP_RESPONSE_TIMEOUT_BACKOFF_MASK);
+#endif /* COAP_WITH_COCOA */
+  if(!send_block(slot)) {
+    return 0;
+  }
+  slot->active = 1;
+  r->next_num++;
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+/* Fill the window with requests for the next blocks */
+static void
+send_blocks(coap_block_window_request_t *r)
+{
+  /* Request a single block until the block size is settled */
+  uint8_t window = r->tracker.base == 0 ? 1 : r->window;
+  uint8_t active = 0;
+  int i;
+
+  for(i = 0; i < r->window; i++) {
+    active += r->slots[i].active;
+  }
+
+  for(i = 0; i < r->window && active < window; i++) {
+    coap_block_window_slot_t *slot = &r->slots[i];
+    if(slot->active) {
+      continue;
+    }
+    if(r->next_num >= r->end
+       || (r->tracker.has_last && r->next_num > r->tracker.last)
+       || r->next_num - r->tracker.base >= COAP_BLOCK_TRACKER_WINDOW) {
+      break;
+    }
+    if(!start_slot(r, slot)) {
+      /* Out of transactions, send more when a response arrives */
+      break;
+    }
+    active++;
+  }
+
+  if(active == 0) {
+    /* Nothing in flight and nothing more to ask for */
+    LOG_WARN("Blockwise transfer stalled at block %"PRIu32"\n",
+             r->tracker.base);
+    finish(r, COAP_REQUEST_STATUS_BLOCK_ERROR);
+  }
+}
+/*---------------------------------------------------------------------------*/
+int
+coap_block_window_get(coap_block_window_request_t *r,
+                      const coap_endpoint_t *endpoint, const char *path,
+                      coap_message_type_t type, uint8_t window,
+                      coap_block_window_callback_t callback)
+{
+  int i;
+
+  memset(r, 0, sizeof(coap_block_window_request_t));
+  coap_endpoint_copy(&r->endpoint, endpoint);
+  r->path = path;
+  r->type = type;
+  r->window = MAX(1, MIN(window, COAP_BLOCK_WINDOW_SIZE));
+  r->block_size = COAP_MAX_BLOCK_SIZE;
+  r->end = UINT32_MAX;
+  r->token[0] = rand();
+  r->token[1] = rand();
+  r->callback = callback;
+  for(i = 0; i < COAP_BLOCK_WINDOW_SIZE; i++) {
+    r->slots[i].request = r;
+  }
+  coap_block_tracker_init(&r->tracker);
+
+  /* The first block settles the block size before the window opens */
+  if(!start_slot(r, &r->slots[0])) {
+    LOG_WARN("Could not allocate transaction buffer\n");
+    return 0;
+  }
+  list_add(requests_list, r);
+  r->active = 1;
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+void
+coap_block_window_cancel(coap_block_window_request_t *r)
+{
+  int i;
+
+  for(i = 0; i < COAP_BLOCK_WINDOW_SIZE; i++) {
+    if(r->slots[i].active) {
+      stop_slot(&r->slots[i]);
+    }
+  }
+  list_remove(requests_list, r);
+  r->active = 0;
+}
+/*---------------------------------------------------------------------------*/
+int
+coap_block_window_receive(const coap_endpoint_t *src,
+                          coap_message_t *response)
+{
+  coap_block_window_request_t *r;
+  uint32_t num = 0;
+  int i;
+
+  for(r = list_head(requests_list); r != NULL; r = r->next) {
+    if(response->token_len == sizeof(r->token)
+       && memcmp(response->token, r->token, sizeof(r->token)) == 0
+       && coap_endpoint_cmp(&r->endpoint, src)) {
+      break;
+    }
+  }
+  if(r == NULL) {
+    return 0;
+  }
+
+  if(response->type == COAP_TYPE_CON) {
+    /* Acknowledge a separate response */
+    coap_message_t ack[1];
+    uint8_t buffer[COAP_HEADER_LEN];
+    coap_init_message(ack, COAP_TYPE_ACK, 0, response->mid);
+    coap_sendto(src, buffer, coap_serialize_message(ack, buffer));
+  }
+
+  coap_get_header_block2(response, &num, NULL, NULL, NULL);
+  for(i = 0; i < COAP_BLOCK_WINDOW_SIZE; i++) {
+    if(r->slots[i].active && r->slots[i].num == num) {
+      handle_response(&r->slots[i], response);
+      return 1;
+    }
+  }
+  /* A late response to a retransmitted block */
+  r->duplicates++;
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+/** @} */
@@ -0,0 +1,166 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * \file
+ *      Pipelined blockwise transfers for CoAP
+ */
+
+/**
+ * \addtogroup coap
+ * @{
+ */
+
+#ifndef COAP_BLOCK_WINDOW_H_
+#define COAP_BLOCK_WINDOW_H_
+
+#include "coap-engine.h"
+#include "coap-transactions.h"
+#include "coap-request-state.h"
+
+#if COAP_BLOCK_WINDOW_SIZE > 32
+#error COAP_BLOCK_WINDOW_SIZE must be at most 32
+#endif
+
+/* The number of blocks after the first missing one that can be tracked */
+#define COAP_BLOCK_TRACKER_WINDOW 32
+
+/*---------------------------------------------------------------------------*/
+/*- Block tracking ----------------------------------------------------------*/
+/*---------------------------------------------------------------------------*/
+/* The blocks of a transfer received so far, in any order */
+typedef struct coap_block_tracker {
+  uint32_t base;        /* the first block not received yet */
+  uint32_t received;    /* bit i is set if block base + i was received */
+  uint32_t last;        /* the number of the final block, if has_last */
+  uint8_t has_last;
+} coap_block_tracker_t;
+
+void coap_block_tracker_init(coap_block_tracker_t *tracker);
+
+/**
+ * \brief Record the arrival of a block
+ * \param num The number of the block
+ * \param more The more flag of the block, 0 for the final one
+ * \return 1 if the block is new, 0 if it was received before, -1 if it is
+ * too far ahead of the first missing block to be tracked
+ */
+int coap_block_tracker_add(coap_block_tracker_t *tracker, uint32_t num,
+                           uint8_t more);
+
+/**
+ * \brief Check if all blocks up to the final one were received
+ */
+int coap_block_tracker_is_complete(const coap_block_tracker_t *tracker);
+
+/*---------------------------------------------------------------------------*/
+/*- Client Part -------------------------------------------------------------*/
+/*---------------------------------------------------------------------------*/
+typedef struct coap_block_window_request coap_block_window_request_t;
+
+/* Called with each new block, which may arrive in any order, with status
+ * COAP_REQUEST_STATUS_MORE. Called once more without data when the
+ * transfer ends, with status COAP_REQUEST_STATUS_FINISHED,
+ * COAP_REQUEST_STATUS_TIMEOUT or COAP_REQUEST_STATUS_BLOCK_ERROR. */
+typedef void (* coap_block_window_callback_t)(coap_block_window_request_t *request,
+                                              uint32_t offset,
+                                              const uint8_t *data,
+                                              uint16_t len);
+
+/* A block in flight */
+typedef struct coap_block_window_slot {
+  coap_block_window_request_t *request;
+  coap_transaction_t *transaction;  /* confirmable requests */
+  coap_timer_t retrans_timer;       /* non-confirmable requests */
+  uint32_t retrans_interval;
+  uint32_t num;
+  uint8_t retrans_counter;
+  uint8_t active;
+} coap_block_window_slot_t;
+
+struct coap_block_window_request {
+  coap_block_window_request_t *next;    /* for LIST */
+  coap_endpoint_t endpoint;
+  const char *path;
+  coap_message_type_t type;
+  uint8_t window;
+  uint16_t block_size;
+  uint32_t next_num;    /* the next block to request */
+  uint32_t end;         /* the server has no blocks from this one on */
+  coap_block_tracker_t tracker;
+  uint8_t token[2];
+  uint8_t active;       /* cleared when the transfer ends or is cancelled */
+  coap_request_status_t status;
+  coap_status_t response_code;  /* of the error that ended the transfer */
+  coap_block_window_callback_t callback;
+  void *user_data;
+  coap_block_window_slot_t slots[COAP_BLOCK_WINDOW_SIZE];
+
+  /* Statistics */
+  uint32_t blocks;              /* new blocks received */
+  uint32_t out_of_order;        /* of which before an earlier block */
+  uint32_t duplicates;          /* blocks received again */
+  uint32_t retransmissions;     /* of non-confirmable requests */
+};
+
+/**
+ * \brief Download a resource blockwise, with several blocks in flight
+ * \param request The state of the transfer, which must remain valid
+ * until its end, as must the path
+ * \param endpoint The server
+ * \param path The URI path of the resource
+ * \param type COAP_TYPE_CON to retransmit through transactions, or
+ * COAP_TYPE_NON to retransmit lost blocks after a timeout. With
+ * COAP_WITH_COCOA, non-confirmable blocks start from the RTO estimate of
+ * the endpoint but never update it: their transaction is freed once
+ * sent, so no round-trip time reaches coap_cocoa_update().
+ * \param window The maximum number of blocks in flight, up to
+ * COAP_BLOCK_WINDOW_SIZE
+ * \param callback Called with each block and at the end of the transfer
+ * \return 1 if the first request was sent, 0 otherwise
+ */
+int coap_block_window_get(coap_block_window_request_t *request,
+                          const coap_endpoint_t *endpoint, const char *path,
+                          coap_message_type_t type, uint8_t window,
+                          coap_block_window_callback_t callback);
+
+/**
+ * \brief Stop a transfer without calling its callback. May be called
+ * from the callback.
+ */
+void coap_block_window_cancel(coap_block_window_request_t *request);
+
+/**
+ * \brief Handle a response that matches no transaction, e.g. the response
+ * to a non-confirmable request. Called by the CoAP engine.
+ * \return 1 if the response belongs to a transfer, 0 otherwise
+ */
+int coap_block_window_receive(const coap_endpoint_t *src,
+                              coap_message_t *response);
+
+#endif /* COAP_BLOCK_WINDOW_H_ */
+/** @} */
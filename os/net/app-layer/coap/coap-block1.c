@@ -117,4 +117,80 @@ coap_block1_handler(coap_message_t *request, coap_message_t *response,
   return 0;
 }
 /*---------------------------------------------------------------------------*/
+/**
+ * \brief Block 1 support for pipelined uploads
+ *
+ *        Like coap_block1_handler(), but accepts the blocks in any order,
+ *        e.g. from a client that keeps several blocks in flight. The
+ *        tracker records the blocks received so far, it must be
+ *        initialized with coap_block_tracker_init() before a transfer,
+ *        and *len set to 0.
+ *
+ * \param request   Request pointer from the handler
+ * \param response  Response pointer from the handler
+ * \param tracker   The blocks of the transfer received so far
+ * \param target    Pointer to the buffer where the request payload can be assembled
+ * \param len       Pointer to the variable, where the function stores the length assembled so far
+ * \param max_len   Length of the "target"-Buffer
+ *
+ * \return 0 if all blocks were received
+ *         1 if more blocks are expected
+ *         -1 on error
+ */
+int
+coap_block1_window_handler(coap_message_t *request, coap_message_t *response,
+                           coap_block_tracker_t *tracker,
+                           uint8_t *target, size_t *len, size_t max_len)
+{
+  const uint8_t *payload = 0;
+  int pay_len = coap_get_payload(request, &payload);
+  int added;
+
+  if(!coap_is_option(request, COAP_OPTION_BLOCK1)) {
+    return coap_block1_handler(request, response, target, len, max_len);
+  }
+
+  if(!pay_len || !payload) {
+    coap_status_code = BAD_REQUEST_4_00;
+    coap_error_message = "NoPayload";
+    return -1;
+  }
+
+  if(request->block1_offset + pay_len > max_len) {
+    coap_status_code = REQUEST_ENTITY_TOO_LARGE_4_13;
+    coap_error_message = "Message to big";
+    return -1;
+  }
+
+  added = coap_block_tracker_add(tracker, request->block1_num,
+                                 request->block1_more);
+  if(added < 0) {
+    coap_status_code = REQUEST_ENTITY_INCOMPLETE_4_08;
+    coap_error_message = "BlockOutOfWindow";
+    return -1;
+  }
+
+  if(added && target && len) {
+    memcpy(target + request->block1_offset, payload, pay_len);
+    if(request->block1_offset + pay_len > *len) {
+      *len = request->block1_offset + pay_len;
+    }
+  }
+
+  LOG_DBG("Blockwise: windowed block 1 request: Num: %"PRIu32
+          ", More: %u, Size: %u, Offset: %"PRIu32"%s\n",
+          request->block1_num, request->block1_more,
+          request->block1_size, request->block1_offset,
+          added ? "" : " (duplicate)");
+
+  coap_set_header_block1(response, request->block1_num,
+                         request->block1_more, request->block1_size);
+  if(!coap_block_tracker_is_complete(tracker)) {
+    coap_set_status_code(response, CONTINUE_2_31);
+    return 1;
+  }
+
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
 /** @} */
@@ -45,11 +45,16 @@
 #define COAP_BLOCK1_H_
 
 #include "coap.h"
+#include "coap-block-window.h"
 #include <stddef.h>
 #include <stdint.h>
 
 int coap_block1_handler(coap_message_t *request, coap_message_t *response,
                         uint8_t *target, size_t *len, size_t max_len);
+int coap_block1_window_handler(coap_message_t *request,
+                               coap_message_t *response,
+                               coap_block_tracker_t *tracker,
+                               uint8_t *target, size_t *len, size_t max_len);
 
 #endif /* COAP_BLOCK1_H_ */
 /** @} */
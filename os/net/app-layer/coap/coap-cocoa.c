@@ -0,0 +1,224 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * \file
+ *      CoCoA retransmission timeout estimation for CoAP. Keeps a strong
+ *      estimator fed by responses to first transmissions and a weak one
+ *      fed by responses to retransmissions, per endpoint, and blends them
+ *      into the RTO used for the next confirmable messages.
+ */
+
+/**
+ * \addtogroup coap
+ * @{
+ */
+
+#include "coap-cocoa.h"
+#include "coap-timer.h"
+#include "lib/memb.h"
+#include "lib/list.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* Log configuration */
+#include "coap-log.h"
+#define LOG_MODULE "coap"
+#define LOG_LEVEL  LOG_LEVEL_COAP
+
+#if COAP_WITH_COCOA
+
+typedef struct cocoa_endpoint {
+  struct cocoa_endpoint *next;  /* for LIST, most recently used first */
+  coap_endpoint_t endpoint;
+  coap_cocoa_state_t state;
+  uint64_t last_update;         /* uptime of the last update of the RTO */
+} cocoa_endpoint_t;
+
+MEMB(cocoa_endpoints_memb, cocoa_endpoint_t, COAP_COCOA_ENDPOINTS);
+LIST(cocoa_endpoints_list);
+
+/*---------------------------------------------------------------------------*/
+static cocoa_endpoint_t *
+find_endpoint(const coap_endpoint_t *endpoint)
+{
+  cocoa_endpoint_t *e;
+
+  for(e = list_head(cocoa_endpoints_list); e != NULL; e = e->next) {
+    if(coap_endpoint_cmp(&e->endpoint, endpoint)) {
+      /* Keep the list in least recently used order for replacement */
+      list_remove(cocoa_endpoints_list, e);
+      list_push(cocoa_endpoints_list, e);
+      return e;
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+static cocoa_endpoint_t *
+add_endpoint(const coap_endpoint_t *endpoint)
+{
+  cocoa_endpoint_t *e = memb_alloc(&cocoa_endpoints_memb);
+
+  if(e == NULL) {
+    /* Replace the least recently used endpoint */
+    e = list_chop(cocoa_endpoints_list);
+    LOG_DBG("Replacing RTO estimate of ");
+    LOG_DBG_COAP_EP(&e->endpoint);
+    LOG_DBG_("\n");
+  }
+  memset(e, 0, sizeof(cocoa_endpoint_t));
+  coap_endpoint_copy(&e->endpoint, endpoint);
+  e->state.rto = COAP_COCOA_DEFAULT_RTO;
+  e->last_update = coap_timer_uptime();
+  list_push(cocoa_endpoints_list, e);
+  return e;
+}
+/*---------------------------------------------------------------------------*/
+/* Move estimates that have not been updated for a while back towards the
+ * default, as they may be outdated */
+static void
+age_rto(cocoa_endpoint_t *e)
+{
+  uint64_t now = coap_timer_uptime();
+  uint64_t elapsed = now - e->last_update;
+
+  if(e->state.rto < 1000 && elapsed > 16 * (uint64_t)e->state.rto) {
+    e->state.rto *= 2;
+    e->last_update = now;
+  } else if(e->state.rto > 3000 && elapsed > 4 * (uint64_t)e->state.rto) {
+    e->state.rto = (COAP_COCOA_DEFAULT_RTO + e->state.rto) / 2;
+    e->last_update = now;
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* One step of the RFC 6298 estimator, returns the RTO of the estimator */
+static uint32_t
+estimate(uint32_t *srtt, uint32_t *rttvar, uint16_t samples, uint32_t rtt,
+         uint32_t k)
+{
+  if(samples == 0) {
+    *srtt = rtt;
+    *rttvar = rtt / 2;
+  } else {
+    uint32_t delta = *srtt > rtt ? *srtt - rtt : rtt - *srtt;
+    *rttvar = (3 * *rttvar + delta) / 4;
+    *srtt = (7 * *srtt + rtt) / 8;
+  }
+  return *srtt + k * *rttvar;
+}
+/*---------------------------------------------------------------------------*/
+void
+coap_cocoa_init(void)
+{
+  memb_init(&cocoa_endpoints_memb);
+  list_init(cocoa_endpoints_list);
+}
+/*---------------------------------------------------------------------------*/
+uint32_t
+coap_cocoa_initial_interval(const coap_endpoint_t *endpoint)
+{
+  cocoa_endpoint_t *e = find_endpoint(endpoint);
+  uint32_t rto = COAP_COCOA_DEFAULT_RTO;
+
+  if(e != NULL) {
+    age_rto(e);
+    rto = e->state.rto;
+  }
+  return rto + (rand() % (rto / 2 + 1));
+}
+/*---------------------------------------------------------------------------*/
+uint32_t
+coap_cocoa_backoff(uint32_t interval, uint32_t initial_interval)
+{
+  /* Back off faster from short RTOs and slower from long ones */
+  if(initial_interval < 1000) {
+    interval *= 3;
+  } else if(initial_interval > 3000) {
+    interval += interval / 2;
+  } else {
+    interval *= 2;
+  }
+  return interval;
+}
+/*---------------------------------------------------------------------------*/
+void
+coap_cocoa_update(const coap_endpoint_t *endpoint, uint32_t rtt,
+                  uint8_t retransmissions)
+{
+  cocoa_endpoint_t *e;
+  coap_cocoa_state_t *s;
+  uint32_t rto;
+
+  if(retransmissions > COAP_COCOA_MAX_WEAK_RETRANSMIT) {
+    return;
+  }
+
+  e = find_endpoint(endpoint);
+  if(e == NULL) {
+    e = add_endpoint(endpoint);
+  }
+  s = &e->state;
+
+  if(retransmissions == 0) {
+    rto = estimate(&s->srtt_strong, &s->rttvar_strong, s->strong_samples,
+                   rtt, 4);
+    s->rto = (s->rto + rto) / 2;
+    s->strong_samples++;
+  } else {
+    rto = estimate(&s->srtt_weak, &s->rttvar_weak, s->weak_samples, rtt, 1);
+    s->rto = (3 * s->rto + rto) / 4;
+    s->weak_samples++;
+  }
+
+  if(s->rto < COAP_COCOA_MIN_RTO) {
+    s->rto = COAP_COCOA_MIN_RTO;
+  } else if(s->rto > COAP_COCOA_MAX_RTO) {
+    s->rto = COAP_COCOA_MAX_RTO;
+  }
+  e->last_update = coap_timer_uptime();
+
+  LOG_DBG("%s RTT %lu ms, RTO %lu ms\n", retransmissions ? "Weak" : "Strong",
+          (unsigned long)rtt, (unsigned long)s->rto);
+}
+/*---------------------------------------------------------------------------*/
+int
+coap_cocoa_get_state(const coap_endpoint_t *endpoint,
+                     coap_cocoa_state_t *state)
+{
+  cocoa_endpoint_t *e = find_endpoint(endpoint);
+
+  if(e == NULL) {
+    return 0;
+  }
+  age_rto(e);
+  *state = e->state;
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+#endif /* COAP_WITH_COCOA */
+/** @} */
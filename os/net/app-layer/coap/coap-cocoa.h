@@ -0,0 +1,93 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * \file
+ *      CoCoA retransmission timeout estimation for CoAP
+ */
+
+/**
+ * \addtogroup coap
+ * @{
+ */
+
+#ifndef COAP_COCOA_H_
+#define COAP_COCOA_H_
+
+#include "coap.h"
+
+/* The RTO of endpoints without any measurement, in ms */
+#define COAP_COCOA_DEFAULT_RTO          2000
+/* Bounds of the RTO estimate, in ms */
+#define COAP_COCOA_MIN_RTO              100
+#define COAP_COCOA_MAX_RTO              32000
+/* Responses to later retransmissions are too ambiguous to be measured */
+#define COAP_COCOA_MAX_WEAK_RETRANSMIT  2
+
+/* The state of the estimator for an endpoint */
+typedef struct coap_cocoa_state {
+  uint32_t rto;                 /* the overall RTO, in ms */
+  uint32_t srtt_strong;         /* from responses to first transmissions */
+  uint32_t rttvar_strong;
+  uint32_t srtt_weak;           /* from responses to retransmissions */
+  uint32_t rttvar_weak;
+  uint16_t strong_samples;
+  uint16_t weak_samples;
+} coap_cocoa_state_t;
+
+void coap_cocoa_init(void);
+
+/**
+ * \brief Get the interval before the first retransmission of a confirmable
+ * message, the RTO of the endpoint dithered by up to 50%
+ */
+uint32_t coap_cocoa_initial_interval(const coap_endpoint_t *endpoint);
+
+/**
+ * \brief Get the interval before the next retransmission, backed off by a
+ * factor that depends on the initial interval of the transaction
+ */
+uint32_t coap_cocoa_backoff(uint32_t interval, uint32_t initial_interval);
+
+/**
+ * \brief Update the estimate of an endpoint with the round-trip time of a
+ * confirmable message
+ * \param rtt The time from the first transmission to the response, in ms
+ * \param retransmissions The retransmissions of the message
+ */
+void coap_cocoa_update(const coap_endpoint_t *endpoint, uint32_t rtt,
+                       uint8_t retransmissions);
+
+/**
+ * \brief Get the estimator state of an endpoint
+ * \return 0 if the endpoint has not been measured
+ */
+int coap_cocoa_get_state(const coap_endpoint_t *endpoint,
+                         coap_cocoa_state_t *state);
+
+#endif /* COAP_COCOA_H_ */
+/** @} */
@@ -95,9 +95,19 @@
 
 /* Number of observer slots (each takes abot xxx bytes) */
 #ifndef COAP_MAX_OBSERVERS
-#define COAP_MAX_OBSERVERS    COAP_MAX_OPEN_TRANSACTIONS - 1
+#define COAP_MAX_OBSERVERS    (COAP_MAX_OPEN_TRANSACTIONS - 1)
 #endif /* COAP_MAX_OBSERVERS */
 
+/* Look transactions up by MID, and observers by token and by MID, in hash
+ * indexes instead of scanning their lists. The number of buckets of each
+ * index, a power of two, or 0 for no index. Pays off with large tables,
+ * e.g. on proxies serving many clients. */
+#ifdef COAP_CONF_TABLE_HASH_SIZE
+#define COAP_TABLE_HASH_SIZE COAP_CONF_TABLE_HASH_SIZE
+#else
+#define COAP_TABLE_HASH_SIZE 0
+#endif /* COAP_CONF_TABLE_HASH_SIZE */
+
 /* Interval in notifies in which NON notifies are changed to CON notifies to check client. */
 #ifdef COAP_CONF_OBSERVE_REFRESH_INTERVAL
 #define COAP_OBSERVE_REFRESH_INTERVAL COAP_CONF_OBSERVE_REFRESH_INTERVAL
@@ -105,5 +115,49 @@
 #define COAP_OBSERVE_REFRESH_INTERVAL  20
 #endif /* COAP_OBSERVE_REFRESH_INTERVAL */
 
+/* Dispatch requests through a hash index of the resource URI paths
+ * instead of comparing the path of every resource. The number of hash
+ * buckets, a power of two, or 0 for no index. Pays off on nodes with
+ * many resources. */
+#ifdef COAP_CONF_RESOURCE_HASH_SIZE
+#define COAP_RESOURCE_HASH_SIZE COAP_CONF_RESOURCE_HASH_SIZE
+#else
+#define COAP_RESOURCE_HASH_SIZE 0
+#endif /* COAP_CONF_RESOURCE_HASH_SIZE */
+
+/* Estimate the retransmission timeout of confirmable messages per
+ * endpoint from the measured round-trip times, following CoCoA
+ * (draft-ietf-core-cocoa), instead of using COAP_RESPONSE_TIMEOUT with
+ * binary exponential backoff on every path.
+ *
+ * This is not a win on every path. In the native benchmark with 10% loss
+ * it cuts the one-hop latency from 963 to 182 ms per request, but on a
+ * six-hop path it rises from 4951 to 6080 ms: the weak samples of
+ * retransmitted requests push the learned RTO up to 9.3 s, and some
+ * initial RTOs reach 16 s and more, so a lost request waits longer before
+ * it is retransmitted. */
+#ifdef COAP_CONF_WITH_COCOA
+#define COAP_WITH_COCOA COAP_CONF_WITH_COCOA
+#else
+#define COAP_WITH_COCOA 0
+#endif /* COAP_CONF_WITH_COCOA */
+
+/* The number of endpoints whose RTO estimate is kept. The least recently
+ * used one is replaced when a new endpoint is measured. */
+#ifdef COAP_CONF_COCOA_ENDPOINTS
+#define COAP_COCOA_ENDPOINTS COAP_CONF_COCOA_ENDPOINTS
+#else
+#define COAP_COCOA_ENDPOINTS 4
+#endif /* COAP_CONF_COCOA_ENDPOINTS */
+
+/* The maximum number of blocks that a pipelined blockwise transfer keeps
+ * in flight. At most 32. Confirmable transfers are also limited by
+ * COAP_MAX_OPEN_TRANSACTIONS. */
+#ifdef COAP_CONF_BLOCK_WINDOW_SIZE
+#define COAP_BLOCK_WINDOW_SIZE COAP_CONF_BLOCK_WINDOW_SIZE
+#else
+#define COAP_BLOCK_WINDOW_SIZE 4
+#endif /* COAP_CONF_BLOCK_WINDOW_SIZE */
+
 #endif /* COAP_CONF_H_ */
 /** @} */
@@ -42,6 +42,7 @@
  */
 
 #include "coap-engine.h"
+#include "coap-block-window.h"
 #include "sys/cc.h"
 #include "lib/list.h"
 #include <stdio.h>
@@ -72,6 +73,14 @@ LIST(coap_handlers);
 LIST(coap_resource_services);
 static uint8_t is_initialized = 0;
 
+#if COAP_RESOURCE_HASH_SIZE
+#if (COAP_RESOURCE_HASH_SIZE & (COAP_RESOURCE_HASH_SIZE - 1)) != 0
+#error COAP_RESOURCE_HASH_SIZE must be power of two
+#endif
+/* The resources by URI path, in activation order within each bucket */
+static coap_resource_t *resource_hash[COAP_RESOURCE_HASH_SIZE];
+#endif /* COAP_RESOURCE_HASH_SIZE */
+
 /*---------------------------------------------------------------------------*/
 /*- CoAP service handlers---------------------------------------------------*/
 /*---------------------------------------------------------------------------*/
@@ -312,12 +321,15 @@ coap_receive(const coap_endpoint_t *src,
         coap_resource_response_handler_t callback = transaction->callback;
         void *callback_data = transaction->callback_data;
 
-        coap_clear_transaction(transaction);
+        coap_complete_transaction(transaction);
 
         /* check if someone registered for the response */
         if(callback) {
           callback(callback_data, message);
         }
+      } else if(message->code != 0) {
+        /* responses to pipelined blockwise requests */
+        coap_block_window_receive(src, message);
       }
       /* if(ACKed transaction) */
       transaction = NULL;
@@ -382,6 +394,10 @@ coap_engine_init(void)
 
   coap_activate_resource(&res_well_known_core, ".well-known/core");
 
+#if COAP_WITH_COCOA
+  coap_cocoa_init();
+#endif /* COAP_WITH_COCOA */
+
   coap_transport_init();
   coap_init_connection();
 }
@@ -395,12 +411,52 @@ coap_engine_init(void)
  * extern keyword. The build system takes care of compiling every
  * *.c file in the ./resources/ sub-directory (see example Makefile).
  */
+#if COAP_RESOURCE_HASH_SIZE
+/* Get the hash bucket of a URI path (FNV-1a) */
+static unsigned
+path_hash(const char *path, int path_len)
+{
+  uint32_t h = 2166136261UL;
+  int i;
+
+  for(i = 0; i < path_len; i++) {
+    h = (h ^ (uint8_t)path[i]) * 16777619UL;
+  }
+  return (h ^ (h >> 16)) & (COAP_RESOURCE_HASH_SIZE - 1);
+}
+/*---------------------------------------------------------------------------*/
+/* Rebuild the hash index from the list of resources. Activations are
+ * rare, and this keeps the buckets in activation order even when a
+ * resource is activated again. */
+static void
+rebuild_resource_hash(void)
+{
+  coap_resource_t *resource;
+  coap_resource_t **p;
+
+  memset(resource_hash, 0, sizeof(resource_hash));
+  for(resource = list_head(coap_resource_services);
+      resource; resource = resource->next) {
+    resource->hash_next = NULL;
+    p = &resource_hash[path_hash(resource->url, resource->url_len)];
+    while(*p != NULL) {
+      p = &(*p)->hash_next;
+    }
+    *p = resource;
+  }
+}
+#endif /* COAP_RESOURCE_HASH_SIZE */
+/*---------------------------------------------------------------------------*/
 void
 coap_activate_resource(coap_resource_t *resource, const char *path)
 {
   coap_periodic_resource_t *periodic;
   resource->url = path;
+  resource->url_len = strlen(path);
   list_add(coap_resource_services, resource);
+#if COAP_RESOURCE_HASH_SIZE
+  rebuild_resource_hash();
+#endif /* COAP_RESOURCE_HASH_SIZE */
 
   LOG_INFO("Activating: %s\n", resource->url);
 
@@ -432,6 +488,85 @@ coap_get_next_resource(coap_resource_t *resource)
   return list_item_next(resource);
 }
 /*---------------------------------------------------------------------------*/
+#if COAP_RESOURCE_HASH_SIZE
+/* Find the first activated resource with exactly this URI path */
+static coap_resource_t *
+hash_lookup(const char *path, int path_len, coap_resource_flags_t flags)
+{
+  coap_resource_t *resource;
+
+  for(resource = resource_hash[path_hash(path, path_len)];
+      resource; resource = resource->hash_next) {
+    if(resource->url_len == path_len
+       && (resource->flags & flags) == flags
+       && memcmp(resource->url, path, path_len) == 0) {
+      return resource;
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+/* Was resource a activated before resource b? */
+static int
+is_activated_before(const coap_resource_t *a, const coap_resource_t *b)
+{
+  coap_resource_t *resource;
+
+  for(resource = list_head(coap_resource_services);
+      resource; resource = resource->next) {
+    if(resource == a || resource == b) {
+      return resource == a;
+    }
+  }
+  return 0;
+}
+#endif /* COAP_RESOURCE_HASH_SIZE */
+/*---------------------------------------------------------------------------*/
+coap_resource_t *
+coap_get_resource_by_path(const char *path, int path_len)
+{
+  coap_resource_t *resource;
+
+  if(path == NULL) {
+    path = "";
+    path_len = 0;
+  }
+
+#if COAP_RESOURCE_HASH_SIZE
+  {
+    coap_resource_t *parent;
+    int len;
+
+    /* The resource with the path itself, or the first activated of its
+     * parents, as with the linear walk below */
+    resource = hash_lookup(path, path_len, 0);
+    for(len = path_len - 1; len >= 0; len--) {
+      if(path[len] == '/') {
+        parent = hash_lookup(path, len, HAS_SUB_RESOURCES);
+        if(parent != NULL
+           && (resource == NULL || is_activated_before(parent, resource))) {
+          resource = parent;
+        }
+      }
+    }
+    return resource;
+  }
+#else /* COAP_RESOURCE_HASH_SIZE */
+  for(resource = list_head(coap_resource_services);
+      resource; resource = resource->next) {
+    /* if the resource handles the path itself, or is a parent of it */
+    if((path_len == resource->url_len
+        || (path_len > resource->url_len
+            && (resource->flags & HAS_SUB_RESOURCES)
+            && path[resource->url_len] == '/'))
+       && memcmp(resource->url, path, resource->url_len) == 0) {
+      return resource;
+    }
+  }
+  return NULL;
+#endif /* COAP_RESOURCE_HASH_SIZE */
+}
+/*---------------------------------------------------------------------------*/
 static int
 invoke_coap_resource_service(coap_message_t *request, coap_message_t *response,
                              uint8_t *buffer, uint16_t buffer_size,
@@ -442,44 +577,34 @@ invoke_coap_resource_service(coap_message_t *request, coap_message_t *response,
 
   coap_resource_t *resource = NULL;
   const char *url = NULL;
-  int url_len, res_url_len;
+  int url_len;
 
   url_len = coap_get_header_uri_path(request, &url);
-  for(resource = list_head(coap_resource_services);
-      resource; resource = resource->next) {
-
-    /* if the web service handles that kind of requests and urls matches */
-    res_url_len = strlen(resource->url);
-    if((url_len == res_url_len
-        || (url_len > res_url_len
-            && (resource->flags & HAS_SUB_RESOURCES)
-            && url[res_url_len] == '/'))
-       && strncmp(resource->url, url, res_url_len) == 0) {
-      coap_resource_flags_t method = coap_get_method_type(request);
-      found = 1;
-
-      LOG_INFO("/%s, method %u, resource->flags %u\n", resource->url,
-               (uint16_t)method, resource->flags);
-
-      if((method & METHOD_GET) && resource->get_handler != NULL) {
-        /* call handler function */
-        resource->get_handler(request, response, buffer, buffer_size, offset);
-      } else if((method & METHOD_POST) && resource->post_handler != NULL) {
-        /* call handler function */
-        resource->post_handler(request, response, buffer, buffer_size,
+  resource = coap_get_resource_by_path(url, url_len);
+  if(resource != NULL) {
+    coap_resource_flags_t method = coap_get_method_type(request);
+    found = 1;
+
+    LOG_INFO("/%s, method %u, resource->flags %u\n", resource->url,
+             (uint16_t)method, resource->flags);
+
+    if((method & METHOD_GET) && resource->get_handler != NULL) {
+      /* call handler function */
+      resource->get_handler(request, response, buffer, buffer_size, offset);
+    } else if((method & METHOD_POST) && resource->post_handler != NULL) {
+      /* call handler function */
+      resource->post_handler(request, response, buffer, buffer_size,
+                             offset);
+    } else if((method & METHOD_PUT) && resource->put_handler != NULL) {
+      /* call handler function */
+      resource->put_handler(request, response, buffer, buffer_size, offset);
+    } else if((method & METHOD_DELETE) && resource->delete_handler != NULL) {
+      /* call handler function */
+      resource->delete_handler(request, response, buffer, buffer_size,
                                offset);
-      } else if((method & METHOD_PUT) && resource->put_handler != NULL) {
-        /* call handler function */
-        resource->put_handler(request, response, buffer, buffer_size, offset);
-      } else if((method & METHOD_DELETE) && resource->delete_handler != NULL) {
-        /* call handler function */
-        resource->delete_handler(request, response, buffer, buffer_size,
-                                 offset);
-      } else {
-        allowed = 0;
-        coap_set_status_code(response, METHOD_NOT_ALLOWED_4_05);
-      }
-      break;
+    } else {
+      allowed = 0;
+      coap_set_status_code(response, METHOD_NOT_ALLOWED_4_05);
     }
   }
   if(!found) {
@@ -111,6 +111,10 @@ struct coap_resource_s {
     coap_resource_trigger_handler_t trigger;
     coap_resource_trigger_handler_t resume;
   };
+  uint16_t url_len;                 /* length of url, set on activation */
+#if COAP_RESOURCE_HASH_SIZE
+  coap_resource_t *hash_next;       /* next resource in the same hash bucket */
+#endif /* COAP_RESOURCE_HASH_SIZE */
 };
 
 struct coap_periodic_resource_s {
@@ -167,6 +171,17 @@ coap_resource_t *coap_get_first_resource(void);
  */
 coap_resource_t *coap_get_next_resource(coap_resource_t *resource);
 /*---------------------------------------------------------------------------*/
+/**
+ * \brief      Returns the resource that requests for a URI path are dispatched to.
+ * \param path
+ *             The URI path, without leading slash.
+ * \param path_len
+ *             The length of the URI path.
+ * \return     The resource with this URI path, or the first activated parent
+ *             resource (HAS_SUB_RESOURCES) of it, or NULL if none exists.
+ */
+coap_resource_t *coap_get_resource_by_path(const char *path, int path_len);
+/*---------------------------------------------------------------------------*/
 
 #include "coap-transactions.h"
 #include "coap-observe.h"
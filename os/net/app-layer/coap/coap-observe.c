@@ -56,9 +56,73 @@
 /*---------------------------------------------------------------------------*/
 MEMB(observers_memb, coap_observer_t, COAP_MAX_OBSERVERS);
 LIST(observers_list);
+
+#if COAP_TABLE_HASH_SIZE
+#if (COAP_TABLE_HASH_SIZE & (COAP_TABLE_HASH_SIZE - 1)) != 0
+#error COAP_TABLE_HASH_SIZE must be power of two
+#endif
+#define MID_HASH(mid) ((mid) & (COAP_TABLE_HASH_SIZE - 1))
+/* The observers by token and by the MID of their last notification */
+static coap_observer_t *observers_by_token[COAP_TABLE_HASH_SIZE];
+static coap_observer_t *observers_by_mid[COAP_TABLE_HASH_SIZE];
+#endif /* COAP_TABLE_HASH_SIZE */
+
+static coap_table_stats_t table_stats;
+
+/* The last notification rendered, without token, which is patched for
+ * each observer */
+static uint8_t notification_buffer[COAP_MAX_PACKET_SIZE];
+static uint16_t notification_len;
+/* The offset of its Observe option, 0 if none */
+static uint16_t observe_offset;
+
+static coap_observe_stats_t stats;
+/* Uptime at the last reset of the statistics, in ms */
+static uint64_t stats_start;
 /*---------------------------------------------------------------------------*/
 /*- Internal API ------------------------------------------------------------*/
 /*---------------------------------------------------------------------------*/
+#if COAP_TABLE_HASH_SIZE
+static unsigned
+token_hash(const uint8_t *token, size_t token_len)
+{
+  /* FNV-1a, tokens are opaque and may be chosen by the client */
+  uint32_t h = 2166136261UL;
+  size_t i;
+
+  for(i = 0; i < token_len; i++) {
+    h = (h ^ token[i]) * 16777619UL;
+  }
+  return (h ^ (h >> 16)) & (COAP_TABLE_HASH_SIZE - 1);
+}
+/*---------------------------------------------------------------------------*/
+static void
+mid_index_remove(coap_observer_t *o)
+{
+  coap_observer_t **p = &observers_by_mid[MID_HASH(o->last_mid)];
+
+  while(*p != NULL && *p != o) {
+    p = &(*p)->mid_next;
+  }
+  if(*p != NULL) {
+    *p = o->mid_next;
+  }
+}
+#endif /* COAP_TABLE_HASH_SIZE */
+/*---------------------------------------------------------------------------*/
+static void
+set_last_mid(coap_observer_t *o, uint16_t mid)
+{
+#if COAP_TABLE_HASH_SIZE
+  mid_index_remove(o);
+  o->last_mid = mid;
+  o->mid_next = observers_by_mid[MID_HASH(mid)];
+  observers_by_mid[MID_HASH(mid)] = o;
+#else /* COAP_TABLE_HASH_SIZE */
+  o->last_mid = mid;
+#endif /* COAP_TABLE_HASH_SIZE */
+}
+/*---------------------------------------------------------------------------*/
 static coap_observer_t *
 add_observer(const coap_endpoint_t *endpoint, const uint8_t *token,
              size_t token_len, const char *uri, int uri_len)
@@ -81,9 +145,27 @@ add_observer(const coap_endpoint_t *endpoint, const uint8_t *token,
     o->last_mid = 0;
 
     LOG_INFO("Adding observer (%u/%u) for /%s [0x%02X%02X]\n",
-             list_length(observers_list) + 1, COAP_MAX_OBSERVERS,
+             table_stats.used + 1, COAP_MAX_OBSERVERS,
              o->url, o->token[0], o->token[1]);
     list_add(observers_list, o);
+
+#if COAP_TABLE_HASH_SIZE
+    {
+      unsigned h = token_hash(o->token, o->token_len);
+      o->token_next = observers_by_token[h];
+      observers_by_token[h] = o;
+      o->mid_next = observers_by_mid[MID_HASH(0)];
+      observers_by_mid[MID_HASH(0)] = o;
+    }
+#endif /* COAP_TABLE_HASH_SIZE */
+
+    table_stats.used++;
+    if(table_stats.used > table_stats.max_used) {
+      table_stats.max_used = table_stats.used;
+    }
+  } else {
+    LOG_WARN("No room for a new observer for /%.*s\n", uri_len, uri);
+    table_stats.failures++;
   }
 
   return o;
@@ -97,7 +179,22 @@ coap_remove_observer(coap_observer_t *o)
   LOG_INFO("Removing observer for /%s [0x%02X%02X]\n", o->url, o->token[0],
            o->token[1]);
 
-  memb_free(&observers_memb, o);
+#if COAP_TABLE_HASH_SIZE
+  {
+    coap_observer_t **p = &observers_by_token[token_hash(o->token, o->token_len)];
+    while(*p != NULL && *p != o) {
+      p = &(*p)->token_next;
+    }
+    if(*p != NULL) {
+      *p = o->token_next;
+    }
+    mid_index_remove(o);
+  }
+#endif /* COAP_TABLE_HASH_SIZE */
+
+  if(memb_free(&observers_memb, o) == 0) {
+    table_stats.used--;
+  }
   list_remove(observers_list, o);
 }
 /*---------------------------------------------------------------------------*/
@@ -106,12 +203,14 @@ coap_remove_observer_by_client(const coap_endpoint_t *endpoint)
 {
   int removed = 0;
   coap_observer_t *obs = NULL;
+  coap_observer_t *next;
 
   LOG_DBG("Remove check client ");
   LOG_DBG_COAP_EP(endpoint);
   LOG_DBG_("\n");
   for(obs = (coap_observer_t *)list_head(observers_list); obs;
-      obs = obs->next) {
+      obs = next) {
+    next = obs->next;
     if(coap_endpoint_cmp(&obs->endpoint, endpoint)) {
       coap_remove_observer(obs);
       removed++;
@@ -126,9 +225,17 @@ coap_remove_observer_by_token(const coap_endpoint_t *endpoint,
 {
   int removed = 0;
   coap_observer_t *obs = NULL;
+  coap_observer_t *next;
 
+#if COAP_TABLE_HASH_SIZE
+  for(obs = observers_by_token[token_hash(token, token_len)]; obs;
+      obs = next) {
+    next = obs->token_next;
+#else /* COAP_TABLE_HASH_SIZE */
   for(obs = (coap_observer_t *)list_head(observers_list); obs;
-      obs = obs->next) {
+      obs = next) {
+    next = obs->next;
+#endif /* COAP_TABLE_HASH_SIZE */
     LOG_DBG("Remove check Token 0x%02X%02X\n", token[0], token[1]);
     if(coap_endpoint_cmp(&obs->endpoint, endpoint)
        && obs->token_len == token_len
@@ -146,9 +253,11 @@ coap_remove_observer_by_uri(const coap_endpoint_t *endpoint,
 {
   int removed = 0;
   coap_observer_t *obs = NULL;
+  coap_observer_t *next;
 
   for(obs = (coap_observer_t *)list_head(observers_list); obs;
-      obs = obs->next) {
+      obs = next) {
+    next = obs->next;
     LOG_DBG("Remove check URL %p\n", uri);
     if((endpoint == NULL
         || (coap_endpoint_cmp(&obs->endpoint, endpoint)))
@@ -165,9 +274,16 @@ coap_remove_observer_by_mid(const coap_endpoint_t *endpoint, uint16_t mid)
 {
   int removed = 0;
   coap_observer_t *obs = NULL;
+  coap_observer_t *next;
 
+#if COAP_TABLE_HASH_SIZE
+  for(obs = observers_by_mid[MID_HASH(mid)]; obs; obs = next) {
+    next = obs->mid_next;
+#else /* COAP_TABLE_HASH_SIZE */
   for(obs = (coap_observer_t *)list_head(observers_list); obs;
-      obs = obs->next) {
+      obs = next) {
+    next = obs->next;
+#endif /* COAP_TABLE_HASH_SIZE */
     LOG_DBG("Remove check MID %u\n", mid);
     if(coap_endpoint_cmp(&obs->endpoint, endpoint)
        && obs->last_mid == mid) {
@@ -185,21 +301,170 @@ coap_notify_observers(coap_resource_t *resource)
 {
   coap_notify_observers_sub(resource, NULL);
 }
+/*---------------------------------------------------------------------------*/
+/* Find the Observe option in a serialized message without token. Returns
+ * its offset, or 0 if the message has none. */
+static uint16_t
+find_observe_option(const uint8_t *buffer, uint16_t len)
+{
+  uint16_t offset = COAP_HEADER_LEN;
+  unsigned int number = 0;
+
+  while(offset < len && buffer[offset] != 0xFF) {
+    uint16_t option = offset;
+    unsigned int delta = buffer[offset] >> 4;
+    unsigned int length = buffer[offset] & 0x0F;
+
+    ++offset;
+    if(delta == 13) {
+      delta = 13 + buffer[offset];
+      offset += 1;
+    } else if(delta == 14) {
+      delta = 269 + ((buffer[offset] << 8) | buffer[offset + 1]);
+      offset += 2;
+    }
+    if(length == 13) {
+      length = 13 + buffer[offset];
+      offset += 1;
+    } else if(length == 14) {
+      length = 269 + ((buffer[offset] << 8) | buffer[offset + 1]);
+      offset += 2;
+    }
+
+    number += delta;
+    if(number == COAP_OPTION_OBSERVE) {
+      return option;
+    } else if(number > COAP_OPTION_OBSERVE) {
+      break;
+    }
+    offset += length;
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+/* Call the handler of the notified resource once and serialize its
+ * response, without token and with an empty Observe option */
+static int
+render_notification(coap_resource_t *resource, const char *url)
+{
+  coap_message_t notification[1]; /* this way the message can be treated as pointer as usual */
+  coap_message_t request[1]; /* this way the message can be treated as pointer as usual */
+  int32_t new_offset = 0;
+
+  coap_init_message(notification, COAP_TYPE_NON, CONTENT_2_05, 0);
+  /* create a "fake" request for the URI */
+  coap_init_message(request, COAP_TYPE_CON, COAP_GET, 0);
+  coap_set_header_uri_path(request, url);
+
+  /* Either old style get_handler or the full handler */
+  if(coap_call_handlers(request, notification, notification_buffer +
+                        COAP_MAX_HEADER_SIZE, COAP_MAX_CHUNK_SIZE,
+                        &new_offset) > 0) {
+    LOG_DBG("Notification on new handlers\n");
+  } else {
+    if(resource != NULL) {
+      resource->get_handler(request, notification,
+                            notification_buffer + COAP_MAX_HEADER_SIZE,
+                            COAP_MAX_CHUNK_SIZE, &new_offset);
+    } else {
+      /* What to do here? */
+      notification->code = BAD_REQUEST_4_00;
+    }
+  }
+  stats.renders++;
+
+  if(notification->code < BAD_REQUEST_4_00) {
+    /* patched with the value of each observer */
+    coap_set_header_observe(notification, 0);
+  }
+
+  if(new_offset != 0) {
+    coap_set_header_block2(notification,
+                           0,
+                           new_offset != -1,
+                           COAP_MAX_BLOCK_SIZE);
+    coap_set_payload(notification,
+                     notification->payload,
+                     MIN(notification->payload_len,
+                         COAP_MAX_BLOCK_SIZE));
+  }
+
+  notification_len = coap_serialize_message(notification, notification_buffer);
+  if(notification_len == 0) {
+    LOG_WARN("Could not serialize notification for %s\n", url);
+    return 0;
+  }
+  observe_offset = find_observe_option(notification_buffer, notification_len);
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+/* Write the rendered notification for an observer, with its token, MID
+ * and Observe value. Returns the length of the message. */
+static uint16_t
+write_notification(uint8_t *message, const coap_observer_t *obs,
+                   coap_message_type_t type, uint16_t mid)
+{
+  uint8_t *p = message;
+  uint16_t rest;
+
+  *p++ = (COAP_HEADER_VERSION_MASK & 1 << COAP_HEADER_VERSION_POSITION)
+    | (COAP_HEADER_TYPE_MASK & type << COAP_HEADER_TYPE_POSITION)
+    | (COAP_HEADER_TOKEN_LEN_MASK & obs->token_len << COAP_HEADER_TOKEN_LEN_POSITION);
+  *p++ = notification_buffer[1];
+  *p++ = (uint8_t)(mid >> 8);
+  *p++ = (uint8_t)mid;
+  memcpy(p, obs->token, obs->token_len);
+  p += obs->token_len;
+
+  if(observe_offset == 0) {
+    rest = COAP_HEADER_LEN;
+  } else {
+    uint32_t observe = obs->obs_counter;
+    uint8_t len = observe > 0xffff ? 3 : observe > 0xff ? 2 : observe > 0 ? 1 : 0;
+
+    /* The options before Observe, then Observe with the same delta */
+    memcpy(p, notification_buffer + COAP_HEADER_LEN, observe_offset - COAP_HEADER_LEN);
+    p += observe_offset - COAP_HEADER_LEN;
+    *p++ = (notification_buffer[observe_offset] & 0xF0) | len;
+    while(len > 0) {
+      *p++ = (uint8_t)(observe >> (8 * --len));
+    }
+    rest = observe_offset + 1 + (notification_buffer[observe_offset] & 0x0F);
+  }
+  memcpy(p, notification_buffer + rest, notification_len - rest);
+  p += notification_len - rest;
+
+  return p - message;
+}
+/*---------------------------------------------------------------------------*/
+static void
+send_batch(coap_transaction_t **batch, int *batch_len)
+{
+  int i;
+
+  for(i = 0; i < *batch_len; i++) {
+    coap_send_transaction(batch[i]);
+  }
+  stats.notifications += *batch_len;
+  *batch_len = 0;
+}
+/*---------------------------------------------------------------------------*/
 /* Can be used either for sub - or when there is not resource - just
    a handler */
 void
 coap_notify_observers_sub(coap_resource_t *resource, const char *subpath)
 {
-  /* build notification */
-  coap_message_t notification[1]; /* this way the message can be treated as pointer as usual */
-  coap_message_t request[1]; /* this way the message can be treated as pointer as usual */
   coap_observer_t *obs = NULL;
   int url_len, obs_url_len;
   char url[COAP_OBSERVER_URL_LEN];
   uint8_t sub_ok = 0;
+  uint8_t is_rendered = 0;
+  coap_transaction_t *batch[COAP_MAX_OPEN_TRANSACTIONS];
+  int batch_len = 0;
+  int notified = 0;
 
   if(resource != NULL) {
-    url_len = strlen(resource->url);
+    url_len = resource->url_len;
     strncpy(url, resource->url, COAP_OBSERVER_URL_LEN - 1);
     if(url_len < COAP_OBSERVER_URL_LEN - 1 && subpath != NULL) {
       strncpy(&url[url_len], subpath, COAP_OBSERVER_URL_LEN - url_len - 1);
@@ -216,11 +481,6 @@ coap_notify_observers_sub(coap_resource_t *resource, const char *subpath)
   /* url now contains the notify URL that needs to match the observer */
   LOG_INFO("Notification from %s\n", url);
 
-  coap_init_message(notification, COAP_TYPE_NON, CONTENT_2_05, 0);
-  /* create a "fake" request for the URI */
-  coap_init_message(request, COAP_TYPE_CON, COAP_GET, 0);
-  coap_set_header_uri_path(request, url);
-
   /* iterate over observers */
   url_len = strlen(url);
   /* Assumes lazy evaluation... */
@@ -240,15 +500,31 @@ coap_notify_observers_sub(coap_resource_t *resource, const char *subpath)
             && obs->url[url_len] == '/'))
        && strncmp(url, obs->url, url_len) == 0) {
       coap_transaction_t *transaction = NULL;
+      coap_message_type_t type = COAP_TYPE_NON;
+      uint16_t mid;
 
-      /*TODO implement special transaction for CON, sharing the same buffer to allow for more observers */
+      /* The representation is the same for all observers: render it once */
+      if(!is_rendered) {
+        if(!render_notification(resource, url)) {
+          return;
+        }
+        is_rendered = 1;
+      }
 
-      if((transaction = coap_new_transaction(coap_get_mid(), &obs->endpoint))) {
+      mid = coap_get_mid();
+      transaction = coap_new_transaction(mid, &obs->endpoint);
+      if(transaction == NULL && batch_len > 0) {
+        /* Free the transactions of the NON notifications and retry */
+        send_batch(batch, &batch_len);
+        transaction = coap_new_transaction(mid, &obs->endpoint);
+      }
+
+      if(transaction != NULL) {
         /* if COAP_OBSERVE_REFRESH_INTERVAL is zero, never send observations as confirmable messages */
         if(COAP_OBSERVE_REFRESH_INTERVAL != 0
             && (obs->obs_counter % COAP_OBSERVE_REFRESH_INTERVAL == 0)) {
           LOG_DBG("           Force Confirmable for\n");
-          notification->type = COAP_TYPE_CON;
+          type = COAP_TYPE_CON;
         }
 
         LOG_DBG("           Observer ");
@@ -256,54 +532,29 @@ coap_notify_observers_sub(coap_resource_t *resource, const char *subpath)
         LOG_DBG_("\n");
 
         /* update last MID for RST matching */
-        obs->last_mid = transaction->mid;
-
-        /* prepare response */
-        notification->mid = transaction->mid;
-
-	int32_t new_offset = 0;
+        set_last_mid(obs, transaction->mid);
 
-        /* Either old style get_handler or the full handler */
-        if(coap_call_handlers(request, notification, transaction->message +
-                              COAP_MAX_HEADER_SIZE, COAP_MAX_CHUNK_SIZE,
-                              &new_offset) > 0) {
-          LOG_DBG("Notification on new handlers\n");
-        } else {
-          if(resource != NULL) {
-            resource->get_handler(request, notification,
-                                  transaction->message + COAP_MAX_HEADER_SIZE,
-                                  COAP_MAX_CHUNK_SIZE, &new_offset);
-          } else {
-            /* What to do here? */
-            notification->code = BAD_REQUEST_4_00;
-          }
+        transaction->message_len =
+          write_notification(transaction->message, obs, type, transaction->mid);
+        if(notified++ > 0) {
+          /* copied from the rendered notification instead of re-encoded */
+          stats.bytes_saved += notification_len - COAP_HEADER_LEN;
         }
 
-        if(notification->code < BAD_REQUEST_4_00) {
-          coap_set_header_observe(notification, (obs->obs_counter)++);
+        if(observe_offset != 0) {
+          (obs->obs_counter)++;
           /* mask out to keep the CoAP observe option length <= 3 bytes */
           obs->obs_counter &= 0xffffff;
         }
-        coap_set_token(notification, obs->token, obs->token_len);
-
-	if(new_offset != 0) {
-	  coap_set_header_block2(notification,
-				 0,
-				 new_offset != -1,
-				 COAP_MAX_BLOCK_SIZE);
-	  coap_set_payload(notification,
-			   notification->payload,
-			   MIN(notification->payload_len,
-			       COAP_MAX_BLOCK_SIZE));
-	}
-
-        transaction->message_len =
-          coap_serialize_message(notification, transaction->message);
 
-        coap_send_transaction(transaction);
+        batch[batch_len++] = transaction;
+        if(batch_len == COAP_MAX_OPEN_TRANSACTIONS) {
+          send_batch(batch, &batch_len);
+        }
       }
     }
   }
+  send_batch(batch, &batch_len);
 }
 /*---------------------------------------------------------------------------*/
 void
@@ -355,6 +606,30 @@ coap_observe_handler(coap_resource_t *resource, coap_message_t *coap_req,
   }
 }
 /*---------------------------------------------------------------------------*/
+void
+coap_observe_get_stats(coap_observe_stats_t *s)
+{
+  uint64_t elapsed = coap_timer_uptime() - stats_start;
+
+  *s = stats;
+  s->notifications_per_second = elapsed > 0
+    ? (uint32_t)((uint64_t)stats.notifications * 1000 / elapsed) : 0;
+}
+/*---------------------------------------------------------------------------*/
+void
+coap_observe_reset_stats(void)
+{
+  memset(&stats, 0, sizeof(stats));
+  stats_start = coap_timer_uptime();
+}
+/*---------------------------------------------------------------------------*/
+void
+coap_observe_get_table_stats(coap_table_stats_t *s)
+{
+  *s = table_stats;
+  s->size = COAP_MAX_OBSERVERS;
+}
+/*---------------------------------------------------------------------------*/
 uint8_t
 coap_has_observers(char *path)
 {
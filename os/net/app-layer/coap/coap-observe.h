@@ -52,6 +52,10 @@
 
 typedef struct coap_observer {
   struct coap_observer *next;   /* for LIST */
+#if COAP_TABLE_HASH_SIZE
+  struct coap_observer *token_next; /* next in the same token hash bucket */
+  struct coap_observer *mid_next;   /* next in the same MID hash bucket */
+#endif /* COAP_TABLE_HASH_SIZE */
 
   char url[COAP_OBSERVER_URL_LEN];
   coap_endpoint_t endpoint;
@@ -65,6 +69,18 @@ typedef struct coap_observer {
   uint8_t retrans_counter;
 } coap_observer_t;
 
+/* Notification statistics */
+typedef struct coap_observe_stats {
+  /* notifications sent */
+  uint32_t notifications;
+  /* representations rendered by resource handlers, one per notify call */
+  uint32_t renders;
+  /* bytes copied from a rendered notification instead of re-encoded */
+  uint32_t bytes_saved;
+  /* notifications per second since the last reset, set by get_stats */
+  uint32_t notifications_per_second;
+} coap_observe_stats_t;
+
 void coap_remove_observer(coap_observer_t *o);
 int coap_remove_observer_by_client(const coap_endpoint_t *ep);
 int coap_remove_observer_by_token(const coap_endpoint_t *ep,
@@ -82,5 +98,9 @@ void coap_observe_handler(coap_resource_t *resource, coap_message_t *request,
 
 uint8_t coap_has_observers(char *path);
 
+void coap_observe_get_stats(coap_observe_stats_t *stats);
+void coap_observe_reset_stats(void);
+void coap_observe_get_table_stats(coap_table_stats_t *stats);
+
 #endif /* COAP_OBSERVE_H_ */
 /** @} */
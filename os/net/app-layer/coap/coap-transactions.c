@@ -47,6 +47,7 @@
 #include "lib/memb.h"
 #include "lib/list.h"
 #include <stdlib.h>
+#include <string.h>
 
 /* Log configuration */
 #include "coap-log.h"
@@ -57,6 +58,19 @@
 MEMB(transactions_memb, coap_transaction_t, COAP_MAX_OPEN_TRANSACTIONS);
 LIST(transactions_list);
 
+#if COAP_TABLE_HASH_SIZE
+#if (COAP_TABLE_HASH_SIZE & (COAP_TABLE_HASH_SIZE - 1)) != 0
+#error COAP_TABLE_HASH_SIZE must be power of two
+#endif
+/* MIDs are allocated sequentially: their low bits spread them evenly */
+#define MID_HASH(mid) ((mid) & (COAP_TABLE_HASH_SIZE - 1))
+/* The transactions by MID, in creation order within each bucket */
+static coap_transaction_t *transactions_by_mid[COAP_TABLE_HASH_SIZE];
+#endif /* COAP_TABLE_HASH_SIZE */
+
+static coap_table_stats_t stats;
+static coap_transmission_stats_t transmission_stats;
+
 /*---------------------------------------------------------------------------*/
 static void
 coap_retransmit_transaction(coap_timer_t *nt)
@@ -71,6 +85,17 @@ coap_retransmit_transaction(coap_timer_t *nt)
   coap_send_transaction(t);
 }
 /*---------------------------------------------------------------------------*/
+static void
+count_initial_interval(uint32_t interval)
+{
+  int bin = 0;
+
+  while(bin < COAP_RTO_STATS_BINS - 1 && interval >= (250UL << bin)) {
+    bin++;
+  }
+  transmission_stats.rto[bin]++;
+}
+/*---------------------------------------------------------------------------*/
 
 /*---------------------------------------------------------------------------*/
 /*- Internal API ------------------------------------------------------------*/
@@ -88,6 +113,25 @@ coap_new_transaction(uint16_t mid, const coap_endpoint_t *endpoint)
     coap_endpoint_copy(&t->endpoint, endpoint);
 
     list_add(transactions_list, t); /* list itself makes sure same element is not added twice */
+
+#if COAP_TABLE_HASH_SIZE
+    {
+      /* Append, so that lookups find the oldest transaction as in the list */
+      coap_transaction_t **p = &transactions_by_mid[MID_HASH(mid)];
+      while(*p != NULL) {
+        p = &(*p)->mid_next;
+      }
+      t->mid_next = NULL;
+      *p = t;
+    }
+#endif /* COAP_TABLE_HASH_SIZE */
+
+    stats.used++;
+    if(stats.used > stats.max_used) {
+      stats.max_used = stats.used;
+    }
+  } else {
+    stats.failures++;
   }
 
   return t;
@@ -108,15 +152,29 @@ coap_send_transaction(coap_transaction_t *t)
       if(t->retrans_counter == 0) {
         coap_timer_set_callback(&t->retrans_timer, coap_retransmit_transaction);
         coap_timer_set_user_data(&t->retrans_timer, t);
+#if COAP_WITH_COCOA
+        t->retrans_interval = coap_cocoa_initial_interval(&t->endpoint);
+        t->initial_interval = t->retrans_interval;
+        t->start_time = coap_timer_uptime();
+#else /* COAP_WITH_COCOA */
         t->retrans_interval =
           COAP_RESPONSE_TIMEOUT_TICKS + (rand() %
                                          COAP_RESPONSE_TIMEOUT_BACKOFF_MASK);
+#endif /* COAP_WITH_COCOA */
         LOG_DBG("Initial interval %lu msec\n",
                 (unsigned long)t->retrans_interval);
+        transmission_stats.transmissions++;
+        count_initial_interval(t->retrans_interval);
       } else {
+#if COAP_WITH_COCOA
+        t->retrans_interval = coap_cocoa_backoff(t->retrans_interval,
+                                                 t->initial_interval);
+#else /* COAP_WITH_COCOA */
         t->retrans_interval <<= 1;  /* double */
-        LOG_DBG("Doubled (%u) interval %lu s\n", t->retrans_counter,
-                (unsigned long)(t->retrans_interval / 1000));
+#endif /* COAP_WITH_COCOA */
+        LOG_DBG("Backed off (%u) interval %lu msec\n", t->retrans_counter,
+                (unsigned long)t->retrans_interval);
+        transmission_stats.retransmissions++;
       }
 
       /* interval updated above */
@@ -124,6 +182,7 @@ coap_send_transaction(coap_transaction_t *t)
     } else {
       /* timed out */
       LOG_DBG("Timeout\n");
+      transmission_stats.timeouts++;
       coap_resource_response_handler_t callback = t->callback;
       void *callback_data = t->callback_data;
 
@@ -150,16 +209,48 @@ coap_clear_transaction(coap_transaction_t *t)
 
     coap_timer_stop(&t->retrans_timer);
     list_remove(transactions_list, t);
-    memb_free(&transactions_memb, t);
+#if COAP_TABLE_HASH_SIZE
+    {
+      coap_transaction_t **p = &transactions_by_mid[MID_HASH(t->mid)];
+      while(*p != NULL && *p != t) {
+        p = &(*p)->mid_next;
+      }
+      if(*p != NULL) {
+        *p = t->mid_next;
+      }
+    }
+#endif /* COAP_TABLE_HASH_SIZE */
+    if(memb_free(&transactions_memb, t) == 0) {
+      stats.used--;
+    }
   }
 }
 /*---------------------------------------------------------------------------*/
+void
+coap_complete_transaction(coap_transaction_t *t)
+{
+#if COAP_WITH_COCOA
+  /* Measure the round-trip time of confirmable messages */
+  if(t && COAP_TYPE_CON ==
+     ((COAP_HEADER_TYPE_MASK & t->message[0]) >> COAP_HEADER_TYPE_POSITION)) {
+    coap_cocoa_update(&t->endpoint,
+                      (uint32_t)(coap_timer_uptime() - t->start_time),
+                      t->retrans_counter);
+  }
+#endif /* COAP_WITH_COCOA */
+  coap_clear_transaction(t);
+}
+/*---------------------------------------------------------------------------*/
 coap_transaction_t *
 coap_get_transaction_by_mid(uint16_t mid)
 {
   coap_transaction_t *t = NULL;
 
+#if COAP_TABLE_HASH_SIZE
+  for(t = transactions_by_mid[MID_HASH(mid)]; t; t = t->mid_next) {
+#else /* COAP_TABLE_HASH_SIZE */
   for(t = (coap_transaction_t *)list_head(transactions_list); t; t = t->next) {
+#endif /* COAP_TABLE_HASH_SIZE */
     if(t->mid == mid) {
       LOG_DBG("Found transaction for MID %u: %p\n", t->mid, t);
       return t;
@@ -168,4 +259,23 @@ coap_get_transaction_by_mid(uint16_t mid)
   return NULL;
 }
 /*---------------------------------------------------------------------------*/
+void
+coap_get_transaction_stats(coap_table_stats_t *s)
+{
+  *s = stats;
+  s->size = COAP_MAX_OPEN_TRANSACTIONS;
+}
+/*---------------------------------------------------------------------------*/
+void
+coap_get_transmission_stats(coap_transmission_stats_t *s)
+{
+  *s = transmission_stats;
+}
+/*---------------------------------------------------------------------------*/
+void
+coap_reset_transmission_stats(void)
+{
+  memset(&transmission_stats, 0, sizeof(transmission_stats));
+}
+/*---------------------------------------------------------------------------*/
 /** @} */
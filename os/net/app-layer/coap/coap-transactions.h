@@ -47,6 +47,7 @@
 #include "coap.h"
 #include "coap-engine.h"
 #include "coap-timer.h"
+#include "coap-cocoa.h"
 
 /*
  * Modulo mask (thus +1) for a random number to get the tick number for the random
@@ -58,11 +59,18 @@
 /* container for transactions with message buffer and retransmission info */
 typedef struct coap_transaction {
   struct coap_transaction *next;        /* for LIST */
+#if COAP_TABLE_HASH_SIZE
+  struct coap_transaction *mid_next;    /* next in the same MID hash bucket */
+#endif /* COAP_TABLE_HASH_SIZE */
 
   uint16_t mid;
   coap_timer_t retrans_timer;
   uint32_t retrans_interval;
   uint8_t retrans_counter;
+#if COAP_WITH_COCOA
+  uint32_t initial_interval;
+  uint64_t start_time;          /* uptime of the first transmission */
+#endif /* COAP_WITH_COCOA */
 
   coap_endpoint_t endpoint;
 
@@ -74,10 +82,26 @@ typedef struct coap_transaction {
                                                  * Use snprintf(buf, len+1, "", ...) to completely fill payload */
 } coap_transaction_t;
 
+/* Bins of the initial retransmission intervals: below 250 ms, then
+ * doubling, the last one for 16 s and above */
+#define COAP_RTO_STATS_BINS 8
+
+/* Retransmission statistics of confirmable messages */
+typedef struct coap_transmission_stats {
+  uint32_t transmissions;       /* first transmissions */
+  uint32_t retransmissions;
+  uint32_t timeouts;            /* messages given up after all retransmissions */
+  uint32_t rto[COAP_RTO_STATS_BINS]; /* initial intervals */
+} coap_transmission_stats_t;
+
 coap_transaction_t *coap_new_transaction(uint16_t mid, const coap_endpoint_t *ep);
 void coap_send_transaction(coap_transaction_t *t);
 void coap_clear_transaction(coap_transaction_t *t);
+void coap_complete_transaction(coap_transaction_t *t);
 coap_transaction_t *coap_get_transaction_by_mid(uint16_t mid);
+void coap_get_transaction_stats(coap_table_stats_t *stats);
+void coap_get_transmission_stats(coap_transmission_stats_t *stats);
+void coap_reset_transmission_stats(void);
 
 #endif /* COAP_TRANSACTIONS_H_ */
 /** @} */
@@ -128,6 +128,14 @@ typedef struct {
   uint8_t *payload;
 } coap_message_t;
 
+/* Occupancy of a table of the CoAP engine */
+typedef struct coap_table_stats {
+  uint16_t used;        /* entries in use */
+  uint16_t max_used;    /* highest number of entries in use */
+  uint16_t size;        /* entries in the pool */
+  uint32_t failures;    /* allocations that failed for lack of room */
+} coap_table_stats_t;
+
 static inline int
 coap_set_option(coap_message_t *message, unsigned int opt)
 {
@@ -68,11 +68,14 @@
 #include "net/ipv6/tcpip.h"
 #include "net/ipv6/uip.h"
 #include "net/ipv6/uip-ds6.h"
+#include "net/ipv6/uip-icmp6.h"
 #include "net/ipv6/uipbuf.h"
 #include "net/ipv6/sicslowpan.h"
 #include "net/netstack.h"
 #include "net/packetbuf.h"
 #include "net/queuebuf.h"
+#include "lib/list.h"
+#include "lib/memb.h"
 
 #include "net/routing/routing.h"
 
@@ -234,6 +237,160 @@ static uint16_t my_tag;
 /* Assuming that the worst growth for uncompression is 38 bytes */
 #define SICSLOWPAN_FIRST_FRAGMENT_SIZE (SICSLOWPAN_FRAGMENT_SIZE + 38)
 
+static struct sicslowpan_reass_stats reass_stats;
+
+#if SICSLOWPAN_REASS_DIRECT
+/* A datagram being reassembled. Fragments are written straight to
+   their offset in buf, which is copied to uip_buf once complete. */
+struct sicslowpan_reass {
+  struct sicslowpan_reass *next;
+  /** The source address of the fragments being merged */
+  linkaddr_t sender;
+  /** The tag in the fragments being merged */
+  uint16_t tag;
+  /** Total length of the fragmented packet */
+  uint16_t len;
+  /** Number of bytes of the packet covered by the fragments so far */
+  uint16_t reassembled_len;
+  /** Reassembly %process %timer. */
+  struct timer reass_timer;
+  /** One bit per 8-byte block of the packet covered by a fragment */
+  uint8_t received[(UIP_BUFSIZE / 8 + 7) / 8];
+  uint8_t buf[UIP_BUFSIZE];
+};
+
+MEMB(reass_memb, struct sicslowpan_reass, SICSLOWPAN_REASS_CONTEXTS);
+/* Ongoing reassemblies, oldest first */
+LIST(reass_list);
+
+/*---------------------------------------------------------------------------*/
+static void
+reass_free(struct sicslowpan_reass *reass)
+{
+  list_remove(reass_list, reass);
+  memb_free(&reass_memb, reass);
+}
+/*---------------------------------------------------------------------------*/
+static void
+reass_timeout(void)
+{
+  struct sicslowpan_reass *reass;
+  struct sicslowpan_reass *next;
+
+  for(reass = list_head(reass_list); reass != NULL; reass = next) {
+    next = list_item_next(reass);
+    if(timer_expired(&reass->reass_timer)) {
+      LOG_WARN("reassembly: timed out (tag %d)\n", reass->tag);
+      reass_stats.timed_out++;
+      reass_free(reass);
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static struct sicslowpan_reass *
+reass_find(uint16_t tag)
+{
+  struct sicslowpan_reass *reass;
+
+  for(reass = list_head(reass_list); reass != NULL;
+      reass = list_item_next(reass)) {
+    if(reass->tag == tag &&
+       linkaddr_cmp(&reass->sender, packetbuf_addr(PACKETBUF_ADDR_SENDER))) {
+      return reass;
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+/* Set up a reassembly context for the first fragment of a datagram */
+static struct sicslowpan_reass *
+reass_new(uint16_t tag, uint16_t frag_size)
+{
+  struct sicslowpan_reass *reass;
+
+  if(frag_size > UIP_BUFSIZE) {
+    LOG_WARN("reassembly: datagram too large (tag %d, len %d)\n",
+             tag, frag_size);
+    return NULL;
+  }
+
+  reass_timeout();
+
+  /* A repeated first fragment restarts its reassembly */
+  reass = reass_find(tag);
+  if(reass != NULL) {
+    list_remove(reass_list, reass);
+  } else {
+    reass = memb_alloc(&reass_memb);
+  }
+  if(reass == NULL) {
+    /* Give up on the oldest reassembly in favor of the new one */
+    reass = list_pop(reass_list);
+    if(reass == NULL) {
+      return NULL;
+    }
+    LOG_WARN("reassembly: evicting tag %d for tag %d\n", reass->tag, tag);
+    reass_stats.evicted++;
+  }
+
+  reass->tag = tag;
+  reass->len = frag_size;
+  reass->reassembled_len = 0;
+  linkaddr_copy(&reass->sender, packetbuf_addr(PACKETBUF_ADDR_SENDER));
+  memset(reass->received, 0, sizeof(reass->received));
+  timer_set(&reass->reass_timer, SICSLOWPAN_REASS_MAXAGE * CLOCK_SECOND / 16);
+  list_add(reass_list, reass);
+
+  return reass;
+}
+/*---------------------------------------------------------------------------*/
+/* Mark the bytes from pos to pos + len as received. Only the bytes no
+   earlier fragment covered count, so that retransmitted or overlapping
+   fragments cannot complete the packet with parts of it missing. */
+static void
+reass_cover(struct sicslowpan_reass *reass, uint16_t pos, uint16_t len)
+{
+  uint16_t end;
+  uint16_t block;
+
+  end = MIN(pos + len, reass->len);
+  for(block = pos / 8; block * 8 < end; block++) {
+    if(!(reass->received[block / 8] & (1 << (block % 8)))) {
+      reass->received[block / 8] |= 1 << (block % 8);
+      reass->reassembled_len += MIN(end - block * 8, 8);
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Write the payload of a subsequent fragment to its final place */
+static int
+reass_store(struct sicslowpan_reass *reass, uint16_t frag_size,
+            uint8_t offset)
+{
+  uint16_t pos;
+  uint16_t len;
+
+  if(frag_size != reass->len) {
+    LOG_WARN("reassembly: fragment size %d instead of %d (tag %d)\n",
+             frag_size, reass->len, reass->tag);
+    return 0;
+  }
+
+  pos = (uint16_t)offset << 3;
+  len = packetbuf_datalen() - packetbuf_hdr_len;
+  if(packetbuf_datalen() <= packetbuf_hdr_len || pos + len > reass->len) {
+    LOG_WARN("reassembly: fragment out of bounds (tag %d, offset %d)\n",
+             reass->tag, pos);
+    return 0;
+  }
+
+  memcpy(&reass->buf[pos], packetbuf_ptr + packetbuf_hdr_len, len);
+  reass_cover(reass, pos, len);
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+#else /* SICSLOWPAN_REASS_DIRECT */
+
 /* all information needed for reassembly */
 struct sicslowpan_frag_info {
   /** When reassembling, the source address of the fragments being merged */
@@ -296,6 +453,7 @@ timeout_fragments(int not_context)
     if(frag_info[i].len > 0 && i != not_context &&
        timer_expired(&frag_info[i].reass_timer)) {
       /* This context can be freed */
+      reass_stats.timed_out++;
       count += clear_fragments(i);
     }
   }
@@ -335,6 +493,7 @@ add_fragment(uint16_t tag, uint16_t frag_size, uint8_t offset)
     for(i = 0; i < SICSLOWPAN_REASS_CONTEXTS; i++) {
       /* clear all fragment info with expired timer to free all fragment buffers */
       if(frag_info[i].len > 0 && timer_expired(&frag_info[i].reass_timer)) {
+        reass_stats.timed_out++;
         clear_fragments(i);
       }
 
@@ -378,6 +537,14 @@ add_fragment(uint16_t tag, uint16_t frag_size, uint8_t offset)
     return -1;
   }
 
+  /* The fragment must fit in uip_buf once the datagram is complete */
+  if(packetbuf_datalen() <= packetbuf_hdr_len ||
+     ((uint16_t)offset << 3) + packetbuf_datalen() - packetbuf_hdr_len > UIP_BUFSIZE) {
+    LOG_WARN("reassembly: fragment out of bounds (tag %d, offset %d)\n",
+             tag, (uint16_t)offset << 3);
+    return -1;
+  }
+
   /* i is the index of the reassembly context */
   len = store_fragment(i, offset);
   if(len < 0 && timeout_fragments(i) > 0) {
@@ -414,6 +581,93 @@ copy_frags2uip(int context)
   /* deallocate all the fragments for this context */
   clear_fragments(context);
 }
+#endif /* SICSLOWPAN_REASS_DIRECT */
+
+/* Fragment forwarding is only done by routers */
+#define VRB_ENABLED (SICSLOWPAN_FRAG_FORWARDING && UIP_CONF_ROUTER)
+
+#if VRB_ENABLED
+/* A virtual reassembly buffer: maps the fragments of a datagram that
+   is routed through this node to the next hop it is forwarded to. */
+struct sicslowpan_vrb {
+  struct sicslowpan_vrb *next;
+  /** The link layer address of the previous hop */
+  linkaddr_t sender;
+  /** The tag of the fragments from the previous hop */
+  uint16_t tag;
+  /** The link layer address of the next hop */
+  linkaddr_t nexthop;
+  /** The tag of the fragments towards the next hop */
+  uint16_t out_tag;
+  /** Total length of the fragmented packet */
+  uint16_t len;
+  /** Length of the datagram forwarded so far */
+  uint16_t forwarded_len;
+  /** Lifetime of the entry, as for a reassembly */
+  struct timer timer;
+  /** One bit per 8-byte offset at which a fragment has been forwarded */
+  uint8_t forwarded[(UIP_BUFSIZE / 8 + 7) / 8];
+};
+
+MEMB(vrb_memb, struct sicslowpan_vrb, SICSLOWPAN_VRB_ENTRIES);
+/* Datagrams being forwarded, oldest first */
+LIST(vrb_list);
+
+/*---------------------------------------------------------------------------*/
+static void
+vrb_free(struct sicslowpan_vrb *vrb)
+{
+  list_remove(vrb_list, vrb);
+  memb_free(&vrb_memb, vrb);
+}
+/*---------------------------------------------------------------------------*/
+static struct sicslowpan_vrb *
+vrb_find(uint16_t tag, const linkaddr_t *sender)
+{
+  struct sicslowpan_vrb *vrb;
+  struct sicslowpan_vrb *next;
+
+  for(vrb = list_head(vrb_list); vrb != NULL; vrb = next) {
+    next = list_item_next(vrb);
+    if(timer_expired(&vrb->timer)) {
+      LOG_WARN("forwarding: timed out (tag %d)\n", vrb->tag);
+      reass_stats.timed_out++;
+      vrb_free(vrb);
+    } else if(vrb->tag == tag && linkaddr_cmp(&vrb->sender, sender)) {
+      return vrb;
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+static struct sicslowpan_vrb *
+vrb_new(uint16_t tag, const linkaddr_t *sender)
+{
+  struct sicslowpan_vrb *vrb;
+
+  /* A repeated first fragment is forwarded again with a new tag */
+  vrb = vrb_find(tag, sender);
+  if(vrb != NULL) {
+    list_remove(vrb_list, vrb);
+  } else {
+    /* Datagrams still being forwarded are not evicted: the new one is
+       reassembled instead */
+    vrb = memb_alloc(&vrb_memb);
+    if(vrb == NULL) {
+      return NULL;
+    }
+  }
+
+  vrb->tag = tag;
+  linkaddr_copy(&vrb->sender, sender);
+  memset(vrb->forwarded, 0, sizeof(vrb->forwarded));
+  vrb->forwarded[0] = 1;
+  timer_set(&vrb->timer, SICSLOWPAN_REASS_MAXAGE * CLOCK_SECOND / 16);
+  list_add(vrb_list, vrb);
+
+  return vrb;
+}
+#endif /* VRB_ENABLED */
 #endif /* SICSLOWPAN_CONF_FRAG */
 
 /* -------------------------------------------------------------------------- */
@@ -1482,26 +1736,28 @@ send_packet(linkaddr_t *dest)
  */
 static int
 fragment_copy_payload_and_send(uint16_t uip_offset, linkaddr_t *dest) {
-  struct queuebuf *q;
+  struct packetbuf_attr attrs[PACKETBUF_NUM_ATTRS];
+  struct packetbuf_addr addrs[PACKETBUF_NUM_ADDRS];
+  uint8_t frag_hdr[SICSLOWPAN_FRAG1_HDR_LEN];
 
   /* Now copy fragment payload from uip_buf */
   memcpy(packetbuf_ptr + packetbuf_hdr_len,
          (uint8_t *)UIP_IP_BUF + uip_offset, packetbuf_payload_len);
   packetbuf_set_datalen(packetbuf_payload_len + packetbuf_hdr_len);
 
-  /* Backup packetbuf to queuebuf. Enables preserving attributes for all framgnets */
-  q = queuebuf_new_from_packetbuf();
-  if(q == NULL) {
-    LOG_WARN("output: could not allocate queuebuf, dropping fragment\n");
-    return 0;
-  }
+  /* Backup what the next fragment reuses: the attributes and the
+     dispatch and tag. Its payload is copied from uip_buf again, so
+     there is no need to keep a copy of the whole frame. */
+  packetbuf_attr_copyto(attrs, addrs);
+  memcpy(frag_hdr, PACKETBUF_FRAG_PTR, sizeof(frag_hdr));
 
   /* Send fragment */
   send_packet(dest);
 
-  /* Restore packetbuf from queuebuf */
-  queuebuf_to_packetbuf(q);
-  queuebuf_free(q);
+  /* Restore packetbuf, which the MAC layer may have modified */
+  packetbuf_clear();
+  packetbuf_attr_copyfrom(attrs, addrs);
+  memcpy(PACKETBUF_FRAG_PTR, frag_hdr, sizeof(frag_hdr));
 
   /* Check tx result. */
   if((last_tx_status == MAC_TX_COLLISION) ||
@@ -1514,6 +1770,328 @@ fragment_copy_payload_and_send(uint16_t uip_offset, linkaddr_t *dest) {
 }
 #endif /* SICSLOWPAN_CONF_FRAG */
 /*--------------------------------------------------------------------*/
+/**
+ * \brief Compress the headers of the IP packet in uip_buf into packetbuf,
+ * using the compression scheme selected at compile time.
+ * \param dest the link layer destination address of the packet
+ * \return 1 if success, 0 otherwise
+ */
+static int
+compress_hdr(linkaddr_t *dest)
+{
+#if SICSLOWPAN_COMPRESSION == SICSLOWPAN_COMPRESSION_IPV6
+  compress_hdr_ipv6(dest);
+#endif /* SICSLOWPAN_COMPRESSION == SICSLOWPAN_COMPRESSION_IPV6 */
+#if SICSLOWPAN_COMPRESSION == SICSLOWPAN_COMPRESSION_6LORH
+  /* Add 6LoRH headers before IPHC. Only needed on routed traffic
+  (non link-local). */
+  if(!uip_is_addr_linklocal(&UIP_IP_BUF->destipaddr)) {
+    add_paging_dispatch(1);
+    add_6lorh_hdr();
+  }
+#endif /* SICSLOWPAN_COMPRESSION == SICSLOWPAN_COMPRESSION_6LORH */
+#if SICSLOWPAN_COMPRESSION >= SICSLOWPAN_COMPRESSION_IPHC
+  if(compress_hdr_iphc(dest) == 0) {
+    return 0;
+  }
+#endif /* SICSLOWPAN_COMPRESSION >= SICSLOWPAN_COMPRESSION_IPHC */
+  return 1;
+}
+#if SICSLOWPAN_CONF_FRAG && VRB_ENABLED
+/*--------------------------------------------------------------------*/
+/**
+ * \brief Check whether the datagram whose first fragment has been
+ * uncompressed in uip_buf can be forwarded fragment by fragment, and
+ * find the link layer address of its next hop.
+ *
+ * Datagrams that need more than a routing table lookup are left to
+ * the regular reassembly: those for this node, multicast or link-local
+ * traffic, datagrams whose hop limit expires here, and datagrams with
+ * extension headers other than a Hop-by-Hop header holding RPL or
+ * padding options. The RPL root is excluded as well, as it rewrites
+ * the extension headers of the datagrams it forwards.
+ * \return the link layer address of the next hop, or NULL
+ */
+static const uip_lladdr_t *
+vrb_get_nexthop(void)
+{
+  const uip_ipaddr_t *nexthop;
+  uip_ds6_route_t *route;
+
+  if(uip_ds6_is_my_addr(&UIP_IP_BUF->destipaddr) ||
+     uip_is_addr_mcast(&UIP_IP_BUF->destipaddr) ||
+     uip_is_addr_linklocal(&UIP_IP_BUF->destipaddr) ||
+     uip_is_addr_loopback(&UIP_IP_BUF->destipaddr) ||
+     uip_is_addr_linklocal(&UIP_IP_BUF->srcipaddr) ||
+     uip_is_addr_unspecified(&UIP_IP_BUF->srcipaddr) ||
+     UIP_IP_BUF->ttl <= 1 ||
+     NETSTACK_ROUTING.node_is_root()) {
+    return NULL;
+  }
+
+  if(UIP_IP_BUF->proto == UIP_PROTO_HBHO) {
+    struct uip_hbho_hdr *hbh = (struct uip_hbho_hdr *)UIP_IP_PAYLOAD(0);
+    uint16_t hbh_len;
+    uint16_t opt_offset;
+
+    hbh_len = (hbh->len << 3) + 8;
+    if(UIP_IPH_LEN + hbh_len > uip_len || uip_is_proto_ext_hdr(hbh->next)) {
+      return NULL;
+    }
+    for(opt_offset = 2; opt_offset < hbh_len;) {
+      struct uip_ext_hdr_opt *opt = (struct uip_ext_hdr_opt *)((uint8_t *)hbh + opt_offset);
+      if(opt->type == UIP_EXT_HDR_OPT_PAD1) {
+        opt_offset++;
+      } else if(opt->type == UIP_EXT_HDR_OPT_PADN ||
+                opt->type == UIP_EXT_HDR_OPT_RPL) {
+        opt_offset += opt->len + 2;
+      } else {
+        return NULL;
+      }
+    }
+  } else if(uip_is_proto_ext_hdr(UIP_IP_BUF->proto)) {
+    return NULL;
+  }
+
+  if(uip_ds6_is_addr_onlink(&UIP_IP_BUF->destipaddr)) {
+    nexthop = &UIP_IP_BUF->destipaddr;
+  } else if((route = uip_ds6_route_lookup(&UIP_IP_BUF->destipaddr)) != NULL) {
+    nexthop = uip_ds6_route_nexthop(route);
+  } else {
+    nexthop = uip_ds6_defrt_choose();
+  }
+
+  /* Unresolved neighbors are left to the regular output path */
+  return nexthop != NULL ? uip_ds6_nbr_lladdr_from_ipaddr(nexthop) : NULL;
+}
+/*--------------------------------------------------------------------*/
+/**
+ * \brief Update the Hop-by-Hop options and the hop limit of the
+ * datagram in uip_buf as uip_process() does before forwarding it.
+ * \return 1 if the datagram can be forwarded, 0 if it must be dropped
+ */
+static int
+vrb_update_headers(void)
+{
+  uint16_t len = uip_len;
+  uint8_t len_field[2];
+
+  if(UIP_IP_BUF->proto == UIP_PROTO_HBHO) {
+    struct uip_hbho_hdr *hbh = (struct uip_hbho_hdr *)UIP_IP_PAYLOAD(0);
+    uint16_t hbh_len = (hbh->len << 3) + 8;
+    uint16_t opt_offset;
+
+    for(opt_offset = 2; opt_offset < hbh_len;) {
+      struct uip_ext_hdr_opt *opt = (struct uip_ext_hdr_opt *)((uint8_t *)hbh + opt_offset);
+      if(opt->type == UIP_EXT_HDR_OPT_PAD1) {
+        opt_offset++;
+        continue;
+      }
+      if(opt->type == UIP_EXT_HDR_OPT_RPL &&
+         !NETSTACK_ROUTING.ext_header_hbh_update((uint8_t *)hbh, opt_offset)) {
+        return 0;
+      }
+      opt_offset += opt->len + 2;
+    }
+  }
+
+  UIP_IP_BUF->ttl--;
+
+  /* The datagram cannot change size, as only its first fragment is here */
+  memcpy(len_field, UIP_IP_BUF->len, sizeof(len_field));
+  if(!NETSTACK_ROUTING.ext_header_update() || uip_len != len ||
+     memcmp(len_field, UIP_IP_BUF->len, sizeof(len_field)) != 0) {
+    LOG_ERR("forwarding: routing protocol extension header update error\n");
+    return 0;
+  }
+  return 1;
+}
+/*--------------------------------------------------------------------*/
+/**
+ * \brief Forward the first fragment of a datagram routed through this
+ * node, and remember its next hop for the subsequent fragments.
+ *
+ * The uncompressed start of the datagram is in buf. Its headers are
+ * updated and compressed again for the next hop, and the fragment gets
+ * a new tag. Should the new header not leave room for all of the
+ * payload, the remainder is sent as a subsequent fragment.
+ * \param buf the uncompressed start of the datagram
+ * \param len the number of bytes in buf
+ * \param frag_size the size of the datagram
+ * \param frag_tag the tag of the fragments from the previous hop
+ * \return 0 if the datagram must be reassembled instead, 1 if the
+ * fragment was forwarded or dropped
+ *
+ * Datagrams whose headers cannot be updated here, or that find every
+ * forwarding entry taken, are reassembled, so that uip_process() deals
+ * with them.
+ */
+static int
+vrb_forward_first(const uint8_t *buf, uint16_t len, uint16_t frag_size,
+                  uint16_t frag_tag)
+{
+  struct sicslowpan_vrb *vrb;
+  const uip_lladdr_t *lladdr;
+  linkaddr_t sender;
+  linkaddr_t dest;
+  uint16_t payload;
+  int frag1_payload;
+
+  if(len >= frag_size || frag_size > UIP_BUFSIZE) {
+    return 0;
+  }
+
+  memcpy(UIP_IP_BUF, buf, len);
+  uip_len = len;
+
+  lladdr = vrb_get_nexthop();
+  if(lladdr == NULL) {
+    uipbuf_clear();
+    return 0;
+  }
+  linkaddr_copy(&dest, (const linkaddr_t *)lladdr);
+  linkaddr_copy(&sender, packetbuf_addr(PACKETBUF_ADDR_SENDER));
+
+  if(!vrb_update_headers()) {
+    uipbuf_clear();
+    return 0;
+  }
+
+  vrb = vrb_new(frag_tag, &sender);
+  if(vrb == NULL) {
+    LOG_WARN("forwarding: no entry left, reassembling tag %d\n", frag_tag);
+    uipbuf_clear();
+    return 0;
+  }
+  linkaddr_copy(&vrb->nexthop, &dest);
+  vrb->out_tag = my_tag++;
+  vrb->len = frag_size;
+  vrb->forwarded_len = len;
+
+  /* Build the first fragment for the next hop, as output() does */
+  uncomp_hdr_len = 0;
+  packetbuf_hdr_len = 0;
+  packetbuf_clear();
+  packetbuf_ptr = packetbuf_dataptr();
+  if(callback) {
+    set_packet_attrs();
+  }
+  packetbuf_set_addr(PACKETBUF_ADDR_RECEIVER, &dest);
+#if LLSEC802154_USES_AUX_HEADER
+  packetbuf_set_attr(PACKETBUF_ATTR_SECURITY_LEVEL,
+    uipbuf_get_attr(UIPBUF_ATTR_LLSEC_LEVEL));
+#endif /* LLSEC802154_USES_AUX_HEADER */
+  mac_max_payload = NETSTACK_MAC.max_payload();
+  if(mac_max_payload <= 0 || compress_hdr(&dest) == 0) {
+    LOG_WARN("forwarding: failed to compress header (tag %d)\n", frag_tag);
+    vrb_free(vrb);
+    reass_stats.dropped++;
+    uipbuf_clear();
+    return 1;
+  }
+
+  memmove(packetbuf_ptr + SICSLOWPAN_FRAG1_HDR_LEN, packetbuf_ptr, packetbuf_hdr_len);
+  packetbuf_hdr_len += SICSLOWPAN_FRAG1_HDR_LEN;
+  SET16(PACKETBUF_FRAG_PTR, PACKETBUF_FRAG_DISPATCH_SIZE,
+        ((SICSLOWPAN_DISPATCH_FRAG1 << 8) | frag_size));
+  SET16(PACKETBUF_FRAG_PTR, PACKETBUF_FRAG_TAG, vrb->out_tag);
+
+  payload = len - uncomp_hdr_len;
+  frag1_payload = (mac_max_payload - packetbuf_hdr_len) & 0xfffffff8;
+  if(frag1_payload < 0 ||
+     payload - MIN(payload, frag1_payload) > mac_max_payload - SICSLOWPAN_FRAGN_HDR_LEN) {
+    LOG_WARN("forwarding: compressed header does not fit first fragment\n");
+    vrb_free(vrb);
+    reass_stats.dropped++;
+    uipbuf_clear();
+    return 1;
+  }
+
+  LOG_INFO("forwarding: tag %d from ", frag_tag);
+  LOG_INFO_LLADDR(&sender);
+  LOG_INFO_(" as tag %d to ", vrb->out_tag);
+  LOG_INFO_LLADDR(&dest);
+  LOG_INFO_(" (len %d)\n", frag_size);
+
+  last_tx_status = MAC_TX_OK;
+  packetbuf_payload_len = MIN(payload, frag1_payload);
+  if(fragment_copy_payload_and_send(uncomp_hdr_len, &dest) &&
+     packetbuf_payload_len < payload) {
+    /* The header grew: the tail of the first fragment goes on its own */
+    uint16_t offset = uncomp_hdr_len + packetbuf_payload_len;
+    packetbuf_hdr_len = SICSLOWPAN_FRAGN_HDR_LEN;
+    SET16(PACKETBUF_FRAG_PTR, PACKETBUF_FRAG_DISPATCH_SIZE,
+          ((SICSLOWPAN_DISPATCH_FRAGN << 8) | frag_size));
+    PACKETBUF_FRAG_PTR[PACKETBUF_FRAG_OFFSET] = offset >> 3;
+    packetbuf_payload_len = len - offset;
+    fragment_copy_payload_and_send(offset, &dest);
+  }
+
+  reass_stats.forwarded++;
+  uipbuf_clear();
+  return 1;
+}
+/*--------------------------------------------------------------------*/
+/**
+ * \brief Forward a subsequent fragment of a datagram whose first
+ * fragment has been forwarded, rewriting its tag for the next hop.
+ * Retransmissions of a fragment that was forwarded already are dropped.
+ * \param frag_tag the tag of the fragment
+ * \param frag_offset the offset of the fragment, in units of 8 bytes
+ * \return 1 if the fragment belonged to a forwarded datagram, 0 otherwise
+ */
+static int
+vrb_forward(uint16_t frag_tag, uint8_t frag_offset)
+{
+  struct sicslowpan_vrb *vrb;
+  uint8_t *data;
+  uint16_t len;
+
+  vrb = vrb_find(frag_tag, packetbuf_addr(PACKETBUF_ADDR_SENDER));
+  if(vrb == NULL) {
+    return 0;
+  }
+
+  len = packetbuf_datalen();
+  if(len <= SICSLOWPAN_FRAGN_HDR_LEN ||
+     ((uint16_t)frag_offset << 3) + len - SICSLOWPAN_FRAGN_HDR_LEN > vrb->len) {
+    LOG_WARN("forwarding: fragment out of bounds (tag %d, offset %d)\n",
+             frag_tag, frag_offset << 3);
+    reass_stats.dropped++;
+    return 1;
+  }
+  if(vrb->forwarded[frag_offset / 8] & (1 << (frag_offset % 8))) {
+    /* A retransmitted fragment, the next hop has it already */
+    return 1;
+  }
+  vrb->forwarded[frag_offset / 8] |= 1 << (frag_offset % 8);
+
+  /* Move the fragment to the start of a fresh packetbuf */
+  data = packetbuf_dataptr();
+  packetbuf_clear();
+  memmove(packetbuf_dataptr(), data, len);
+  packetbuf_set_datalen(len);
+  packetbuf_ptr = packetbuf_dataptr();
+  SET16(PACKETBUF_FRAG_PTR, PACKETBUF_FRAG_TAG, vrb->out_tag);
+#if LLSEC802154_USES_AUX_HEADER
+  packetbuf_set_attr(PACKETBUF_ATTR_SECURITY_LEVEL,
+    uipbuf_get_attr(UIPBUF_ATTR_LLSEC_LEVEL));
+#endif /* LLSEC802154_USES_AUX_HEADER */
+
+  LOG_INFO("forwarding: fragment (tag %d, offset %d) as tag %d\n",
+           frag_tag, PACKETBUF_FRAG_PTR[PACKETBUF_FRAG_OFFSET] << 3,
+           vrb->out_tag);
+
+  send_packet(&vrb->nexthop);
+
+  vrb->forwarded_len += len - SICSLOWPAN_FRAGN_HDR_LEN;
+  if(vrb->forwarded_len >= vrb->len) {
+    vrb_free(vrb);
+  }
+  return 1;
+}
+#endif /* SICSLOWPAN_CONF_FRAG && VRB_ENABLED */
+/*--------------------------------------------------------------------*/
 /** \brief Take an IP packet and format it to be sent on an 802.15.4
  *  network using 6lowpan.
  *  \param localdest The MAC address of the destination
@@ -1562,6 +2140,22 @@ output(const linkaddr_t *localdest)
   packetbuf_set_attr(PACKETBUF_ATTR_MAX_MAC_TRANSMISSIONS,
                      uipbuf_get_attr(UIPBUF_ATTR_MAX_MAC_TRANSMISSIONS));
 
+#if TSCH_QUEUE_NUM_PRIORITIES > 1
+  {
+    /* Queue ICMPv6 control messages (RPL, ND), but not echoes, ahead of
+       data. The ICMPv6 header may follow extension headers, e.g. the
+       routing header of a source-routed DAO-ACK. */
+    struct uip_icmp_hdr *icmp;
+    icmp = (struct uip_icmp_hdr *)uipbuf_search_header(uip_buf, uip_len,
+                                                       UIP_PROTO_ICMP6);
+    if(icmp != NULL
+       && icmp->type != ICMP6_ECHO_REQUEST
+       && icmp->type != ICMP6_ECHO_REPLY) {
+      packetbuf_set_attr(PACKETBUF_ATTR_TSCH_PRIORITY, TSCH_QUEUE_CONTROL_PRIORITY);
+    }
+  }
+#endif /* TSCH_QUEUE_NUM_PRIORITIES > 1 */
+
 /* Calculate NETSTACK_FRAMER's header length, that will be added in the NETSTACK_MAC */
   packetbuf_set_addr(PACKETBUF_ADDR_RECEIVER, &dest);
 #if LLSEC802154_USES_AUX_HEADER
@@ -1583,23 +2177,10 @@ output(const linkaddr_t *localdest)
   }
 
   /* Try to compress the headers */
-#if SICSLOWPAN_COMPRESSION == SICSLOWPAN_COMPRESSION_IPV6
-  compress_hdr_ipv6(&dest);
-#endif /* SICSLOWPAN_COMPRESSION == SICSLOWPAN_COMPRESSION_IPV6 */
-#if SICSLOWPAN_COMPRESSION == SICSLOWPAN_COMPRESSION_6LORH
-  /* Add 6LoRH headers before IPHC. Only needed on routed traffic
-  (non link-local). */
-  if(!uip_is_addr_linklocal(&UIP_IP_BUF->destipaddr)) {
-    add_paging_dispatch(1);
-    add_6lorh_hdr();
-  }
-#endif /* SICSLOWPAN_COMPRESSION == SICSLOWPAN_COMPRESSION_6LORH */
-#if SICSLOWPAN_COMPRESSION >= SICSLOWPAN_COMPRESSION_IPHC
-  if(compress_hdr_iphc(&dest) == 0) {
+  if(compress_hdr(&dest) == 0) {
     /* Warning should already be issued by function above */
     return 0;
   }
-#endif /* SICSLOWPAN_COMPRESSION >= SICSLOWPAN_COMPRESSION_IPHC */
 
   /* Use the mac_max_payload to understand what is the max payload in a MAC
    * packet. We calculate it here only to make a better decision of whether
@@ -1644,7 +2225,7 @@ output(const linkaddr_t *localdest)
       fragment_count += 1 + (middle_fragn_total_payload - 1) / fragn_max_payload;
     }
 
-    int freebuf = queuebuf_numfree() - 1;
+    int freebuf = queuebuf_numfree();
     LOG_INFO("output: fragmentation needed, fragments: %u, free queuebufs: %u\n",
       fragment_count, freebuf);
 
@@ -1765,7 +2346,11 @@ input(void)
 
 #if SICSLOWPAN_CONF_FRAG
   uint8_t is_fragment = 0;
+#if SICSLOWPAN_REASS_DIRECT
+  struct sicslowpan_reass *reass = NULL;
+#else /* SICSLOWPAN_REASS_DIRECT */
   int8_t frag_context = 0;
+#endif /* SICSLOWPAN_REASS_DIRECT */
 
   /* tag of the fragment */
   uint16_t frag_tag = 0;
@@ -1815,15 +2400,28 @@ input(void)
       LOG_INFO("input: received first element of a fragmented packet (tag %d, len %d)\n",
              frag_tag, frag_size);
 
+#if SICSLOWPAN_REASS_DIRECT
+      /* Uncompress the first fragment right into the datagram buffer */
+      reass = reass_new(frag_tag, frag_size);
+      if(reass == NULL) {
+        LOG_ERR("input: failed to allocate new reassembly context\n");
+        reass_stats.dropped++;
+        return;
+      }
+
+      buffer = reass->buf;
+#else /* SICSLOWPAN_REASS_DIRECT */
       /* Add the fragment to the fragmentation context */
       frag_context = add_fragment(frag_tag, frag_size, frag_offset);
 
       if(frag_context == -1) {
         LOG_ERR("input: failed to allocate new reassembly context\n");
+        reass_stats.dropped++;
         return;
       }
 
       buffer = frag_info[frag_context].first_frag;
+#endif /* SICSLOWPAN_REASS_DIRECT */
       break;
     case SICSLOWPAN_DISPATCH_FRAGN:
       /*
@@ -1835,12 +2433,42 @@ input(void)
       frag_size = GET16(PACKETBUF_FRAG_PTR, PACKETBUF_FRAG_DISPATCH_SIZE) & 0x07ff;
       packetbuf_hdr_len += SICSLOWPAN_FRAGN_HDR_LEN;
 
+#if VRB_ENABLED
+      /* Fragments of a datagram routed through us go straight on */
+      if(vrb_forward(frag_tag, frag_offset)) {
+        return;
+      }
+#endif /* VRB_ENABLED */
+
+#if SICSLOWPAN_REASS_DIRECT
+      reass = reass_find(frag_tag);
+      if(reass != NULL && timer_expired(&reass->reass_timer)) {
+        LOG_WARN("reassembly: timed out (tag %d)\n", reass->tag);
+        reass_stats.timed_out++;
+        reass_free(reass);
+        reass = NULL;
+      }
+
+      if(reass == NULL || !reass_store(reass, frag_size, frag_offset)) {
+        LOG_ERR("input: reassembly context not found (tag %d)\n", frag_tag);
+        reass_stats.dropped++;
+        return;
+      }
+
+      /* The payload is in place already */
+      buffer = NULL;
+
+      if(reass->reassembled_len >= reass->len) {
+        last_fragment = 1;
+      }
+#else /* SICSLOWPAN_REASS_DIRECT */
       /* Add the fragment to the fragmentation context (this will also
          copy the payload) */
       frag_context = add_fragment(frag_tag, frag_size, frag_offset);
 
       if(frag_context == -1) {
         LOG_ERR("input: reassembly context not found (tag %d)\n", frag_tag);
+        reass_stats.dropped++;
         return;
       }
 
@@ -1851,6 +2479,7 @@ input(void)
       if(frag_info[frag_context].reassembled_len >= frag_size) {
         last_fragment = 1;
       }
+#endif /* SICSLOWPAN_REASS_DIRECT */
       is_fragment = 1;
       break;
     default:
@@ -1936,11 +2565,35 @@ input(void)
     memcpy((uint8_t *)buffer + uncomp_hdr_len, packetbuf_ptr + packetbuf_hdr_len, packetbuf_payload_len);
   }
 
+#if SICSLOWPAN_CONF_FRAG && VRB_ENABLED
+  /* Forward the datagram without reassembling it if it is routed on */
+  if(first_fragment != 0 &&
+     vrb_forward_first(buffer, uncomp_hdr_len + packetbuf_payload_len,
+                       frag_size, frag_tag)) {
+#if SICSLOWPAN_REASS_DIRECT
+    reass_free(reass);
+#else /* SICSLOWPAN_REASS_DIRECT */
+    clear_fragments(frag_context);
+#endif /* SICSLOWPAN_REASS_DIRECT */
+    return;
+  }
+#endif /* SICSLOWPAN_CONF_FRAG && VRB_ENABLED */
+
   /* update processed_ip_in_len if fragment, sicslowpan_len otherwise */
 
 #if SICSLOWPAN_CONF_FRAG
   if(frag_size > 0) {
     /* Add the size of the header only for the first fragment. */
+#if SICSLOWPAN_REASS_DIRECT
+    if(first_fragment != 0) {
+      reass_cover(reass, 0, uncomp_hdr_len + packetbuf_payload_len);
+    }
+    if(last_fragment != 0) {
+      memcpy((uint8_t *)UIP_IP_BUF, reass->buf, reass->len);
+      reass_free(reass);
+      reass_stats.completed++;
+    }
+#else /* SICSLOWPAN_REASS_DIRECT */
     if(first_fragment != 0) {
       frag_info[frag_context].reassembled_len = uncomp_hdr_len + packetbuf_payload_len;
       frag_info[frag_context].first_frag_len = uncomp_hdr_len + packetbuf_payload_len;
@@ -1951,7 +2604,9 @@ input(void)
       frag_info[frag_context].reassembled_len = frag_size;
       /* copy to uip */
       copy_frags2uip(frag_context);
+      reass_stats.completed++;
     }
+#endif /* SICSLOWPAN_REASS_DIRECT */
   }
 
   /*
@@ -2013,6 +2668,14 @@ input(void)
 void
 sicslowpan_init(void)
 {
+#if SICSLOWPAN_CONF_FRAG && SICSLOWPAN_REASS_DIRECT
+  memb_init(&reass_memb);
+  list_init(reass_list);
+#endif /* SICSLOWPAN_CONF_FRAG && SICSLOWPAN_REASS_DIRECT */
+#if SICSLOWPAN_CONF_FRAG && VRB_ENABLED
+  memb_init(&vrb_memb);
+  list_init(vrb_list);
+#endif /* SICSLOWPAN_CONF_FRAG && VRB_ENABLED */
 
 #if SICSLOWPAN_COMPRESSION == SICSLOWPAN_COMPRESSION_IPHC
 /* Preinitialize any address contexts for better header compression
@@ -2065,6 +2728,16 @@ sicslowpan_get_last_rssi(void)
   return last_rssi;
 }
 /*--------------------------------------------------------------------*/
+const struct sicslowpan_reass_stats *
+sicslowpan_get_reass_stats(void)
+{
+#if SICSLOWPAN_CONF_FRAG
+  return &reass_stats;
+#else /* SICSLOWPAN_CONF_FRAG */
+  return NULL;
+#endif /* SICSLOWPAN_CONF_FRAG */
+}
+/*--------------------------------------------------------------------*/
 const struct network_driver sicslowpan_driver = {
   "sicslowpan",
   sicslowpan_init,
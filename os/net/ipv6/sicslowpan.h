@@ -336,6 +336,25 @@ struct sicslowpan_nh_compressor {
 
 int sicslowpan_get_last_rssi(void);
 
+/** Outcome counters of the fragment reassembly contexts */
+struct sicslowpan_reass_stats {
+  /** Datagrams that were reassembled and delivered */
+  uint16_t completed;
+  /** Reassemblies abandoned after SICSLOWPAN_REASS_MAXAGE */
+  uint16_t timed_out;
+  /** Reassemblies dropped to make room for a new datagram */
+  uint16_t evicted;
+  /** Fragments dropped for lack of a reassembly context or buffer */
+  uint16_t dropped;
+  /** Datagrams forwarded fragment by fragment, without reassembly */
+  uint16_t forwarded;
+};
+
+/**
+ * \brief Get the fragment reassembly counters
+ */
+const struct sicslowpan_reass_stats *sicslowpan_get_reass_stats(void);
+
 extern const struct network_driver sicslowpan_driver;
 
 #endif /* SICSLOWPAN_H_ */
@@ -809,6 +809,9 @@ PROCESS_THREAD(tcpip_process, ev, data)
 {
   PROCESS_BEGIN();
 
+  /* Keep application event bursts from delaying packet processing */
+  process_set_priority(PROCESS_CURRENT(), PROCESS_PRIORITY_HIGH);
+
 #if UIP_TCP
   memset(s.listenports, 0, UIP_LISTENPORTS*sizeof(*(s.listenports)));
   s.p = PROCESS_CURRENT();
@@ -91,6 +91,23 @@ MEMB(routememb, uip_ds6_route_t, UIP_DS6_ROUTE_NB);
 static int num_routes = 0;
 static void rm_routelist_callback(nbr_table_item_t *ptr);
 
+#if UIP_DS6_ROUTE_TRIE
+/* The route trie is a compressed binary trie indexing the routes on
+   the routelist by prefix. Every node covers a prefix of the given
+   length; nodes either hold a route or are branching points with two
+   children, so a trie indexing N routes never needs more than 2N - 1
+   nodes. */
+struct route_trie_node {
+  struct route_trie_node *parent;
+  struct route_trie_node *child[2];
+  uip_ds6_route_t *route;
+  uip_ipaddr_t prefix;
+  uint8_t length;
+};
+MEMB(routetriememb, struct route_trie_node, 2 * UIP_DS6_ROUTE_NB);
+static struct route_trie_node *route_trie_root;
+#endif /* UIP_DS6_ROUTE_TRIE */
+
 #endif /* (UIP_MAX_ROUTES != 0) */
 
 /* Default routes are held on the defaultrouterlist and their
@@ -174,6 +191,10 @@ uip_ds6_route_init(void)
 #if (UIP_MAX_ROUTES != 0)
   memb_init(&routememb);
   list_init(routelist);
+#if UIP_DS6_ROUTE_TRIE
+  memb_init(&routetriememb);
+  route_trie_root = NULL;
+#endif /* UIP_DS6_ROUTE_TRIE */
   nbr_table_register(nbr_routes,
                      (nbr_table_callback *)rm_routelist_callback);
 #endif /* (UIP_MAX_ROUTES != 0) */
@@ -186,6 +207,237 @@ uip_ds6_route_init(void)
 #endif
 }
 #if (UIP_MAX_ROUTES != 0)
+#if UIP_DS6_ROUTE_TRIE
+/*---------------------------------------------------------------------------*/
+static int
+route_trie_bit(const uip_ipaddr_t *addr, uint8_t pos)
+{
+  return (addr->u8[pos >> 3] >> (7 - (pos & 7))) & 1;
+}
+/*---------------------------------------------------------------------------*/
+/* Returns the number of leading bits that a and b have in common,
+   capped at max. The first 'from' bits are known to be equal. */
+static uint8_t
+route_trie_common_bits(const uip_ipaddr_t *a, const uip_ipaddr_t *b,
+                       uint8_t from, uint8_t max)
+{
+  uint8_t i;
+  uint8_t bits;
+  uint8_t diff;
+
+  for(i = from >> 3, bits = i << 3;
+      i < sizeof(uip_ipaddr_t) && bits < max;
+      i++, bits += 8) {
+    diff = a->u8[i] ^ b->u8[i];
+    if(diff != 0) {
+      while((diff & 0x80) == 0) {
+        bits++;
+        diff <<= 1;
+      }
+      break;
+    }
+  }
+  return MIN(bits, max);
+}
+/*---------------------------------------------------------------------------*/
+static struct route_trie_node *
+route_trie_node_new(const uip_ipaddr_t *prefix, uint8_t length)
+{
+  struct route_trie_node *n;
+
+  n = memb_alloc(&routetriememb);
+  if(n != NULL) {
+    memset(n, 0, sizeof(*n));
+    uip_ipaddr_copy(&n->prefix, prefix);
+    n->length = length;
+  }
+  return n;
+}
+/*---------------------------------------------------------------------------*/
+static struct route_trie_node **
+route_trie_link(struct route_trie_node *n)
+{
+  if(n->parent == NULL) {
+    return &route_trie_root;
+  }
+  return &n->parent->child[n->parent->child[1] == n];
+}
+/*---------------------------------------------------------------------------*/
+static int
+route_trie_insert(uip_ds6_route_t *route)
+{
+  struct route_trie_node **link;
+  struct route_trie_node *parent;
+  struct route_trie_node *n;
+  struct route_trie_node *split;
+  struct route_trie_node *leaf;
+  uint8_t common;
+
+  link = &route_trie_root;
+  parent = NULL;
+  while((n = *link) != NULL) {
+    common = route_trie_common_bits(&route->ipaddr, &n->prefix,
+                                    parent != NULL ? parent->length : 0,
+                                    MIN(route->length, n->length));
+    if(common < n->length) {
+      /* The new prefix diverges from, or is shorter than, the prefix
+         of n: insert a node at the point where they differ. */
+      split = route_trie_node_new(&route->ipaddr, common);
+      leaf = NULL;
+      if(split == NULL) {
+        return 0;
+      }
+      if(common < route->length) {
+        leaf = route_trie_node_new(&route->ipaddr, route->length);
+        if(leaf == NULL) {
+          memb_free(&routetriememb, split);
+          return 0;
+        }
+        leaf->route = route;
+        leaf->parent = split;
+        split->child[route_trie_bit(&route->ipaddr, common)] = leaf;
+      } else {
+        split->route = route;
+      }
+      split->parent = parent;
+      split->child[route_trie_bit(&n->prefix, common)] = n;
+      n->parent = split;
+      *link = split;
+      return 1;
+    }
+    if(n->length == route->length) {
+      n->route = route;
+      return 1;
+    }
+    parent = n;
+    link = &n->child[route_trie_bit(&route->ipaddr, n->length)];
+  }
+
+  n = route_trie_node_new(&route->ipaddr, route->length);
+  if(n == NULL) {
+    return 0;
+  }
+  n->route = route;
+  n->parent = parent;
+  *link = n;
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+/* Returns the node holding exactly the given prefix, if any */
+static struct route_trie_node *
+route_trie_find(const uip_ipaddr_t *prefix, uint8_t length)
+{
+  struct route_trie_node *n;
+  uint8_t checked;
+
+  n = route_trie_root;
+  checked = 0;
+  while(n != NULL && n->length < length &&
+        route_trie_common_bits(prefix, &n->prefix,
+                               checked, n->length) == n->length) {
+    checked = n->length;
+    n = n->child[route_trie_bit(prefix, n->length)];
+  }
+  if(n == NULL || n->length != length ||
+     route_trie_common_bits(prefix, &n->prefix, checked, length) != length) {
+    return NULL;
+  }
+  return n;
+}
+/*---------------------------------------------------------------------------*/
+static void
+route_trie_remove(uip_ds6_route_t *route)
+{
+  struct route_trie_node *n;
+  struct route_trie_node *child;
+  struct route_trie_node *parent;
+
+  n = route_trie_find(&route->ipaddr, route->length);
+  if(n == NULL || n->route != route) {
+    return;
+  }
+  n->route = NULL;
+
+  /* Remove nodes that no longer hold a route or branch */
+  while(n != NULL && n->route == NULL &&
+        (n->child[0] == NULL || n->child[1] == NULL)) {
+    child = n->child[0] != NULL ? n->child[0] : n->child[1];
+    parent = n->parent;
+    *route_trie_link(n) = child;
+    memb_free(&routetriememb, n);
+    if(child != NULL) {
+      /* The parent still has as many children as before */
+      child->parent = parent;
+      break;
+    }
+    n = parent;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static uip_ds6_route_t *
+route_trie_lookup(const uip_ipaddr_t *addr)
+{
+  struct route_trie_node *n;
+  uip_ds6_route_t *found;
+  uint8_t checked;
+
+  found = NULL;
+  checked = 0;
+  for(n = route_trie_root;
+      n != NULL &&
+        route_trie_common_bits(addr, &n->prefix,
+                               checked, n->length) == n->length;
+      n = n->child[route_trie_bit(addr, n->length)]) {
+    if(n->route != NULL) {
+      found = n->route;
+    }
+    if(n->length == 128) {
+      break;
+    }
+    checked = n->length;
+  }
+  return found;
+}
+#endif /* UIP_DS6_ROUTE_TRIE */
+/*---------------------------------------------------------------------------*/
+/* Returns the route for exactly the given prefix, unlike
+   uip_ds6_route_lookup() which returns the longest matching one */
+static uip_ds6_route_t *
+route_find(const uip_ipaddr_t *ipaddr, uint8_t length)
+{
+#if UIP_DS6_ROUTE_TRIE
+  struct route_trie_node *n;
+
+  n = route_trie_find(ipaddr, length);
+  return n != NULL ? n->route : NULL;
+#else /* UIP_DS6_ROUTE_TRIE */
+  uip_ds6_route_t *r;
+
+  for(r = list_head(routelist); r != NULL; r = list_item_next(r)) {
+    if(r->length == length && uip_ipaddr_prefixcmp(ipaddr, &r->ipaddr, length)) {
+      return r;
+    }
+  }
+  return NULL;
+#endif /* UIP_DS6_ROUTE_TRIE */
+}
+/*---------------------------------------------------------------------------*/
+static void
+route_mark_used(uip_ds6_route_t *route)
+{
+#if !UIP_DS6_ROUTE_TRIE || UIP_DS6_ROUTE_REMOVE_LEAST_RECENTLY_USED
+  /* With the route trie, the list order only matters if it is used
+     to find the least recently used route. */
+  if(route != list_head(routelist)) {
+    /* We put the route at the start of the routeslist list. The list
+       is ordered by how recently we looked them up: the least recently
+       used route will be at the end of the list - for fast lookups
+       (assuming multiple packets to the same node). */
+    list_remove(routelist, route);
+    list_push(routelist, route);
+  }
+#endif /* !UIP_DS6_ROUTE_TRIE || UIP_DS6_ROUTE_REMOVE_LEAST_RECENTLY_USED */
+}
 /*---------------------------------------------------------------------------*/
 static uip_lladdr_t *
 uip_ds6_route_nexthop_lladdr(uip_ds6_route_t *route)
@@ -266,9 +518,11 @@ uip_ds6_route_t *
 uip_ds6_route_lookup(const uip_ipaddr_t *addr)
 {
 #if (UIP_MAX_ROUTES != 0)
-  uip_ds6_route_t *r;
   uip_ds6_route_t *found_route;
+#if !UIP_DS6_ROUTE_TRIE
+  uip_ds6_route_t *r;
   uint8_t longestmatch;
+#endif /* !UIP_DS6_ROUTE_TRIE */
 
   LOG_INFO("Looking up route for ");
   LOG_INFO_6ADDR(addr);
@@ -278,6 +532,9 @@ uip_ds6_route_lookup(const uip_ipaddr_t *addr)
     return NULL;
   }
 
+#if UIP_DS6_ROUTE_TRIE
+  found_route = route_trie_lookup(addr);
+#else /* UIP_DS6_ROUTE_TRIE */
   found_route = NULL;
   longestmatch = 0;
   for(r = uip_ds6_route_head();
@@ -293,6 +550,7 @@ uip_ds6_route_lookup(const uip_ipaddr_t *addr)
       }
     }
   }
+#endif /* UIP_DS6_ROUTE_TRIE */
 
   if(found_route != NULL) {
     LOG_INFO("Found route: ");
@@ -304,14 +562,8 @@ uip_ds6_route_lookup(const uip_ipaddr_t *addr)
     LOG_WARN("No route found\n");
   }
 
-  if(found_route != NULL && found_route != list_head(routelist)) {
-    /* If we found a route, we put it at the start of the routeslist
-       list. The list is ordered by how recently we looked them up:
-       the least recently used route will be at the end of the
-       list - for fast lookups (assuming multiple packets to the same node). */
-
-    list_remove(routelist, found_route);
-    list_push(routelist, found_route);
+  if(found_route != NULL) {
+    route_mark_used(found_route);
   }
 
   return found_route;
@@ -346,14 +598,15 @@ uip_ds6_route_add(const uip_ipaddr_t *ipaddr, uint8_t length,
   }
 
   /* First make sure that we don't add a route twice. If we find an
-     existing route for our destination, we'll delete the old
-     one first. */
-  r = uip_ds6_route_lookup(ipaddr);
+     existing route for the same prefix, we'll delete the old one
+     first. A longer route covering ipaddr is a different route. */
+  r = route_find(ipaddr, length);
   if(r != NULL) {
     const uip_ipaddr_t *current_nexthop;
     current_nexthop = uip_ds6_route_nexthop(r);
     if(current_nexthop != NULL && uip_ipaddr_cmp(nexthop, current_nexthop)) {
       /* no need to update route - already correct! */
+      route_mark_used(r);
       return r;
     }
     LOG_INFO("Add: old route for ");
@@ -460,6 +713,14 @@ uip_ds6_route_add(const uip_ipaddr_t *ipaddr, uint8_t length,
   memset(&r->state, 0, sizeof(UIP_DS6_ROUTE_STATE_TYPE));
 #endif
 
+#if UIP_DS6_ROUTE_TRIE
+  if(!route_trie_insert(r)) {
+    /* This should not happen, as the trie has room for twice as many
+       nodes as there are routes. */
+    LOG_ERR("Add: could not index route\n");
+  }
+#endif /* UIP_DS6_ROUTE_TRIE */
+
   LOG_INFO("Add: adding route: ");
   LOG_INFO_6ADDR(ipaddr);
   LOG_INFO_(" via ");
@@ -500,6 +761,9 @@ uip_ds6_route_rm(uip_ds6_route_t *route)
 
     /* Remove the route from the route list */
     list_remove(routelist, route);
+#if UIP_DS6_ROUTE_TRIE
+    route_trie_remove(route);
+#endif /* UIP_DS6_ROUTE_TRIE */
 
     /* Find the corresponding neighbor_route and remove it. */
     for(neighbor_route = list_head(route->neighbor_routes->route_list);
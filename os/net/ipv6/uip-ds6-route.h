@@ -104,6 +104,17 @@ void uip_ds6_notification_rm(struct uip_ds6_notification *n);
 /*--------------------------------------------------*/
 #endif
 
+/* Routing table lookup index. When enabled, a compressed binary (patricia)
+   trie is maintained alongside the route list, making
+   uip_ds6_route_lookup() proportional to the prefix length rather than
+   to the number of routes. Useful for roots and border routers with
+   large routing tables. */
+#ifdef UIP_CONF_DS6_ROUTE_TRIE
+#define UIP_DS6_ROUTE_TRIE UIP_CONF_DS6_ROUTE_TRIE
+#else /* UIP_CONF_DS6_ROUTE_TRIE */
+#define UIP_DS6_ROUTE_TRIE 0
+#endif /* UIP_CONF_DS6_ROUTE_TRIE */
+
 /* Routing table */
 #ifdef UIP_MAX_ROUTES
 #define UIP_DS6_ROUTE_NB UIP_MAX_ROUTES
@@ -58,6 +58,25 @@ static int num_nodes;
 LIST(nodelist);
 MEMB(nodememb, uip_sr_node_t, UIP_SR_LINK_NUM);
 
+#if UIP_SR_HASH_SIZE > 0
+/* Nodes indexed by link identifier */
+static uip_sr_node_t *node_hash[UIP_SR_HASH_SIZE];
+#endif /* UIP_SR_HASH_SIZE > 0 */
+
+#if UIP_SR_SRH_CACHE_SIZE > 0
+struct srh_cache_entry {
+  void *graph;
+  uip_ipaddr_t dest;
+  uip_ipaddr_t next_hop;
+  uint16_t version;
+  uint8_t len;
+  uint8_t hdr[UIP_SR_SRH_CACHE_MAX_LEN];
+};
+static struct srh_cache_entry srh_cache[UIP_SR_SRH_CACHE_SIZE];
+/* Incremented every time the graph changes, making all cached headers stale */
+static uint16_t topology_version;
+#endif /* UIP_SR_SRH_CACHE_SIZE > 0 */
+
 /*---------------------------------------------------------------------------*/
 int
 uip_sr_num_nodes(void)
@@ -65,6 +84,63 @@ uip_sr_num_nodes(void)
   return num_nodes;
 }
 /*---------------------------------------------------------------------------*/
+#if UIP_SR_HASH_SIZE > 0 || UIP_SR_SRH_CACHE_SIZE > 0
+static unsigned
+hash_link_identifier(const unsigned char *iid)
+{
+  unsigned hash = 0;
+  int i;
+  for(i = 0; i < 8; i++) {
+    hash = hash * 31 + iid[i];
+  }
+  return hash;
+}
+#endif /* UIP_SR_HASH_SIZE > 0 || UIP_SR_SRH_CACHE_SIZE > 0 */
+/*---------------------------------------------------------------------------*/
+#if UIP_SR_HASH_SIZE > 0
+static uip_sr_node_t **
+hash_bucket(const unsigned char *iid)
+{
+  return &node_hash[hash_link_identifier(iid) % UIP_SR_HASH_SIZE];
+}
+/*---------------------------------------------------------------------------*/
+static void
+hash_remove(uip_sr_node_t *node)
+{
+  uip_sr_node_t **prev;
+  for(prev = hash_bucket(node->link_identifier);
+      *prev != NULL; prev = &(*prev)->hash_next) {
+    if(*prev == node) {
+      *prev = node->hash_next;
+      return;
+    }
+  }
+}
+#endif /* UIP_SR_HASH_SIZE > 0 */
+/*---------------------------------------------------------------------------*/
+static void
+topology_changed(void)
+{
+#if UIP_SR_SRH_CACHE_SIZE > 0
+  if(++topology_version == 0) {
+    /* Make sure no stale entry becomes valid again after a wrap-around */
+    memset(srh_cache, 0, sizeof(srh_cache));
+  }
+#endif /* UIP_SR_SRH_CACHE_SIZE > 0 */
+}
+/*---------------------------------------------------------------------------*/
+static void
+free_node(uip_sr_node_t *node)
+{
+#if UIP_SR_HASH_SIZE > 0
+  hash_remove(node);
+#endif /* UIP_SR_HASH_SIZE > 0 */
+  list_remove(nodelist, node);
+  memb_free(&nodememb, node);
+  num_nodes--;
+  topology_changed();
+}
+/*---------------------------------------------------------------------------*/
 static int
 node_matches_address(void *graph, const uip_sr_node_t *node, const uip_ipaddr_t *addr)
 {
@@ -81,7 +157,15 @@ uip_sr_node_t *
 uip_sr_get_node(void *graph, const uip_ipaddr_t *addr)
 {
   uip_sr_node_t *l;
+  if(addr == NULL) {
+    return NULL;
+  }
+#if UIP_SR_HASH_SIZE > 0
+  for(l = *hash_bucket(((const unsigned char *)addr) + 8);
+      l != NULL; l = l->hash_next) {
+#else /* UIP_SR_HASH_SIZE > 0 */
   for(l = list_head(nodelist); l != NULL; l = list_item_next(l)) {
+#endif /* UIP_SR_HASH_SIZE > 0 */
     /* Compare prefix and node identifier */
     if(node_matches_address(graph, l, addr)) {
       return l;
@@ -148,18 +232,22 @@ uip_sr_update_node(void *graph, const uip_ipaddr_t *child, const uip_ipaddr_t *p
       return NULL;
     }
     child_node->parent = NULL;
+    memcpy(child_node->link_identifier, ((const unsigned char *)child) + 8, 8);
     list_add(nodelist, child_node);
+#if UIP_SR_HASH_SIZE > 0
+    child_node->hash_next = *hash_bucket(child_node->link_identifier);
+    *hash_bucket(child_node->link_identifier) = child_node;
+#endif /* UIP_SR_HASH_SIZE > 0 */
     num_nodes++;
   }
 
   /* Initialize node */
   child_node->graph = graph;
   child_node->lifetime = lifetime;
-  memcpy(child_node->link_identifier, ((const unsigned char *)child) + 8, 8);
+  old_parent_node = child_node->parent;
 
   /* Is the node reachable before the update? */
   if(uip_sr_is_addr_reachable(graph, child)) {
-    old_parent_node = child_node->parent;
     /* Update node */
     child_node->parent = parent_node;
     /* Has the node become unreachable? May happen if we create a loop. */
@@ -173,6 +261,10 @@ uip_sr_update_node(void *graph, const uip_ipaddr_t *child, const uip_ipaddr_t *p
     child_node->parent = parent_node;
   }
 
+  if(child_node->parent != old_parent_node) {
+    topology_changed();
+  }
+
   LOG_INFO("NS: updating link, child ");
   LOG_INFO_6ADDR(child);
   LOG_INFO_(", parent ");
@@ -188,6 +280,13 @@ uip_sr_init(void)
   num_nodes = 0;
   memb_init(&nodememb);
   list_init(nodelist);
+#if UIP_SR_HASH_SIZE > 0
+  memset(node_hash, 0, sizeof(node_hash));
+#endif /* UIP_SR_HASH_SIZE > 0 */
+#if UIP_SR_SRH_CACHE_SIZE > 0
+  memset(srh_cache, 0, sizeof(srh_cache));
+  topology_version = 0;
+#endif /* UIP_SR_SRH_CACHE_SIZE > 0 */
 }
 /*---------------------------------------------------------------------------*/
 uip_sr_node_t *
@@ -226,9 +325,7 @@ uip_sr_periodic(unsigned seconds)
         LOG_INFO_("\n");
       }
       /* No child found, deallocate node */
-      list_remove(nodelist, l);
-      memb_free(&nodememb, l);
-      num_nodes--;
+      free_node(l);
     } else if(l->lifetime != UIP_SR_INFINITE_LIFETIME) {
       l->lifetime = l->lifetime > seconds ? l->lifetime - seconds : 0;
     }
@@ -242,10 +339,51 @@ uip_sr_free_all(void)
   uip_sr_node_t *next;
   for(l = list_head(nodelist); l != NULL; l = next) {
     next = list_item_next(l);
-    list_remove(nodelist, l);
-    memb_free(&nodememb, l);
-    num_nodes--;
+    free_node(l);
+  }
+}
+/*---------------------------------------------------------------------------*/
+const uint8_t *
+uip_sr_srh_cache_lookup(void *graph, const uip_ipaddr_t *dest,
+                        uip_ipaddr_t *next_hop, uint8_t *len)
+{
+#if UIP_SR_SRH_CACHE_SIZE > 0
+  struct srh_cache_entry *e;
+
+  e = &srh_cache[hash_link_identifier(((const unsigned char *)dest) + 8)
+                 % UIP_SR_SRH_CACHE_SIZE];
+  if(e->len != 0 && e->version == topology_version && e->graph == graph
+     && uip_ipaddr_cmp(&e->dest, dest)) {
+    uip_ipaddr_copy(next_hop, &e->next_hop);
+    *len = e->len;
+    return e->hdr;
   }
+#endif /* UIP_SR_SRH_CACHE_SIZE > 0 */
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+void
+uip_sr_srh_cache_add(void *graph, const uip_ipaddr_t *dest,
+                     const uip_ipaddr_t *next_hop,
+                     const uint8_t *hdr, uint8_t len)
+{
+#if UIP_SR_SRH_CACHE_SIZE > 0
+  struct srh_cache_entry *e;
+
+  if(len == 0 || len > UIP_SR_SRH_CACHE_MAX_LEN) {
+    return;
+  }
+
+  /* Direct-mapped: the new header replaces whatever was in its slot */
+  e = &srh_cache[hash_link_identifier(((const unsigned char *)dest) + 8)
+                 % UIP_SR_SRH_CACHE_SIZE];
+  e->graph = graph;
+  uip_ipaddr_copy(&e->dest, dest);
+  uip_ipaddr_copy(&e->next_hop, next_hop);
+  e->version = topology_version;
+  e->len = len;
+  memcpy(e->hdr, hdr, len);
+#endif /* UIP_SR_SRH_CACHE_SIZE > 0 */
 }
 /*---------------------------------------------------------------------------*/
 int
@@ -85,6 +85,30 @@
 
 #define UIP_SR_INFINITE_LIFETIME           0xFFFFFFFF
 
+/* Number of buckets of the hash table indexing nodes by link identifier.
+ * 0 disables the hash table, in which case lookups scan the node list */
+#ifdef UIP_SR_CONF_HASH_SIZE
+#define UIP_SR_HASH_SIZE              UIP_SR_CONF_HASH_SIZE
+#else /* UIP_SR_CONF_HASH_SIZE */
+#define UIP_SR_HASH_SIZE              0
+#endif /* UIP_SR_CONF_HASH_SIZE */
+
+/* Number of source routing headers cached at the root, so that repeated
+ * packets to the same destination reuse the header built for the previous
+ * one. 0 disables the cache */
+#ifdef UIP_SR_CONF_SRH_CACHE_SIZE
+#define UIP_SR_SRH_CACHE_SIZE         UIP_SR_CONF_SRH_CACHE_SIZE
+#else /* UIP_SR_CONF_SRH_CACHE_SIZE */
+#define UIP_SR_SRH_CACHE_SIZE         0
+#endif /* UIP_SR_CONF_SRH_CACHE_SIZE */
+
+/* Largest source routing header that will be cached */
+#ifdef UIP_SR_CONF_SRH_CACHE_MAX_LEN
+#define UIP_SR_SRH_CACHE_MAX_LEN      UIP_SR_CONF_SRH_CACHE_MAX_LEN
+#else /* UIP_SR_CONF_SRH_CACHE_MAX_LEN */
+#define UIP_SR_SRH_CACHE_MAX_LEN      64
+#endif /* UIP_SR_CONF_SRH_CACHE_MAX_LEN */
+
 /********** Data Structures  **********/
 
 /** \brief A node in a source routing graph, stored at the root and representing
@@ -98,6 +122,10 @@ typedef struct uip_sr_node {
   us with the prefix */
   unsigned char link_identifier[8];
   struct uip_sr_node *parent;
+#if UIP_SR_HASH_SIZE > 0
+  /* Next node in the same hash bucket */
+  struct uip_sr_node *hash_next;
+#endif /* UIP_SR_HASH_SIZE > 0 */
 } uip_sr_node_t;
 
 /********** Public functions **********/
@@ -170,6 +198,32 @@ int uip_sr_is_addr_reachable(void *graph, const uip_ipaddr_t *addr);
 */
 void uip_sr_periodic(unsigned seconds);
 
+/**
+ * Looks up the source routing header cached for a destination. Any change
+ * to the source routing graph invalidates the cache.
+ *
+ * \param graph The graph the destination belongs to
+ * \param dest The destination IPv6 address
+ * \param next_hop Where to write the first hop of the source route
+ * \param len Where to write the length of the header
+ * \return A pointer to the cached header, NULL if none is cached
+*/
+const uint8_t *uip_sr_srh_cache_lookup(void *graph, const uip_ipaddr_t *dest,
+                                       uip_ipaddr_t *next_hop, uint8_t *len);
+
+/**
+ * Stores the source routing header built for a destination in the cache
+ *
+ * \param graph The graph the destination belongs to
+ * \param dest The destination IPv6 address
+ * \param next_hop The first hop of the source route
+ * \param hdr The routing header, starting with the generic IPv6 routing header
+ * \param len The length of the header
+*/
+void uip_sr_srh_cache_add(void *graph, const uip_ipaddr_t *dest,
+                          const uip_ipaddr_t *next_hop,
+                          const uint8_t *hdr, uint8_t len);
+
 /**
  * Initialize this module
 */
@@ -2099,6 +2099,24 @@ extern uip_lladdr_t uip_lladdr;
  */
 uint16_t uip_chksum(uint16_t *data, uint16_t len);
 
+/**
+ * Add the 16-bit words of a buffer to a one's complement sum.
+ *
+ * uIP computes all checksums with this function when the CPU sets
+ * UIP_ARCH_CHKSUM_ADD and provides an optimized implementation of it.
+ *
+ * \param sum The sum so far, in host byte order.
+ *
+ * \param data A pointer to the buffer, in network byte order. No
+ * particular alignment is required.
+ *
+ * \param len The length of the buffer. An odd last byte is padded with
+ * zero.
+ *
+ * \return The one's complement sum, in host byte order.
+ */
+uint16_t uip_arch_chksum_add(uint16_t sum, const uint8_t *data, uint16_t len);
+
 /**
  * Calculate the IP header checksum of the packet header in uip_buf.
  *
@@ -277,37 +277,44 @@ uip_add32(uint8_t *op32, uint16_t op16)
 #endif /* UIP_TCP */
 
 #if ! UIP_ARCH_CHKSUM
+#if UIP_ARCH_CHKSUM_ADD
+#define chksum uip_arch_chksum_add
+#else /* UIP_ARCH_CHKSUM_ADD */
 /*---------------------------------------------------------------------------*/
 static uint16_t
 chksum(uint16_t sum, const uint8_t *data, uint16_t len)
 {
-  uint16_t t;
-  const uint8_t *dataptr;
-  const uint8_t *last_byte;
-
-  dataptr = data;
-  last_byte = data + len - 1;
-
-  while(dataptr < last_byte) {   /* At least two more bytes */
-    t = (dataptr[0] << 8) + dataptr[1];
-    sum += t;
-    if(sum < t) {
-      sum++;      /* carry */
-    }
-    dataptr += 2;
+  /* The carries are accumulated in the upper half and folded back in
+     at the end. For len < 64 KiB the accumulator cannot overflow. */
+  uint32_t acc = sum;
+
+  /* Four words per iteration */
+  while(len >= 8) {
+    acc += ((uint16_t)data[0] << 8) + data[1];
+    acc += ((uint16_t)data[2] << 8) + data[3];
+    acc += ((uint16_t)data[4] << 8) + data[5];
+    acc += ((uint16_t)data[6] << 8) + data[7];
+    data += 8;
+    len -= 8;
   }
 
-  if(dataptr == last_byte) {
-    t = (dataptr[0] << 8) + 0;
-    sum += t;
-    if(sum < t) {
-      sum++;      /* carry */
-    }
+  while(len >= 2) {
+    acc += ((uint16_t)data[0] << 8) + data[1];
+    data += 2;
+    len -= 2;
   }
 
+  if(len == 1) {
+    acc += (uint16_t)data[0] << 8;
+  }
+
+  acc = (acc >> 16) + (acc & 0xffff);
+  acc = (acc >> 16) + (acc & 0xffff);
+
   /* Return sum in host byte order. */
-  return sum;
+  return (uint16_t)acc;
 }
+#endif /* UIP_ARCH_CHKSUM_ADD */
 /*---------------------------------------------------------------------------*/
 uint16_t
 uip_chksum(uint16_t *data, uint16_t len)
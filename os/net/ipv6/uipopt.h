@@ -559,6 +559,38 @@ void uip_log(char *msg);
 #define SICSLOWPAN_CONF_FRAG  1
 #endif
 
+/**
+ * Reassemble fragments in place: each reassembly gets a datagram-sized
+ * buffer from a pool, and every fragment is written once at its final
+ * offset instead of being buffered and copied twice
+ */
+#ifdef SICSLOWPAN_CONF_REASS_DIRECT
+#define SICSLOWPAN_REASS_DIRECT SICSLOWPAN_CONF_REASS_DIRECT
+#else
+#define SICSLOWPAN_REASS_DIRECT 0
+#endif
+
+/**
+ * Forward fragments of datagrams that are routed through this node
+ * without reassembling them (virtual reassembly, RFC 8930). The first
+ * fragment selects the next hop, subsequent fragments follow it as
+ * soon as they arrive. Only meaningful on routers.
+ */
+#ifdef SICSLOWPAN_CONF_FRAG_FORWARDING
+#define SICSLOWPAN_FRAG_FORWARDING SICSLOWPAN_CONF_FRAG_FORWARDING
+#else
+#define SICSLOWPAN_FRAG_FORWARDING 0
+#endif
+
+/**
+ * The number of datagrams whose fragments can be forwarded at once
+ */
+#ifdef SICSLOWPAN_CONF_VRB_ENTRIES
+#define SICSLOWPAN_VRB_ENTRIES SICSLOWPAN_CONF_VRB_ENTRIES
+#else
+#define SICSLOWPAN_VRB_ENTRIES 4
+#endif
+
 /** @} */
 
 /*------------------------------------------------------------------------------*/
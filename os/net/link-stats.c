@@ -86,6 +86,42 @@ link_stats_get_lladdr(const struct link_stats *stat)
 {
   return nbr_table_get_lladdr(link_stats, stat);
 }
+#if NBR_TABLE_LRU
+/*---------------------------------------------------------------------------*/
+/* Among the least recently used neighbors, pick the one with the worst
+ * link: no statistics at all, then stale statistics, then the highest ETX */
+static const linkaddr_t *
+find_removable(nbr_table_reason_t reason, void *data)
+{
+  const linkaddr_t *lladdr;
+  const linkaddr_t *worst = NULL;
+  uint32_t worst_score = 0;
+  int i;
+
+  for(lladdr = nbr_table_lru_head(), i = 0;
+      lladdr != NULL && i < NBR_TABLE_POLICY_CANDIDATES;
+      lladdr = nbr_table_lru_next(lladdr), i++) {
+    const struct link_stats *stats = link_stats_from_lladdr(lladdr);
+    uint32_t score;
+    if(stats == NULL) {
+      return lladdr;
+    }
+    score = stats->etx;
+    if(!link_stats_is_fresh(stats)) {
+      score += 0x10000;
+    }
+    if(worst == NULL || score > worst_score) {
+      worst = lladdr;
+      worst_score = score;
+    }
+  }
+  return worst;
+}
+const nbr_table_policy_t link_stats_nbr_policy = {
+  "link-quality",
+  find_removable
+};
+#endif /* NBR_TABLE_LRU */
 /*---------------------------------------------------------------------------*/
 /* Are the statistics fresh? */
 int
@@ -34,6 +34,7 @@
 #define LINK_STATS_H_
 
 #include "net/linkaddr.h"
+#include "net/nbr-table.h"
 
 /* ETX fixed point divisor. 128 is the value used by RPL (RFC 6551 and RFC 6719) */
 #ifdef LINK_STATS_CONF_ETX_DIVISOR
@@ -107,4 +108,10 @@ void link_stats_packet_sent(const linkaddr_t *lladdr, int status, int numtx);
 /* Packet input callback. Updates statistics for receptions on a given link */
 void link_stats_input_callback(const linkaddr_t *lladdr);
 
+#if NBR_TABLE_LRU
+/* Neighbor table eviction policy that removes the neighbor with the
+ * worst link among the least recently used ones */
+extern const nbr_table_policy_t link_stats_nbr_policy;
+#endif /* NBR_TABLE_LRU */
+
 #endif /* LINK_STATS_H_ */
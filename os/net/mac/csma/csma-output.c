@@ -40,6 +40,7 @@
  */
 
 #include "net/mac/csma/csma.h"
+#include "net/mac/csma/csma-output.h"
 #include "net/mac/csma/csma-security.h"
 #include "net/packetbuf.h"
 #include "net/queuebuf.h"
@@ -50,6 +51,9 @@
 #include "net/netstack.h"
 #include "lib/list.h"
 #include "lib/memb.h"
+#include "net/nbr-table.h"
+
+#include <string.h>
 
 /* Log configuration */
 #include "sys/log.h"
@@ -86,6 +90,11 @@
 #define CSMA_MAX_FRAME_RETRIES 7
 #endif
 
+/* Bits of the first byte of the frame control field, which are read or
+   updated in frames that are already created */
+#define FCF_SECURITY_ENABLED 0x08
+#define FCF_FRAME_PENDING    0x10
+
 /* Packet metadata */
 struct qbuf_metadata {
   mac_callback_t sent;
@@ -100,6 +109,10 @@ struct neighbor_queue {
   struct ctimer transmit_timer;
   uint8_t transmissions;
   uint8_t collisions;
+#if CSMA_BURST_MAX_FRAMES > 0
+  /* Frames acknowledged so far in the ongoing burst */
+  uint8_t burst_len;
+#endif /* CSMA_BURST_MAX_FRAMES > 0 */
   LIST_STRUCT(packet_queue);
 };
 
@@ -130,8 +143,14 @@ MEMB(neighbor_memb, struct neighbor_queue, CSMA_MAX_NEIGHBOR_QUEUES);
 MEMB(packet_memb, struct packet_queue, MAX_QUEUED_PACKETS);
 MEMB(metadata_memb, struct qbuf_metadata, MAX_QUEUED_PACKETS);
 LIST(neighbor_list);
-
-static void packet_sent(void *ptr, int status, int num_transmissions);
+#if CSMA_BURST_MAX_FRAMES > 0
+/* The state of a burst is kept in its neighbor queue, the statistics
+   are for all neighbors together */
+static struct csma_burst_stats burst_stats;
+#endif /* CSMA_BURST_MAX_FRAMES > 0 */
+
+static void packet_sent(struct neighbor_queue *n, struct packet_queue *q,
+                        int status, int num_transmissions);
 static void transmit_from_queue(void *ptr);
 /*---------------------------------------------------------------------------*/
 static struct neighbor_queue *
@@ -161,12 +180,10 @@ backoff_period(void)
 #endif /* CONTIKI_TARGET_COOJA */
 }
 /*---------------------------------------------------------------------------*/
+/* Create the frame in packetbuf, once for all its transmissions */
 static int
-send_one_packet(void *ptr)
+create_frame(void)
 {
-  int ret;
-  int last_sent_ok = 0;
-
   packetbuf_set_addr(PACKETBUF_ADDR_SENDER, &linkaddr_node_addr);
   packetbuf_set_attr(PACKETBUF_ATTR_MAC_ACK, 1);
 
@@ -177,77 +194,111 @@ send_one_packet(void *ptr)
 #endif /* LLSEC802154_USES_EXPLICIT_KEYS */
 #endif /* LLSEC802154_ENABLED */
 
-  if(csma_security_create_frame() < 0) {
-    /* Failed to allocate space for headers */
-    LOG_ERR("failed to create packet, seqno: %d\n", packetbuf_attr(PACKETBUF_ATTR_MAC_SEQNO));
-    ret = MAC_TX_ERR_FATAL;
+  return csma_security_create_frame();
+}
+/*---------------------------------------------------------------------------*/
+/* Transmit the frame straight from its queuebuf */
+static int
+send_one_packet(struct neighbor_queue *n, struct packet_queue *q)
+{
+  int ret;
+  int last_sent_ok = 0;
+  uint8_t *frame;
+  uint16_t len;
+  int is_broadcast;
+  uint8_t dsn;
+
+  frame = queuebuf_dataptr(q->buf);
+  len = queuebuf_datalen(q->buf);
+  dsn = frame[2];
+  is_broadcast = linkaddr_cmp(queuebuf_addr(q->buf, PACKETBUF_ADDR_RECEIVER),
+                              &linkaddr_null);
+
+  NETSTACK_RADIO.prepare(frame, len);
+
+  if(NETSTACK_RADIO.receiving_packet() ||
+     (!is_broadcast && NETSTACK_RADIO.pending_packet())) {
+
+    /* Currently receiving a packet over air or the radio has
+       already received a packet that needs to be read before
+       sending with auto ack. */
+    ret = MAC_TX_COLLISION;
   } else {
-    int is_broadcast;
-    uint8_t dsn;
-    dsn = ((uint8_t *)packetbuf_hdrptr())[2] & 0xff;
-
-    NETSTACK_RADIO.prepare(packetbuf_hdrptr(), packetbuf_totlen());
-
-    is_broadcast = packetbuf_holds_broadcast();
 
-    if(NETSTACK_RADIO.receiving_packet() ||
-       (!is_broadcast && NETSTACK_RADIO.pending_packet())) {
-
-      /* Currently receiving a packet over air or the radio has
-         already received a packet that needs to be read before
-         sending with auto ack. */
-      ret = MAC_TX_COLLISION;
-    } else {
-
-      switch(NETSTACK_RADIO.transmit(packetbuf_totlen())) {
-      case RADIO_TX_OK:
-        if(is_broadcast) {
-          ret = MAC_TX_OK;
-        } else {
-          /* Check for ack */
-
-          /* Wait for max CSMA_ACK_WAIT_TIME */
-          RTIMER_BUSYWAIT_UNTIL(NETSTACK_RADIO.pending_packet(), CSMA_ACK_WAIT_TIME);
-
-          ret = MAC_TX_NOACK;
-          if(NETSTACK_RADIO.receiving_packet() ||
-             NETSTACK_RADIO.pending_packet() ||
-             NETSTACK_RADIO.channel_clear() == 0) {
-            int len;
-            uint8_t ackbuf[CSMA_ACK_LEN];
-
-            /* Wait an additional CSMA_AFTER_ACK_DETECTED_WAIT_TIME to complete reception */
-            RTIMER_BUSYWAIT_UNTIL(NETSTACK_RADIO.pending_packet(), CSMA_AFTER_ACK_DETECTED_WAIT_TIME);
-
-            if(NETSTACK_RADIO.pending_packet()) {
-              len = NETSTACK_RADIO.read(ackbuf, CSMA_ACK_LEN);
-              if(len == CSMA_ACK_LEN && ackbuf[2] == dsn) {
-                /* Ack received */
-                ret = MAC_TX_OK;
-              } else {
-                /* Not an ack or ack not for us: collision */
-                ret = MAC_TX_COLLISION;
-              }
+    switch(NETSTACK_RADIO.transmit(len)) {
+    case RADIO_TX_OK:
+      if(is_broadcast) {
+        ret = MAC_TX_OK;
+      } else {
+        /* Check for ack */
+
+        /* Wait for max CSMA_ACK_WAIT_TIME */
+        RTIMER_BUSYWAIT_UNTIL(NETSTACK_RADIO.pending_packet(), CSMA_ACK_WAIT_TIME);
+
+        ret = MAC_TX_NOACK;
+        if(NETSTACK_RADIO.receiving_packet() ||
+           NETSTACK_RADIO.pending_packet() ||
+           NETSTACK_RADIO.channel_clear() == 0) {
+          int len;
+          uint8_t ackbuf[CSMA_ACK_LEN];
+
+          /* Wait an additional CSMA_AFTER_ACK_DETECTED_WAIT_TIME to complete reception */
+          RTIMER_BUSYWAIT_UNTIL(NETSTACK_RADIO.pending_packet(), CSMA_AFTER_ACK_DETECTED_WAIT_TIME);
+
+          if(NETSTACK_RADIO.pending_packet()) {
+            len = NETSTACK_RADIO.read(ackbuf, CSMA_ACK_LEN);
+            if(len == CSMA_ACK_LEN && ackbuf[2] == dsn) {
+              /* Ack received */
+              ret = MAC_TX_OK;
+            } else {
+              /* Not an ack or ack not for us: collision */
+              ret = MAC_TX_COLLISION;
             }
           }
         }
-        break;
-      case RADIO_TX_COLLISION:
-        ret = MAC_TX_COLLISION;
-        break;
-      default:
-        ret = MAC_TX_ERR;
-        break;
       }
+      break;
+    case RADIO_TX_COLLISION:
+      ret = MAC_TX_COLLISION;
+      break;
+    default:
+      ret = MAC_TX_ERR;
+      break;
     }
   }
   if(ret == MAC_TX_OK) {
     last_sent_ok = 1;
   }
 
-  packet_sent(ptr, ret, 1);
+  packet_sent(n, q, ret, 1);
   return last_sent_ok;
 }
+#if CSMA_BURST_MAX_FRAMES > 0
+/*---------------------------------------------------------------------------*/
+/* Announce in the created frame whether another frame follows. The
+   header of a secured frame is authenticated and cannot be updated, so
+   secured frames are never sent in bursts. */
+static void
+set_frame_pending(struct packet_queue *q, int pending)
+{
+  uint8_t *frame = queuebuf_dataptr(q->buf);
+
+  if(frame[0] & FCF_SECURITY_ENABLED) {
+    return;
+  }
+  if(pending) {
+    frame[0] |= FCF_FRAME_PENDING;
+  } else {
+    frame[0] &= ~FCF_FRAME_PENDING;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static int
+frame_pending(struct packet_queue *q)
+{
+  return (((uint8_t *)queuebuf_dataptr(q->buf))[0] & FCF_FRAME_PENDING) != 0;
+}
+#endif /* CSMA_BURST_MAX_FRAMES > 0 */
 /*---------------------------------------------------------------------------*/
 static void
 transmit_from_queue(void *ptr)
@@ -261,9 +312,15 @@ transmit_from_queue(void *ptr)
       LOG_INFO_(", seqno %u, tx %u, queue %d\n",
         queuebuf_attr(q->buf, PACKETBUF_ATTR_MAC_SEQNO),
         n->transmissions, list_length(n->packet_queue));
+#if CSMA_BURST_MAX_FRAMES > 0
+      /* Announce that another frame follows if it is to be sent
+         right after this one */
+      set_frame_pending(q, !linkaddr_cmp(&n->addr, &linkaddr_null) &&
+                        list_item_next(q) != NULL &&
+                        n->burst_len + 1 < CSMA_BURST_MAX_FRAMES);
+#endif /* CSMA_BURST_MAX_FRAMES > 0 */
       /* Send first packet in the neighbor queue */
-      queuebuf_to_packetbuf(q->buf);
-      send_one_packet(n);
+      send_one_packet(n, q);
     }
   }
 }
@@ -278,6 +335,12 @@ schedule_transmission(struct neighbor_queue *n)
 
   /* Compute max delay as per IEEE 802.15.4: 2^BE-1 backoff periods  */
   delay = ((1 << backoff_exponent) - 1) * backoff_period();
+#if CSMA_BURST_MAX_FRAMES > 0
+  if(n->burst_len > 0) {
+    /* The receiver expects the next frame of the burst right away */
+    delay = 0;
+  }
+#endif /* CSMA_BURST_MAX_FRAMES > 0 */
   if(delay > 0) {
     /* Pick a time for next transmission */
     delay = random_rand() % delay;
@@ -331,9 +394,11 @@ tx_done(int status, struct packet_queue *q, struct neighbor_queue *n)
   LOG_INFO("packet sent to ");
   LOG_INFO_LLADDR(&n->addr);
   LOG_INFO_(", seqno %u, status %u, tx %u, coll %u\n",
-              packetbuf_attr(PACKETBUF_ATTR_MAC_SEQNO),
+              queuebuf_attr(q->buf, PACKETBUF_ATTR_MAC_SEQNO),
               status, n->transmissions, n->collisions);
 
+  /* The callback finds the attributes of the packet in packetbuf */
+  queuebuf_attr_to_packetbuf(q->buf);
   free_packet(n, q, status);
   mac_call_sent_callback(sent, cptr, status, ntx);
 }
@@ -342,9 +407,6 @@ static void
 rexmit(struct packet_queue *q, struct neighbor_queue *n)
 {
   schedule_transmission(n);
-  /* This is needed to correctly attribute energy that we spent
-     transmitting this packet. */
-  queuebuf_update_attr_from_packetbuf(q->buf);
 }
 /*---------------------------------------------------------------------------*/
 static void
@@ -394,42 +456,58 @@ tx_ok(struct packet_queue *q, struct neighbor_queue *n, int num_transmissions)
   n->transmissions += num_transmissions;
   tx_done(MAC_TX_OK, q, n);
 }
+#if CSMA_BURST_MAX_FRAMES > 0
 /*---------------------------------------------------------------------------*/
 static void
-packet_sent(void *ptr, int status, int num_transmissions)
+burst_update(struct neighbor_queue *n, struct packet_queue *q, int status)
 {
-  struct neighbor_queue *n;
-  struct packet_queue *q;
+  int more;
 
-  n = ptr;
-  if(n == NULL) {
+  /* The burst goes on only if the frame that announced more was acked */
+  more = status == MAC_TX_OK && frame_pending(q);
+  if(n->burst_len == 0 && !more) {
+    /* A frame sent on its own */
     return;
   }
 
-  /* Find out what packet this callback refers to */
-  for(q = list_head(n->packet_queue);
-      q != NULL; q = list_item_next(q)) {
-    if(queuebuf_attr(q->buf, PACKETBUF_ATTR_MAC_SEQNO) ==
-       packetbuf_attr(PACKETBUF_ATTR_MAC_SEQNO)) {
-      break;
+  if(n->burst_len > 0) {
+    burst_stats.burst_frames++;
+    if(status != MAC_TX_OK) {
+      burst_stats.aborted++;
     }
   }
 
-  if(q == NULL) {
-    LOG_WARN("packet sent: seqno %u not found\n",
-           packetbuf_attr(PACKETBUF_ATTR_MAC_SEQNO));
-    return;
-  } else if(q->ptr == NULL) {
-    LOG_WARN("packet sent: no metadata\n");
-    return;
+  if(more) {
+    n->burst_len++;
+  } else {
+    LOG_DBG("burst of %u frames to ", n->burst_len + 1);
+    LOG_DBG_LLADDR(&n->addr);
+    LOG_DBG_(", status %u\n", status);
+    burst_stats.bursts++;
+    if(n->burst_len + 1 > burst_stats.longest) {
+      burst_stats.longest = n->burst_len + 1;
+    }
+    n->burst_len = 0;
   }
-
+}
+#endif /* CSMA_BURST_MAX_FRAMES > 0 */
+/*---------------------------------------------------------------------------*/
+static void
+packet_sent(struct neighbor_queue *n, struct packet_queue *q,
+            int status, int num_transmissions)
+{
   LOG_INFO("tx to ");
   LOG_INFO_LLADDR(&n->addr);
   LOG_INFO_(", seqno %u, status %u, tx %u, coll %u\n",
-            packetbuf_attr(PACKETBUF_ATTR_MAC_SEQNO),
+            queuebuf_attr(q->buf, PACKETBUF_ATTR_MAC_SEQNO),
             status, n->transmissions, n->collisions);
 
+#if CSMA_BURST_MAX_FRAMES > 0
+  if(status != MAC_TX_DEFERRED) {
+    burst_update(n, q, status);
+  }
+#endif /* CSMA_BURST_MAX_FRAMES > 0 */
+
   switch(status) {
   case MAC_TX_OK:
     tx_ok(q, n, num_transmissions);
@@ -471,6 +549,16 @@ csma_output_packet(mac_callback_t sent, void *ptr)
   packetbuf_set_attr(PACKETBUF_ATTR_MAC_SEQNO, seqno++);
   packetbuf_set_attr(PACKETBUF_ATTR_FRAME_TYPE, FRAME802154_DATAFRAME);
 
+  /* The frame is created here and queued as is, so that every attempt
+     transmits it straight from its queuebuf */
+  if(create_frame() < 0) {
+    /* Failed to allocate space for headers */
+    LOG_ERR("failed to create packet, seqno: %d\n",
+            packetbuf_attr(PACKETBUF_ATTR_MAC_SEQNO));
+    mac_call_sent_callback(sent, ptr, MAC_TX_ERR_FATAL, 1);
+    return;
+  }
+
   /* Look for the neighbor entry */
   n = neighbor_queue_from_addr(addr);
   if(n == NULL) {
@@ -481,6 +569,9 @@ csma_output_packet(mac_callback_t sent, void *ptr)
       linkaddr_copy(&n->addr, addr);
       n->transmissions = 0;
       n->collisions = 0;
+#if CSMA_BURST_MAX_FRAMES > 0
+      n->burst_len = 0;
+#endif /* CSMA_BURST_MAX_FRAMES > 0 */
       /* Init packet queue for this neighbor */
       LIST_STRUCT_INIT(n, packet_queue);
       /* Add neighbor to the neighbor list */
@@ -547,4 +638,15 @@ csma_output_init(void)
   memb_init(&packet_memb);
   memb_init(&metadata_memb);
   memb_init(&neighbor_memb);
+#if CSMA_BURST_MAX_FRAMES > 0
+  memset(&burst_stats, 0, sizeof(burst_stats));
+#endif /* CSMA_BURST_MAX_FRAMES > 0 */
+}
+#if CSMA_BURST_MAX_FRAMES > 0
+/*---------------------------------------------------------------------------*/
+const struct csma_burst_stats *
+csma_output_burst_stats(void)
+{
+  return &burst_stats;
 }
+#endif /* CSMA_BURST_MAX_FRAMES > 0 */
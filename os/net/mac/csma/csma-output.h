@@ -44,8 +44,28 @@
 
 #include "contiki.h"
 #include "net/mac/mac.h"
+#include "net/mac/csma/csma.h"
+#include "net/linkaddr.h"
+
+/* Burst statistics, for all neighbors together */
+struct csma_burst_stats {
+  uint16_t bursts;        /* Bursts of at least two frames */
+  uint16_t burst_frames;  /* Frames sent without backoff within a burst */
+  uint16_t aborted;       /* Bursts cut short by a failed transmission */
+  uint8_t longest;        /* The largest number of frames in a burst */
+};
 
 void csma_output_packet(mac_callback_t sent, void *ptr);
 void csma_output_init(void);
 
+#if CSMA_BURST_MAX_FRAMES > 0
+/* Get the burst statistics. They are totals for all neighbors rather
+   than per neighbor: keeping them per neighbor would need an entry in the
+   neighbor table, and adding one just for statistics could evict a
+   neighbor that the upper layers need. The CSMA neighbor queues, which
+   hold the state of ongoing bursts, are freed once empty and cannot
+   keep statistics either. */
+const struct csma_burst_stats *csma_output_burst_stats(void);
+#endif /* CSMA_BURST_MAX_FRAMES > 0 */
+
 #endif /* CSMA_OUTPUT_H_ */
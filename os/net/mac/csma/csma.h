@@ -65,6 +65,16 @@
 
 #define CSMA_ACK_LEN 3
 
+/* The maximum number of frames sent back-to-back to the same neighbor.
+ * Once a frame announced with the frame pending bit is acknowledged,
+ * the next queued frame is sent without a new backoff. 0 disables
+ * bursts. */
+#ifdef CSMA_CONF_BURST_MAX_FRAMES
+#define CSMA_BURST_MAX_FRAMES CSMA_CONF_BURST_MAX_FRAMES
+#else /* CSMA_CONF_BURST_MAX_FRAMES */
+#define CSMA_BURST_MAX_FRAMES 0
+#endif /* CSMA_CONF_BURST_MAX_FRAMES */
+
 /* Default MAC len for 802.15.4 classic */
 #ifdef  CSMA_MAC_CONF_LEN
 #define CSMA_MAC_LEN CSMA_MAC_CONF_LEN
@@ -75,11 +75,15 @@ enum ieee802154e_mlme_short_subie_id {
   MLME_SHORT_IE_TSCH_EB_FILTER,
   MLME_SHORT_IE_TSCH_MAC_METRICS_1,
   MLME_SHORT_IE_TSCH_MAC_METRICS_2,
+  /* Not defined by IEEE 802.15.4 */
+  MLME_SHORT_IE_TSCH_CHANNEL_QUALITY = 0x7f,
 };
 
 /* c.f. IEEE 802.15.4e Table 4e */
 enum ieee802154e_mlme_long_subie_id {
   MLME_LONG_IE_TSCH_CHANNEL_HOPPING_SEQUENCE = 0x9,
+  /* Not defined by IEEE 802.15.4 */
+  MLME_LONG_IE_TSCH_NEXT_HOPPING_SEQUENCE = 0xa,
 };
 
 #include <net/mac/tsch/sixtop/sixtop.h>
@@ -340,6 +344,58 @@ frame80215e_create_ie_tsch_channel_hopping_sequence(uint8_t *buf, int len,
   }
 }
 
+#if TSCH_WITH_HOPPING_SEQUENCE_SWITCH
+/* MLME sub-IE. Next TSCH hopping sequence. Used in EBs: announces a
+ * hopping sequence switch */
+int
+frame80215e_create_ie_tsch_next_hopping_sequence(uint8_t *buf, int len,
+    struct ieee802154_ies *ies)
+{
+  int ie_len;
+  if(ies == NULL || ies->ie_next_hopping_sequence_len == 0
+     || ies->ie_next_hopping_sequence_len > sizeof(ies->ie_next_hopping_sequence_list)) {
+    return -1;
+  }
+  ie_len = 6 + ies->ie_next_hopping_sequence_len;
+  if(len >= 2 + ie_len) {
+    buf[2] = ies->ie_next_hopping_sequence_asn.ls4b;
+    buf[3] = ies->ie_next_hopping_sequence_asn.ls4b >> 8;
+    buf[4] = ies->ie_next_hopping_sequence_asn.ls4b >> 16;
+    buf[5] = ies->ie_next_hopping_sequence_asn.ls4b >> 24;
+    buf[6] = ies->ie_next_hopping_sequence_asn.ms1b;
+    buf[7] = ies->ie_next_hopping_sequence_len;
+    memcpy(buf + 8, ies->ie_next_hopping_sequence_list, ies->ie_next_hopping_sequence_len);
+    create_mlme_long_ie_descriptor(buf, MLME_LONG_IE_TSCH_NEXT_HOPPING_SEQUENCE, ie_len);
+    return 2 + ie_len;
+  } else {
+    return -1;
+  }
+}
+
+/* MLME sub-IE. Channel quality. Used in EBs: reports channel quality
+ * towards the coordinator */
+int
+frame80215e_create_ie_tsch_channel_quality(uint8_t *buf, int len,
+    struct ieee802154_ies *ies)
+{
+  int ie_len;
+  if(ies == NULL || ies->ie_channel_quality_len == 0
+     || ies->ie_channel_quality_len > sizeof(ies->ie_channel_quality)) {
+    return -1;
+  }
+  ie_len = 2 + ies->ie_channel_quality_len;
+  if(len >= 2 + ie_len) {
+    buf[2] = ies->ie_channel_quality_nodes;
+    buf[3] = ies->ie_channel_quality_first_channel;
+    memcpy(buf + 4, ies->ie_channel_quality, ies->ie_channel_quality_len);
+    create_mlme_short_ie_descriptor(buf, MLME_SHORT_IE_TSCH_CHANNEL_QUALITY, ie_len);
+    return 2 + ie_len;
+  } else {
+    return -1;
+  }
+}
+#endif /* TSCH_WITH_HOPPING_SEQUENCE_SWITCH */
+
 /* Parse a header IE */
 static int
 frame802154e_parse_header_ie(const uint8_t *buf, int len,
@@ -434,6 +490,19 @@ frame802154e_parse_mlme_short_ie(const uint8_t *buf, int len,
         return len;
       }
       break;
+#if TSCH_WITH_HOPPING_SEQUENCE_SWITCH
+    case MLME_SHORT_IE_TSCH_CHANNEL_QUALITY:
+      if(len > 2 && len - 2 <= FRAME802154E_IE_MAX_CHANNELS) {
+        if(ies != NULL) {
+          ies->ie_channel_quality_nodes = buf[0];
+          ies->ie_channel_quality_first_channel = buf[1];
+          ies->ie_channel_quality_len = len - 2;
+          memcpy(ies->ie_channel_quality, buf + 2, len - 2);
+        }
+        return len;
+      }
+      break;
+#endif /* TSCH_WITH_HOPPING_SEQUENCE_SWITCH */
   }
   return -1;
 }
@@ -459,6 +528,22 @@ frame802154e_parse_mlme_long_ie(const uint8_t *buf, int len,
         return len;
       }
       break;
+#if TSCH_WITH_HOPPING_SEQUENCE_SWITCH
+    case MLME_LONG_IE_TSCH_NEXT_HOPPING_SEQUENCE:
+      if(len > 6 && buf[5] > 0 && buf[5] <= TSCH_HOPPING_SEQUENCE_MAX_LEN && len == 6 + buf[5]) {
+        if(ies != NULL) {
+          ies->ie_next_hopping_sequence_asn.ls4b = (uint32_t)buf[0];
+          ies->ie_next_hopping_sequence_asn.ls4b |= (uint32_t)buf[1] << 8;
+          ies->ie_next_hopping_sequence_asn.ls4b |= (uint32_t)buf[2] << 16;
+          ies->ie_next_hopping_sequence_asn.ls4b |= (uint32_t)buf[3] << 24;
+          ies->ie_next_hopping_sequence_asn.ms1b = buf[4];
+          ies->ie_next_hopping_sequence_len = buf[5];
+          memcpy(ies->ie_next_hopping_sequence_list, buf + 6, buf[5]);
+        }
+        return len;
+      }
+      break;
+#endif /* TSCH_WITH_HOPPING_SEQUENCE_SWITCH */
   }
   return -1;
 }
@@ -50,6 +50,7 @@
 #include "net/mac/tsch/tsch-asn.h"
 
 #define FRAME802154E_IE_MAX_LINKS       4
+#define FRAME802154E_IE_MAX_CHANNELS    16
 
 /* Structures used for the Slotframe and Links information element */
 struct tsch_slotframe_and_links_link {
@@ -85,6 +86,19 @@ struct ieee802154_ies {
   /* We include and parse only the sequence len and list and omit unused fields */
   uint16_t ie_hopping_sequence_len;
   uint8_t ie_hopping_sequence_list[TSCH_HOPPING_SEQUENCE_MAX_LEN];
+#if TSCH_WITH_HOPPING_SEQUENCE_SWITCH
+  /* Non-standard long MLME IE: hopping sequence to use from a given ASN on */
+  struct tsch_asn_t ie_next_hopping_sequence_asn;
+  uint16_t ie_next_hopping_sequence_len;
+  uint8_t ie_next_hopping_sequence_list[TSCH_HOPPING_SEQUENCE_MAX_LEN];
+  /* Non-standard short MLME IE: how free the channels are around the
+   * sender and its children, 255 meaning always free, and the number of
+   * nodes the report covers */
+  uint8_t ie_channel_quality_nodes;
+  uint8_t ie_channel_quality_first_channel;
+  uint8_t ie_channel_quality_len;
+  uint8_t ie_channel_quality[FRAME802154E_IE_MAX_CHANNELS];
+#endif /* TSCH_WITH_HOPPING_SEQUENCE_SWITCH */
 #if TSCH_WITH_SIXTOP
   /* Payload Sixtop IE */
   const uint8_t *sixtop_ie_content_ptr;
@@ -127,6 +141,16 @@ int frame80215e_create_ie_tsch_timeslot(uint8_t *buf, int len,
 /* MLME sub-IE. TSCH channel hopping sequence. Used in EBs: hopping sequence */
 int frame80215e_create_ie_tsch_channel_hopping_sequence(uint8_t *buf, int len,
     struct ieee802154_ies *ies);
+#if TSCH_WITH_HOPPING_SEQUENCE_SWITCH
+/* MLME sub-IE. Next TSCH hopping sequence. Used in EBs: announces a
+ * hopping sequence switch */
+int frame80215e_create_ie_tsch_next_hopping_sequence(uint8_t *buf, int len,
+    struct ieee802154_ies *ies);
+/* MLME sub-IE. Channel quality. Used in EBs: reports channel quality
+ * towards the coordinator */
+int frame80215e_create_ie_tsch_channel_quality(uint8_t *buf, int len,
+    struct ieee802154_ies *ies);
+#endif /* TSCH_WITH_HOPPING_SEQUENCE_SWITCH */
 
 /* Parse all Information Elements of a frame */
 int frame802154e_parse_information_elements(const uint8_t *buf, uint8_t buf_size,
@@ -192,6 +192,9 @@ sixtop_output(const linkaddr_t *dest_addr, mac_callback_t callback, void *arg)
 
   /* 6P packet is data frame */
   packetbuf_set_attr(PACKETBUF_ATTR_FRAME_TYPE, FRAME802154_DATAFRAME);
+#if TSCH_QUEUE_NUM_PRIORITIES > 1
+  packetbuf_set_attr(PACKETBUF_ATTR_TSCH_PRIORITY, TSCH_QUEUE_CONTROL_PRIORITY);
+#endif /* TSCH_QUEUE_NUM_PRIORITIES > 1 */
 
   packetbuf_set_addr(PACKETBUF_ADDR_RECEIVER, dest_addr);
   packetbuf_set_addr(PACKETBUF_ADDR_SENDER, &linkaddr_node_addr);
@@ -154,6 +154,24 @@
 #define TSCH_HOPPING_SEQUENCE_MAX_LEN sizeof(TSCH_DEFAULT_HOPPING_SEQUENCE)
 #endif
 
+/* Switch hopping sequences network-wide: a new sequence is announced in
+ * EBs along with the ASN at which all nodes start using it. This adds
+ * non-standard IEs to EBs, which nodes without this option fail to
+ * parse, and must be enabled on every node of the network. */
+#ifdef TSCH_CONF_WITH_HOPPING_SEQUENCE_SWITCH
+#define TSCH_WITH_HOPPING_SEQUENCE_SWITCH TSCH_CONF_WITH_HOPPING_SEQUENCE_SWITCH
+#else
+#define TSCH_WITH_HOPPING_SEQUENCE_SWITCH 0
+#endif
+
+/* How long in advance a hopping sequence switch is announced. Must leave
+ * time for the announcement to travel down the network in EBs. */
+#ifdef TSCH_CONF_HOPPING_SEQUENCE_SWITCH_DELAY
+#define TSCH_HOPPING_SEQUENCE_SWITCH_DELAY TSCH_CONF_HOPPING_SEQUENCE_SWITCH_DELAY
+#else
+#define TSCH_HOPPING_SEQUENCE_SWITCH_DELAY (8 * TSCH_MAX_EB_PERIOD)
+#endif
+
 /******** Configuration: association *******/
 
 /* Start TSCH automatically after init? If not, the upper layers
@@ -226,11 +244,17 @@
 #define TSCH_PACKET_EB_WITH_TIMESLOT_TIMING 0
 #endif
 
-/* TSCH EB: include hopping sequence Information Element? */
+/* TSCH EB: include hopping sequence Information Element? Needed with
+ * hopping sequence switches, so that nodes joining after a switch learn
+ * the current sequence. */
 #ifdef TSCH_PACKET_CONF_EB_WITH_HOPPING_SEQUENCE
 #define TSCH_PACKET_EB_WITH_HOPPING_SEQUENCE TSCH_PACKET_CONF_EB_WITH_HOPPING_SEQUENCE
 #else
-#define TSCH_PACKET_EB_WITH_HOPPING_SEQUENCE 0
+#define TSCH_PACKET_EB_WITH_HOPPING_SEQUENCE TSCH_WITH_HOPPING_SEQUENCE_SWITCH
+#endif
+
+#if TSCH_WITH_HOPPING_SEQUENCE_SWITCH && !TSCH_PACKET_EB_WITH_HOPPING_SEQUENCE
+#error "TSCH_CONF_WITH_HOPPING_SEQUENCE_SWITCH requires TSCH_PACKET_CONF_EB_WITH_HOPPING_SEQUENCE"
 #endif
 
 /* TSCH EB: include slotframe and link Information Element? */
@@ -308,6 +332,33 @@
 #define TSCH_QUEUE_MAX_NEIGHBOR_QUEUES ((NBR_TABLE_CONF_MAX_NEIGHBORS) + 2)
 #endif
 
+/* The number of priority classes in each neighbor queue, each of them
+ * holding up to TSCH_QUEUE_NUM_PER_NEIGHBOR packets. A packet is queued
+ * in the class set in PACKETBUF_ATTR_TSCH_PRIORITY, 0 (the default)
+ * being the lowest, and higher classes are served first. */
+#ifdef TSCH_QUEUE_CONF_NUM_PRIORITIES
+#define TSCH_QUEUE_NUM_PRIORITIES TSCH_QUEUE_CONF_NUM_PRIORITIES
+#else
+#define TSCH_QUEUE_NUM_PRIORITIES 1
+#endif
+
+/* The priority class of control traffic: RPL and ND messages, 6P
+ * messages and keepalives */
+#ifdef TSCH_QUEUE_CONF_CONTROL_PRIORITY
+#define TSCH_QUEUE_CONTROL_PRIORITY TSCH_QUEUE_CONF_CONTROL_PRIORITY
+#else
+#define TSCH_QUEUE_CONTROL_PRIORITY (TSCH_QUEUE_NUM_PRIORITIES - 1)
+#endif
+
+/* Let packets carry a deadline in PACKETBUF_ATTR_TSCH_DEADLINE: the
+ * number of timeslots they may wait in queue, 0 for no deadline.
+ * Packets past their deadline are dropped instead of being sent. */
+#ifdef TSCH_QUEUE_CONF_WITH_DEADLINE
+#define TSCH_QUEUE_WITH_DEADLINE TSCH_QUEUE_CONF_WITH_DEADLINE
+#else
+#define TSCH_QUEUE_WITH_DEADLINE 0
+#endif
+
 /******** Configuration: scheduling  *******/
 
 /* Initializes TSCH with a 6TiSCH minimal schedule */
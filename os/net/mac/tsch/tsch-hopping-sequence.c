@@ -0,0 +1,133 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * \file
+ *         Network-wide switches of the TSCH hopping sequence. A new
+ *         sequence is announced in EBs along with the ASN at which all
+ *         nodes start using it.
+ */
+
+/**
+ * \addtogroup tsch
+ * @{
+*/
+
+#include "contiki.h"
+#include "net/mac/tsch/tsch.h"
+#include <string.h>
+
+/* Log configuration */
+#include "sys/log.h"
+#define LOG_MODULE "TSCH"
+#define LOG_LEVEL LOG_LEVEL_MAC
+
+#if TSCH_WITH_HOPPING_SEQUENCE_SWITCH
+
+/* The hopping sequence to switch to, if any. Read from the slot operation. */
+static struct tsch_hopping_sequence_switch next_hopping_sequence;
+/*---------------------------------------------------------------------------*/
+static int
+is_next_hopping_sequence(const struct ieee802154_ies *ies)
+{
+  return next_hopping_sequence.len == ies->ie_next_hopping_sequence_len
+      && next_hopping_sequence.asn.ls4b == ies->ie_next_hopping_sequence_asn.ls4b
+      && next_hopping_sequence.asn.ms1b == ies->ie_next_hopping_sequence_asn.ms1b
+      && !memcmp(next_hopping_sequence.sequence, ies->ie_next_hopping_sequence_list,
+                 next_hopping_sequence.len);
+}
+/*---------------------------------------------------------------------------*/
+int
+tsch_check_next_hopping_sequence(struct ieee802154_ies *ies, const struct tsch_asn_t *rx_asn)
+{
+  if(ies->ie_next_hopping_sequence_len == 0 || is_next_hopping_sequence(ies)) {
+    return 0;
+  }
+  if((int32_t)TSCH_ASN_DIFF(*rx_asn, ies->ie_next_hopping_sequence_asn) >= 0) {
+    ies->ie_channel_hopping_sequence_id = 1;
+    ies->ie_hopping_sequence_len = ies->ie_next_hopping_sequence_len;
+    memcpy(ies->ie_hopping_sequence_list, ies->ie_next_hopping_sequence_list,
+           ies->ie_next_hopping_sequence_len);
+    return 0;
+  }
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+void
+tsch_set_next_hopping_sequence(const uint8_t *sequence, uint8_t len, const struct tsch_asn_t *asn)
+{
+  if(len > 0) {
+    memcpy(next_hopping_sequence.sequence, sequence, len);
+    next_hopping_sequence.asn = *asn;
+  }
+  next_hopping_sequence.len = len;
+}
+/*---------------------------------------------------------------------------*/
+int
+tsch_announce_hopping_sequence(const uint8_t *sequence, uint8_t len)
+{
+  struct tsch_asn_t asn;
+
+  if(!tsch_is_associated || len == 0 || len > TSCH_HOPPING_SEQUENCE_MAX_LEN) {
+    return 0;
+  }
+  if(!tsch_get_lock()) {
+    return 0;
+  }
+  asn = tsch_current_asn;
+  TSCH_ASN_INC(asn, TSCH_CLOCK_TO_SLOTS((uint32_t)TSCH_HOPPING_SEQUENCE_SWITCH_DELAY,
+                                        tsch_timing[tsch_ts_timeslot_length]));
+  tsch_set_next_hopping_sequence(sequence, len, &asn);
+  tsch_release_lock();
+  LOG_INFO("announcing hopping sequence switch at asn-%x.%lx, len %u\n",
+           asn.ms1b, (unsigned long)asn.ls4b, len);
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+const struct tsch_hopping_sequence_switch *
+tsch_get_next_hopping_sequence(void)
+{
+  return next_hopping_sequence.len != 0 ? &next_hopping_sequence : NULL;
+}
+/*---------------------------------------------------------------------------*/
+void
+tsch_update_hopping_sequence(void)
+{
+  if(next_hopping_sequence.len != 0
+     && (int32_t)TSCH_ASN_DIFF(tsch_current_asn, next_hopping_sequence.asn) >= 0) {
+    memcpy(tsch_hopping_sequence, next_hopping_sequence.sequence, next_hopping_sequence.len);
+    TSCH_ASN_DIVISOR_INIT(tsch_hopping_sequence_length, next_hopping_sequence.len);
+    next_hopping_sequence.len = 0;
+    TSCH_LOG_ADD(tsch_log_message,
+        snprintf(log->message, sizeof(log->message),
+            "switched hopping sequence, len %u", tsch_hopping_sequence_length.val);
+    );
+  }
+}
+/*---------------------------------------------------------------------------*/
+#endif /* TSCH_WITH_HOPPING_SEQUENCE_SWITCH */
+/** @} */
@@ -257,6 +257,31 @@ tsch_packet_create_eb(uint8_t *hdr_len, uint8_t *tsch_sync_ie_offset)
   }
 #endif /* TSCH_PACKET_EB_WITH_HOPPING_SEQUENCE */
 
+#if TSCH_WITH_HOPPING_SEQUENCE_SWITCH
+  /* Relay any pending hopping sequence switch */
+  {
+    const struct tsch_hopping_sequence_switch *next = tsch_get_next_hopping_sequence();
+    if(next != NULL) {
+      ies.ie_next_hopping_sequence_asn = next->asn;
+      ies.ie_next_hopping_sequence_len = next->len;
+      memcpy(ies.ie_next_hopping_sequence_list, next->sequence, next->len);
+    }
+  }
+#if TSCH_STATS_CHANNEL_REPORTS
+  /* Report the channel quality of our sub-tree towards the coordinator */
+  if(!tsch_is_coordinator) {
+    int i;
+    ies.ie_channel_quality_nodes = tsch_stats_get_network_nodes();
+    ies.ie_channel_quality_first_channel = TSCH_STATS_FIRST_CHANNEL;
+    ies.ie_channel_quality_len = MIN(TSCH_STATS_NUM_CHANNELS, sizeof(ies.ie_channel_quality));
+    for(i = 0; i < ies.ie_channel_quality_len; i++) {
+      ies.ie_channel_quality[i] = (uint32_t)tsch_stats_get_network_channel_free(i) * 255
+          / TSCH_STATS_BINARY_SCALING_FACTOR;
+    }
+  }
+#endif /* TSCH_STATS_CHANNEL_REPORTS */
+#endif /* TSCH_WITH_HOPPING_SEQUENCE_SWITCH */
+
   /* Add Slotframe and Link IE */
 #if TSCH_PACKET_EB_WITH_SLOTFRAME_AND_LINK
   {
@@ -315,6 +340,30 @@ tsch_packet_create_eb(uint8_t *hdr_len, uint8_t *tsch_sync_ie_offset)
   p += ie_len;
   packetbuf_set_datalen(packetbuf_datalen() + ie_len);
 
+#if TSCH_WITH_HOPPING_SEQUENCE_SWITCH
+  if(ies.ie_next_hopping_sequence_len != 0) {
+    ie_len = frame80215e_create_ie_tsch_next_hopping_sequence(p,
+                                                              packetbuf_remaininglen(),
+                                                              &ies);
+    if(ie_len < 0) {
+      return -1;
+    }
+    p += ie_len;
+    packetbuf_set_datalen(packetbuf_datalen() + ie_len);
+  }
+
+  if(ies.ie_channel_quality_len != 0) {
+    ie_len = frame80215e_create_ie_tsch_channel_quality(p,
+                                                        packetbuf_remaininglen(),
+                                                        &ies);
+    if(ie_len < 0) {
+      return -1;
+    }
+    p += ie_len;
+    packetbuf_set_datalen(packetbuf_datalen() + ie_len);
+  }
+#endif /* TSCH_WITH_HOPPING_SEQUENCE_SWITCH */
+
 #if 0
   /* Payload IE list termination: optional */
   ie_len = frame80215e_create_ie_payload_list_termination(p,
@@ -0,0 +1,231 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * \file
+ *         Slot timing profiler for TSCH. The slot operation timestamps
+ *         the phases of every timeslot into a ringbuf, from interrupt.
+ *         The records are aggregated later by the TSCH pending events
+ *         process.
+ */
+
+/**
+ * \addtogroup tsch
+ * @{
+*/
+
+#include "contiki.h"
+#include "net/mac/tsch/tsch-profile.h"
+#include "lib/ringbufindex.h"
+#include <string.h>
+
+/* Log configuration */
+#include "sys/log.h"
+#define LOG_MODULE "TSCH Prof"
+#define LOG_LEVEL LOG_LEVEL_MAC
+
+#if TSCH_PROFILE_ON
+
+PROCESS_NAME(tsch_pending_events_process);
+
+/* Check if TSCH_PROFILE_QUEUE_LEN is a power of two */
+#if (TSCH_PROFILE_QUEUE_LEN & (TSCH_PROFILE_QUEUE_LEN - 1)) != 0
+#error TSCH_PROFILE_QUEUE_LEN must be power of two
+#endif
+
+/* The timing of one timeslot */
+struct tsch_profile_record {
+  uint32_t durations[tsch_profile_num_phases];
+  uint32_t slot_duration;
+  uint16_t phases; /* Bitmap of the phases that ran */
+  uint8_t overrun;
+};
+
+static struct ringbufindex profile_ringbuf;
+static struct tsch_profile_record profile_array[TSCH_PROFILE_QUEUE_LEN];
+static struct tsch_profile_stats stats;
+static uint32_t profile_dropped;
+
+/* The slot being recorded, NULL if none */
+static struct tsch_profile_record *current_record;
+static rtimer_clock_t current_slot_start;
+static rtimer_clock_t current_slot_length;
+static TSCH_PROFILE_TICKS_T phase_start;
+
+static const char *phase_names[tsch_profile_num_phases] = {
+  "packet", "tx-prepare", "tx-security", "radio-prepare", "ack-parse",
+  "rx-parse", "rx-security", "ack-prepare", "schedule",
+};
+
+/*---------------------------------------------------------------------------*/
+void
+tsch_profile_slot_start(rtimer_clock_t slot_start, rtimer_clock_t slot_length)
+{
+  int index = ringbufindex_peek_put(&profile_ringbuf);
+  if(index == -1) {
+    profile_dropped++;
+    current_record = NULL;
+    return;
+  }
+  current_record = &profile_array[index];
+  memset(current_record, 0, sizeof(struct tsch_profile_record));
+  current_slot_start = slot_start;
+  current_slot_length = slot_length;
+}
+/*---------------------------------------------------------------------------*/
+void
+tsch_profile_slot_end(void)
+{
+  rtimer_clock_t duration;
+
+  if(current_record == NULL) {
+    return;
+  }
+  duration = (rtimer_clock_t)(RTIMER_NOW() - current_slot_start);
+  current_record->slot_duration = duration;
+  current_record->overrun = duration > current_slot_length;
+  current_record = NULL;
+  ringbufindex_put(&profile_ringbuf);
+  /* Idle slots do not poll the pending events process, make sure the
+   * queue gets drained before it fills up */
+  if(ringbufindex_elements(&profile_ringbuf) >= TSCH_PROFILE_QUEUE_LEN / 2) {
+    process_poll(&tsch_pending_events_process);
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+tsch_profile_phase_start(enum tsch_profile_phase phase)
+{
+  phase_start = TSCH_PROFILE_NOW();
+}
+/*---------------------------------------------------------------------------*/
+void
+tsch_profile_phase_end(enum tsch_profile_phase phase)
+{
+  if(current_record != NULL) {
+    /* A phase may run more than once per slot, e.g. the packet selection
+     * when falling back to the backup link */
+    current_record->durations[phase] += (TSCH_PROFILE_TICKS_T)(TSCH_PROFILE_NOW() - phase_start);
+    current_record->phases |= 1 << phase;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+update_phase_stats(struct tsch_profile_phase_stats *s, uint32_t duration)
+{
+  if(s->count == 0 || duration < s->min) {
+    s->min = duration;
+  }
+  if(duration > s->max) {
+    s->max = duration;
+  }
+  s->total += duration;
+  s->count++;
+}
+/*---------------------------------------------------------------------------*/
+void
+tsch_profile_process_pending(void)
+{
+  int16_t index;
+  int i;
+
+  while((index = ringbufindex_peek_get(&profile_ringbuf)) != -1) {
+    struct tsch_profile_record *r = &profile_array[index];
+    for(i = 0; i < tsch_profile_num_phases; i++) {
+      if(r->phases & (1 << i)) {
+        update_phase_stats(&stats.phases[i], r->durations[i]);
+      }
+    }
+    update_phase_stats(&stats.slot, r->slot_duration);
+    if(r->overrun) {
+      stats.overruns++;
+    }
+    ringbufindex_get(&profile_ringbuf);
+  }
+  stats.dropped = profile_dropped;
+}
+/*---------------------------------------------------------------------------*/
+const struct tsch_profile_stats *
+tsch_profile_get_stats(void)
+{
+  tsch_profile_process_pending();
+  return &stats;
+}
+/*---------------------------------------------------------------------------*/
+void
+tsch_profile_reset(void)
+{
+  tsch_profile_process_pending();
+  memset(&stats, 0, sizeof(stats));
+  profile_dropped = 0;
+}
+/*---------------------------------------------------------------------------*/
+const char *
+tsch_profile_phase_name(enum tsch_profile_phase phase)
+{
+  if(phase >= tsch_profile_num_phases) {
+    return "unknown";
+  }
+  return phase_names[phase];
+}
+/*---------------------------------------------------------------------------*/
+void
+tsch_profile_print(void)
+{
+  int i;
+
+  tsch_profile_process_pending();
+  LOG_INFO("slots %lu, overruns %lu, dropped %lu\n",
+           (unsigned long)stats.slot.count, (unsigned long)stats.overruns,
+           (unsigned long)stats.dropped);
+  if(stats.slot.count > 0) {
+    LOG_INFO("slot: min %lu avg %lu max %lu us\n",
+             (unsigned long)TSCH_PROFILE_RTIMER_TO_US(stats.slot.min),
+             (unsigned long)TSCH_PROFILE_RTIMER_TO_US(stats.slot.total / stats.slot.count),
+             (unsigned long)TSCH_PROFILE_RTIMER_TO_US(stats.slot.max));
+  }
+  for(i = 0; i < tsch_profile_num_phases; i++) {
+    const struct tsch_profile_phase_stats *s = &stats.phases[i];
+    if(s->count > 0) {
+      LOG_INFO("%s: count %lu min %lu avg %lu max %lu us\n",
+               phase_names[i], (unsigned long)s->count,
+               (unsigned long)TSCH_PROFILE_TICKS_TO_US(s->min),
+               (unsigned long)TSCH_PROFILE_TICKS_TO_US(s->total / s->count),
+               (unsigned long)TSCH_PROFILE_TICKS_TO_US(s->max));
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+tsch_profile_init(void)
+{
+  ringbufindex_init(&profile_ringbuf, TSCH_PROFILE_QUEUE_LEN);
+  current_record = NULL;
+}
+
+#endif /* TSCH_PROFILE_ON */
+/** @} */
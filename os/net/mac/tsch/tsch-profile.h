@@ -0,0 +1,190 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * \addtogroup tsch
+ * @{
+ * \file
+ *	TSCH slot timing profiler
+*/
+
+#ifndef __TSCH_PROFILE_H__
+#define __TSCH_PROFILE_H__
+
+/********** Includes **********/
+
+#include "contiki.h"
+#include "sys/rtimer.h"
+
+/******** Configuration *******/
+
+/* Timestamp the phases of every timeslot and aggregate them outside of
+ * interrupt context. Off by default. */
+#ifdef TSCH_PROFILE_CONF_ON
+#define TSCH_PROFILE_ON TSCH_PROFILE_CONF_ON
+#else /* TSCH_PROFILE_CONF_ON */
+#define TSCH_PROFILE_ON 0
+#endif /* TSCH_PROFILE_CONF_ON */
+
+/* The length of the profile queue, i.e. the maximum number of slots
+ * recorded but not yet aggregated. Must be a power of two. */
+#ifdef TSCH_PROFILE_CONF_QUEUE_LEN
+#define TSCH_PROFILE_QUEUE_LEN TSCH_PROFILE_CONF_QUEUE_LEN
+#else /* TSCH_PROFILE_CONF_QUEUE_LEN */
+#define TSCH_PROFILE_QUEUE_LEN 16
+#endif /* TSCH_PROFILE_CONF_QUEUE_LEN */
+
+/* The time source of the profiler. Defaults to the rtimer, which works
+ * on any platform including native and Cooja. Platforms with a cycle
+ * counter may override this for a finer resolution, in which case they
+ * must also set TSCH_PROFILE_CONF_TICKS_T and TSCH_PROFILE_CONF_TICKS_TO_US. */
+#ifdef TSCH_PROFILE_CONF_NOW
+#define TSCH_PROFILE_NOW() TSCH_PROFILE_CONF_NOW()
+#else /* TSCH_PROFILE_CONF_NOW */
+#define TSCH_PROFILE_NOW() RTIMER_NOW()
+#endif /* TSCH_PROFILE_CONF_NOW */
+
+#ifdef TSCH_PROFILE_CONF_TICKS_T
+#define TSCH_PROFILE_TICKS_T TSCH_PROFILE_CONF_TICKS_T
+#else /* TSCH_PROFILE_CONF_TICKS_T */
+#define TSCH_PROFILE_TICKS_T rtimer_clock_t
+#endif /* TSCH_PROFILE_CONF_TICKS_T */
+
+#ifdef TSCH_PROFILE_CONF_TICKS_TO_US
+#define TSCH_PROFILE_TICKS_TO_US(t) TSCH_PROFILE_CONF_TICKS_TO_US(t)
+#else /* TSCH_PROFILE_CONF_TICKS_TO_US */
+#define TSCH_PROFILE_TICKS_TO_US(t) TSCH_PROFILE_RTIMER_TO_US(t)
+#endif /* TSCH_PROFILE_CONF_TICKS_TO_US */
+
+/* Unlike RTIMERTICKS_TO_US, available with any rtimer */
+#define TSCH_PROFILE_RTIMER_TO_US(t) ((uint32_t)(((uint64_t)(t) * 1000000) / RTIMER_SECOND))
+
+/************ Types ***********/
+
+/** \brief The phases of a timeslot that are profiled */
+enum tsch_profile_phase {
+  tsch_profile_packet,        /* Selecting the packet and neighbor for the link */
+  tsch_profile_tx_prepare,    /* Frame pending bit and EB update */
+  tsch_profile_tx_security,   /* Securing the outgoing frame */
+  tsch_profile_radio_prepare, /* Copying the frame to the radio */
+  tsch_profile_ack_parse,     /* Reading, parsing and authenticating an ACK */
+  tsch_profile_rx_parse,      /* Reading and parsing a received frame */
+  tsch_profile_rx_security,   /* Authenticating and decrypting it */
+  tsch_profile_ack_prepare,   /* Building, securing and copying the ACK */
+  tsch_profile_schedule,      /* Looking up the next active link */
+  tsch_profile_num_phases
+};
+
+/** \brief Aggregated timing of one phase, in profiler ticks */
+struct tsch_profile_phase_stats {
+  uint32_t count;
+  uint32_t min;
+  uint32_t max;
+  uint64_t total;
+};
+
+/** \brief Aggregated timing of all timeslots */
+struct tsch_profile_stats {
+  struct tsch_profile_phase_stats phases[tsch_profile_num_phases];
+  /* Time from the start of the slot to the end of its operation,
+   * including the lookup of the next link, in rtimer ticks */
+  struct tsch_profile_phase_stats slot;
+  /* Slots whose operation ended after the start of the next timeslot */
+  uint32_t overruns;
+  /* Slots that could not be recorded because the queue was full */
+  uint32_t dropped;
+};
+
+#if TSCH_PROFILE_ON
+
+/********** Functions *********/
+
+/**
+ * \brief Start recording a timeslot. Called from the slot operation.
+ * \param slot_start The start time of the timeslot
+ * \param slot_length The length of the timeslot, in rtimer ticks
+ */
+void tsch_profile_slot_start(rtimer_clock_t slot_start, rtimer_clock_t slot_length);
+/**
+ * \brief Finish recording the current timeslot. Called from the slot
+ * operation.
+ */
+void tsch_profile_slot_end(void);
+/**
+ * \brief Timestamp the start of a phase of the current timeslot
+ */
+void tsch_profile_phase_start(enum tsch_profile_phase phase);
+/**
+ * \brief Timestamp the end of a phase of the current timeslot
+ */
+void tsch_profile_phase_end(enum tsch_profile_phase phase);
+/**
+ * \brief Initialize the profiler
+ */
+void tsch_profile_init(void);
+/**
+ * \brief Aggregate the recorded timeslots. Called from the TSCH pending
+ * events process.
+ */
+void tsch_profile_process_pending(void);
+/**
+ * \brief Get the aggregated timing of the timeslots recorded so far
+ */
+const struct tsch_profile_stats *tsch_profile_get_stats(void);
+/**
+ * \brief Reset the aggregated timing
+ */
+void tsch_profile_reset(void);
+/**
+ * \brief Get the name of a phase, for printing
+ */
+const char *tsch_profile_phase_name(enum tsch_profile_phase phase);
+/**
+ * \brief Log the aggregated timing
+ */
+void tsch_profile_print(void);
+
+/************ Macros **********/
+
+#define TSCH_PROFILE_SLOT_START(slot_start, slot_length) tsch_profile_slot_start(slot_start, slot_length)
+#define TSCH_PROFILE_SLOT_END() tsch_profile_slot_end()
+#define TSCH_PROFILE_START(phase) tsch_profile_phase_start(phase)
+#define TSCH_PROFILE_END(phase) tsch_profile_phase_end(phase)
+
+#else /* TSCH_PROFILE_ON */
+
+#define tsch_profile_init()
+#define tsch_profile_process_pending()
+#define TSCH_PROFILE_SLOT_START(slot_start, slot_length)
+#define TSCH_PROFILE_SLOT_END()
+#define TSCH_PROFILE_START(phase)
+#define TSCH_PROFILE_END(phase)
+
+#endif /* TSCH_PROFILE_ON */
+
+#endif /* __TSCH_PROFILE_H__ */
+/** @} */
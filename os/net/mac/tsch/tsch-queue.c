@@ -74,6 +74,31 @@ LIST(neighbor_list);
 struct tsch_neighbor *n_broadcast;
 struct tsch_neighbor *n_eb;
 
+#if TSCH_QUEUE_WITH_DEADLINE
+/* Set from the slot operation when it skips packets past their deadline */
+static volatile uint8_t stale_packets_pending;
+#endif /* TSCH_QUEUE_WITH_DEADLINE */
+
+/*---------------------------------------------------------------------------*/
+/* Read the current ASN from outside the slot operation, which may
+ * update it at any time */
+static void
+get_current_asn(struct tsch_asn_t *asn)
+{
+  do {
+    *asn = tsch_current_asn;
+  } while(asn->ls4b != tsch_current_asn.ls4b || asn->ms1b != tsch_current_asn.ms1b);
+}
+#if TSCH_QUEUE_WITH_DEADLINE
+/*---------------------------------------------------------------------------*/
+/* Has a packet waited in queue past its deadline? */
+static int
+is_stale(const struct tsch_packet *p, const struct tsch_asn_t *asn)
+{
+  return p->deadline != 0 && (uint32_t)TSCH_ASN_DIFF(*asn, p->queued_asn) > p->deadline;
+}
+#endif /* TSCH_QUEUE_WITH_DEADLINE */
+
 /*---------------------------------------------------------------------------*/
 /* Add a TSCH neighbor */
 struct tsch_neighbor *
@@ -88,8 +113,11 @@ tsch_queue_add_nbr(const linkaddr_t *addr)
       n = memb_alloc(&neighbor_memb);
       if(n != NULL) {
         /* Initialize neighbor entry */
+        int i;
         memset(n, 0, sizeof(struct tsch_neighbor));
-        ringbufindex_init(&n->tx_ringbuf, TSCH_QUEUE_NUM_PER_NEIGHBOR);
+        for(i = 0; i < TSCH_QUEUE_NUM_PRIORITIES; i++) {
+          ringbufindex_init(&n->tx_ringbuf[i], TSCH_QUEUE_NUM_PER_NEIGHBOR);
+        }
         linkaddr_copy(&n->addr, addr);
         n->is_broadcast = linkaddr_cmp(addr, &tsch_eb_address)
           || linkaddr_cmp(addr, &tsch_broadcast_address);
@@ -233,10 +261,15 @@ tsch_queue_add_packet(const linkaddr_t *addr, uint8_t max_transmissions,
   struct tsch_neighbor *n = NULL;
   int16_t put_index = -1;
   struct tsch_packet *p = NULL;
+  uint8_t priority = 0;
+#if TSCH_QUEUE_NUM_PRIORITIES > 1
+  priority = MIN(packetbuf_attr(PACKETBUF_ATTR_TSCH_PRIORITY),
+                 TSCH_QUEUE_NUM_PRIORITIES - 1);
+#endif /* TSCH_QUEUE_NUM_PRIORITIES > 1 */
   if(!tsch_is_locked()) {
     n = tsch_queue_add_nbr(addr);
     if(n != NULL) {
-      put_index = ringbufindex_peek_put(&n->tx_ringbuf);
+      put_index = ringbufindex_peek_put(&n->tx_ringbuf[priority]);
       if(put_index != -1) {
         p = memb_alloc(&packet_memb);
         if(p != NULL) {
@@ -251,11 +284,16 @@ tsch_queue_add_packet(const linkaddr_t *addr, uint8_t max_transmissions,
             p->ret = MAC_TX_DEFERRED;
             p->transmissions = 0;
             p->max_transmissions = max_transmissions;
+            p->priority = priority;
+            get_current_asn(&p->queued_asn);
+#if TSCH_QUEUE_WITH_DEADLINE
+            p->deadline = packetbuf_attr(PACKETBUF_ATTR_TSCH_DEADLINE);
+#endif /* TSCH_QUEUE_WITH_DEADLINE */
             /* Add to ringbuf (actual add committed through atomic operation) */
-            n->tx_array[put_index] = p;
-            ringbufindex_put(&n->tx_ringbuf);
-            LOG_DBG("packet is added put_index %u, packet %p\n",
-                   put_index, p);
+            n->tx_array[priority][put_index] = p;
+            ringbufindex_put(&n->tx_ringbuf[priority]);
+            LOG_DBG("packet is added put_index %u, priority %u, packet %p\n",
+                   put_index, priority, p);
             return p;
           } else {
             memb_free(&packet_memb, p);
@@ -283,24 +321,42 @@ tsch_queue_packet_count(const linkaddr_t *addr)
   if(!tsch_is_locked()) {
     n = tsch_queue_add_nbr(addr);
     if(n != NULL) {
-      return ringbufindex_elements(&n->tx_ringbuf);
+      int count = 0;
+      int i;
+      for(i = 0; i < TSCH_QUEUE_NUM_PRIORITIES; i++) {
+        count += ringbufindex_elements(&n->tx_ringbuf[i]);
+      }
+      return count;
     }
   }
   return -1;
 }
 /*---------------------------------------------------------------------------*/
-/* Remove first packet from a neighbor queue */
+/* Remove first packet from a priority class of a neighbor queue */
+static struct tsch_packet *
+remove_packet(struct tsch_neighbor *n, uint8_t priority)
+{
+  /* Get and remove packet from ringbuf (remove committed through an atomic operation */
+  int16_t get_index = ringbufindex_get(&n->tx_ringbuf[priority]);
+  if(get_index != -1) {
+    return n->tx_array[priority][get_index];
+  } else {
+    return NULL;
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Remove first packet from a neighbor queue, highest priority first */
 struct tsch_packet *
 tsch_queue_remove_packet_from_queue(struct tsch_neighbor *n)
 {
   if(!tsch_is_locked()) {
     if(n != NULL) {
-      /* Get and remove packet from ringbuf (remove committed through an atomic operation */
-      int16_t get_index = ringbufindex_get(&n->tx_ringbuf);
-      if(get_index != -1) {
-        return n->tx_array[get_index];
-      } else {
-        return NULL;
+      int i;
+      for(i = TSCH_QUEUE_NUM_PRIORITIES - 1; i >= 0; i--) {
+        struct tsch_packet *p = remove_packet(n, i);
+        if(p != NULL) {
+          return p;
+        }
       }
     }
   }
@@ -328,7 +384,7 @@ tsch_queue_packet_sent(struct tsch_neighbor *n, struct tsch_packet *p,
 
   if(mac_tx_status == MAC_TX_OK) {
     /* Successful transmission */
-    tsch_queue_remove_packet_from_queue(n);
+    remove_packet(n, p->priority);
     in_queue = 0;
 
     /* Update CSMA state in the unicast case */
@@ -343,7 +399,7 @@ tsch_queue_packet_sent(struct tsch_neighbor *n, struct tsch_packet *p,
     /* Failed transmission */
     if(p->transmissions >= p->max_transmissions) {
       /* Drop packet */
-      tsch_queue_remove_packet_from_queue(n);
+      remove_packet(n, p->priority);
       in_queue = 0;
     }
     /* Update CSMA state in the unicast case */
@@ -357,6 +413,11 @@ tsch_queue_packet_sent(struct tsch_neighbor *n, struct tsch_packet *p,
     }
   }
 
+  if(!in_queue) {
+    tsch_stats_dequeued_packet(p->priority,
+        TSCH_ASN_DIFF(tsch_current_asn, p->queued_asn), 0);
+  }
+
   return in_queue;
 }
 /*---------------------------------------------------------------------------*/
@@ -402,31 +463,57 @@ tsch_queue_free_unused_neighbors(void)
 int
 tsch_queue_is_empty(const struct tsch_neighbor *n)
 {
-  return !tsch_is_locked() && n != NULL && ringbufindex_empty(&n->tx_ringbuf);
+  int i;
+
+  if(tsch_is_locked() || n == NULL) {
+    return 0;
+  }
+  for(i = 0; i < TSCH_QUEUE_NUM_PRIORITIES; i++) {
+    if(!ringbufindex_empty(&n->tx_ringbuf[i])) {
+      return 0;
+    }
+  }
+  return 1;
 }
 /*---------------------------------------------------------------------------*/
-/* Returns the first packet from a neighbor queue */
+/* Returns the first packet from a neighbor queue, from the highest
+ * priority class that has one for the link */
 struct tsch_packet *
 tsch_queue_get_packet_for_nbr(const struct tsch_neighbor *n, struct tsch_link *link)
 {
   if(!tsch_is_locked()) {
     int is_shared_link = link != NULL && link->link_options & LINK_OPTION_SHARED;
-    if(n != NULL) {
-      int16_t get_index = ringbufindex_peek_get(&n->tx_ringbuf);
-      if(get_index != -1 &&
-          !(is_shared_link && !tsch_queue_backoff_expired(n))) {    /* If this is a shared link,
-                                                                    make sure the backoff has expired */
-#if TSCH_WITH_LINK_SELECTOR
-        int packet_attr_slotframe = queuebuf_attr(n->tx_array[get_index]->qb, PACKETBUF_ATTR_TSCH_SLOTFRAME);
-        int packet_attr_timeslot = queuebuf_attr(n->tx_array[get_index]->qb, PACKETBUF_ATTR_TSCH_TIMESLOT);
-        if(packet_attr_slotframe != 0xffff && packet_attr_slotframe != link->slotframe_handle) {
-          return NULL;
+    if(n != NULL && !(is_shared_link && !tsch_queue_backoff_expired(n))) { /* If this is a shared link,
+                                                                         make sure the backoff has expired */
+      int i;
+      for(i = TSCH_QUEUE_NUM_PRIORITIES - 1; i >= 0; i--) {
+        int16_t get_index = ringbufindex_peek_get(&n->tx_ringbuf[i]);
+        struct tsch_packet *p;
+        if(get_index == -1) {
+          continue;
         }
-        if(packet_attr_timeslot != 0xffff && packet_attr_timeslot != link->timeslot) {
-          return NULL;
+        p = n->tx_array[i][get_index];
+#if TSCH_QUEUE_WITH_DEADLINE
+        if(is_stale(p, &tsch_current_asn)) {
+          /* Leave it to tsch_queue_drop_stale_packets */
+          stale_packets_pending = 1;
+          process_poll(&tsch_pending_events_process);
+          continue;
+        }
+#endif /* TSCH_QUEUE_WITH_DEADLINE */
+#if TSCH_WITH_LINK_SELECTOR
+        {
+          int packet_attr_slotframe = queuebuf_attr(p->qb, PACKETBUF_ATTR_TSCH_SLOTFRAME);
+          int packet_attr_timeslot = queuebuf_attr(p->qb, PACKETBUF_ATTR_TSCH_TIMESLOT);
+          if(packet_attr_slotframe != 0xffff && packet_attr_slotframe != link->slotframe_handle) {
+            continue;
+          }
+          if(packet_attr_timeslot != 0xffff && packet_attr_timeslot != link->timeslot) {
+            continue;
+          }
         }
 #endif
-        return n->tx_array[get_index];
+        return p;
       }
     }
   }
@@ -450,24 +537,85 @@ tsch_queue_get_unicast_packet_for_any(struct tsch_neighbor **n, struct tsch_link
 {
   if(!tsch_is_locked()) {
     struct tsch_neighbor *curr_nbr = list_head(neighbor_list);
+    struct tsch_neighbor *best_nbr = NULL;
+    struct tsch_packet *best = NULL;
     struct tsch_packet *p = NULL;
     while(curr_nbr != NULL) {
       if(!curr_nbr->is_broadcast && curr_nbr->tx_links_count == 0) {
         /* Only look up for non-broadcast neighbors we do not have a tx link to */
         p = tsch_queue_get_packet_for_nbr(curr_nbr, link);
-        if(p != NULL) {
-          if(n != NULL) {
-            *n = curr_nbr;
+        /* Keep the first packet of the highest priority */
+        if(p != NULL && (best == NULL || p->priority > best->priority)) {
+          best = p;
+          best_nbr = curr_nbr;
+          if(p->priority == TSCH_QUEUE_NUM_PRIORITIES - 1) {
+            break;
           }
-          return p;
         }
       }
       curr_nbr = list_item_next(curr_nbr);
     }
+    if(best != NULL && n != NULL) {
+      *n = best_nbr;
+    }
+    return best;
+  }
+  return NULL;
+}
+#if TSCH_QUEUE_WITH_DEADLINE
+/*---------------------------------------------------------------------------*/
+/* Take out one packet past its deadline from the queues, if any */
+static struct tsch_packet *
+remove_stale_packet(void)
+{
+  struct tsch_asn_t asn;
+  struct tsch_neighbor *n;
+  int i;
+
+  get_current_asn(&asn);
+  for(n = list_head(neighbor_list); n != NULL; n = list_item_next(n)) {
+    for(i = 0; i < TSCH_QUEUE_NUM_PRIORITIES; i++) {
+      int16_t get_index = ringbufindex_peek_get(&n->tx_ringbuf[i]);
+      if(get_index != -1 && is_stale(n->tx_array[i][get_index], &asn)) {
+        return remove_packet(n, i);
+      }
+    }
   }
   return NULL;
 }
 /*---------------------------------------------------------------------------*/
+/* Drop the packets that the slot operation skipped as past their deadline */
+void
+tsch_queue_drop_stale_packets(void)
+{
+  struct tsch_packet *p;
+  struct tsch_asn_t asn;
+
+  if(!stale_packets_pending) {
+    return;
+  }
+  stale_packets_pending = 0;
+
+  while(1) {
+    /* Take the lock so that the slot operation is not sending the packet */
+    if(!tsch_get_lock()) {
+      stale_packets_pending = 1;
+      return;
+    }
+    p = remove_stale_packet();
+    tsch_release_lock();
+    if(p == NULL) {
+      return;
+    }
+    LOG_WARN("! dropping packet past its deadline, priority %u\n", p->priority);
+    get_current_asn(&asn);
+    tsch_stats_dequeued_packet(p->priority, TSCH_ASN_DIFF(asn, p->queued_asn), 1);
+    mac_call_sent_callback(p->sent, p->ptr, MAC_TX_ERR, p->transmissions);
+    tsch_queue_free_packet(p);
+  }
+}
+#endif /* TSCH_QUEUE_WITH_DEADLINE */
+/*---------------------------------------------------------------------------*/
 /* May the neighbor transmit over a shared link? */
 int
 tsch_queue_backoff_expired(const struct tsch_neighbor *n)
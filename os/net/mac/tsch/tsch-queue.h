@@ -46,6 +46,7 @@
 #include "lib/ringbufindex.h"
 #include "net/linkaddr.h"
 #include "net/mac/mac.h"
+#include "net/mac/tsch/tsch-conf.h"
 
 /***** External Variables *****/
 
@@ -153,6 +154,13 @@ struct tsch_packet *tsch_queue_get_packet_for_dest_addr(const linkaddr_t *addr,
  * \return The packet if any, else NULL
  */
 struct tsch_packet *tsch_queue_get_unicast_packet_for_any(struct tsch_neighbor **n, struct tsch_link *link);
+#if TSCH_QUEUE_WITH_DEADLINE
+/**
+ * \brief Drop the packets found past their deadline by the slot operation,
+ * calling their packet_sent callback with MAC_TX_ERR
+ */
+void tsch_queue_drop_stale_packets(void);
+#endif /* TSCH_QUEUE_WITH_DEADLINE */
 /**
  * \brief Is the neighbor backoff timer expired?
  * \param n The neighbor queue
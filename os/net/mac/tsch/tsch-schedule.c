@@ -66,6 +66,77 @@ MEMB(link_memb, struct tsch_link, TSCH_SCHEDULE_MAX_LINKS);
 MEMB(slotframe_memb, struct tsch_slotframe, TSCH_SCHEDULE_MAX_SLOTFRAMES);
 /* List of slotframes (each slotframe holds its own list of links) */
 LIST(slotframe_list);
+/* The links of all slotframes, grouped by slotframe in the order of
+ * slotframe_list, and sorted by timeslot within a slotframe. This lets
+ * the slot operation find the next active link with a binary search. */
+static struct tsch_link *sorted_links[TSCH_SCHEDULE_MAX_LINKS];
+static uint16_t num_sorted_links;
+
+/*---------------------------------------------------------------------------*/
+/* Returns the position, among the sorted links of a slotframe, of the
+ * first link with a timeslot greater than the given one */
+static uint16_t
+sorted_links_after(const struct tsch_slotframe *sf, uint16_t timeslot)
+{
+  struct tsch_link **links = &sorted_links[sf->first_sorted_link];
+  uint16_t low = 0;
+  uint16_t high = sf->num_sorted_links;
+
+  while(low < high) {
+    uint16_t mid = (low + high) / 2;
+    if(links[mid]->timeslot <= timeslot) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  return low;
+}
+/*---------------------------------------------------------------------------*/
+/* Moves the sorted links of the slotframes that follow sf by an offset */
+static void
+sorted_links_shift(struct tsch_slotframe *sf, int offset)
+{
+  while((sf = list_item_next(sf)) != NULL) {
+    sf->first_sorted_link += offset;
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Inserts a link into the sorted index. Call with the lock held. */
+static void
+sorted_links_add(struct tsch_slotframe *sf, struct tsch_link *l)
+{
+  uint16_t pos = sf->first_sorted_link + sorted_links_after(sf, l->timeslot);
+
+  memmove(&sorted_links[pos + 1], &sorted_links[pos],
+          (num_sorted_links - pos) * sizeof(sorted_links[0]));
+  sorted_links[pos] = l;
+  num_sorted_links++;
+  sf->num_sorted_links++;
+  sorted_links_shift(sf, 1);
+}
+/*---------------------------------------------------------------------------*/
+/* Removes a link from the sorted index. Call with the lock held. */
+static void
+sorted_links_remove(struct tsch_slotframe *sf, struct tsch_link *l)
+{
+  uint16_t pos = sf->first_sorted_link + sorted_links_after(sf, l->timeslot);
+
+  /* Look for the link among the ones at its timeslot */
+  while(pos > sf->first_sorted_link && sorted_links[pos - 1] != l) {
+    pos--;
+  }
+  if(pos == sf->first_sorted_link) {
+    return;
+  }
+  pos--;
+  memmove(&sorted_links[pos], &sorted_links[pos + 1],
+          (num_sorted_links - pos - 1) * sizeof(sorted_links[0]));
+  num_sorted_links--;
+  sf->num_sorted_links--;
+  sorted_links_shift(sf, -1);
+}
+/*---------------------------------------------------------------------------*/
 
 /* Adds and returns a slotframe (NULL if failure) */
 struct tsch_slotframe *
@@ -87,7 +158,10 @@ tsch_schedule_add_slotframe(uint16_t handle, uint16_t size)
       sf->handle = handle;
       TSCH_ASN_DIVISOR_INIT(sf->size, size);
       LIST_STRUCT_INIT(sf, links_list);
-      /* Add the slotframe to the global list */
+      /* Add the slotframe to the global list, its links to the end of
+       * the sorted index */
+      sf->first_sorted_link = num_sorted_links;
+      sf->num_sorted_links = 0;
       list_add(slotframe_list, sf);
     }
     LOG_INFO("add_slotframe %u %u\n",
@@ -256,6 +330,7 @@ tsch_schedule_add_link(struct tsch_slotframe *slotframe,
           address = &linkaddr_null;
         }
         linkaddr_copy(&l->addr, address);
+        sorted_links_add(slotframe, l);
 
         LOG_INFO("add_link sf=%u opt=%s type=%s ts=%u ch=%u addr=",
                  slotframe->handle,
@@ -309,6 +384,7 @@ tsch_schedule_remove_link(struct tsch_slotframe *slotframe, struct tsch_link *l)
       LOG_INFO_("\n");
 
       list_remove(slotframe->links_list, l);
+      sorted_links_remove(slotframe, l);
       memb_free(&link_memb, l);
 
       /* Release the lock before we update the neighbor (will take the lock) */
@@ -347,15 +423,14 @@ tsch_schedule_get_link_by_timeslot(struct tsch_slotframe *slotframe, uint16_t ti
 {
   if(!tsch_is_locked()) {
     if(slotframe != NULL) {
-      struct tsch_link *l = list_head(slotframe->links_list);
-      /* Loop over all items. Assume there is max one link per timeslot */
-      while(l != NULL) {
+      uint16_t pos = sorted_links_after(slotframe, timeslot);
+      /* Assume there is max one link per timeslot */
+      if(pos > 0) {
+        struct tsch_link *l = sorted_links[slotframe->first_sorted_link + pos - 1];
         if(l->timeslot == timeslot) {
           return l;
         }
-        l = list_item_next(l);
       }
-      return l;
     }
   }
   return NULL;
@@ -378,7 +453,15 @@ tsch_schedule_get_next_active_link(struct tsch_asn_t *asn, uint16_t *time_offset
     while(sf != NULL) {
       /* Get timeslot from ASN, given the slotframe length */
       uint16_t timeslot = TSCH_ASN_MOD(*asn, sf->size);
-      struct tsch_link *l = list_head(sf->links_list);
+      struct tsch_link **links = &sorted_links[sf->first_sorted_link];
+      /* The slotframe's next links are the first ones after the current
+       * timeslot, or the first ones of the slotframe if none is left */
+      uint16_t pos = sorted_links_after(sf, timeslot);
+      struct tsch_link *l;
+      if(pos == sf->num_sorted_links) {
+        pos = 0;
+      }
+      l = pos < sf->num_sorted_links ? links[pos] : NULL;
       while(l != NULL) {
         uint16_t time_to_timeslot =
           l->timeslot > timeslot ?
@@ -422,7 +505,10 @@ tsch_schedule_get_next_active_link(struct tsch_asn_t *asn, uint16_t *time_offset
           }
         }
 
-        l = list_item_next(l);
+        /* Only links at the same timeslot can tie */
+        pos++;
+        l = pos < sf->num_sorted_links && links[pos]->timeslot == l->timeslot ?
+          links[pos] : NULL;
       }
       sf = list_item_next(sf);
     }
@@ -444,6 +530,7 @@ tsch_schedule_init(void)
     memb_init(&link_memb);
     memb_init(&slotframe_memb);
     list_init(slotframe_list);
+    num_sorted_links = 0;
     tsch_release_lock();
     return 1;
   } else {
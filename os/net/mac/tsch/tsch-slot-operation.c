@@ -461,6 +461,7 @@ PT_THREAD(tsch_tx_slot(struct pt *pt, struct rtimer *t))
       static uint8_t cca_status;
 #endif /* TSCH_CCA_ENABLED */
 
+      TSCH_PROFILE_START(tsch_profile_tx_prepare);
       /* get payload */
       packet = queuebuf_dataptr(current_packet->qb);
       packet_len = queuebuf_datalen(current_packet->qb);
@@ -482,14 +483,17 @@ PT_THREAD(tsch_tx_slot(struct pt *pt, struct rtimer *t))
       } else {
         packet_ready = 1;
       }
+      TSCH_PROFILE_END(tsch_profile_tx_prepare);
 
 #if LLSEC802154_ENABLED
       if(tsch_is_pan_secured) {
         /* If we are going to encrypt, we need to generate the output in a separate buffer and keep
          * the original untouched. This is to allow for future retransmissions. */
         int with_encryption = queuebuf_attr(current_packet->qb, PACKETBUF_ATTR_SECURITY_LEVEL) & 0x4;
+        TSCH_PROFILE_START(tsch_profile_tx_security);
         packet_len += tsch_security_secure_frame(packet, with_encryption ? encrypted_packet : packet, current_packet->header_len,
             packet_len - current_packet->header_len, &tsch_current_asn);
+        TSCH_PROFILE_END(tsch_profile_tx_security);
         if(with_encryption) {
           packet = encrypted_packet;
         }
@@ -497,7 +501,12 @@ PT_THREAD(tsch_tx_slot(struct pt *pt, struct rtimer *t))
 #endif /* LLSEC802154_ENABLED */
 
       /* prepare packet to send: copy to radio buffer */
-      if(packet_ready && NETSTACK_RADIO.prepare(packet, packet_len) == 0) { /* 0 means success */
+      TSCH_PROFILE_START(tsch_profile_radio_prepare);
+      if(packet_ready) {
+        packet_ready = NETSTACK_RADIO.prepare(packet, packet_len) == 0; /* 0 means success */
+      }
+      TSCH_PROFILE_END(tsch_profile_radio_prepare);
+      if(packet_ready) {
         static rtimer_clock_t tx_duration;
 
 #if TSCH_CCA_ENABLED
@@ -573,6 +582,7 @@ PT_THREAD(tsch_tx_slot(struct pt *pt, struct rtimer *t))
 #endif /* TSCH_HW_FRAME_FILTERING */
 
               /* Read ack frame */
+              TSCH_PROFILE_START(tsch_profile_ack_parse);
               ack_len = NETSTACK_RADIO.read((void *)ackbuf, sizeof(ackbuf));
 
               is_time_source = 0;
@@ -600,6 +610,7 @@ PT_THREAD(tsch_tx_slot(struct pt *pt, struct rtimer *t))
                 }
 #endif /* LLSEC802154_ENABLED */
               }
+              TSCH_PROFILE_END(tsch_profile_ack_parse);
 
               if(ack_len != 0) {
                 if(is_time_source) {
@@ -768,6 +779,7 @@ PT_THREAD(tsch_rx_slot(struct pt *pt, struct rtimer *t))
         radio_value_t radio_last_lqi;
 
         /* Read packet */
+        TSCH_PROFILE_START(tsch_profile_rx_parse);
         current_input->len = NETSTACK_RADIO.read((void *)current_input->payload, TSCH_PACKET_MAX_LEN);
         NETSTACK_RADIO.get_value(RADIO_PARAM_LAST_RSSI, &radio_last_rssi);
         current_input->rx_asn = tsch_current_asn;
@@ -777,6 +789,7 @@ PT_THREAD(tsch_rx_slot(struct pt *pt, struct rtimer *t))
         frame_valid = header_len > 0 &&
           frame802154_check_dest_panid(&frame) &&
           frame802154_extract_linkaddr(&frame, &source_address, &destination_address);
+        TSCH_PROFILE_END(tsch_profile_rx_parse);
 
 #if TSCH_RESYNC_WITH_SFD_TIMESTAMPS
         /* At the end of the reception, get an more accurate estimate of SFD arrival time */
@@ -806,9 +819,13 @@ PT_THREAD(tsch_rx_slot(struct pt *pt, struct rtimer *t))
 #if LLSEC802154_ENABLED
         /* Decrypt and verify incoming frame */
         if(frame_valid) {
-          if(tsch_security_parse_frame(
+          int frame_secured;
+          TSCH_PROFILE_START(tsch_profile_rx_security);
+          frame_secured = tsch_security_parse_frame(
                current_input->payload, header_len, current_input->len - header_len - tsch_security_mic_len(&frame),
-               &frame, &source_address, &tsch_current_asn)) {
+               &frame, &source_address, &tsch_current_asn);
+          TSCH_PROFILE_END(tsch_profile_rx_security);
+          if(frame_secured) {
             current_input->len -= tsch_security_mic_len(&frame);
           } else {
             TSCH_LOG_ADD(tsch_log_message,
@@ -850,6 +867,7 @@ PT_THREAD(tsch_rx_slot(struct pt *pt, struct rtimer *t))
               static int ack_len;
 
               /* Build ACK frame */
+              TSCH_PROFILE_START(tsch_profile_ack_prepare);
               ack_len = tsch_packet_create_eack(ack_buf, sizeof(ack_buf),
                   &source_address, frame.seq, (int16_t)RTIMERTICKS_TO_US(estimated_drift), do_nack);
 
@@ -863,6 +881,7 @@ PT_THREAD(tsch_rx_slot(struct pt *pt, struct rtimer *t))
 
                 /* Copy to radio buffer */
                 NETSTACK_RADIO.prepare((const void *)ack_buf, ack_len);
+                TSCH_PROFILE_END(tsch_profile_ack_prepare);
 
                 /* Wait for time to ACK and transmit ACK */
                 TSCH_SCHEDULE_AND_YIELD(pt, t, rx_start_time,
@@ -961,6 +980,7 @@ PT_THREAD(tsch_slot_operation(struct rtimer *t, void *ptr))
     } else {
       int is_active_slot;
       TSCH_DEBUG_SLOT_START();
+      TSCH_PROFILE_SLOT_START(current_slot_start, tsch_timing[tsch_ts_timeslot_length]);
       tsch_in_slot_operation = 1;
       /* Measure on-air noise level while TSCH is idle */
       tsch_stats_sample_rssi();
@@ -968,6 +988,7 @@ PT_THREAD(tsch_slot_operation(struct rtimer *t, void *ptr))
       drift_correction = 0;
       is_drift_correction_used = 0;
       /* Get a packet ready to be sent */
+      TSCH_PROFILE_START(tsch_profile_packet);
       current_packet = get_packet_and_neighbor_for_link(current_link, &current_neighbor);
       /* There is no packet to send, and this link does not have Rx flag. Instead of doing
        * nothing, switch to the backup link (has Rx flag) if any. */
@@ -975,6 +996,7 @@ PT_THREAD(tsch_slot_operation(struct rtimer *t, void *ptr))
         current_link = backup_link;
         current_packet = get_packet_and_neighbor_for_link(current_link, &current_neighbor);
       }
+      TSCH_PROFILE_END(tsch_profile_packet);
       is_active_slot = current_packet != NULL || (current_link->link_options & LINK_OPTION_RX);
       if(is_active_slot) {
         /* If we are in a burst, we stick to current channel instead of
@@ -983,6 +1005,10 @@ PT_THREAD(tsch_slot_operation(struct rtimer *t, void *ptr))
           /* Reset burst_link_scheduled flag. Will be set again if burst continue. */
           burst_link_scheduled = 0;
         } else {
+#if TSCH_WITH_HOPPING_SEQUENCE_SWITCH
+          /* Apply any pending network-wide hopping sequence switch */
+          tsch_update_hopping_sequence();
+#endif /* TSCH_WITH_HOPPING_SEQUENCE_SWITCH */
           /* Hop channel */
           tsch_current_channel = tsch_calculate_channel(&tsch_current_asn, current_link->channel_offset);
         }
@@ -1050,7 +1076,9 @@ PT_THREAD(tsch_slot_operation(struct rtimer *t, void *ptr))
           tsch_current_burst_count++;
         } else {
           /* Get next active link */
+          TSCH_PROFILE_START(tsch_profile_schedule);
           current_link = tsch_schedule_get_next_active_link(&tsch_current_asn, &timeslot_diff, &backup_link);
+          TSCH_PROFILE_END(tsch_profile_schedule);
           if(current_link == NULL) {
             /* There is no next link. Fall back to default
              * behavior: wake up at the next slot. */
@@ -1075,6 +1103,7 @@ PT_THREAD(tsch_slot_operation(struct rtimer *t, void *ptr))
       } while(!tsch_schedule_slot_operation(t, prev_slot_start, time_to_next_active_slot, "main"));
     }
 
+    TSCH_PROFILE_SLOT_END();
     tsch_in_slot_operation = 0;
     PT_YIELD(&slot_operation_pt);
   }
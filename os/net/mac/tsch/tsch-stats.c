@@ -38,6 +38,7 @@
 #include "net/mac/tsch/tsch.h"
 #include "net/netstack.h"
 #include "dev/radio.h"
+#include "net/nbr-table.h"
 
 /* Log configuration */
 #include "sys/log.h"
@@ -56,6 +57,17 @@ static struct ctimer periodic_timer;
 
 static void periodic(void *);
 
+#if TSCH_STATS_CHANNEL_REPORTS
+/* The channel quality last reported by a child */
+struct tsch_channel_report {
+  tsch_stat_t channel_free[TSCH_STATS_NUM_CHANNELS];
+  clock_time_t last_update;
+  /* The number of nodes of the sub-tree of the child */
+  uint8_t nodes;
+};
+NBR_TABLE(struct tsch_channel_report, channel_reports);
+#endif /* TSCH_STATS_CHANNEL_REPORTS */
+
 /*---------------------------------------------------------------------------*/
 void
 tsch_stats_init(void)
@@ -68,6 +80,9 @@ tsch_stats_init(void)
     tsch_stats.channel_free_ewma[i] = TSCH_STATS_DEFAULT_CHANNEL_FREE;
   }
 #endif
+#if TSCH_STATS_CHANNEL_REPORTS
+  nbr_table_register(channel_reports, NULL);
+#endif /* TSCH_STATS_CHANNEL_REPORTS */
 
   tsch_stats_reset_neighbor_stats();
 
@@ -187,6 +202,106 @@ tsch_stats_sample_rssi(void)
 #endif /* TSCH_STATS_SAMPLE_NOISE_RSSI */
 }
 /*---------------------------------------------------------------------------*/
+void
+tsch_stats_dequeued_packet(uint8_t priority, uint32_t delay, uint8_t stale)
+{
+  struct tsch_queue_stats *stats;
+
+  if(priority >= TSCH_QUEUE_NUM_PRIORITIES) {
+    return;
+  }
+  stats = &tsch_stats.queue[priority];
+  stats->dequeued++;
+  stats->stale += stale;
+  stats->total_delay += delay;
+  stats->max_delay = MAX(stats->max_delay, delay);
+}
+/*---------------------------------------------------------------------------*/
+#if TSCH_STATS_CHANNEL_REPORTS
+static int
+is_report_fresh(const struct tsch_channel_report *report)
+{
+  return clock_time() - report->last_update < TSCH_STATS_DECAY_INTERVAL;
+}
+/*---------------------------------------------------------------------------*/
+void
+tsch_stats_channel_report_input(const linkaddr_t *from, uint8_t nodes,
+                                uint8_t first_channel,
+                                const uint8_t *quality, uint8_t len)
+{
+  struct tsch_channel_report *report;
+  int i;
+
+  report = nbr_table_get_from_lladdr(channel_reports, from);
+  if(report == NULL) {
+    /* Only neighbors that TSCH already knows get a report, so that an
+     * EB heard from any node does not evict a neighbor in use */
+    if(tsch_queue_get_nbr(from) == NULL) {
+      return;
+    }
+    report = nbr_table_add_lladdr(channel_reports, from, NBR_TABLE_REASON_MAC, NULL);
+    if(report == NULL) {
+      return;
+    }
+    for(i = 0; i < TSCH_STATS_NUM_CHANNELS; ++i) {
+      report->channel_free[i] = TSCH_STATS_DEFAULT_CHANNEL_FREE;
+    }
+  }
+
+  for(i = 0; i < len; ++i) {
+    uint8_t channel = first_channel + i;
+    if(channel >= TSCH_STATS_FIRST_CHANNEL
+       && channel < TSCH_STATS_FIRST_CHANNEL + TSCH_STATS_NUM_CHANNELS) {
+      report->channel_free[tsch_stats_channel_to_index(channel)] =
+          (uint32_t)quality[i] * TSCH_STATS_BINARY_SCALING_FACTOR / 255;
+    }
+  }
+  /* A report covers at least the child itself */
+  report->nodes = MAX(nodes, 1);
+  report->last_update = clock_time();
+}
+/*---------------------------------------------------------------------------*/
+tsch_stat_t
+tsch_stats_get_network_channel_free(uint8_t channel_index)
+{
+  struct tsch_channel_report *report;
+  uint32_t sum;
+  uint32_t count;
+
+  if(channel_index >= TSCH_STATS_NUM_CHANNELS) {
+    return TSCH_STATS_DEFAULT_CHANNEL_FREE;
+  }
+
+  /* Reports cover the children's own children, so the metric of a
+   * coordinator covers the whole network, each node counting once */
+  sum = tsch_stats.channel_free_ewma[channel_index];
+  count = 1;
+  for(report = nbr_table_head(channel_reports); report != NULL;
+      report = nbr_table_next(channel_reports, report)) {
+    if(is_report_fresh(report)) {
+      sum += (uint32_t)report->channel_free[channel_index] * report->nodes;
+      count += report->nodes;
+    }
+  }
+  return sum / count;
+}
+/*---------------------------------------------------------------------------*/
+uint8_t
+tsch_stats_get_network_nodes(void)
+{
+  struct tsch_channel_report *report;
+  uint16_t count = 1;
+
+  for(report = nbr_table_head(channel_reports); report != NULL;
+      report = nbr_table_next(channel_reports, report)) {
+    if(is_report_fresh(report)) {
+      count += report->nodes;
+    }
+  }
+  return MIN(count, UINT8_MAX);
+}
+#endif /* TSCH_STATS_CHANNEL_REPORTS */
+/*---------------------------------------------------------------------------*/
 /* Periodic timer called every TSCH_STATS_DECAY_INTERVAL ticks */
 static void
 periodic(void *ptr)
@@ -206,6 +321,15 @@ periodic(void *ptr)
   }
 #endif
 
+  LOG_DBG("Queues:\n");
+  for(i = 0; i < TSCH_QUEUE_NUM_PRIORITIES; ++i) {
+    struct tsch_queue_stats *q = &tsch_stats.queue[i];
+    LOG_DBG("  priority %u: %lu dequeued, %lu stale, %lu avg delay, %lu max delay\n",
+        i, (unsigned long)q->dequeued, (unsigned long)q->stale,
+        (unsigned long)(q->dequeued ? q->total_delay / q->dequeued : 0),
+        (unsigned long)q->max_delay);
+  }
+
   timesource = tsch_queue_get_time_source();
   if(timesource != NULL) {
     LOG_DBG("Time source neighbor:\n");
@@ -229,6 +353,20 @@ periodic(void *ptr)
     TSCH_STATS_EWMA_UPDATE(stats[i].p_tx_success, TSCH_STATS_DEFAULT_P_TX);
   }
 
+#if TSCH_STATS_CHANNEL_REPORTS
+  /* Forget the children that stopped reporting */
+  {
+    struct tsch_channel_report *report = nbr_table_head(channel_reports);
+    while(report != NULL) {
+      struct tsch_channel_report *next = nbr_table_next(channel_reports, report);
+      if(!is_report_fresh(report)) {
+        nbr_table_remove(channel_reports, report);
+      }
+      report = next;
+    }
+  }
+#endif /* TSCH_STATS_CHANNEL_REPORTS */
+
   ctimer_set(&periodic_timer, TSCH_STATS_DECAY_INTERVAL, periodic, NULL);
 }
 /*---------------------------------------------------------------------------*/
@@ -109,6 +109,10 @@
 #define TSCH_STATS_FIRST_CHANNEL 11
 #endif
 
+/* Aggregate the channel quality that children report in their EBs, as
+ * input for network-wide hopping sequence switches */
+#define TSCH_STATS_CHANNEL_REPORTS (TSCH_STATS_ON && TSCH_STATS_SAMPLE_NOISE_RSSI && TSCH_WITH_HOPPING_SEQUENCE_SWITCH)
+
 /* Internal: the scaling of the various stats */
 #define TSCH_STATS_RSSI_SCALING_FACTOR    -16
 #define TSCH_STATS_LQI_SCALING_FACTOR      16
@@ -138,11 +142,25 @@
 
 typedef uint16_t tsch_stat_t;
 
+/* Queueing statistics of a priority class */
+struct tsch_queue_stats {
+  /* number of packets that left the queue */
+  uint32_t dequeued;
+  /* of which dropped past their deadline */
+  uint32_t stale;
+  /* sum of their queueing delays, in timeslots */
+  uint32_t total_delay;
+  /* longest queueing delay, in timeslots */
+  uint32_t max_delay;
+};
+
 struct tsch_global_stats {
   /* the maximum synchronization error */
   uint32_t max_sync_error;
   /* number of disassociations */
   uint16_t num_disassociations;
+  /* per-priority class queueing statistics */
+  struct tsch_queue_stats queue[TSCH_QUEUE_NUM_PRIORITIES];
 #if TSCH_STATS_SAMPLE_NOISE_RSSI
   /* per-channel noise estimates */
   tsch_stat_t noise_rssi[TSCH_STATS_NUM_CHANNELS];
@@ -190,10 +208,30 @@ void tsch_stats_on_time_synchronization(int32_t sync_error);
 
 void tsch_stats_sample_rssi(void);
 
+void tsch_stats_dequeued_packet(uint8_t priority, uint32_t delay, uint8_t stale);
+
 struct tsch_neighbor_stats *tsch_stats_get_from_neighbor(struct tsch_neighbor *);
 
 void tsch_stats_reset_neighbor_stats(void);
 
+#if TSCH_STATS_CHANNEL_REPORTS
+/* Store the channel quality reported by a child for the nodes of its sub-tree,
+ * scaled from 0 (busy) to 255 (free). Reports from nodes that are not TSCH
+ * neighbors are ignored. */
+void tsch_stats_channel_report_input(const linkaddr_t *from, uint8_t nodes,
+                                     uint8_t first_channel,
+                                     const uint8_t *quality, uint8_t len);
+
+/* The channel free metric averaged over the nodes of our sub-tree: the local
+ * node and the recent reports of its children, each weighted by the number
+ * of nodes it covers */
+tsch_stat_t tsch_stats_get_network_channel_free(uint8_t channel_index);
+
+/* The number of nodes of our sub-tree, the local node included, as far as
+ * the recent reports of the children tell. At most 255. */
+uint8_t tsch_stats_get_network_nodes(void);
+#endif /* TSCH_STATS_CHANNEL_REPORTS */
+
 #else /* TSCH_STATS_ON */
 
 #define tsch_stats_init()
@@ -201,6 +239,7 @@ void tsch_stats_reset_neighbor_stats(void);
 #define tsch_stats_rx_packet(n, rssi, lqi, channel)
 #define tsch_stats_on_time_synchronization(sync_error)
 #define tsch_stats_sample_rssi()
+#define tsch_stats_dequeued_packet(priority, delay, stale)
 #define tsch_stats_get_from_neighbor(neighbor) NULL
 #define tsch_stats_reset_neighbor_stats()
 
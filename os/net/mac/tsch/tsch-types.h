@@ -91,6 +91,10 @@ struct tsch_slotframe {
   struct tsch_asn_divisor_t size;
   /* List of links belonging to this slotframe */
   LIST_STRUCT(links_list);
+  /* Where the links of this slotframe start in the timeslot-sorted
+   * index of the schedule, and how many there are */
+  uint16_t first_sorted_link;
+  uint16_t num_sorted_links;
 };
 
 /** \brief TSCH packet information */
@@ -103,6 +107,11 @@ struct tsch_packet {
   uint8_t ret; /* status -- MAC return code */
   uint8_t header_len; /* length of header and header IEs (needed for link-layer security) */
   uint8_t tsch_sync_ie_offset; /* Offset within the frame used for quick update of EB ASN and join priority */
+  uint8_t priority; /* priority class of the packet in its neighbor queue */
+  struct tsch_asn_t queued_asn; /* ASN at which the packet was queued */
+#if TSCH_QUEUE_WITH_DEADLINE
+  uint16_t deadline; /* number of timeslots the packet may wait in queue, 0 for none */
+#endif /* TSCH_QUEUE_WITH_DEADLINE */
 };
 
 /** \brief TSCH neighbor information */
@@ -117,11 +126,11 @@ struct tsch_neighbor {
   uint8_t last_backoff_window; /* Last CSMA backoff window */
   uint8_t tx_links_count; /* How many links do we have to this neighbor? */
   uint8_t dedicated_tx_links_count; /* How many dedicated links do we have to this neighbor? */
-  /* Array for the ringbuf. Contains pointers to packets.
-   * Its size must be a power of two to allow for atomic put */
-  struct tsch_packet *tx_array[TSCH_QUEUE_NUM_PER_NEIGHBOR];
-  /* Circular buffer of pointers to packet. */
-  struct ringbufindex tx_ringbuf;
+  /* Arrays for the ringbufs, one per priority class. Contain pointers to
+   * packets. Their size must be a power of two to allow for atomic put */
+  struct tsch_packet *tx_array[TSCH_QUEUE_NUM_PRIORITIES][TSCH_QUEUE_NUM_PER_NEIGHBOR];
+  /* Circular buffers of pointers to packet, one per priority class. */
+  struct ringbufindex tx_ringbuf[TSCH_QUEUE_NUM_PRIORITIES];
 };
 
 /** \brief TSCH timeslot timing elements. Used to index timeslot timing
@@ -151,5 +160,12 @@ struct input_packet {
   uint8_t channel; /* Channel we received the packet on */
 };
 
+/** \brief A hopping sequence switch, announced in EBs */
+struct tsch_hopping_sequence_switch {
+  struct tsch_asn_t asn; /* ASN from which the sequence is used */
+  uint8_t len; /* Sequence length, 0 if no switch is pending */
+  uint8_t sequence[TSCH_HOPPING_SEQUENCE_MAX_LEN];
+};
+
 #endif /* __TSCH_CONF_H__ */
 /** @} */
@@ -219,6 +219,9 @@ tsch_reset(void)
   tsch_join_priority = 0xff;
   TSCH_ASN_INIT(tsch_current_asn, 0, 0);
   current_link = NULL;
+#if TSCH_WITH_HOPPING_SEQUENCE_SWITCH
+  tsch_set_next_hopping_sequence(NULL, 0, NULL);
+#endif /* TSCH_WITH_HOPPING_SEQUENCE_SWITCH */
   /* Reset timeslot timing to defaults */
   tsch_default_timing_us = TSCH_DEFAULT_TIMESLOT_TIMING;
   for(i = 0; i < tsch_ts_elements_count; i++) {
@@ -316,6 +319,9 @@ keepalive_send(void *ptr)
         /* Simply send an empty packet */
         packetbuf_clear();
         packetbuf_set_addr(PACKETBUF_ADDR_RECEIVER, &n->addr);
+#if TSCH_QUEUE_NUM_PRIORITIES > 1
+        packetbuf_set_attr(PACKETBUF_ATTR_TSCH_PRIORITY, TSCH_QUEUE_CONTROL_PRIORITY);
+#endif /* TSCH_QUEUE_NUM_PRIORITIES > 1 */
         NETSTACK_MAC.send(keepalive_packet_sent, NULL);
         LOG_INFO("sending KA to ");
         LOG_INFO_LLADDR(&n->addr);
@@ -369,6 +375,18 @@ eb_input(struct input_packet *current_input)
       last_eb_nbr_jp = eb_ies.ie_join_priority;
     }
 
+#if TSCH_STATS_CHANNEL_REPORTS
+    /* Aggregate the channel quality seen by our children */
+    if(eb_ies.ie_channel_quality_len != 0
+       && eb_ies.ie_join_priority == tsch_join_priority + 1) {
+      tsch_stats_channel_report_input((linkaddr_t *)&frame.src_addr,
+                                      eb_ies.ie_channel_quality_nodes,
+                                      eb_ies.ie_channel_quality_first_channel,
+                                      eb_ies.ie_channel_quality,
+                                      eb_ies.ie_channel_quality_len);
+    }
+#endif /* TSCH_STATS_CHANNEL_REPORTS */
+
 #if TSCH_AUTOSELECT_TIME_SOURCE
     if(!tsch_is_coordinator) {
       /* Maintain EB received counter for every neighbor */
@@ -428,6 +446,22 @@ eb_input(struct input_packet *current_input)
 #endif /* TSCH_AUTOSELECT_TIME_SOURCE */
       }
 
+#if TSCH_WITH_HOPPING_SEQUENCE_SWITCH
+      /* Hopping sequence switch relayed by our time source */
+      if(tsch_check_next_hopping_sequence(&eb_ies, &current_input->rx_asn)) {
+        if(tsch_get_lock()) {
+          tsch_set_next_hopping_sequence(eb_ies.ie_next_hopping_sequence_list,
+                                         eb_ies.ie_next_hopping_sequence_len,
+                                         &eb_ies.ie_next_hopping_sequence_asn);
+          tsch_release_lock();
+          LOG_INFO("hopping sequence switch at asn-%x.%lx, len %u\n",
+                   eb_ies.ie_next_hopping_sequence_asn.ms1b,
+                   (unsigned long)eb_ies.ie_next_hopping_sequence_asn.ls4b,
+                   eb_ies.ie_next_hopping_sequence_len);
+        }
+      }
+#endif /* TSCH_WITH_HOPPING_SEQUENCE_SWITCH */
+
       /* TSCH hopping sequence */
       if(eb_ies.ie_channel_hopping_sequence_id != 0) {
         if(eb_ies.ie_hopping_sequence_len != tsch_hopping_sequence_length.val
@@ -490,8 +524,9 @@ tsch_tx_process_pending(void)
   /* Loop on accessing (without removing) a pending input packet */
   while((dequeued_index = ringbufindex_peek_get(&dequeued_ringbuf)) != -1) {
     struct tsch_packet *p = dequeued_array[dequeued_index];
-    /* Put packet into packetbuf for packet_sent callback */
-    queuebuf_to_packetbuf(p->qb);
+    /* Put the packet attributes into packetbuf for the packet_sent
+       callback, the frame itself is not needed any more */
+    queuebuf_attr_to_packetbuf(p->qb);
     LOG_INFO("packet sent to ");
     LOG_INFO_LLADDR(packetbuf_addr(PACKETBUF_ADDR_RECEIVER));
     LOG_INFO_(", seqno %u, status %d, tx %d\n",
@@ -603,6 +638,17 @@ tsch_associate(const struct input_packet *input_eb, rtimer_clock_t timestamp)
     tsch_timing[i] = US_TO_RTIMERTICKS(tsch_timing_us[i]);
   }
 
+#if TSCH_WITH_HOPPING_SEQUENCE_SWITCH
+  /* Hopping sequence switch announced by the network. The slot operation
+   * is not running yet. */
+  tsch_set_next_hopping_sequence(NULL, 0, NULL);
+  if(tsch_check_next_hopping_sequence(&ies, &tsch_current_asn)) {
+    tsch_set_next_hopping_sequence(ies.ie_next_hopping_sequence_list,
+                                   ies.ie_next_hopping_sequence_len,
+                                   &ies.ie_next_hopping_sequence_asn);
+  }
+#endif /* TSCH_WITH_HOPPING_SEQUENCE_SWITCH */
+
   /* TSCH hopping sequence */
   if(ies.ie_channel_hopping_sequence_id == 0) {
     memcpy(tsch_hopping_sequence, TSCH_DEFAULT_HOPPING_SEQUENCE, sizeof(TSCH_DEFAULT_HOPPING_SEQUENCE));
@@ -905,7 +951,11 @@ PROCESS_THREAD(tsch_pending_events_process, ev, data)
     PROCESS_YIELD_UNTIL(ev == PROCESS_EVENT_POLL);
     tsch_rx_process_pending();
     tsch_tx_process_pending();
+#if TSCH_QUEUE_WITH_DEADLINE
+    tsch_queue_drop_stale_packets();
+#endif /* TSCH_QUEUE_WITH_DEADLINE */
     tsch_log_process_pending();
+    tsch_profile_process_pending();
 #ifdef TSCH_CALLBACK_SELECT_CHANNELS
     TSCH_CALLBACK_SELECT_CHANNELS();
 #endif
@@ -977,6 +1027,7 @@ tsch_init(void)
   tsch_queue_init();
   tsch_schedule_init();
   tsch_log_init();
+  tsch_profile_init();
   ringbufindex_init(&input_ringbuf, TSCH_MAX_INCOMING_PACKETS);
   ringbufindex_init(&dequeued_ringbuf, TSCH_DEQUEUED_ARRAY_SIZE);
 #if TSCH_AUTOSELECT_TIME_SOURCE
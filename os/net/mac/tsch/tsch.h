@@ -57,6 +57,7 @@ frequency hopping for enhanced reliability.
 #include "net/mac/tsch/tsch-slot-operation.h"
 #include "net/mac/tsch/tsch-queue.h"
 #include "net/mac/tsch/tsch-log.h"
+#include "net/mac/tsch/tsch-profile.h"
 #include "net/mac/tsch/tsch-packet.h"
 #include "net/mac/tsch/tsch-security.h"
 #include "net/mac/tsch/tsch-schedule.h"
@@ -231,5 +232,51 @@ void tsch_schedule_keepalive_immediately(void);
   */
 void tsch_disassociate(void);
 
+#if TSCH_WITH_HOPPING_SEQUENCE_SWITCH
+/**
+ * Announce a new hopping sequence to the network. Meant for the
+ * coordinator. The announcement is relayed in EBs and all nodes switch
+ * to the new sequence in the same timeslot, TSCH_HOPPING_SEQUENCE_SWITCH_DELAY
+ * from now.
+ *
+ * \param sequence The new hopping sequence
+ * \param len The length of the new hopping sequence
+ * \return 1 if the switch is scheduled, 0 otherwise
+ */
+int tsch_announce_hopping_sequence(const uint8_t *sequence, uint8_t len);
+/**
+ * Get the pending hopping sequence switch
+ *
+ * \return The pending switch, or NULL if there is none
+ */
+const struct tsch_hopping_sequence_switch *tsch_get_next_hopping_sequence(void);
+/**
+ * Switch to the next hopping sequence if its ASN has been reached.
+ * Called from the slot operation.
+ */
+void tsch_update_hopping_sequence(void);
+/**
+ * Take the hopping sequence switch announced in an EB into account. A
+ * switch that already took place at rx_asn means the EB was built before
+ * the switch: its hopping sequence IE is outdated, so it is replaced with
+ * the announced sequence.
+ *
+ * \param ies The IEs of the EB
+ * \param rx_asn The ASN at which the EB was received
+ * eturn 1 if the EB announces a future switch that is not pending yet
+ */
+int tsch_check_next_hopping_sequence(struct ieee802154_ies *ies,
+                                     const struct tsch_asn_t *rx_asn);
+/**
+ * Set the pending hopping sequence switch
+ *
+ * \param sequence The next hopping sequence
+ * \param len The length of the sequence, 0 to cancel any pending switch
+ * \param asn The ASN from which the sequence is used
+ */
+void tsch_set_next_hopping_sequence(const uint8_t *sequence, uint8_t len,
+                                    const struct tsch_asn_t *asn);
+#endif /* TSCH_WITH_HOPPING_SEQUENCE_SWITCH */
+
 #endif /* __TSCH_H__ */
 /** @} */
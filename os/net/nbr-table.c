@@ -60,6 +60,7 @@ static void print_table();
 const linkaddr_t *NBR_TABLE_FIND_REMOVABLE(nbr_table_reason_t reason, void *data);
 #endif /* NBR_TABLE_FIND_REMOVABLE */
 
+extern const nbr_table_policy_t NBR_TABLE_POLICY;
 
 /* List of link-layer addresses of the neighbors, used as key in the tables */
 typedef struct nbr_table_key {
@@ -83,6 +84,53 @@ static unsigned num_tables;
 MEMB(neighbor_addr_mem, nbr_table_key_t, NBR_TABLE_MAX_NEIGHBORS);
 LIST(nbr_table_keys);
 
+#if NBR_TABLE_HASH
+/* An open-addressing hash index over the keys, with at least twice as
+ * many slots as there are neighbors. A slot holds a neighbor index plus
+ * one, or 0 when free. Collisions are resolved by linear probing, and
+ * removals shift the following entries back, so there are no tombstones. */
+#if NBR_TABLE_MAX_NEIGHBORS <= 8
+#define HASH_SIZE 16
+#elif NBR_TABLE_MAX_NEIGHBORS <= 16
+#define HASH_SIZE 32
+#elif NBR_TABLE_MAX_NEIGHBORS <= 32
+#define HASH_SIZE 64
+#elif NBR_TABLE_MAX_NEIGHBORS <= 64
+#define HASH_SIZE 128
+#elif NBR_TABLE_MAX_NEIGHBORS <= 128
+#define HASH_SIZE 256
+#elif NBR_TABLE_MAX_NEIGHBORS <= 256
+#define HASH_SIZE 512
+#elif NBR_TABLE_MAX_NEIGHBORS <= 512
+#define HASH_SIZE 1024
+#elif NBR_TABLE_MAX_NEIGHBORS <= 1024
+#define HASH_SIZE 2048
+#elif NBR_TABLE_MAX_NEIGHBORS <= 2048
+#define HASH_SIZE 4096
+#else
+#error "NBR_TABLE_CONF_HASH supports up to 2048 neighbors"
+#endif
+#define HASH_MASK (HASH_SIZE - 1)
+
+static uint16_t hash_slots[HASH_SIZE];
+#endif /* NBR_TABLE_HASH */
+
+#if NBR_TABLE_LRU
+/* A doubly linked list of the neighbor indices, from the least recently
+ * used one (lru_head) to the most recently used one (lru_tail) */
+#define LRU_NONE 0xffff
+static uint16_t lru_prev[NBR_TABLE_MAX_NEIGHBORS];
+static uint16_t lru_next[NBR_TABLE_MAX_NEIGHBORS];
+static uint16_t lru_head = LRU_NONE;
+static uint16_t lru_tail = LRU_NONE;
+#endif /* NBR_TABLE_LRU */
+
+static const nbr_table_policy_t *policy = &NBR_TABLE_POLICY;
+static nbr_table_stats_t stats;
+/* Set while looking for a neighbor to remove, so that the lookups made
+ * by the policy do not count as uses */
+static uint8_t finding_removable;
+
 /*---------------------------------------------------------------------------*/
 /* Get a key from a neighbor index */
 static nbr_table_key_t *
@@ -125,17 +173,172 @@ key_from_item(nbr_table_t *table, const nbr_table_item_t *item)
 {
   return key_from_index(index_from_item(table, item));
 }
+#if NBR_TABLE_HASH
+/*---------------------------------------------------------------------------*/
+/* Get the home slot of a link-layer address (FNV-1a) */
+static unsigned
+hash_slot(const linkaddr_t *lladdr)
+{
+  uint32_t h = 2166136261UL;
+  int i;
+
+  for(i = 0; i < LINKADDR_SIZE; i++) {
+    h = (h ^ lladdr->u8[i]) * 16777619UL;
+  }
+  return (h ^ (h >> 16)) & HASH_MASK;
+}
+/*---------------------------------------------------------------------------*/
+/* Look up the index of a neighbor in the hash index */
+static int
+hash_find(const linkaddr_t *lladdr)
+{
+  unsigned slot = hash_slot(lladdr);
+
+  while(hash_slots[slot] != 0) {
+    int index = hash_slots[slot] - 1;
+    if(linkaddr_cmp(lladdr, &key_from_index(index)->lladdr)) {
+      return index;
+    }
+    slot = (slot + 1) & HASH_MASK;
+  }
+  return -1;
+}
+/*---------------------------------------------------------------------------*/
+/* Add a neighbor, whose address is set, to the hash index */
+static void
+hash_add(int index)
+{
+  unsigned slot = hash_slot(&key_from_index(index)->lladdr);
+
+  while(hash_slots[slot] != 0) {
+    slot = (slot + 1) & HASH_MASK;
+  }
+  hash_slots[slot] = index + 1;
+}
+/*---------------------------------------------------------------------------*/
+/* Remove a neighbor, whose address is still set, from the hash index */
+static void
+hash_remove(int index)
+{
+  unsigned slot = hash_slot(&key_from_index(index)->lladdr);
+  unsigned next;
+  unsigned home;
+
+  while(hash_slots[slot] != index + 1) {
+    if(hash_slots[slot] == 0) {
+      return;
+    }
+    slot = (slot + 1) & HASH_MASK;
+  }
+  hash_slots[slot] = 0;
+
+  /* Move back the entries that can no longer be reached past the hole */
+  for(next = (slot + 1) & HASH_MASK; hash_slots[next] != 0;
+      next = (next + 1) & HASH_MASK) {
+    home = hash_slot(&key_from_index(hash_slots[next] - 1)->lladdr);
+    if(((next - home) & HASH_MASK) >= ((next - slot) & HASH_MASK)) {
+      hash_slots[slot] = hash_slots[next];
+      hash_slots[next] = 0;
+      slot = next;
+    }
+  }
+}
+#endif /* NBR_TABLE_HASH */
+#if NBR_TABLE_LRU
+/*---------------------------------------------------------------------------*/
+static void
+lru_unlink(int index)
+{
+  if(lru_prev[index] != LRU_NONE) {
+    lru_next[lru_prev[index]] = lru_next[index];
+  } else {
+    lru_head = lru_next[index];
+  }
+  if(lru_next[index] != LRU_NONE) {
+    lru_prev[lru_next[index]] = lru_prev[index];
+  } else {
+    lru_tail = lru_prev[index];
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Insert a neighbor as the most recently used one */
+static void
+lru_append(int index)
+{
+  lru_prev[index] = lru_tail;
+  lru_next[index] = LRU_NONE;
+  if(lru_tail != LRU_NONE) {
+    lru_next[lru_tail] = index;
+  } else {
+    lru_head = index;
+  }
+  lru_tail = index;
+}
+/*---------------------------------------------------------------------------*/
+/* Insert a neighbor as the least recently used one */
+static void
+lru_prepend(int index)
+{
+  lru_prev[index] = LRU_NONE;
+  lru_next[index] = lru_head;
+  if(lru_head != LRU_NONE) {
+    lru_prev[lru_head] = index;
+  } else {
+    lru_tail = index;
+  }
+  lru_head = index;
+}
+/*---------------------------------------------------------------------------*/
+static void
+lru_touch(int index)
+{
+  if(index != lru_tail && !finding_removable) {
+    lru_unlink(index);
+    lru_append(index);
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Move the locked neighbors found at the head of the list to its tail,
+ * since they are in use anyway. This keeps the walks of the policies
+ * short, whatever the number of locked neighbors. */
+static void
+lru_skip_locked(void)
+{
+  int i;
+
+  for(i = 0; i < NBR_TABLE_MAX_NEIGHBORS && lru_head != LRU_NONE
+        && locked_map[lru_head] != 0; i++) {
+    int index = lru_head;
+    lru_unlink(index);
+    lru_append(index);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static const linkaddr_t *
+lru_unlocked_from(int index)
+{
+  while(index != LRU_NONE && locked_map[index] != 0) {
+    index = lru_next[index];
+  }
+  return index != LRU_NONE ? &key_from_index(index)->lladdr : NULL;
+}
+#endif /* NBR_TABLE_LRU */
 /*---------------------------------------------------------------------------*/
 /* Get the index of a neighbor from its link-layer address */
 static int
 index_from_lladdr(const linkaddr_t *lladdr)
 {
+#if !NBR_TABLE_HASH
   nbr_table_key_t *key;
+#endif /* !NBR_TABLE_HASH */
   /* Allow lladdr-free insertion, useful e.g. for IPv6 ND.
    * Only one such entry is possible at a time, indexed by linkaddr_null. */
   if(lladdr == NULL) {
     lladdr = &linkaddr_null;
   }
+#if NBR_TABLE_HASH
+  return hash_find(lladdr);
+#else /* NBR_TABLE_HASH */
   key = list_head(nbr_table_keys);
   while(key != NULL) {
     if(lladdr && linkaddr_cmp(lladdr, &key->lladdr)) {
@@ -144,6 +347,7 @@ index_from_lladdr(const linkaddr_t *lladdr)
     key = list_item_next(key);
   }
   return -1;
+#endif /* NBR_TABLE_HASH */
 }
 /*---------------------------------------------------------------------------*/
 /* Get bit from "used" or "locked" bitmap */
@@ -193,89 +397,149 @@ remove_key(nbr_table_key_t *least_used_key)
   }
   /* Empty used map */
   used_map[index_from_key(least_used_key)] = 0;
+#if NBR_TABLE_HASH
+  hash_remove(index_from_key(least_used_key));
+#endif /* NBR_TABLE_HASH */
+#if NBR_TABLE_LRU
+  /* The key is reused right away, so it keeps its place in the list, the
+   * order that matters for eviction being the one of the recency list */
+  lru_unlink(index_from_key(least_used_key));
+#else /* NBR_TABLE_LRU */
   /* Remove neighbor from list */
   list_remove(nbr_table_keys, least_used_key);
+#endif /* NBR_TABLE_LRU */
+}
+/*---------------------------------------------------------------------------*/
+static const linkaddr_t *
+find_least_used(nbr_table_reason_t reason, void *data)
+{
+  nbr_table_key_t *key;
+  int least_used_count = 0;
+  nbr_table_key_t *least_used_key = NULL;
+
+  /* The replacement policy is the following: remove neighbor that is:
+   * (1) not locked
+   * (2) used by fewest tables
+   * (3) oldest (the list is ordered by insertion time)
+   * */
+  /* Get item from first key */
+  key = list_head(nbr_table_keys);
+  while(key != NULL) {
+    int item_index = index_from_key(key);
+    int locked = locked_map[item_index];
+    /* Never delete a locked item */
+    if(!locked) {
+      int used = used_map[item_index];
+      int used_count = 0;
+      /* Count how many tables are using this item */
+      while(used != 0) {
+        if((used & 1) == 1) {
+          used_count++;
+        }
+        used >>= 1;
+      }
+      /* Find least used item */
+      if(least_used_key == NULL || used_count < least_used_count) {
+        least_used_key = key;
+        least_used_count = used_count;
+        if(used_count == 0) { /* We won't find any least used item */
+          break;
+        }
+      }
+    }
+    key = list_item_next(key);
+  }
+  return least_used_key != NULL ? &least_used_key->lladdr : NULL;
+}
+const nbr_table_policy_t nbr_table_policy_least_used = {
+  "least-used",
+  find_least_used
+};
+/*---------------------------------------------------------------------------*/
+#if NBR_TABLE_LRU
+static const linkaddr_t *
+find_lru(nbr_table_reason_t reason, void *data)
+{
+  return nbr_table_lru_head();
+}
+const nbr_table_policy_t nbr_table_policy_lru = {
+  "lru",
+  find_lru
+};
+#endif /* NBR_TABLE_LRU */
+/*---------------------------------------------------------------------------*/
+/* Get the key of a neighbor chosen for removal, unlocking it if needed */
+static nbr_table_key_t *
+removable_key(const linkaddr_t *lladdr)
+{
+  int index;
+
+  if(lladdr == NULL || (index = index_from_lladdr(lladdr)) == -1) {
+    return NULL;
+  }
+  /* Allow delete of locked item? */
+  if(locked_map[index]) {
+    PRINTF("Deleting locked item!\n");
+    locked_map[index] = 0;
+    stats.locked_evictions++;
+  }
+  return key_from_index(index);
 }
 /*---------------------------------------------------------------------------*/
 static nbr_table_key_t *
 nbr_table_allocate(nbr_table_reason_t reason, void *data)
 {
   nbr_table_key_t *key;
-  int least_used_count = 0;
   nbr_table_key_t *least_used_key = NULL;
 
   key = memb_alloc(&neighbor_addr_mem);
   if(key != NULL) {
+    /* Add neighbor to list */
+    list_add(nbr_table_keys, key);
     return key;
-  } else {
+  }
+
+  /* No more space, try to free a neighbor */
+  finding_removable = 1;
+#if NBR_TABLE_LRU
+  lru_skip_locked();
+#endif /* NBR_TABLE_LRU */
 #ifdef NBR_TABLE_FIND_REMOVABLE
+  {
     const linkaddr_t *lladdr;
     lladdr = NBR_TABLE_FIND_REMOVABLE(reason, data);
     if(lladdr == NULL) {
       /* Nothing found that can be deleted - return NULL to indicate failure */
       PRINTF("*** Not removing entry to allocate new\n");
+      finding_removable = 0;
+      stats.failures++;
       return NULL;
-    } else {
-      /* used least_used_key to indicate what is the least useful entry */
-      int index;
-      int locked = 0;
-      if((index = index_from_lladdr(lladdr)) != -1) {
-        least_used_key = key_from_index(index);
-        locked = locked_map[index];
-      }
-      /* Allow delete of locked item? */
-      if(least_used_key != NULL && locked) {
-        PRINTF("Deleting locked item!\n");
-        locked_map[index] = 0;
-      }
     }
+    /* used least_used_key to indicate what is the least useful entry */
+    least_used_key = removable_key(lladdr);
+  }
 #endif /* NBR_TABLE_FIND_REMOVABLE */
 
-    if(least_used_key == NULL) {
-      /* No more space, try to free a neighbor.
-       * The replacement policy is the following: remove neighbor that is:
-       * (1) not locked
-       * (2) used by fewest tables
-       * (3) oldest (the list is ordered by insertion time)
-       * */
-      /* Get item from first key */
-      key = list_head(nbr_table_keys);
-      while(key != NULL) {
-        int item_index = index_from_key(key);
-        int locked = locked_map[item_index];
-        /* Never delete a locked item */
-        if(!locked) {
-          int used = used_map[item_index];
-          int used_count = 0;
-          /* Count how many tables are using this item */
-          while(used != 0) {
-            if((used & 1) == 1) {
-              used_count++;
-            }
-          used >>= 1;
-          }
-          /* Find least used item */
-          if(least_used_key == NULL || used_count < least_used_count) {
-            least_used_key = key;
-            least_used_count = used_count;
-            if(used_count == 0) { /* We won't find any least used item */
-              break;
-            }
-          }
-        }
-        key = list_item_next(key);
-      }
-    }
+  if(least_used_key == NULL) {
+    least_used_key = removable_key(policy->find_removable(reason, data));
+  }
+  finding_removable = 0;
 
-    if(least_used_key == NULL) {
-      /* We haven't found any unlocked item, allocation fails */
-      return NULL;
-    } else {
-      /* Reuse least used item */
-      remove_key(least_used_key);
-      return least_used_key;
-    }
+  if(least_used_key == NULL) {
+    /* We haven't found any unlocked item, allocation fails */
+    stats.failures++;
+    return NULL;
+  }
+  /* Reuse least used item */
+  if(reason < NBR_TABLE_NUM_REASONS) {
+    stats.evictions[reason]++;
   }
+  remove_key(least_used_key);
+#if !NBR_TABLE_LRU
+  /* Add neighbor back to list, as the newest */
+  list_add(nbr_table_keys, least_used_key);
+#endif /* !NBR_TABLE_LRU */
+  return least_used_key;
 }
 /*---------------------------------------------------------------------------*/
 /* Register a new neighbor table. To be used at initialization by modules
@@ -369,14 +633,19 @@ nbr_table_add_lladdr(nbr_table_t *table, const linkaddr_t *lladdr, nbr_table_rea
       return NULL;
     }
 
-    /* Add neighbor to list */
-    list_add(nbr_table_keys, key);
-
     /* Get index from newly allocated neighbor */
     index = index_from_key(key);
 
     /* Set link-layer address */
     linkaddr_copy(&key->lladdr, lladdr);
+#if NBR_TABLE_HASH
+    hash_add(index);
+#endif /* NBR_TABLE_HASH */
+#if NBR_TABLE_LRU
+    lru_append(index);
+  } else {
+    lru_touch(index);
+#endif /* NBR_TABLE_LRU */
   }
 
   /* Get item in the current table */
@@ -396,8 +665,16 @@ nbr_table_add_lladdr(nbr_table_t *table, const linkaddr_t *lladdr, nbr_table_rea
 void *
 nbr_table_get_from_lladdr(nbr_table_t *table, const linkaddr_t *lladdr)
 {
-  void *item = item_from_index(table, index_from_lladdr(lladdr));
-  return nbr_get_bit(used_map, table, item) ? item : NULL;
+  int index = index_from_lladdr(lladdr);
+  void *item = item_from_index(table, index);
+
+  if(!nbr_get_bit(used_map, table, item)) {
+    return NULL;
+  }
+#if NBR_TABLE_LRU
+  lru_touch(index);
+#endif /* NBR_TABLE_LRU */
+  return item;
 }
 /*---------------------------------------------------------------------------*/
 /* Removes a neighbor from the current table (unset "used" bit) */
@@ -406,6 +683,16 @@ nbr_table_remove(nbr_table_t *table, void *item)
 {
   int ret = nbr_set_bit(used_map, table, item, 0);
   nbr_set_bit(locked_map, table, item, 0);
+#if NBR_TABLE_LRU
+  if(ret) {
+    int index = index_from_item(table, item);
+    if(used_map[index] == 0 && index != lru_head) {
+      /* No table uses the neighbor any more, make it the first to go */
+      lru_unlink(index);
+      lru_prepend(index);
+    }
+  }
+#endif /* NBR_TABLE_LRU */
   return ret;
 }
 /*---------------------------------------------------------------------------*/
@@ -439,6 +726,49 @@ nbr_table_get_lladdr(nbr_table_t *table, const void *item)
   return key != NULL ? &key->lladdr : NULL;
 }
 /*---------------------------------------------------------------------------*/
+void
+nbr_table_set_policy(const nbr_table_policy_t *new_policy)
+{
+  if(new_policy != NULL) {
+    policy = new_policy;
+  }
+}
+/*---------------------------------------------------------------------------*/
+const nbr_table_policy_t *
+nbr_table_get_policy(void)
+{
+  return policy;
+}
+/*---------------------------------------------------------------------------*/
+void
+nbr_table_get_stats(nbr_table_stats_t *s)
+{
+  if(s != NULL) {
+    memcpy(s, &stats, sizeof(stats));
+  }
+}
+#if NBR_TABLE_LRU
+/*---------------------------------------------------------------------------*/
+const linkaddr_t *
+nbr_table_lru_head(void)
+{
+  return lru_unlocked_from(lru_head);
+}
+/*---------------------------------------------------------------------------*/
+const linkaddr_t *
+nbr_table_lru_next(const linkaddr_t *lladdr)
+{
+  nbr_table_key_t *key;
+
+  if(lladdr == NULL) {
+    return NULL;
+  }
+  /* The address is the one of a key returned by the walk */
+  key = (nbr_table_key_t *)((char *)lladdr - offsetof(nbr_table_key_t, lladdr));
+  return lru_unlocked_from(lru_next[index_from_key(key)]);
+}
+#endif /* NBR_TABLE_LRU */
+/*---------------------------------------------------------------------------*/
 #if DEBUG
 static void
 print_table()
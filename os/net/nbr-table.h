@@ -46,6 +46,43 @@
 #define NBR_TABLE_MAX_NEIGHBORS 8
 #endif /* NBR_TABLE_CONF_MAX_NEIGHBORS */
 
+/* Look neighbors up by link-layer address in a hash index instead of
+ * scanning the list of neighbors. This costs four bytes per neighbor and
+ * pays off with large tables, e.g. on border routers. */
+#ifdef NBR_TABLE_CONF_HASH
+#define NBR_TABLE_HASH NBR_TABLE_CONF_HASH
+#else /* NBR_TABLE_CONF_HASH */
+#define NBR_TABLE_HASH 0
+#endif /* NBR_TABLE_CONF_HASH */
+
+/* The eviction policy, which picks the neighbor to remove when a new
+ * neighbor is added to a full table. The default removes the oldest
+ * unlocked neighbor used by the fewest tables. */
+#ifdef NBR_TABLE_CONF_POLICY
+#define NBR_TABLE_POLICY NBR_TABLE_CONF_POLICY
+#else /* NBR_TABLE_CONF_POLICY */
+#define NBR_TABLE_POLICY nbr_table_policy_least_used
+#endif /* NBR_TABLE_CONF_POLICY */
+
+/* Keep the neighbors in least recently used order. This is what the
+ * LRU, link-quality and RPL policies build on, and is on by default
+ * when a policy is configured. Costs four bytes per neighbor. */
+#ifdef NBR_TABLE_CONF_LRU
+#define NBR_TABLE_LRU NBR_TABLE_CONF_LRU
+#elif defined(NBR_TABLE_CONF_POLICY)
+#define NBR_TABLE_LRU 1
+#else /* NBR_TABLE_CONF_LRU */
+#define NBR_TABLE_LRU 0
+#endif /* NBR_TABLE_CONF_LRU */
+
+/* The number of least recently used neighbors among which the
+ * link-quality and RPL policies pick the one to remove */
+#ifdef NBR_TABLE_CONF_POLICY_CANDIDATES
+#define NBR_TABLE_POLICY_CANDIDATES NBR_TABLE_CONF_POLICY_CANDIDATES
+#else /* NBR_TABLE_CONF_POLICY_CANDIDATES */
+#define NBR_TABLE_POLICY_CANDIDATES 4
+#endif /* NBR_TABLE_CONF_POLICY_CANDIDATES */
+
 /* An item in a neighbor table */
 typedef void nbr_table_item_t;
 
@@ -89,6 +126,33 @@ typedef enum {
   NBR_TABLE_REASON_SIXTOP,
 } nbr_table_reason_t;
 
+#define NBR_TABLE_NUM_REASONS (NBR_TABLE_REASON_SIXTOP + 1)
+
+/** \brief An eviction policy for full neighbor tables */
+typedef struct nbr_table_policy {
+  const char *name;
+  /* Returns the link-layer address of the neighbor to remove so that a
+   * new one can be added for the given reason, or NULL to refuse it */
+  const linkaddr_t *(*find_removable)(nbr_table_reason_t reason, void *data);
+} nbr_table_policy_t;
+
+/** \brief Eviction statistics */
+typedef struct nbr_table_stats {
+  /* Neighbors removed to make room, by reason of the addition */
+  uint32_t evictions[NBR_TABLE_NUM_REASONS];
+  /* How many of the removed neighbors were locked */
+  uint32_t locked_evictions;
+  /* Additions that failed for lack of room */
+  uint32_t failures;
+} nbr_table_stats_t;
+
+/* Remove the oldest unlocked neighbor used by the fewest tables */
+extern const nbr_table_policy_t nbr_table_policy_least_used;
+#if NBR_TABLE_LRU
+/* Remove the least recently used unlocked neighbor */
+extern const nbr_table_policy_t nbr_table_policy_lru;
+#endif /* NBR_TABLE_LRU */
+
 /** \name Neighbor tables: register and loop through table elements */
 /** @{ */
 int nbr_table_register(nbr_table_t *table, nbr_table_callback *callback);
@@ -115,4 +179,17 @@ int nbr_table_unlock(nbr_table_t *table, nbr_table_item_t *item);
 linkaddr_t *nbr_table_get_lladdr(nbr_table_t *table, const nbr_table_item_t *item);
 /** @} */
 
+/** \name Neighbor tables: eviction */
+/** @{ */
+void nbr_table_set_policy(const nbr_table_policy_t *policy);
+const nbr_table_policy_t *nbr_table_get_policy(void);
+void nbr_table_get_stats(nbr_table_stats_t *stats);
+#if NBR_TABLE_LRU
+/* Walk the unlocked neighbors from the least recently used one. Looking
+ * neighbors up from a policy does not change their order. */
+const linkaddr_t *nbr_table_lru_head(void);
+const linkaddr_t *nbr_table_lru_next(const linkaddr_t *lladdr);
+#endif /* NBR_TABLE_LRU */
+/** @} */
+
 #endif /* NBR_TABLE_H_ */
@@ -228,9 +228,16 @@ enum {
   PACKETBUF_ATTR_TSCH_SLOTFRAME,
   PACKETBUF_ATTR_TSCH_TIMESLOT,
 #endif /* TSCH_WITH_LINK_SELECTOR */
+#if TSCH_QUEUE_NUM_PRIORITIES > 1
+  PACKETBUF_ATTR_TSCH_PRIORITY,
+#endif /* TSCH_QUEUE_NUM_PRIORITIES > 1 */
+#if TSCH_QUEUE_WITH_DEADLINE
+  PACKETBUF_ATTR_TSCH_DEADLINE,
+#endif /* TSCH_QUEUE_WITH_DEADLINE */
 
   /* Scope 1 attributes: used between two neighbors only. */
   PACKETBUF_ATTR_FRAME_TYPE,
+  PACKETBUF_ATTR_PENDING,
 #if LLSEC802154_USES_AUX_HEADER
   PACKETBUF_ATTR_SECURITY_LEVEL,
 #endif /* LLSEC802154_USES_AUX_HEADER */
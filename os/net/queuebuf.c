@@ -54,6 +54,8 @@
 /* Structure pointing to a buffer either stored
    in RAM or swapped in CFS */
 struct queuebuf {
+  /* The number of holders of the buffer */
+  uint8_t refs;
 #if QUEUEBUF_DEBUG
   struct queuebuf *next;
   const char *file;
@@ -135,6 +137,8 @@ LIST(queuebuf_list);
 uint8_t queuebuf_len, queuebuf_max_len;
 #endif /* QUEUEBUF_STATS */
 
+static struct queuebuf_stats stats;
+
 #if WITH_SWAP
 /*---------------------------------------------------------------------------*/
 static void
@@ -289,6 +293,7 @@ queuebuf_init(void)
 #endif
   memb_init(&buframmem);
   memb_init(&bufmem);
+  memset(&stats, 0, sizeof(stats));
 #if QUEUEBUF_STATS
   queuebuf_max_len = 0;
 #endif /* QUEUEBUF_STATS */
@@ -335,6 +340,7 @@ queuebuf_new_from_packetbuf(void)
     if(buf->ram_ptr == NULL) {
       PRINTF("queuebuf_new_from_packetbuf: could not queuebuf data\n");
       memb_free(&bufmem, buf);
+      stats.failures++;
       return NULL;
     }
     buframptr = buf->ram_ptr;
@@ -348,11 +354,18 @@ queuebuf_new_from_packetbuf(void)
       if(queuebuf_flush_tmpdata() == -1) {
         /* We were unable to write the data in the swap */
         memb_free(&bufmem, buf);
+        stats.failures++;
         return NULL;
       }
     }
 #endif
 
+    buf->refs = 1;
+    stats.allocations++;
+    if(++stats.in_use > stats.max_in_use) {
+      stats.max_in_use = stats.in_use;
+    }
+
 #if QUEUEBUF_STATS
     ++queuebuf_len;
     PRINTF("#A q=%d\n", queuebuf_len);
@@ -363,6 +376,7 @@ queuebuf_new_from_packetbuf(void)
 
   } else {
     PRINTF("queuebuf_new_from_packetbuf: could not allocate a queuebuf\n");
+    stats.failures++;
   }
   return buf;
 }
@@ -392,10 +406,26 @@ queuebuf_update_from_packetbuf(struct queuebuf *buf)
 #endif
 }
 /*---------------------------------------------------------------------------*/
+struct queuebuf *
+queuebuf_ref(struct queuebuf *buf)
+{
+  if(!memb_inmemb(&bufmem, buf) || buf->refs == 0 || buf->refs == UINT8_MAX) {
+    return NULL;
+  }
+  buf->refs++;
+  stats.references++;
+  return buf;
+}
+/*---------------------------------------------------------------------------*/
 void
 queuebuf_free(struct queuebuf *buf)
 {
-  if(memb_inmemb(&bufmem, buf)) {
+  if(memb_inmemb(&bufmem, buf) && buf->refs > 0) {
+    if(--buf->refs > 0) {
+      /* Still held elsewhere */
+      return;
+    }
+    stats.in_use--;
 #if WITH_SWAP
     if(buf->location == IN_RAM) {
       memb_free(&buframmem, buf->ram_ptr);
@@ -426,6 +456,16 @@ queuebuf_to_packetbuf(struct queuebuf *b)
   }
 }
 /*---------------------------------------------------------------------------*/
+void
+queuebuf_attr_to_packetbuf(struct queuebuf *b)
+{
+  if(memb_inmemb(&bufmem, b)) {
+    struct queuebuf_data *buframptr = queuebuf_load_to_ram(b);
+    packetbuf_clear();
+    packetbuf_attr_copyfrom(buframptr->attrs, buframptr->addrs);
+  }
+}
+/*---------------------------------------------------------------------------*/
 void *
 queuebuf_dataptr(struct queuebuf *b)
 {
@@ -458,6 +498,12 @@ queuebuf_attr(struct queuebuf *b, uint8_t type)
 }
 /*---------------------------------------------------------------------------*/
 void
+queuebuf_get_stats(struct queuebuf_stats *s)
+{
+  memcpy(s, &stats, sizeof(stats));
+}
+/*---------------------------------------------------------------------------*/
+void
 queuebuf_debug_print(void)
 {
 #if QUEUEBUF_DEBUG
@@ -48,6 +48,16 @@
  *
  * The queuebuf module handles buffers that are queued.
  *
+ * A queuebuf is reference counted, so that the same frame can sit in
+ * several queues, for instance a broadcast that goes out in the queue of
+ * each neighbor, without being copied. Every holder obtained from
+ * queuebuf_new_from_packetbuf() or queuebuf_ref() calls queuebuf_free()
+ * once, and the buffer returns to the pool with the last call.
+ *
+ * The MAC layers transmit frames straight from their queuebuf, and only
+ * restore its attributes to packetbuf for the sent callback, with
+ * queuebuf_attr_to_packetbuf().
+ *
  */
 
 #ifndef QUEUEBUF_H_
@@ -93,6 +103,15 @@
 
 struct queuebuf;
 
+/* Allocation statistics of the queuebuf pool */
+struct queuebuf_stats {
+  uint16_t in_use;       /* queuebufs currently allocated */
+  uint16_t max_in_use;   /* the most queuebufs allocated at once */
+  uint32_t allocations;  /* successful allocations */
+  uint32_t failures;     /* allocations that found the pool empty */
+  uint32_t references;   /* extra references taken with queuebuf_ref() */
+};
+
 void queuebuf_init(void);
 
 #if QUEUEBUF_DEBUG
@@ -101,10 +120,37 @@ struct queuebuf *queuebuf_new_from_packetbuf_debug(const char *file, int line);
 #else /* QUEUEBUF_DEBUG */
 struct queuebuf *queuebuf_new_from_packetbuf(void);
 #endif /* QUEUEBUF_DEBUG */
+/* The updates are seen by every holder of a shared queuebuf */
 void queuebuf_update_attr_from_packetbuf(struct queuebuf *b);
 void queuebuf_update_from_packetbuf(struct queuebuf *b);
 
 void queuebuf_to_packetbuf(struct queuebuf *b);
+
+/**
+ * \brief      Clear packetbuf and restore the attributes of a queuebuf
+ * \param b    The queuebuf
+ *
+ *             Unlike queuebuf_to_packetbuf(), the frame itself is not
+ *             copied, for callers that only need its attributes and
+ *             addresses, such as the sent callbacks of the MAC layers.
+ */
+void queuebuf_attr_to_packetbuf(struct queuebuf *b);
+
+/**
+ * \brief      Take another reference to a queuebuf
+ * \param b    The queuebuf
+ * \return     b, or NULL if b is not an allocated queuebuf or has
+ *             too many references
+ *
+ *             The frame is shared rather than copied, and stays
+ *             allocated until queuebuf_free() was called once more.
+ */
+struct queuebuf *queuebuf_ref(struct queuebuf *b);
+
+/**
+ * \brief      Drop a reference to a queuebuf, freeing it with the last one
+ * \param b    The queuebuf
+ */
 void queuebuf_free(struct queuebuf *b);
 
 void *queuebuf_dataptr(struct queuebuf *b);
@@ -117,6 +163,12 @@ void queuebuf_debug_print(void);
 
 int queuebuf_numfree(void);
 
+/**
+ * \brief       Get the allocation statistics of the queuebuf pool
+ * \param stats Filled with the statistics
+ */
+void queuebuf_get_stats(struct queuebuf_stats *stats);
+
 #endif /* __QUEUEBUF_H__ */
 
 /** @} */
@@ -275,6 +275,41 @@ count_matching_bytes(const void *p1, const void *p2, size_t n)
   return n;
 }
 /*---------------------------------------------------------------------------*/
+#if UIP_SR_SRH_CACHE_SIZE > 0
+/* Used by insert_srh_header to insert a source routing header that was
+ * built for a previous packet to the same destination. Returns 1 on success,
+ * 0 on failure. */
+static int
+insert_cached_srh_header(const uint8_t *srh, uint8_t ext_len,
+                         const uip_ipaddr_t *next_hop)
+{
+  struct uip_routing_hdr *rh_hdr = (struct uip_routing_hdr *)UIP_IP_PAYLOAD(0);
+
+  /* Check if there is enough space to store the extension header */
+  if(uip_len + ext_len > UIP_LINK_MTU) {
+    LOG_ERR("Packet too long: impossible to add source routing header (%u bytes)\n", ext_len);
+    return 0;
+  }
+
+  /* Move existing ext headers and payload ext_len further */
+  memmove(uip_buf + UIP_IPH_LEN + uip_ext_len + ext_len,
+      uip_buf + UIP_IPH_LEN + uip_ext_len, uip_len - UIP_IPH_LEN);
+
+  /* Insert the cached source routing header (as first ext header) */
+  memcpy(rh_hdr, srh, ext_len);
+  rh_hdr->next = UIP_IP_BUF->proto;
+  UIP_IP_BUF->proto = UIP_PROTO_ROUTING;
+
+  uip_ipaddr_copy(&UIP_IP_BUF->destipaddr, next_hop);
+
+  /* Update the IPv6 length field */
+  uipbuf_add_ext_hdr(ext_len);
+  uipbuf_set_len_field(UIP_IP_BUF, uip_len - UIP_IPH_LEN);
+
+  return 1;
+}
+#endif /* UIP_SR_SRH_CACHE_SIZE > 0 */
+/*---------------------------------------------------------------------------*/
 static int
 insert_srh_header(void)
 {
@@ -289,6 +324,9 @@ insert_srh_header(void)
   uip_sr_node_t *node;
   rpl_dag_t *dag;
   uip_ipaddr_t node_addr;
+#if UIP_SR_SRH_CACHE_SIZE > 0
+  const uint8_t *cached_srh;
+#endif /* UIP_SR_SRH_CACHE_SIZE > 0 */
 
   /* Always insest SRH as first extension header */
   struct uip_routing_hdr *rh_hdr = (struct uip_routing_hdr *)UIP_IP_PAYLOAD(0);
@@ -308,6 +346,15 @@ insert_srh_header(void)
     return 0;
   }
 
+#if UIP_SR_SRH_CACHE_SIZE > 0
+  cached_srh = uip_sr_srh_cache_lookup(dag, &UIP_IP_BUF->destipaddr,
+                                       &node_addr, &ext_len);
+  if(cached_srh != NULL) {
+    LOG_DBG("SRH found in cache\n");
+    return insert_cached_srh_header(cached_srh, ext_len, &node_addr);
+  }
+#endif /* UIP_SR_SRH_CACHE_SIZE > 0 */
+
   dest_node = uip_sr_get_node(dag, &UIP_IP_BUF->destipaddr);
   if(dest_node == NULL) {
     /* The destination is not found, skip SRH insertion */
@@ -403,6 +450,10 @@ insert_srh_header(void)
 
   /* The next hop (i.e. node whose parent is the root) is placed as the current IPv6 destination */
   NETSTACK_ROUTING.get_sr_node_ipaddr(&node_addr, node);
+#if UIP_SR_SRH_CACHE_SIZE > 0
+  uip_sr_srh_cache_add(dag, &UIP_IP_BUF->destipaddr, &node_addr,
+                       (const uint8_t *)rh_hdr, ext_len);
+#endif /* UIP_SR_SRH_CACHE_SIZE > 0 */
   uip_ipaddr_copy(&UIP_IP_BUF->destipaddr, &node_addr);
 
   /* Update the IPv6 length field */
@@ -152,5 +152,66 @@ rpl_nbr_policy_find_removable(nbr_table_reason_t reason, void *data)
       return NULL;
   }
 }
+#if NBR_TABLE_LRU
+/*---------------------------------------------------------------------------*/
+/* Among the least recently used neighbors, pick the one that matters
+ * least to RPL: a neighbor that RPL does not know, else the one with the
+ * worst rank. The preferred parent and the next hops of routes are
+ * locked, so they are never candidates. */
+static const linkaddr_t *
+find_removable_lru(nbr_table_reason_t reason, void *data)
+{
+  const linkaddr_t *lladdr;
+  const linkaddr_t *worst_lladdr = NULL;
+  rpl_nbr_t *worst_nbr = NULL;
+  rpl_rank_t worst_nbr_rank = 0;
+  int i;
+
+  for(lladdr = nbr_table_lru_head(), i = 0;
+      lladdr != NULL && i < NBR_TABLE_POLICY_CANDIDATES;
+      lladdr = nbr_table_lru_next(lladdr), i++) {
+    rpl_nbr_t *nbr = rpl_neighbor_get_from_lladdr((uip_lladdr_t *)lladdr);
+    rpl_rank_t nbr_rank;
+    if(nbr == NULL) {
+      return lladdr;
+    }
+    nbr_rank = rpl_neighbor_rank_via_nbr(nbr);
+    if(worst_lladdr == NULL || nbr_rank > worst_nbr_rank) {
+      worst_lladdr = lladdr;
+      worst_nbr = nbr;
+      worst_nbr_rank = nbr_rank;
+    }
+  }
+
+  if(worst_lladdr == NULL) {
+    return NULL;
+  }
+
+  switch(reason) {
+    case NBR_TABLE_REASON_RPL_DIO: {
+      rpl_dio_t *dio = data;
+      /* Replace an RPL neighbor only with a clearly better one */
+      if(!curr_instance.used || curr_instance.instance_id != dio->instance_id
+         || dio->rank + curr_instance.min_hoprankinc
+            >= worst_nbr_rank - curr_instance.min_hoprankinc / 2) {
+        LOG_DBG("nbr-policy: DIO rank %u, worst_rank %u -- do not add to cache\n",
+                dio->rank, worst_nbr_rank);
+        return NULL;
+      }
+      return worst_lladdr;
+    }
+    case NBR_TABLE_REASON_RPL_DIS:
+    case NBR_TABLE_REASON_IPV6_ND_AUTOFILL:
+      return worst_lladdr;
+    default:
+      /* Other additions may not push out a parent */
+      return rpl_neighbor_is_parent(worst_nbr) ? NULL : worst_lladdr;
+  }
+}
+const nbr_table_policy_t rpl_nbr_policy = {
+  "rpl",
+  find_removable_lru
+};
+#endif /* NBR_TABLE_LRU */
 /*---------------------------------------------------------------------------*/
 /** @}*/
@@ -64,6 +64,11 @@
 extern rpl_instance_t curr_instance;
 /* The RPL multicast address (used for DIS and DIO) */
 extern uip_ipaddr_t rpl_multicast_addr;
+#if NBR_TABLE_LRU
+/* Neighbor table eviction policy that removes, among the least recently
+ * used neighbors, the one that matters least to RPL */
+extern const nbr_table_policy_t rpl_nbr_policy;
+#endif /* NBR_TABLE_LRU */
 
 /********** Public functions **********/
 
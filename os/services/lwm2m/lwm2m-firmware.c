@@ -39,6 +39,7 @@
 #include "lwm2m-engine.h"
 #include "lwm2m-firmware.h"
 #include "coap.h"
+#include "coap-block-window.h"
 #include <inttypes.h>
 #include <string.h>
 
@@ -72,6 +73,15 @@ static uint8_t result = RESULT_DEFAULT;
 
 static lwm2m_object_instance_t reg_object;
 
+static lwm2m_firmware_writer_t firmware_writer;
+
+/* The blocks of the package written so far */
+static coap_block_tracker_t package_blocks;
+
+/* The download from the Package URI */
+static coap_block_window_request_t download;
+static char package_uri[LWM2M_FIRMWARE_URI_SIZE];
+
 static const lwm2m_resource_id_t resources[] =
   { WO(UPDATE_PACKAGE),
     WO(UPDATE_PACKAGE_URI),
@@ -80,6 +90,108 @@ static const lwm2m_resource_id_t resources[] =
     EX(UPDATE_UPDATE)
   };
 
+/*---------------------------------------------------------------------------*/
+static void
+set_state(uint8_t new_state, uint8_t new_result)
+{
+  if(new_state != state) {
+    state = new_state;
+    lwm2m_notify_object_observers(&reg_object, UPDATE_STATE);
+  }
+  if(new_result != result) {
+    result = new_result;
+    lwm2m_notify_object_observers(&reg_object, UPDATE_RESULT);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static int
+write_package(uint32_t offset, const uint8_t *data, uint16_t len)
+{
+  if(firmware_writer != NULL && !firmware_writer(offset, data, len)) {
+    LOG_WARN("Could not store %u bytes at %"PRIu32"\n", len, offset);
+    set_state(STATE_IDLE, RESULT_NO_STORAGE);
+    return 0;
+  }
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static void
+download_callback(coap_block_window_request_t *request, uint32_t offset,
+                  const uint8_t *data, uint16_t len)
+{
+  switch(request->status) {
+  case COAP_REQUEST_STATUS_MORE:
+    if(!write_package(offset, data, len)) {
+      coap_block_window_cancel(request);
+    }
+    break;
+  case COAP_REQUEST_STATUS_FINISHED:
+    LOG_INFO("Firmware downloaded: %"PRIu32" blocks, %"PRIu32
+             " out of order, %"PRIu32" retransmitted\n",
+             request->blocks, request->out_of_order,
+             request->retransmissions);
+    set_state(STATE_DOWNLOADED, RESULT_DEFAULT);
+    break;
+  case COAP_REQUEST_STATUS_BLOCK_ERROR:
+    LOG_WARN("Firmware download failed: %u\n", request->response_code);
+    set_state(STATE_IDLE, request->response_code == NOT_FOUND_4_04
+              ? RESULT_INVALID_URI : RESULT_CONNECTION_LOST);
+    break;
+  default:
+    LOG_WARN("Firmware download timed out\n");
+    set_state(STATE_IDLE, RESULT_CONNECTION_LOST);
+    break;
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Download the package from a coap:// URI, with the blocks pipelined */
+static void
+start_download(const uint8_t *uri, int len)
+{
+  coap_endpoint_t endpoint;
+  const char *path;
+
+  coap_block_window_cancel(&download);
+
+  if(len == 0) {
+    /* An empty URI cancels the update */
+    set_state(STATE_IDLE, RESULT_DEFAULT);
+    return;
+  }
+  if(len >= sizeof(package_uri)) {
+    set_state(STATE_IDLE, RESULT_INVALID_URI);
+    return;
+  }
+  memcpy(package_uri, uri, len);
+  package_uri[len] = '\0';
+
+  /* The path follows the authority, which may hold an IPv6 address */
+  path = strstr(package_uri, "://");
+  if(path != NULL) {
+    path += 3;
+    if(*path == '[') {
+      path = strchr(path, ']');
+    }
+    if(path != NULL) {
+      path = strchr(path, '/');
+    }
+  }
+  if(path == NULL || path[1] == '\0'
+     || !coap_endpoint_parse(package_uri, path - package_uri, &endpoint)) {
+    LOG_WARN("Invalid package URI: %s\n", package_uri);
+    set_state(STATE_IDLE, RESULT_INVALID_URI);
+    return;
+  }
+
+  LOG_INFO("Downloading firmware from %s\n", package_uri);
+  coap_block_tracker_init(&package_blocks);
+  if(!coap_block_window_get(&download, &endpoint, path + 1, COAP_TYPE_CON,
+                            COAP_BLOCK_WINDOW_SIZE, download_callback)) {
+    set_state(STATE_IDLE, RESULT_OUT_OF_MEM);
+    return;
+  }
+  set_state(STATE_DOWNLOADING, RESULT_DEFAULT);
+}
 /*---------------------------------------------------------------------------*/
 static lwm2m_status_t
 lwm2m_callback(lwm2m_object_instance_t *object,
@@ -122,10 +234,32 @@ lwm2m_callback(lwm2m_object_instance_t *object,
       /* The firmware is written */
       LOG_DBG("Firmware received: %"PRIu32" %d fin:%d\n", ctx->offset,
               (int)ctx->inbuf->size, lwm2m_object_is_final_incoming(ctx));
-      if(lwm2m_object_is_final_incoming(ctx)) {
-        state = STATE_DOWNLOADED;
-      } else {
-        state = STATE_DOWNLOADING;
+      if(!coap_get_header_block1(ctx->request, &num, &more, NULL, NULL)) {
+        /* The whole package in one message */
+        num = 0;
+        more = 0;
+      }
+      if(state != STATE_DOWNLOADING
+         || (num == 0 && package_blocks.base > 0)) {
+        /* The first block to arrive starts a new package. So does the
+           first block once received: the server restarted the push, and
+           the blocks received so far may belong to another package. */
+        coap_block_window_cancel(&download);
+        coap_block_tracker_init(&package_blocks);
+        set_state(STATE_DOWNLOADING, RESULT_DEFAULT);
+      }
+      /* Blocks may be pipelined by the server and arrive in any order */
+      switch(coap_block_tracker_add(&package_blocks, num, more)) {
+      case -1:
+        return LWM2M_STATUS_ERROR;
+      case 1:
+        if(!write_package(ctx->offset, ctx->inbuf->buffer, ctx->inbuf->size)) {
+          return LWM2M_STATUS_ERROR;
+        }
+        break;
+      }
+      if(coap_block_tracker_is_complete(&package_blocks)) {
+        set_state(STATE_DOWNLOADED, RESULT_DEFAULT);
       }
       return LWM2M_STATUS_OK;
     case UPDATE_PACKAGE_URI:
@@ -140,6 +274,7 @@ lwm2m_callback(lwm2m_object_instance_t *object,
         }
         LOG_DBG_("'\n");
       }
+      start_download(ctx->inbuf->buffer, ctx->inbuf->size);
       return LWM2M_STATUS_OK;
     }
   } else if(ctx->operation == LWM2M_OP_EXECUTE && ctx->resource_id == UPDATE_UPDATE) {
@@ -152,6 +287,12 @@ lwm2m_callback(lwm2m_object_instance_t *object,
   return LWM2M_STATUS_ERROR;
 }
 
+/*---------------------------------------------------------------------------*/
+void
+lwm2m_firmware_set_writer(lwm2m_firmware_writer_t writer)
+{
+  firmware_writer = writer;
+}
 /*---------------------------------------------------------------------------*/
 void
 lwm2m_firmware_init(void)
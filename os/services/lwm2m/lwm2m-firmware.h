@@ -39,7 +39,22 @@
 #ifndef LWM2M_FIRMWARE_H_
 #define LWM2M_FIRMWARE_H_
 
+#include "contiki.h"
+
+/* The longest Package URI that can be downloaded from */
+#ifdef LWM2M_FIRMWARE_CONF_URI_SIZE
+#define LWM2M_FIRMWARE_URI_SIZE LWM2M_FIRMWARE_CONF_URI_SIZE
+#else /* LWM2M_FIRMWARE_CONF_URI_SIZE */
+#define LWM2M_FIRMWARE_URI_SIZE 64
+#endif /* LWM2M_FIRMWARE_CONF_URI_SIZE */
+
+/* Stores a part of the firmware package. The parts may arrive in any
+ * order, as blocks are pipelined. Returns 0 if the part cannot be stored. */
+typedef int (* lwm2m_firmware_writer_t)(uint32_t offset, const uint8_t *data,
+                                        uint16_t len);
+
 void lwm2m_firmware_init(void);
+void lwm2m_firmware_set_writer(lwm2m_firmware_writer_t writer);
 
 #endif /* LWM2M_FIRMWARE_H_ */
 /** @} */
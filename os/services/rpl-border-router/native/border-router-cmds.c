@@ -108,6 +108,28 @@ dectoi(const uint8_t *buf, int len, int *v)
   return buf;
 }
 /*---------------------------------------------------------------------------*/
+static void
+print_tx_stat(void)
+{
+  const struct border_router_mac_stats *stats = border_router_mac_get_stats();
+  unsigned long reported = stats->acked + stats->failed;
+
+  printf("frames sent to radio: %lu (%lu queued for credits)\n",
+         stats->sent, stats->queued);
+  printf("frames acked: %lu failed: %lu lost: %lu dropped: %lu\n",
+         stats->acked, stats->failed, stats->lost, stats->dropped);
+  printf("window: %u in flight: %u (max %u) pending: %u\n",
+         stats->window, stats->in_flight, stats->max_in_flight,
+         stats->pending);
+  printf("send-to-report latency avg: %lu ms max: %lu ms\n",
+         reported > 0 ? (unsigned long)(stats->latency_total * 1000 /
+                                        CLOCK_SECOND / reported) : 0,
+         (unsigned long)(stats->latency_max * 1000 / CLOCK_SECOND));
+  if(stats->unexpected > 0) {
+    printf("unexpected reports: %lu\n", stats->unexpected);
+  }
+}
+/*---------------------------------------------------------------------------*/
 
 /*---------------------------------------------------------------------------*/
 /* TODO: the below code needs some way of identifying from where the command */
@@ -170,6 +192,10 @@ border_router_cmd_handler(const uint8_t *data, int len)
                data[2], data[3], data[4]);
         packet_sent(data[2], data[3], data[4]);
         return 1;
+      case 'W':
+        LOG_DBG("Radio grants %d credits\n", data[2]);
+        border_router_mac_set_window(data[2]);
+        return 1;
       default:
       return 0;
       }
@@ -202,6 +228,9 @@ border_router_cmd_handler(const uint8_t *data, int len)
     } else if(data[1] == 'S') {
       border_router_print_stat();
       return 1;
+    } else if(data[1] == 'T' && command_context == CMD_CONTEXT_STDIO) {
+      print_tx_stat();
+      return 1;
     }
   }
   return 0;
@@ -42,6 +42,8 @@
 #include "net/netstack.h"
 #include "packetutils.h"
 #include "border-router.h"
+#include "lib/list.h"
+#include "lib/memb.h"
 #include <string.h>
 
 /*---------------------------------------------------------------------------*/
@@ -51,7 +53,20 @@
 #define LOG_LEVEL LOG_LEVEL_NONE
 
 #define MAX_CALLBACKS 16
-static int callback_pos;
+
+/* The number of frames waiting for the radio to grant credits */
+#ifdef BORDER_ROUTER_MAC_CONF_QUEUE_SIZE
+#define QUEUE_SIZE BORDER_ROUTER_MAC_CONF_QUEUE_SIZE
+#else
+#define QUEUE_SIZE QUEUEBUF_NUM
+#endif
+
+/* How long to wait for the radio to report on a frame */
+#ifdef BORDER_ROUTER_MAC_CONF_TX_TIMEOUT
+#define TX_TIMEOUT BORDER_ROUTER_MAC_CONF_TX_TIMEOUT
+#else
+#define TX_TIMEOUT (5 * CLOCK_SECOND)
+#endif
 
 /* a structure for calling back when packet data is coming back
    from radio... */
@@ -60,9 +75,34 @@ struct tx_callback {
   void *ptr;
   struct packetbuf_attr attrs[PACKETBUF_NUM_ATTRS];
   struct packetbuf_addr addrs[PACKETBUF_NUM_ADDRS];
+  clock_time_t sent_time;
+  uint8_t in_use;
+};
+
+/* A frame that is ready to be sent but waits for a credit */
+struct tx_pending {
+  struct tx_pending *next;
+  struct queuebuf *buf;
+  mac_callback_t cback;
+  void *ptr;
 };
 /*---------------------------------------------------------------------------*/
 static struct tx_callback callbacks[MAX_CALLBACKS];
+static int callback_pos;
+
+/* The number of frames the radio accepts before reporting on any of
+   them. Radios that do not advertise credits get one per session id. */
+static uint8_t window = MAX_CALLBACKS;
+static uint8_t in_flight;
+
+MEMB(pending_memb, struct tx_pending, QUEUE_SIZE);
+LIST(pending_list);
+
+static struct ctimer timeout_timer;
+
+static struct border_router_mac_stats stats;
+
+static void tx_timeout(void *ptr);
 /*---------------------------------------------------------------------------*/
 void
 init_sec(void)
@@ -77,29 +117,23 @@ init_sec(void)
 #endif
 }
 /*---------------------------------------------------------------------------*/
-
-void
-packet_sent(uint8_t sessionid, uint8_t status, uint8_t tx)
-{
-  if(sessionid < MAX_CALLBACKS) {
-    struct tx_callback *callback;
-    callback = &callbacks[sessionid];
-    packetbuf_clear();
-    packetbuf_attr_copyfrom(callback->attrs, callback->addrs);
-    mac_call_sent_callback(callback->cback, callback->ptr, status, tx);
-  } else {
-    LOG_ERR("Session id to high (%d)\n", sessionid);
-  }
-}
-/*---------------------------------------------------------------------------*/
 static int
 setup_callback(mac_callback_t sent, void *ptr)
 {
   struct tx_callback *callback;
-  int tmp = callback_pos;
+  int tmp;
+
+  /* Skip session ids that the radio has not reported on yet */
+  while(callbacks[callback_pos].in_use) {
+    callback_pos = (callback_pos + 1) % MAX_CALLBACKS;
+  }
+
+  tmp = callback_pos;
   callback = &callbacks[callback_pos];
   callback->cback = sent;
   callback->ptr = ptr;
+  callback->sent_time = clock_time();
+  callback->in_use = 1;
   packetbuf_attr_copyto(callback->attrs, callback->addrs);
 
   callback_pos++;
@@ -110,14 +144,151 @@ setup_callback(mac_callback_t sent, void *ptr)
   return tmp;
 }
 /*---------------------------------------------------------------------------*/
+/* Send the framed packet in packetbuf to the radio */
 static void
-send_packet(mac_callback_t sent, void *ptr)
+transmit(mac_callback_t sent, void *ptr)
 {
   int size;
   /* 3 bytes per packet attribute is required for serialization */
   uint8_t buf[PACKETBUF_NUM_ATTRS * 3 + PACKETBUF_SIZE + 3];
   uint8_t sid;
 
+  /* here we send the data over SLIP to the radio-chip */
+  size = 0;
+#if SERIALIZE_ATTRIBUTES
+  size = packetutils_serialize_atts(&buf[3], sizeof(buf) - 3);
+#endif
+  if(size < 0 || size + packetbuf_totlen() + 3 > sizeof(buf)) {
+    LOG_WARN("send failed, too large header\n");
+    stats.dropped++;
+    mac_call_sent_callback(sent, ptr, MAC_TX_ERR_FATAL, 1);
+  } else {
+    sid = setup_callback(sent, ptr);
+
+    buf[0] = '!';
+    buf[1] = 'S';
+    buf[2] = sid; /* sequence or session number for this packet */
+
+    /* Copy packet data */
+    memcpy(&buf[3 + size], packetbuf_hdrptr(), packetbuf_totlen());
+
+    write_to_slip(buf, packetbuf_totlen() + size + 3);
+
+    stats.sent++;
+    in_flight++;
+    if(in_flight > stats.max_in_flight) {
+      stats.max_in_flight = in_flight;
+    }
+    if(ctimer_expired(&timeout_timer)) {
+      ctimer_set(&timeout_timer, TX_TIMEOUT, tx_timeout, NULL);
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Send the queued frames for which the radio has credits */
+static void
+transmit_pending(void)
+{
+  struct tx_pending *p;
+
+  while(in_flight < window && (p = list_pop(pending_list)) != NULL) {
+    queuebuf_to_packetbuf(p->buf);
+    queuebuf_free(p->buf);
+    transmit(p->cback, p->ptr);
+    memb_free(&pending_memb, p);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+report(uint8_t sessionid, uint8_t status, uint8_t tx)
+{
+  struct tx_callback *callback;
+
+  callback = &callbacks[sessionid];
+  callback->in_use = 0;
+  in_flight--;
+
+  packetbuf_clear();
+  packetbuf_attr_copyfrom(callback->attrs, callback->addrs);
+  mac_call_sent_callback(callback->cback, callback->ptr, status, tx);
+}
+/*---------------------------------------------------------------------------*/
+static void
+tx_timeout(void *ptr)
+{
+  clock_time_t now = clock_time();
+  clock_time_t next = TX_TIMEOUT;
+  int i;
+
+  for(i = 0; i < MAX_CALLBACKS; i++) {
+    if(callbacks[i].in_use) {
+      if(now - callbacks[i].sent_time >= TX_TIMEOUT) {
+        /* The report got lost: free the credit and let the upper
+           layer decide what to do about the frame */
+        LOG_WARN("no report for sid %d\n", i);
+        stats.lost++;
+        report(i, MAC_TX_ERR, 1);
+      } else if(TX_TIMEOUT - (now - callbacks[i].sent_time) < next) {
+        next = TX_TIMEOUT - (now - callbacks[i].sent_time);
+      }
+    }
+  }
+
+  if(in_flight > 0) {
+    ctimer_set(&timeout_timer, next, tx_timeout, NULL);
+  }
+  transmit_pending();
+}
+/*---------------------------------------------------------------------------*/
+void
+packet_sent(uint8_t sessionid, uint8_t status, uint8_t tx)
+{
+  clock_time_t latency;
+
+  if(sessionid >= MAX_CALLBACKS) {
+    LOG_ERR("Session id to high (%d)\n", sessionid);
+  } else if(!callbacks[sessionid].in_use) {
+    LOG_WARN("Unexpected report for sid %d\n", sessionid);
+    stats.unexpected++;
+  } else {
+    latency = clock_time() - callbacks[sessionid].sent_time;
+    stats.latency_total += latency;
+    if(latency > stats.latency_max) {
+      stats.latency_max = latency;
+    }
+    if(status == MAC_TX_OK) {
+      stats.acked++;
+    } else {
+      stats.failed++;
+    }
+
+    report(sessionid, status, tx);
+    transmit_pending();
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+border_router_mac_set_window(uint8_t credits)
+{
+  LOG_INFO("radio grants %u credits\n", credits);
+  window = MIN(MAX(credits, 1), MAX_CALLBACKS);
+  transmit_pending();
+}
+/*---------------------------------------------------------------------------*/
+const struct border_router_mac_stats *
+border_router_mac_get_stats(void)
+{
+  stats.window = window;
+  stats.in_flight = in_flight;
+  stats.pending = list_length(pending_list);
+  return &stats;
+}
+/*---------------------------------------------------------------------------*/
+static void
+send_packet(mac_callback_t sent, void *ptr)
+{
+  struct tx_pending *p;
+
   packetbuf_set_addr(PACKETBUF_ADDR_SENDER, &linkaddr_node_addr);
 
   /* ack or not ? */
@@ -131,27 +302,29 @@ send_packet(mac_callback_t sent, void *ptr)
   if(NETSTACK_FRAMER.create() < 0) {
     /* Failed to allocate space for headers */
     LOG_WARN("send failed, too large header\n");
+    stats.dropped++;
     mac_call_sent_callback(sent, ptr, MAC_TX_ERR_FATAL, 1);
+  } else if(in_flight < window && list_head(pending_list) == NULL) {
+    transmit(sent, ptr);
   } else {
-    /* here we send the data over SLIP to the radio-chip */
-    size = 0;
-#if SERIALIZE_ATTRIBUTES
-    size = packetutils_serialize_atts(&buf[3], sizeof(buf) - 3);
-#endif
-    if(size < 0 || size + packetbuf_totlen() + 3 > sizeof(buf)) {
-      LOG_WARN("send failed, too large header\n");
-      mac_call_sent_callback(sent, ptr, MAC_TX_ERR_FATAL, 1);
+    /* Out of credits: wait for the radio to report on a frame */
+    p = memb_alloc(&pending_memb);
+    if(p != NULL) {
+      p->buf = queuebuf_new_from_packetbuf();
+      if(p->buf == NULL) {
+        memb_free(&pending_memb, p);
+        p = NULL;
+      }
+    }
+    if(p == NULL) {
+      LOG_WARN("send failed, queue full\n");
+      stats.dropped++;
+      mac_call_sent_callback(sent, ptr, MAC_TX_ERR, 1);
     } else {
-      sid = setup_callback(sent, ptr);
-
-      buf[0] = '!';
-      buf[1] = 'S';
-      buf[2] = sid; /* sequence or session number for this packet */
-
-      /* Copy packet data */
-      memcpy(&buf[3 + size], packetbuf_hdrptr(), packetbuf_totlen());
-
-      write_to_slip(buf, packetbuf_totlen() + size + 3);
+      p->cback = sent;
+      p->ptr = ptr;
+      list_add(pending_list, p);
+      stats.queued++;
     }
   }
 }
@@ -189,6 +362,8 @@ static void
 init(void)
 {
   callback_pos = 0;
+  memb_init(&pending_memb);
+  list_init(pending_list);
 }
 /*---------------------------------------------------------------------------*/
 const struct mac_driver border_router_mac_driver = {
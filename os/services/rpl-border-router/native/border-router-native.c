@@ -96,6 +96,11 @@ border_router_print_stat()
 {
   printf("bytes received over SLIP: %ld\n", slip_received);
   printf("bytes sent over SLIP: %ld\n", slip_sent);
+#ifndef __CYGWIN__
+  printf("packets read from tun: %lu in %lu wake-ups (max %u, %lu full)\n",
+         tun6_net_get_stats()->packets, tun6_net_get_stats()->wakeups,
+         tun6_net_get_stats()->max_batch, tun6_net_get_stats()->full_batches);
+#endif /* __CYGWIN__ */
 }
 /*---------------------------------------------------------------------------*/
 PROCESS_THREAD(border_router_process, ev, data)
@@ -122,6 +127,9 @@ PROCESS_THREAD(border_router_process, ev, data)
     PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&et));
   }
 
+  /* Ask how many frames the radio can take at once */
+  write_to_slip((uint8_t *)"?W", 2);
+
   if(slip_config_ipaddr != NULL) {
     uip_ipaddr_t prefix;
 
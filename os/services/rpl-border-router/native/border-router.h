@@ -39,8 +39,26 @@
 
 #include "contiki.h"
 #include "net/ipv6/uip.h"
+#include "tun6-net.h"
 #include <stdio.h>
 
+/* Transmission statistics of the border router MAC */
+struct border_router_mac_stats {
+  unsigned long sent;         /* frames written to the radio */
+  unsigned long acked;        /* frames the radio reported as sent */
+  unsigned long failed;       /* frames the radio failed to send */
+  unsigned long lost;         /* frames the radio never reported on */
+  unsigned long dropped;      /* frames dropped before reaching the radio */
+  unsigned long queued;       /* frames that had to wait for a credit */
+  unsigned long unexpected;   /* reports for frames not in flight */
+  clock_time_t latency_total; /* send-to-report time, summed */
+  clock_time_t latency_max;
+  uint8_t max_in_flight;
+  uint8_t window;
+  uint8_t in_flight;
+  uint8_t pending;
+};
+
 int border_router_cmd_handler(const uint8_t *data, int len);
 int slip_config_handle_arguments(int argc, char **argv);
 void write_to_slip(const uint8_t *buf, int len);
@@ -50,6 +68,9 @@ void border_router_set_mac(const uint8_t *data);
 void border_router_set_sensors(const char *data, int len);
 void border_router_print_stat(void);
 
+void border_router_mac_set_window(uint8_t credits);
+const struct border_router_mac_stats *border_router_mac_get_stats(void);
+
 void tun_init(void);
 
 int slip_init(void);
@@ -45,6 +45,7 @@
 #include <termios.h>
 #include <signal.h>
 #include <sys/ioctl.h>
+#include <sys/uio.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
@@ -70,6 +71,19 @@ extern speed_t slip_config_b_rate;
 #define SEND_DELAY 0
 #endif
 
+/* Size of the buffer for outgoing SLIP frames, a power of two */
+#ifdef SLIP_DEV_CONF_BUF_SIZE
+#define SLIP_BUF_SIZE SLIP_DEV_CONF_BUF_SIZE
+#else
+#define SLIP_BUF_SIZE 2048
+#endif
+
+/* The free-running buffer positions stay valid modulo SLIP_BUF_SIZE when
+ * they wrap around only if SLIP_BUF_SIZE is a power of two */
+#if (SLIP_BUF_SIZE & (SLIP_BUF_SIZE - 1)) != 0
+#error SLIP_BUF_SIZE must be power of two
+#endif
+
 int devopen(const char *dev, int flags);
 
 static FILE *inslip;
@@ -286,73 +300,173 @@ after_fread:
 
   goto read_more;
 }
-unsigned char slip_buf[2048];
-int slip_end, slip_begin, slip_packet_end, slip_packet_count;
+/*---------------------------------------------------------------------------*/
+/* Outgoing SLIP frames, encoded, in a ring buffer. Only complete frames
+   are queued, so every SLIP_END in the buffer terminates a frame. */
+static unsigned char slip_buf[SLIP_BUF_SIZE];
+/* Free-running write and read positions, taken modulo SLIP_BUF_SIZE */
+static unsigned slip_head, slip_tail;
+/* Bytes left of the frame being sent, when frames are sent one by one */
+static unsigned slip_frame_left;
 static struct timer send_delay_timer;
+/* Wakes the main loop up when the send delay is over */
+static struct ctimer send_delay_wakeup;
 /* delay between slip packets */
 static clock_time_t send_delay = SEND_DELAY;
 /*---------------------------------------------------------------------------*/
 static void
-slip_send(int fd, unsigned char c)
+send_delay_expired(void *ptr)
+{
+  /* The flush happens once the main loop waits for the slip device to
+     be writable again */
+  select_update_fd(slipfd);
+}
+/*---------------------------------------------------------------------------*/
+/* Append bytes to the ring buffer, which has room for them */
+static void
+slip_append(const uint8_t *data, unsigned len)
+{
+  unsigned pos = slip_head % SLIP_BUF_SIZE;
+  unsigned first = MIN(len, SLIP_BUF_SIZE - pos);
+
+  if(len == 0) {
+    return;
+  }
+  memcpy(&slip_buf[pos], data, first);
+  memcpy(slip_buf, data + first, len - first);
+  slip_head += len;
+  slip_sent += len;
+}
+/*---------------------------------------------------------------------------*/
+/* The number of bytes that data takes once SLIP encoded, SLIP_END included */
+static unsigned
+slip_encoded_len(const uint8_t *data, unsigned len)
+{
+  unsigned i;
+  unsigned encoded = len + 1;
+
+  for(i = 0; i < len; i++) {
+    if(data[i] == SLIP_END || data[i] == SLIP_ESC) {
+      encoded++;
+    }
+  }
+  return encoded;
+}
+/*---------------------------------------------------------------------------*/
+/* Encode a frame into the ring buffer, copying the runs of bytes between
+   the ones that need escaping in bulk */
+static void
+slip_encode(const uint8_t *data, unsigned len)
 {
-  if(slip_end >= sizeof(slip_buf)) {
+  static const uint8_t esc_end[] = { SLIP_ESC, SLIP_ESC_END };
+  static const uint8_t esc_esc[] = { SLIP_ESC, SLIP_ESC_ESC };
+  static const uint8_t end[] = { SLIP_END };
+  const uint8_t *stop = data + len;
+  const uint8_t *next_end;
+  const uint8_t *next_esc;
+  const uint8_t *next;
+
+  if(SLIP_BUF_SIZE - (slip_head - slip_tail) < 2 * len + 1 &&
+     SLIP_BUF_SIZE - (slip_head - slip_tail) < slip_encoded_len(data, len)) {
     err(1, "slip_send overflow");
   }
-  slip_buf[slip_end] = c;
-  slip_end++;
-  slip_sent++;
-  if(c == SLIP_END) {
-    /* Full packet received. */
-    slip_packet_count++;
-    if(slip_packet_end == 0) {
-      slip_packet_end = slip_end;
+
+  next_end = len > 0 ? memchr(data, SLIP_END, len) : NULL;
+  next_esc = len > 0 ? memchr(data, SLIP_ESC, len) : NULL;
+  while(data < stop) {
+    if(next_end == NULL && next_esc == NULL) {
+      next = stop;
+    } else if(next_esc == NULL || (next_end != NULL && next_end < next_esc)) {
+      next = next_end;
+    } else {
+      next = next_esc;
     }
+
+    slip_append(data, next - data);
+    if(next == stop) {
+      break;
+    }
+
+    if(next == next_end) {
+      slip_append(esc_end, sizeof(esc_end));
+      next_end = memchr(next + 1, SLIP_END, stop - next - 1);
+    } else {
+      slip_append(esc_esc, sizeof(esc_esc));
+      next_esc = memchr(next + 1, SLIP_ESC, stop - next - 1);
+    }
+    data = next + 1;
   }
+  slip_append(end, sizeof(end));
 }
 /*---------------------------------------------------------------------------*/
 int
 slip_empty()
 {
-  return slip_packet_end == 0;
+  return slip_head == slip_tail;
+}
+/*---------------------------------------------------------------------------*/
+/* The length of the frame at the read position of the ring buffer */
+static unsigned
+slip_next_frame_len(void)
+{
+  unsigned pos = slip_tail % SLIP_BUF_SIZE;
+  unsigned first = MIN(slip_head - slip_tail, SLIP_BUF_SIZE - pos);
+  const uint8_t *end;
+
+  end = memchr(&slip_buf[pos], SLIP_END, first);
+  if(end != NULL) {
+    return end - &slip_buf[pos] + 1;
+  }
+  end = memchr(slip_buf, SLIP_END, slip_head - slip_tail - first);
+  if(end != NULL) {
+    return first + (end - slip_buf) + 1;
+  }
+  return slip_head - slip_tail;
 }
 /*---------------------------------------------------------------------------*/
 void
 slip_flushbuf(int fd)
 {
+  struct iovec iov[2];
+  unsigned pos;
+  unsigned len;
   int n;
 
   if(slip_empty()) {
     return;
   }
 
-  n = write(fd, slip_buf + slip_begin, slip_packet_end - slip_begin);
+  if(send_delay > 0) {
+    /* One frame at a time, with a pause in between */
+    if(slip_frame_left == 0) {
+      slip_frame_left = slip_next_frame_len();
+    }
+    len = slip_frame_left;
+  } else {
+    /* Everything that is queued, in as few writes as possible */
+    len = slip_head - slip_tail;
+  }
+
+  pos = slip_tail % SLIP_BUF_SIZE;
+  iov[0].iov_base = &slip_buf[pos];
+  iov[0].iov_len = MIN(len, SLIP_BUF_SIZE - pos);
+  iov[1].iov_base = slip_buf;
+  iov[1].iov_len = len - iov[0].iov_len;
+
+  n = writev(fd, iov, iov[1].iov_len > 0 ? 2 : 1);
 
   if(n == -1 && errno != EAGAIN) {
     err(1, "slip_flushbuf write failed");
   } else if(n == -1) {
     PROGRESS("Q");		/* Outqueue is full! */
   } else {
-    slip_begin += n;
-    if(slip_begin == slip_packet_end) {
-      slip_packet_count--;
-      if(slip_end > slip_packet_end) {
-        memmove(slip_buf, slip_buf + slip_packet_end,
-               slip_end - slip_packet_end);
-      }
-      slip_end -= slip_packet_end;
-      slip_begin = slip_packet_end = 0;
-      if(slip_end > 0) {
-        /* Find end of next slip packet */
-        for(n = 1; n < slip_end; n++) {
-          if(slip_buf[n] == SLIP_END) {
-            slip_packet_end = n + 1;
-            break;
-          }
-        }
+    slip_tail += n;
+    if(send_delay > 0) {
+      slip_frame_left -= n;
+      if(slip_frame_left == 0 && !slip_empty()) {
         /* a delay between slip packets to avoid losing data */
-        if(send_delay > 0) {
-          timer_set(&send_delay_timer, send_delay);
-        }
+        timer_set(&send_delay_timer, send_delay);
+        ctimer_set(&send_delay_wakeup, send_delay, send_delay_expired, NULL);
       }
     }
   }
@@ -395,24 +509,9 @@ write_to_serial(int outfd, const uint8_t *inbuf, int len)
   /* It would be ``nice'' to send a SLIP_END here but it's not
    * really necessary.
    */
-  /* slip_send(outfd, SLIP_END); */
 
-  for(i = 0; i < len; i++) {
-    switch(p[i]) {
-    case SLIP_END:
-      slip_send(outfd, SLIP_ESC);
-      slip_send(outfd, SLIP_ESC_END);
-      break;
-    case SLIP_ESC:
-      slip_send(outfd, SLIP_ESC);
-      slip_send(outfd, SLIP_ESC_ESC);
-      break;
-    default:
-      slip_send(outfd, p[i]);
-      break;
-    }
-  }
-  slip_send(outfd, SLIP_END);
+  slip_encode(p, len);
+  select_update_fd(outfd);
   PROGRESS("t");
 }
 /*---------------------------------------------------------------------------*/
@@ -559,7 +658,7 @@ slip_init(void)
   }
 
   timer_set(&send_delay_timer, 0);
-  slip_send(slipfd, SLIP_END);
+  slip_encode(NULL, 0);
   inslip = fdopen(slipfd, "r");
   if(inslip == NULL) {
     err(1, "main: fdopen");
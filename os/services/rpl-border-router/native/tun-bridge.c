@@ -66,6 +66,7 @@
 #include "net/packetbuf.h"
 #include "cmd.h"
 #include "border-router.h"
+#include "tun6-net.h"
 
 extern const char *slip_config_ipaddr;
 extern char slip_config_tundev[32];
@@ -147,42 +148,6 @@ devopen(const char *dev, int flags)
   return open(t, flags);
 }
 /*---------------------------------------------------------------------------*/
-#ifdef linux
-int
-tun_alloc(char *dev)
-{
-  struct ifreq ifr;
-  int fd, err;
-
-  if((fd = open("/dev/net/tun", O_RDWR)) < 0) {
-    return -1;
-  }
-
-  memset(&ifr, 0, sizeof(ifr));
-
-  /* Flags: IFF_TUN   - TUN device (no Ethernet headers)
-   *        IFF_NO_PI - Do not provide packet information
-   */
-  ifr.ifr_flags = IFF_TUN | IFF_NO_PI;
-  if(*dev != 0) {
-    strncpy(ifr.ifr_name, dev, IFNAMSIZ);
-  }
-
-  if((err = ioctl(fd, TUNSETIFF, (void *)&ifr)) < 0) {
-    close(fd);
-    return err;
-  }
-  strcpy(dev, ifr.ifr_name);
-  return fd;
-}
-#else
-int
-tun_alloc(char *dev)
-{
-  return devopen(dev, O_RDWR);
-}
-#endif
-
 #ifdef __CYGWIN__
 /*wpcap process is used to connect to host interface */
 void
@@ -207,14 +172,12 @@ tun_init()
 
   LOG_INFO("Opening tun interface:%s\n", slip_config_tundev);
 
-  tunfd = tun_alloc(slip_config_tundev);
+  tunfd = tun6_net_open(slip_config_tundev, &tun_select_callback);
 
   if(tunfd == -1) {
     err(1, "main: open");
   }
 
-  select_set_callback(tunfd, &tun_select_callback);
-
   fprintf(stderr, "opened %s device ``/dev/%s''\n",
           "tun", slip_config_tundev);
 
@@ -236,16 +199,6 @@ tun_output(uint8_t *data, int len)
   return 0;
 }
 /*---------------------------------------------------------------------------*/
-int
-tun_input(unsigned char *data, int maxlen)
-{
-  int size;
-  if((size = read(tunfd, data, maxlen)) == -1) {
-    err(1, "tun_input: read");
-  }
-  return size;
-}
-/*---------------------------------------------------------------------------*/
 static void
 init(void)
 {
@@ -270,11 +223,27 @@ const struct uip_fallback_interface rpl_interface = {
 static int
 set_fd(fd_set *rset, fd_set *wset)
 {
-  FD_SET(tunfd, rset);
-  return 1;
+  return tun6_net_set_fd(rset);
 }
 /*---------------------------------------------------------------------------*/
 
+/* Pass a packet read from tun on, and tell if the next one may follow
+   right away */
+static int
+input_packet(void)
+{
+  tcpip_input();
+
+  if(slip_config_basedelay) {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    delaymsec = slip_config_basedelay;
+    delaystartsec = tv.tv_sec;
+    delaystartmsec = tv.tv_usec / 1000;
+  }
+  return delaymsec == 0;
+}
+/*---------------------------------------------------------------------------*/
 static void
 handle_fd(fd_set *rset, fd_set *wset)
 {
@@ -295,22 +264,7 @@ handle_fd(fd_set *rset, fd_set *wset)
   }
 
   if(delaymsec == 0) {
-    int size;
-
-    if(FD_ISSET(tunfd, rset)) {
-      size = tun_input(uip_buf, sizeof(uip_buf));
-      /* printf("TUN data incoming read:%d\n", size); */
-      uip_len = size;
-      tcpip_input();
-
-      if(slip_config_basedelay) {
-        struct timeval tv;
-        gettimeofday(&tv, NULL);
-        delaymsec = slip_config_basedelay;
-        delaystartsec = tv.tv_sec;
-        delaystartmsec = tv.tv_usec / 1000;
-      }
-    }
+    tun6_net_read(rset, input_packet);
   }
 }
 #endif /*  __CYGWIN_ */
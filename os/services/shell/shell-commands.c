@@ -563,6 +563,16 @@ PT_THREAD(cmd_tsch_set_coordinator(struct pt *pt, shell_output_func output, char
   PT_END(pt);
 }
 /*---------------------------------------------------------------------------*/
+static void
+shell_output_hopping_sequence(shell_output_func output, const uint8_t *sequence, uint8_t len)
+{
+  int i;
+  for(i = 0; i < len; i++) {
+    SHELL_OUTPUT(output, "%s%u", i == 0 ? "" : ", ", sequence[i]);
+  }
+  SHELL_OUTPUT(output, "\n");
+}
+/*---------------------------------------------------------------------------*/
 static
 PT_THREAD(cmd_tsch_status(struct pt *pt, shell_output_func output, char *args))
 {
@@ -586,6 +596,33 @@ PT_THREAD(cmd_tsch_status(struct pt *pt, shell_output_func output, char *args))
     }
     SHELL_OUTPUT(output, "-- Last synchronized: %lu seconds ago\n", (clock_time() - last_sync_time) / CLOCK_SECOND);
     SHELL_OUTPUT(output, "-- Drift w.r.t. coordinator: %ld ppm\n", tsch_adaptive_timesync_get_drift_ppm());
+    SHELL_OUTPUT(output, "-- Hopping sequence: ");
+    shell_output_hopping_sequence(output, tsch_hopping_sequence, tsch_hopping_sequence_length.val);
+#if TSCH_WITH_HOPPING_SEQUENCE_SWITCH
+    {
+      const struct tsch_hopping_sequence_switch *next = tsch_get_next_hopping_sequence();
+      if(next != NULL) {
+        SHELL_OUTPUT(output, "-- Next hopping sequence at asn-%x.%lx (in %ld slots): ",
+                     next->asn.ms1b, (unsigned long)next->asn.ls4b,
+                     (long)(int32_t)TSCH_ASN_DIFF(next->asn, tsch_current_asn));
+        shell_output_hopping_sequence(output, next->sequence, next->len);
+      } else {
+        SHELL_OUTPUT(output, "-- Next hopping sequence: none\n");
+      }
+    }
+#endif /* TSCH_WITH_HOPPING_SEQUENCE_SWITCH */
+#if TSCH_STATS_CHANNEL_REPORTS
+    {
+      int i;
+      SHELL_OUTPUT(output, "-- Channel free (network): ");
+      for(i = 0; i < TSCH_STATS_NUM_CHANNELS; i++) {
+        SHELL_OUTPUT(output, "%s%u: %u%%", i == 0 ? "" : ", ", tsch_stats_index_to_channel(i),
+                     (unsigned)((uint32_t)tsch_stats_get_network_channel_free(i) * 100
+                                / TSCH_STATS_BINARY_SCALING_FACTOR));
+      }
+      SHELL_OUTPUT(output, "\n");
+    }
+#endif /* TSCH_STATS_CHANNEL_REPORTS */
   }
 
   PT_END(pt);
@@ -702,6 +739,50 @@ PT_THREAD(cmd_tsch_schedule(struct pt *pt, shell_output_func output, char *args)
   }
   PT_END(pt);
 }
+#if TSCH_PROFILE_ON
+/*---------------------------------------------------------------------------*/
+static
+PT_THREAD(cmd_tsch_profile(struct pt *pt, shell_output_func output, char *args))
+{
+  const struct tsch_profile_stats *stats;
+  char *next_args;
+  int i;
+
+  PT_BEGIN(pt);
+
+  SHELL_ARGS_INIT(args, next_args);
+  SHELL_ARGS_NEXT(args, next_args);
+
+  if(args != NULL && !strcmp(args, "reset")) {
+    tsch_profile_reset();
+    SHELL_OUTPUT(output, "TSCH profile reset\n");
+    PT_EXIT(pt);
+  }
+
+  stats = tsch_profile_get_stats();
+  SHELL_OUTPUT(output, "TSCH profile: %lu slots, %lu overruns, %lu dropped\n",
+               (unsigned long)stats->slot.count, (unsigned long)stats->overruns,
+               (unsigned long)stats->dropped);
+  if(stats->slot.count > 0) {
+    SHELL_OUTPUT(output, "-- slot: min %lu avg %lu max %lu us\n",
+                 (unsigned long)TSCH_PROFILE_RTIMER_TO_US(stats->slot.min),
+                 (unsigned long)TSCH_PROFILE_RTIMER_TO_US(stats->slot.total / stats->slot.count),
+                 (unsigned long)TSCH_PROFILE_RTIMER_TO_US(stats->slot.max));
+  }
+  for(i = 0; i < tsch_profile_num_phases; i++) {
+    const struct tsch_profile_phase_stats *s = &stats->phases[i];
+    if(s->count > 0) {
+      SHELL_OUTPUT(output, "-- %s: count %lu, min %lu avg %lu max %lu us\n",
+                   tsch_profile_phase_name(i), (unsigned long)s->count,
+                   (unsigned long)TSCH_PROFILE_TICKS_TO_US(s->min),
+                   (unsigned long)TSCH_PROFILE_TICKS_TO_US(s->total / s->count),
+                   (unsigned long)TSCH_PROFILE_TICKS_TO_US(s->max));
+    }
+  }
+
+  PT_END(pt);
+}
+#endif /* TSCH_PROFILE_ON */
 #endif /* MAC_CONF_WITH_TSCH */
 /*---------------------------------------------------------------------------*/
 #if TSCH_WITH_SIXTOP
@@ -867,6 +948,9 @@ const struct shell_command_t builtin_shell_commands[] = {
   { "tsch-set-coordinator", cmd_tsch_set_coordinator, "'> tsch-set-coordinator 0/1 [0/1]': Sets node as coordinator (1) or not (0). Second, optional parameter: enable (1) or disable (0) security." },
   { "tsch-schedule",        cmd_tsch_schedule,        "'> tsch-schedule': Shows the current TSCH schedule" },
   { "tsch-status",          cmd_tsch_status,          "'> tsch-status': Shows a summary of the current TSCH state" },
+#if TSCH_PROFILE_ON
+  { "tsch-profile",         cmd_tsch_profile,         "'> tsch-profile [reset]': Shows (or resets) the timing of the TSCH timeslot phases" },
+#endif /* TSCH_PROFILE_ON */
 #endif /* MAC_CONF_WITH_TSCH */
 #if TSCH_WITH_SIXTOP
   { "6top",                 cmd_6top,                 "'> 6top help': Shows 6top command usage" },
@@ -94,20 +94,33 @@ tsch_cs_bitmap_set(tsch_cs_bitmap_t bitmap, uint8_t channel)
 }
 /*---------------------------------------------------------------------------*/
 static tsch_cs_bitmap_t
-tsch_cs_bitmap_calc(void)
+tsch_cs_bitmap_calc(const uint8_t *sequence, uint8_t len)
 {
   tsch_cs_bitmap_t result = 0;
   int i;
-  for(i = 0; i < tsch_hopping_sequence_length.val; ++i) {
-    result = tsch_cs_bitmap_set(result, tsch_hopping_sequence[i]);
+  for(i = 0; i < len; ++i) {
+    result = tsch_cs_bitmap_set(result, sequence[i]);
   }
   return result;
 }
 /*---------------------------------------------------------------------------*/
+/* The "channel free" metric of a channel. With channel reports, this
+ * includes the metric of the rest of the network. */
+static inline tsch_stat_t
+tsch_cs_channel_free(uint8_t index)
+{
+#if TSCH_STATS_CHANNEL_REPORTS
+  return tsch_stats_get_network_channel_free(index);
+#else /* TSCH_STATS_CHANNEL_REPORTS */
+  return tsch_stats.channel_free_ewma[index];
+#endif /* TSCH_STATS_CHANNEL_REPORTS */
+}
+/*---------------------------------------------------------------------------*/
 void
 tsch_cs_adaptations_init(void)
 {
-  tsch_cs_initial_bitmap = tsch_cs_bitmap_calc();
+  tsch_cs_initial_bitmap = tsch_cs_bitmap_calc(tsch_hopping_sequence,
+                                               tsch_hopping_sequence_length.val);
   tsch_cs_current_bitmap = tsch_cs_initial_bitmap;
 }
 /*---------------------------------------------------------------------------*/
@@ -196,6 +209,7 @@ tsch_cs_process(void)
   bool try_replace;
   bool has_replaced;
   struct tsch_cs_quality qualities[TSCH_STATS_NUM_CHANNELS];
+  tsch_stat_t channel_free[TSCH_STATS_NUM_CHANNELS];
   uint8_t is_channel_busy[TSCH_STATS_NUM_CHANNELS];
   uint8_t is_in_sequence[TSCH_STATS_NUM_CHANNELS];
   static uint32_t last_time_changed;
@@ -210,12 +224,20 @@ tsch_cs_process(void)
     return false;
   }
 
+#if TSCH_WITH_HOPPING_SEQUENCE_SWITCH
+  if(tsch_get_next_hopping_sequence() != NULL) {
+    /* wait for the network to switch to the last announced sequence */
+    return false;
+  }
+#endif /* TSCH_WITH_HOPPING_SEQUENCE_SWITCH */
+
   /* reset the flag */
   recaculation_requested = false;
 
   for(i = 0; i < TSCH_STATS_NUM_CHANNELS; ++i) {
+    channel_free[i] = tsch_cs_channel_free(i);
     qualities[i].channel = i + TSCH_STATS_FIRST_CHANNEL;
-    qualities[i].metric = tsch_stats.channel_free_ewma[i];
+    qualities[i].metric = channel_free[i];
   }
 
   /* bubble sort the channels */
@@ -223,7 +245,7 @@ tsch_cs_process(void)
 
   /* start with the threshold values */
   for(i = 0; i < TSCH_STATS_NUM_CHANNELS; ++i) {
-    is_channel_busy[i] = (tsch_stats.channel_free_ewma[i] < TSCH_CS_FREE_THRESHOLD);
+    is_channel_busy[i] = (channel_free[i] < TSCH_CS_FREE_THRESHOLD);
   }
   memset(is_in_sequence, 0xff, sizeof(is_in_sequence));
   for(i = 0; i < tsch_hopping_sequence_length.val; ++i) {
@@ -271,13 +293,31 @@ tsch_cs_process(void)
       if(replacement != 0xff) {
         printf("\ncs: replacing channel %u %u (%u) with %u\n",
                channel, tsch_hopping_sequence[position], position, replacement);
-        /* mark the old channel as busy */
-        tsch_cs_busy_since[channel - TSCH_STATS_FIRST_CHANNEL] = clock_seconds();
+#if TSCH_WITH_HOPPING_SEQUENCE_SWITCH
+        {
+          /* announce the new sequence so that the whole network switches at once */
+          uint8_t sequence[TSCH_HOPPING_SEQUENCE_MAX_LEN];
+          uint8_t len = tsch_hopping_sequence_length.val;
+          memcpy(sequence, tsch_hopping_sequence, len);
+          sequence[position] = replacement;
+          has_replaced = tsch_announce_hopping_sequence(sequence, len);
+          if(has_replaced) {
+            /* recalculate the hopping sequence bitmap */
+            tsch_cs_current_bitmap = tsch_cs_bitmap_calc(sequence, len);
+          }
+        }
+#else /* TSCH_WITH_HOPPING_SEQUENCE_SWITCH */
         /* do the actual replacement in the global TSCH HS variable */
         tsch_hopping_sequence[position] = replacement;
         has_replaced = true;
         /* recalculate the hopping sequence bitmap */
-        tsch_cs_current_bitmap = tsch_cs_bitmap_calc();
+        tsch_cs_current_bitmap = tsch_cs_bitmap_calc(tsch_hopping_sequence,
+                                                     tsch_hopping_sequence_length.val);
+#endif /* TSCH_WITH_HOPPING_SEQUENCE_SWITCH */
+        if(has_replaced) {
+          /* mark the old channel as busy */
+          tsch_cs_busy_since[channel - TSCH_STATS_FIRST_CHANNEL] = clock_seconds();
+        }
       }
       break; /* replace just one at once */
     }
@@ -312,7 +352,7 @@ tsch_cs_channel_stats_updated(uint8_t updated_channel, uint16_t old_busyness_met
   index = tsch_stats_channel_to_index(updated_channel);
 
   old_is_busy = (old_busyness_metric < TSCH_CS_FREE_THRESHOLD);
-  new_is_busy = (tsch_stats.channel_free_ewma[index] < TSCH_CS_FREE_THRESHOLD);
+  new_is_busy = (tsch_cs_channel_free(index) < TSCH_CS_FREE_THRESHOLD);
 
   if(old_is_busy != new_is_busy) {
     /* the status of the channel has changed*/
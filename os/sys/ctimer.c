@@ -46,7 +46,10 @@
 #include "contiki.h"
 #include "lib/list.h"
 
+#include <stddef.h>
+
 LIST(ctimer_list);
+PROCESS(ctimer_process, "Ctimer process");
 
 static char initialized;
 
@@ -59,7 +62,32 @@ static char initialized;
 #endif
 
 /*---------------------------------------------------------------------------*/
-PROCESS(ctimer_process, "Ctimer process");
+static void
+add_ctimer(struct ctimer *c)
+{
+#if ETIMER_WITH_HEAP
+  if(initialized) {
+    /* The etimer heap keeps track of the timer, no need for the list */
+    c->pending = 1;
+    return;
+  }
+#endif /* ETIMER_WITH_HEAP */
+  list_add(ctimer_list, c);
+}
+/*---------------------------------------------------------------------------*/
+static void
+cancel_event(struct ctimer *c)
+{
+#if ETIMER_WITH_HEAP
+  if(initialized && c->pending && etimer_expired(&c->etimer)) {
+    /* The etimer has expired but its event was not delivered yet. Drop
+       the event, the ctimer may be freed as soon as it is stopped. */
+    process_drop_events(&ctimer_process, PROCESS_EVENT_TIMER, &c->etimer);
+    c->pending = 0;
+  }
+#endif /* ETIMER_WITH_HEAP */
+}
+/*---------------------------------------------------------------------------*/
 PROCESS_THREAD(ctimer_process, ev, data)
 {
   struct ctimer *c;
@@ -67,11 +95,31 @@ PROCESS_THREAD(ctimer_process, ev, data)
 
   for(c = list_head(ctimer_list); c != NULL; c = c->next) {
     etimer_set(&c->etimer, c->etimer.timer.interval);
+#if ETIMER_WITH_HEAP
+    c->pending = 1;
+#endif /* ETIMER_WITH_HEAP */
   }
   initialized = 1;
+#if ETIMER_WITH_HEAP
+  list_init(ctimer_list);
+#endif /* ETIMER_WITH_HEAP */
 
   while(1) {
     PROCESS_YIELD_UNTIL(ev == PROCESS_EVENT_TIMER);
+#if ETIMER_WITH_HEAP
+    /* All etimers of this process belong to a ctimer. Events of ctimers
+       that were stopped or set again since their etimer expired are
+       dropped from the event queue, so the ctimer is still there. */
+    c = (struct ctimer *)((char *)data - offsetof(struct ctimer, etimer));
+    if(c->pending && etimer_expired(&c->etimer)) {
+      c->pending = 0;
+      PROCESS_CONTEXT_BEGIN(c->p);
+      if(c->f != NULL) {
+        c->f(c->ptr);
+      }
+      PROCESS_CONTEXT_END(c->p);
+    }
+#else /* ETIMER_WITH_HEAP */
     for(c = list_head(ctimer_list); c != NULL; c = c->next) {
       if(&c->etimer == data) {
 	list_remove(ctimer_list, c);
@@ -83,6 +131,7 @@ PROCESS_THREAD(ctimer_process, ev, data)
 	break;
       }
     }
+#endif /* ETIMER_WITH_HEAP */
   }
   PROCESS_END();
 }
@@ -107,6 +156,7 @@ ctimer_set_with_process(struct ctimer *c, clock_time_t t,
 	   void (*f)(void *), void *ptr, struct process *p)
 {
   PRINTF("ctimer_set %p %lu\n", c, (unsigned long)t);
+  cancel_event(c);
   c->p = p;
   c->f = f;
   c->ptr = ptr;
@@ -118,42 +168,51 @@ ctimer_set_with_process(struct ctimer *c, clock_time_t t,
     c->etimer.timer.interval = t;
   }
 
-  list_add(ctimer_list, c);
+  add_ctimer(c);
 }
 /*---------------------------------------------------------------------------*/
 void
 ctimer_reset(struct ctimer *c)
 {
+  cancel_event(c);
   if(initialized) {
     PROCESS_CONTEXT_BEGIN(&ctimer_process);
     etimer_reset(&c->etimer);
     PROCESS_CONTEXT_END(&ctimer_process);
   }
 
-  list_add(ctimer_list, c);
+  add_ctimer(c);
 }
 /*---------------------------------------------------------------------------*/
 void
 ctimer_restart(struct ctimer *c)
 {
+  cancel_event(c);
   if(initialized) {
     PROCESS_CONTEXT_BEGIN(&ctimer_process);
     etimer_restart(&c->etimer);
     PROCESS_CONTEXT_END(&ctimer_process);
   }
 
-  list_add(ctimer_list, c);
+  add_ctimer(c);
 }
 /*---------------------------------------------------------------------------*/
 void
 ctimer_stop(struct ctimer *c)
 {
+  cancel_event(c);
   if(initialized) {
     etimer_stop(&c->etimer);
   } else {
     c->etimer.next = NULL;
     c->etimer.p = PROCESS_NONE;
   }
+#if ETIMER_WITH_HEAP
+  c->pending = 0;
+  if(initialized) {
+    return;
+  }
+#endif /* ETIMER_WITH_HEAP */
   list_remove(ctimer_list, c);
 }
 /*---------------------------------------------------------------------------*/
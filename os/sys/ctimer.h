@@ -63,6 +63,11 @@ struct ctimer {
   struct process *p;
   void (*f)(void *);
   void *ptr;
+#if ETIMER_WITH_HEAP
+  /* Set while the callback is due, replaces the ctimer list once the
+     ctimer process has started */
+  uint8_t pending;
+#endif /* ETIMER_WITH_HEAP */
 };
 
 /**
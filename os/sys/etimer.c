@@ -49,10 +49,229 @@
 #include "sys/etimer.h"
 #include "sys/process.h"
 
+#if ETIMER_WITH_HEAP
+static struct etimer *heap_root;
+#else /* ETIMER_WITH_HEAP */
 static struct etimer *timerlist;
+#endif /* ETIMER_WITH_HEAP */
 static clock_time_t next_expiration;
 
 PROCESS(etimer_process, "Event timer");
+#if ETIMER_WITH_HEAP
+/*---------------------------------------------------------------------------*/
+/* Tells whether timer a expires before timer b, taking wraps into account */
+static int
+heap_before(struct etimer *a, struct etimer *b)
+{
+  clock_time_t diff;
+
+  diff = etimer_expiration_time(b) - etimer_expiration_time(a);
+  return diff != 0 &&
+    diff <= (clock_time_t)((clock_time_t)~(clock_time_t)0 >> 1);
+}
+/*---------------------------------------------------------------------------*/
+/* Melds two heaps, returning the root of the result */
+static struct etimer *
+heap_meld(struct etimer *a, struct etimer *b)
+{
+  struct etimer *tmp;
+
+  if(a == NULL) {
+    return b;
+  }
+  if(b == NULL) {
+    return a;
+  }
+  if(heap_before(b, a)) {
+    tmp = a;
+    a = b;
+    b = tmp;
+  }
+  /* b becomes the first child of a */
+  b->prev = a;
+  b->next = a->child;
+  if(a->child != NULL) {
+    a->child->prev = b;
+  }
+  a->child = b;
+  a->next = NULL;
+  a->prev = NULL;
+  return a;
+}
+/*---------------------------------------------------------------------------*/
+/* Melds a list of sibling heaps into one, using the two-pass pairing
+   strategy that gives the heap its amortized bounds. */
+static struct etimer *
+heap_merge_pairs(struct etimer *first)
+{
+  struct etimer *a, *b;
+  struct etimer *paired;
+  struct etimer *result;
+
+  /* First pass: meld pairs from left to right, stacking the results */
+  paired = NULL;
+  while(first != NULL) {
+    a = first;
+    b = a->next;
+    first = b != NULL ? b->next : NULL;
+    a->next = a->prev = NULL;
+    if(b != NULL) {
+      b->next = b->prev = NULL;
+      a = heap_meld(a, b);
+    }
+    a->next = paired;
+    paired = a;
+  }
+
+  /* Second pass: meld the pairs from right to left */
+  result = NULL;
+  while(paired != NULL) {
+    a = paired;
+    paired = a->next;
+    a->next = NULL;
+    result = heap_meld(result, a);
+  }
+  return result;
+}
+/*---------------------------------------------------------------------------*/
+/* Tells whether a timer is in the heap. Safe on timers that were never
+   set, whose other fields may hold anything. */
+static int
+in_heap(const struct etimer *t)
+{
+  return t->heap_self == t;
+}
+/*---------------------------------------------------------------------------*/
+static void
+heap_insert(struct etimer *t)
+{
+  t->next = t->prev = t->child = NULL;
+  t->heap_self = t;
+  heap_root = heap_meld(heap_root, t);
+}
+/*---------------------------------------------------------------------------*/
+static void
+heap_remove(struct etimer *t)
+{
+  struct etimer *sub;
+
+  if(t == heap_root) {
+    heap_root = heap_merge_pairs(t->child);
+  } else {
+    /* Unlink t from its siblings, then meld its children back in */
+    if(t->prev->child == t) {
+      t->prev->child = t->next;
+    } else {
+      t->prev->next = t->next;
+    }
+    if(t->next != NULL) {
+      t->next->prev = t->prev;
+    }
+    sub = heap_merge_pairs(t->child);
+    heap_root = heap_meld(heap_root, sub);
+  }
+  t->next = t->prev = t->child = NULL;
+  t->heap_self = NULL;
+}
+/*---------------------------------------------------------------------------*/
+/* Returns the first pending timer of process p, in depth-first order */
+static struct etimer *
+heap_find_process(struct process *p)
+{
+  struct etimer *t;
+
+  t = heap_root;
+  while(t != NULL) {
+    if(t->p == p) {
+      return t;
+    }
+    if(t->child != NULL) {
+      t = t->child;
+    } else {
+      /* Climb up until there is a right sibling to visit */
+      while(t != NULL && t->next == NULL) {
+        while(t->prev != NULL && t->prev->child != t) {
+          t = t->prev;
+        }
+        t = t->prev;
+      }
+      if(t != NULL) {
+        t = t->next;
+      }
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+static void
+update_time(void)
+{
+  next_expiration = heap_root == NULL ? 0 : etimer_expiration_time(heap_root);
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(etimer_process, ev, data)
+{
+  struct etimer *t;
+
+  PROCESS_BEGIN();
+
+  heap_root = NULL;
+
+  while(1) {
+    PROCESS_YIELD();
+
+    if(ev == PROCESS_EVENT_EXITED) {
+      while((t = heap_find_process(data)) != NULL) {
+        heap_remove(t);
+      }
+      update_time();
+      continue;
+    } else if(ev != PROCESS_EVENT_POLL) {
+      continue;
+    }
+
+    /* The heap root is always the first timer to expire */
+    while(heap_root != NULL && timer_expired(&heap_root->timer)) {
+      t = heap_root;
+      if(process_post(t->p, PROCESS_EVENT_TIMER, t) == PROCESS_ERR_OK) {
+        /* Reset the process ID of the event timer, to signal that the
+           etimer has expired. This is later checked in the
+           etimer_expired() function. */
+        t->p = PROCESS_NONE;
+        heap_remove(t);
+      } else {
+        etimer_request_poll();
+        break;
+      }
+    }
+    update_time();
+  }
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
+void
+etimer_request_poll(void)
+{
+  process_poll(&etimer_process);
+}
+/*---------------------------------------------------------------------------*/
+static void
+add_timer(struct etimer *timer)
+{
+  etimer_request_poll();
+
+  if(timer->p != PROCESS_NONE && in_heap(timer)) {
+    /* Timer already in the heap, move it to its new position. */
+    heap_remove(timer);
+  }
+
+  timer->p = PROCESS_CURRENT();
+  heap_insert(timer);
+
+  update_time();
+}
+#else /* ETIMER_WITH_HEAP */
 /*---------------------------------------------------------------------------*/
 static void
 update_time(void)
@@ -172,6 +391,7 @@ add_timer(struct etimer *timer)
 
   update_time();
 }
+#endif /* ETIMER_WITH_HEAP */
 /*---------------------------------------------------------------------------*/
 void
 etimer_set(struct etimer *et, clock_time_t interval)
@@ -206,6 +426,12 @@ void
 etimer_adjust(struct etimer *et, int timediff)
 {
   et->timer.start += timediff;
+#if ETIMER_WITH_HEAP
+  if(et->p != PROCESS_NONE && in_heap(et)) {
+    heap_remove(et);
+    heap_insert(et);
+  }
+#endif /* ETIMER_WITH_HEAP */
   update_time();
 }
 /*---------------------------------------------------------------------------*/
@@ -230,7 +456,11 @@ etimer_start_time(struct etimer *et)
 int
 etimer_pending(void)
 {
+#if ETIMER_WITH_HEAP
+  return heap_root != NULL;
+#else /* ETIMER_WITH_HEAP */
   return timerlist != NULL;
+#endif /* ETIMER_WITH_HEAP */
 }
 /*---------------------------------------------------------------------------*/
 clock_time_t
@@ -242,6 +472,12 @@ etimer_next_expiration_time(void)
 void
 etimer_stop(struct etimer *et)
 {
+#if ETIMER_WITH_HEAP
+  if(et->p != PROCESS_NONE && in_heap(et)) {
+    heap_remove(et);
+    update_time();
+  }
+#else /* ETIMER_WITH_HEAP */
   struct etimer *t;
 
   /* First check if et is the first event timer on the list. */
@@ -265,6 +501,7 @@ etimer_stop(struct etimer *et)
 
   /* Remove the next pointer from the item to be removed. */
   et->next = NULL;
+#endif /* ETIMER_WITH_HEAP */
   /* Set the timer as expired */
   et->p = PROCESS_NONE;
 }
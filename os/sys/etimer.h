@@ -64,6 +64,21 @@
 
 #include "contiki.h"
 
+/*
+ * By default, pending event timers are kept on an unsorted list, which
+ * makes setting, stopping and expiring a timer linear in the number of
+ * pending timers. With ETIMER_CONF_WITH_HEAP, they are instead kept in a
+ * pairing heap ordered by expiration time: setting a timer is O(1),
+ * stopping or expiring one is O(log n) amortized, and the next expiration
+ * time is always known. All pending timers must then expire within half
+ * the range of clock_time_t of each other.
+ */
+#ifdef ETIMER_CONF_WITH_HEAP
+#define ETIMER_WITH_HEAP ETIMER_CONF_WITH_HEAP
+#else /* ETIMER_CONF_WITH_HEAP */
+#define ETIMER_WITH_HEAP 0
+#endif /* ETIMER_CONF_WITH_HEAP */
+
 /**
  * A timer.
  *
@@ -76,6 +91,15 @@ struct etimer {
   struct timer timer;
   struct etimer *next;
   struct process *p;
+#if ETIMER_WITH_HEAP
+  /* First child in the heap */
+  struct etimer *child;
+  /* Left sibling, or parent for the first child */
+  struct etimer *prev;
+  /* Points to the timer itself while it is in the heap. Unlike a flag,
+   * the garbage of a timer that was never set cannot pass for it. */
+  struct etimer *heap_self;
+#endif /* ETIMER_WITH_HEAP */
 };
 
 /**
@@ -47,6 +47,9 @@
 
 #include "contiki.h"
 #include "sys/process.h"
+#if PROCESS_PRIORITY_LEVELS > 1
+#include "sys/int-master.h"
+#endif /* PROCESS_PRIORITY_LEVELS > 1 */
 
 /*
  * Pointer to the currently running process structure.
@@ -63,13 +66,45 @@ struct event_data {
   process_event_t ev;
   process_data_t data;
   struct process *p;
+#if PROCESS_PRIORITY_LEVELS > 1
+  process_num_events_t next;
+#endif /* PROCESS_PRIORITY_LEVELS > 1 */
 };
 
-static process_num_events_t nevents, fevent;
+static process_num_events_t nevents;
 static struct event_data events[PROCESS_CONF_NUMEVENTS];
 
+#if PROCESS_PRIORITY_LEVELS > 1
+#if PROCESS_CONF_NUMEVENTS > 255
+#error "PROCESS_CONF_NUMEVENTS must be at most 255 with process priorities"
+#endif
+
+/* Marks the end of an event list */
+#define EVENT_NONE PROCESS_CONF_NUMEVENTS
+
+/*
+ * The slots of the event array are linked into one FIFO per priority
+ * level, the unused slots into a free list.
+ */
+static process_num_events_t free_event;
+static process_num_events_t first_event[PROCESS_PRIORITY_LEVELS];
+static process_num_events_t last_event[PROCESS_PRIORITY_LEVELS];
+
+/*
+ * Processes that have requested a poll, one FIFO per priority level.
+ * The poll queues are also updated from interrupt context, through
+ * process_poll(), so they are only touched with interrupts disabled.
+ */
+static struct process *first_poll[PROCESS_PRIORITY_LEVELS];
+static struct process *last_poll[PROCESS_PRIORITY_LEVELS];
+static unsigned int npolls[PROCESS_PRIORITY_LEVELS];
+#else /* PROCESS_PRIORITY_LEVELS > 1 */
+static process_num_events_t fevent;
+#endif /* PROCESS_PRIORITY_LEVELS > 1 */
+
 #if PROCESS_CONF_STATS
 process_num_events_t process_maxevents;
+unsigned long process_events_dropped;
 #endif
 
 static volatile unsigned char poll_requested;
@@ -88,6 +123,63 @@ static void call_process(struct process *p, process_event_t ev, process_data_t d
 #define PRINTF(...)
 #endif
 
+#if PROCESS_PRIORITY_LEVELS > 1
+/*---------------------------------------------------------------------------*/
+/* Must be called with interrupts disabled */
+static void
+poll_enqueue(struct process *p)
+{
+  p->next_poll = NULL;
+  if(last_poll[p->priority] == NULL) {
+    first_poll[p->priority] = p;
+  } else {
+    last_poll[p->priority]->next_poll = p;
+  }
+  last_poll[p->priority] = p;
+  npolls[p->priority]++;
+}
+/*---------------------------------------------------------------------------*/
+/* Must be called with interrupts disabled */
+static struct process *
+poll_dequeue(unsigned char priority)
+{
+  struct process *p;
+
+  p = first_poll[priority];
+  if(p != NULL) {
+    first_poll[priority] = p->next_poll;
+    if(first_poll[priority] == NULL) {
+      last_poll[priority] = NULL;
+    }
+    npolls[priority]--;
+  }
+  return p;
+}
+/*---------------------------------------------------------------------------*/
+/* Must be called with interrupts disabled */
+static void
+poll_remove(struct process *p)
+{
+  struct process *q, *prev;
+
+  prev = NULL;
+  for(q = first_poll[p->priority]; q != NULL; q = q->next_poll) {
+    if(q == p) {
+      if(prev == NULL) {
+        first_poll[p->priority] = p->next_poll;
+      } else {
+        prev->next_poll = p->next_poll;
+      }
+      if(last_poll[p->priority] == p) {
+        last_poll[p->priority] = prev;
+      }
+      npolls[p->priority]--;
+      return;
+    }
+    prev = q;
+  }
+}
+#endif /* PROCESS_PRIORITY_LEVELS > 1 */
 /*---------------------------------------------------------------------------*/
 process_event_t
 process_alloc_event(void)
@@ -125,6 +217,9 @@ exit_process(struct process *p, struct process *fromprocess)
 {
   register struct process *q;
   struct process *old_current = process_current;
+#if PROCESS_PRIORITY_LEVELS > 1
+  int_master_status_t status;
+#endif /* PROCESS_PRIORITY_LEVELS > 1 */
 
   PRINTF("process: exit_process '%s'\n", PROCESS_NAME_STRING(p));
 
@@ -168,6 +263,17 @@ exit_process(struct process *p, struct process *fromprocess)
     }
   }
 
+#if PROCESS_PRIORITY_LEVELS > 1
+  /* Drop any pending poll request, the process may be restarted
+     later and must not find itself on a stale poll queue. */
+  status = int_master_read_and_disable();
+  if(p->needspoll) {
+    poll_remove(p);
+    p->needspoll = 0;
+  }
+  int_master_status_set(status);
+#endif /* PROCESS_PRIORITY_LEVELS > 1 */
+
   process_current = old_current;
 }
 /*---------------------------------------------------------------------------*/
@@ -207,11 +313,30 @@ process_exit(struct process *p)
 void
 process_init(void)
 {
+#if PROCESS_PRIORITY_LEVELS > 1
+  process_num_events_t i;
+  unsigned char prio;
+#endif /* PROCESS_PRIORITY_LEVELS > 1 */
+
   lastevent = PROCESS_EVENT_MAX;
 
-  nevents = fevent = 0;
+  nevents = 0;
+#if PROCESS_PRIORITY_LEVELS > 1
+  for(i = 0; i < PROCESS_CONF_NUMEVENTS; i++) {
+    events[i].next = i + 1;
+  }
+  free_event = 0;
+  for(prio = 0; prio < PROCESS_PRIORITY_LEVELS; prio++) {
+    first_event[prio] = last_event[prio] = EVENT_NONE;
+    first_poll[prio] = last_poll[prio] = NULL;
+    npolls[prio] = 0;
+  }
+#else /* PROCESS_PRIORITY_LEVELS > 1 */
+  fevent = 0;
+#endif /* PROCESS_PRIORITY_LEVELS > 1 */
 #if PROCESS_CONF_STATS
   process_maxevents = 0;
+  process_events_dropped = 0;
 #endif /* PROCESS_CONF_STATS */
 
   process_current = process_list = NULL;
@@ -225,6 +350,34 @@ static void
 do_poll(void)
 {
   struct process *p;
+#if PROCESS_PRIORITY_LEVELS > 1
+  int_master_status_t status;
+  unsigned int n;
+  int prio;
+
+  poll_requested = 0;
+  /*
+   * Only visit the processes that asked to be polled, highest
+   * priority first. Poll requests made while we are at it are left
+   * for the next round, so that a process that keeps polling itself
+   * cannot starve the event queue.
+   */
+  for(prio = PROCESS_PRIORITY_LEVELS - 1; prio >= 0; prio--) {
+    for(n = npolls[prio]; n > 0; n--) {
+      status = int_master_read_and_disable();
+      p = poll_dequeue(prio);
+      if(p != NULL) {
+        p->needspoll = 0;
+      }
+      int_master_status_set(status);
+      if(p == NULL) {
+        break;
+      }
+      p->state = PROCESS_STATE_RUNNING;
+      call_process(p, PROCESS_EVENT_POLL, NULL);
+    }
+  }
+#else /* PROCESS_PRIORITY_LEVELS > 1 */
 
   poll_requested = 0;
   /* Call the processes that needs to be polled. */
@@ -235,6 +388,7 @@ do_poll(void)
       call_process(p, PROCESS_EVENT_POLL, NULL);
     }
   }
+#endif /* PROCESS_PRIORITY_LEVELS > 1 */
 }
 /*---------------------------------------------------------------------------*/
 /*
@@ -249,6 +403,10 @@ do_event(void)
   process_data_t data;
   struct process *receiver;
   struct process *p;
+#if PROCESS_PRIORITY_LEVELS > 1
+  process_num_events_t snum;
+  int prio;
+#endif /* PROCESS_PRIORITY_LEVELS > 1 */
 
   /*
    * If there are any events in the queue, take the first one and walk
@@ -260,6 +418,25 @@ do_event(void)
 
   if(nevents > 0) {
 
+#if PROCESS_PRIORITY_LEVELS > 1
+    /* Take the oldest event of the highest priority level that has
+       any, and put its slot back on the free list. */
+    for(prio = PROCESS_PRIORITY_LEVELS - 1;
+        first_event[prio] == EVENT_NONE; prio--);
+    snum = first_event[prio];
+    first_event[prio] = events[snum].next;
+    if(first_event[prio] == EVENT_NONE) {
+      last_event[prio] = EVENT_NONE;
+    }
+
+    ev = events[snum].ev;
+    data = events[snum].data;
+    receiver = events[snum].p;
+
+    events[snum].next = free_event;
+    free_event = snum;
+    --nevents;
+#else /* PROCESS_PRIORITY_LEVELS > 1 */
     /* There are events that we should deliver. */
     ev = events[fevent].ev;
 
@@ -270,6 +447,7 @@ do_event(void)
        and decrease the number of events. */
     fevent = (fevent + 1) % PROCESS_CONF_NUMEVENTS;
     --nevents;
+#endif /* PROCESS_PRIORITY_LEVELS > 1 */
 
     /* If this is a broadcast event, we deliver it to all events, in
        order of their priority. */
@@ -322,6 +500,9 @@ int
 process_post(struct process *p, process_event_t ev, process_data_t data)
 {
   process_num_events_t snum;
+#if PROCESS_PRIORITY_LEVELS > 1
+  unsigned char prio;
+#endif /* PROCESS_PRIORITY_LEVELS > 1 */
 
   if(PROCESS_CURRENT() == NULL) {
     PRINTF("process_post: NULL process posts event %d to process '%s', nevents %d\n",
@@ -340,10 +521,28 @@ process_post(struct process *p, process_event_t ev, process_data_t data)
       printf("soft panic: event queue is full when event %d was posted to %s from %s\n", ev, PROCESS_NAME_STRING(p), PROCESS_NAME_STRING(process_current));
     }
 #endif /* DEBUG */
+#if PROCESS_CONF_STATS
+    process_events_dropped++;
+#endif /* PROCESS_CONF_STATS */
     return PROCESS_ERR_FULL;
   }
 
+#if PROCESS_PRIORITY_LEVELS > 1
+  /* Broadcast events are queued at normal priority, all others at
+     the priority of the receiving process. */
+  prio = p == PROCESS_BROADCAST ? PROCESS_PRIORITY_NORMAL : p->priority;
+  snum = free_event;
+  free_event = events[snum].next;
+  events[snum].next = EVENT_NONE;
+  if(last_event[prio] == EVENT_NONE) {
+    first_event[prio] = snum;
+  } else {
+    events[last_event[prio]].next = snum;
+  }
+  last_event[prio] = snum;
+#else /* PROCESS_PRIORITY_LEVELS > 1 */
   snum = (process_num_events_t)(fevent + nevents) % PROCESS_CONF_NUMEVENTS;
+#endif /* PROCESS_PRIORITY_LEVELS > 1 */
   events[snum].ev = ev;
   events[snum].data = data;
   events[snum].p = p;
@@ -358,6 +557,61 @@ process_post(struct process *p, process_event_t ev, process_data_t data)
   return PROCESS_ERR_OK;
 }
 /*---------------------------------------------------------------------------*/
+int
+process_drop_events(struct process *p, process_event_t ev, process_data_t data)
+{
+  process_num_events_t snum;
+  int dropped = 0;
+#if PROCESS_PRIORITY_LEVELS > 1
+  process_num_events_t prev;
+  process_num_events_t next;
+  int prio;
+
+  for(prio = 0; prio < PROCESS_PRIORITY_LEVELS; prio++) {
+    prev = EVENT_NONE;
+    for(snum = first_event[prio]; snum != EVENT_NONE; snum = next) {
+      next = events[snum].next;
+      if(events[snum].p == p && events[snum].ev == ev &&
+         events[snum].data == data) {
+        if(prev == EVENT_NONE) {
+          first_event[prio] = next;
+        } else {
+          events[prev].next = next;
+        }
+        if(last_event[prio] == snum) {
+          last_event[prio] = prev;
+        }
+        events[snum].next = free_event;
+        free_event = snum;
+        --nevents;
+        dropped++;
+      } else {
+        prev = snum;
+      }
+    }
+  }
+#else /* PROCESS_PRIORITY_LEVELS > 1 */
+  process_num_events_t i;
+  process_num_events_t kept;
+
+  /* Move the events that are kept towards the head of the queue */
+  kept = 0;
+  for(i = 0; i < nevents; i++) {
+    snum = (process_num_events_t)(fevent + i) % PROCESS_CONF_NUMEVENTS;
+    if(events[snum].p == p && events[snum].ev == ev &&
+       events[snum].data == data) {
+      dropped++;
+    } else {
+      events[(process_num_events_t)(fevent + kept) % PROCESS_CONF_NUMEVENTS] =
+        events[snum];
+      kept++;
+    }
+  }
+  nevents = kept;
+#endif /* PROCESS_PRIORITY_LEVELS > 1 */
+  return dropped;
+}
+/*---------------------------------------------------------------------------*/
 void
 process_post_synch(struct process *p, process_event_t ev, process_data_t data)
 {
@@ -370,15 +624,51 @@ process_post_synch(struct process *p, process_event_t ev, process_data_t data)
 void
 process_poll(struct process *p)
 {
+#if PROCESS_PRIORITY_LEVELS > 1
+  int_master_status_t status;
+#endif /* PROCESS_PRIORITY_LEVELS > 1 */
+
   if(p != NULL) {
     if(p->state == PROCESS_STATE_RUNNING ||
        p->state == PROCESS_STATE_CALLED) {
+#if PROCESS_PRIORITY_LEVELS > 1
+      status = int_master_read_and_disable();
+      if(!p->needspoll) {
+        p->needspoll = 1;
+        poll_enqueue(p);
+      }
+      int_master_status_set(status);
+#else /* PROCESS_PRIORITY_LEVELS > 1 */
       p->needspoll = 1;
+#endif /* PROCESS_PRIORITY_LEVELS > 1 */
       poll_requested = 1;
     }
   }
 }
 /*---------------------------------------------------------------------------*/
+void
+process_set_priority(struct process *p, unsigned char priority)
+{
+#if PROCESS_PRIORITY_LEVELS > 1
+  int_master_status_t status;
+
+  if(priority > PROCESS_PRIORITY_HIGH) {
+    priority = PROCESS_PRIORITY_HIGH;
+  }
+
+  /* A pending poll request moves along to the new poll queue */
+  status = int_master_read_and_disable();
+  if(p->needspoll) {
+    poll_remove(p);
+    p->priority = priority;
+    poll_enqueue(p);
+  } else {
+    p->priority = priority;
+  }
+  int_master_status_set(status);
+#endif /* PROCESS_PRIORITY_LEVELS > 1 */
+}
+/*---------------------------------------------------------------------------*/
 int
 process_is_running(struct process *p)
 {
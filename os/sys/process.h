@@ -88,6 +88,29 @@ typedef unsigned char process_num_events_t;
 #define PROCESS_CONF_NUMEVENTS 32
 #endif /* PROCESS_CONF_NUMEVENTS */
 
+/**
+ * \name Process priorities
+ *
+ * With more than one priority level, the scheduler keeps one poll
+ * queue and one event queue per level. Pending polls and events of a
+ * higher priority process are always handled before those of a lower
+ * priority process, and only processes that have requested a poll are
+ * visited when polling. With a single level (the default), processes
+ * are scheduled in plain FIFO order.
+ * @{
+ */
+#ifdef PROCESS_CONF_PRIORITY_LEVELS
+#define PROCESS_PRIORITY_LEVELS PROCESS_CONF_PRIORITY_LEVELS
+#else
+#define PROCESS_PRIORITY_LEVELS 1
+#endif /* PROCESS_CONF_PRIORITY_LEVELS */
+
+/** The priority of a process that has not been given one explicitly. */
+#define PROCESS_PRIORITY_NORMAL 0
+/** The highest priority, used for the network stack processes. */
+#define PROCESS_PRIORITY_HIGH   (PROCESS_PRIORITY_LEVELS - 1)
+/** @} */
+
 #define PROCESS_EVENT_NONE            0x80
 #define PROCESS_EVENT_INIT            0x81
 #define PROCESS_EVENT_POLL            0x82
@@ -323,6 +346,10 @@ struct process {
   PT_THREAD((* thread)(struct pt *, process_event_t, process_data_t));
   struct pt pt;
   unsigned char state, needspoll;
+#if PROCESS_PRIORITY_LEVELS > 1
+  struct process *next_poll;
+  unsigned char priority;
+#endif /* PROCESS_PRIORITY_LEVELS > 1 */
 };
 
 /**
@@ -364,6 +391,20 @@ void process_start(struct process *p, process_data_t data);
  */
 int process_post(struct process *p, process_event_t ev, process_data_t data);
 
+/**
+ * Remove events that were posted to a process but not delivered yet.
+ *
+ * \param p The process to which the events were posted.
+ *
+ * \param ev The event.
+ *
+ * \param data The auxiliary data that was posted with the event.
+ *
+ * \return The number of events removed from the event queue.
+ */
+int process_drop_events(struct process *p, process_event_t ev,
+                        process_data_t data);
+
 /**
  * Post a synchronous event to a process.
  *
@@ -389,6 +430,19 @@ void process_post_synch(struct process *p,
  */
 void process_exit(struct process *p);
 
+/**
+ * Set the scheduling priority of a process.
+ *
+ * Processes start out with PROCESS_PRIORITY_NORMAL. Events posted to
+ * the process and poll requests are queued at its priority. The call
+ * has no effect unless PROCESS_CONF_PRIORITY_LEVELS is larger than one.
+ *
+ * \param p The process.
+ * \param priority The priority, from PROCESS_PRIORITY_NORMAL up to
+ * PROCESS_PRIORITY_HIGH.
+ */
+void process_set_priority(struct process *p, unsigned char priority);
+
 
 /**
  * Get a pointer to the currently running process.
@@ -523,6 +577,13 @@ int process_nevents(void);
 
 extern struct process *process_list;
 
+#if PROCESS_CONF_STATS
+/** The largest number of events that have been queued at once. */
+extern process_num_events_t process_maxevents;
+/** The number of events that were dropped because the queue was full. */
+extern unsigned long process_events_dropped;
+#endif /* PROCESS_CONF_STATS */
+
 #define PROCESS_LIST() process_list
 
 #endif /* PROCESS_H_ */
@@ -0,0 +1,42 @@
+#!/bin/bash
+source ../utils.sh
+
+# Contiki directory
+CONTIKI=$1
+
+# Example code directory
+CODE_DIR=$CONTIKI/tests/08-native-runs/code-etimer-benchmark/
+CODE=etimer-benchmark
+
+rm -f $CODE.log $CODE.err
+
+# Run the benchmark with the timer list and with the timer heap
+for HEAP in 0 1; do
+  echo "Running $CODE with ETIMER_HEAP=$HEAP"
+  make -C $CODE_DIR TARGET=native clean > /dev/null
+  make -C $CODE_DIR TARGET=native ETIMER_HEAP=$HEAP > make.log 2> make.err
+  timeout 120 $CODE_DIR/$CODE.native >> $CODE.log 2>> $CODE.err
+done
+
+# Both runs must get to the end
+if grep -q "=check-me= FAILED" $CODE.log || ! grep -q "=check-me= SUCCEEDED" $CODE.log ||
+   [ $(grep -c "5000 timers" $CODE.log) -ne 2 ] ; then
+  echo "==== make.log ====" ; cat make.log;
+  echo "==== make.err ====" ; cat make.err;
+  echo "==== $CODE.log ====" ; cat $CODE.log;
+  echo "==== $CODE.err ====" ; cat $CODE.err;
+
+  printf "%-32s TEST FAIL\n" "$CODE" | tee $CODE.testlog;
+else
+  grep "benchmark\|timers:" $CODE.log
+  printf "%-32s TEST OK\n" "$CODE" | tee $CODE.testlog;
+fi
+
+rm make.log
+rm make.err
+rm $CODE.log
+rm $CODE.err
+
+# We do not want Make to stop -> Return 0
+# The Makefile will check if a log contains FAIL at the end
+exit 0
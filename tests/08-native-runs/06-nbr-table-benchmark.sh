@@ -0,0 +1,46 @@
+#!/bin/bash
+source ../utils.sh
+
+# Contiki directory
+CONTIKI=$1
+
+# Example code directory
+CODE_DIR=$CONTIKI/tests/08-native-runs/code-nbr-table-benchmark/
+CODE=nbr-table-benchmark
+
+rm -f $CODE.log $CODE.err
+
+# Run the benchmark with growing tables, scanned, hashed, and hashed
+# in LRU order
+for SIZE in 16 128 512; do
+  for CONF in "0 0" "1 0" "1 1"; do
+    set -- $CONF
+    HASH=$1
+    LRU=$2
+    echo "Running $CODE with NBR_TABLE_SIZE=$SIZE NBR_TABLE_HASH=$HASH NBR_TABLE_LRU=$LRU"
+    make -C $CODE_DIR TARGET=native clean > /dev/null
+    make -C $CODE_DIR TARGET=native NBR_TABLE_SIZE=$SIZE NBR_TABLE_HASH=$HASH NBR_TABLE_LRU=$LRU > make.log 2> make.err
+    timeout 120 $CODE_DIR/$CODE.native >> $CODE.log 2>> $CODE.err
+  done
+done
+
+if grep -q "=check-me= FAILED" $CODE.log || ! grep -q "=check-me= SUCCEEDED" $CODE.log ; then
+  echo "==== make.log ====" ; cat make.log;
+  echo "==== make.err ====" ; cat make.err;
+  echo "==== $CODE.log ====" ; cat $CODE.log;
+  echo "==== $CODE.err ====" ; cat $CODE.err;
+
+  printf "%-32s TEST FAIL\n" "$CODE" | tee $CODE.testlog;
+else
+  grep "benchmark\|lookups/s\|evictions/s" $CODE.log
+  printf "%-32s TEST OK\n" "$CODE" | tee $CODE.testlog;
+fi
+
+rm make.log
+rm make.err
+rm $CODE.log
+rm $CODE.err
+
+# We do not want Make to stop -> Return 0
+# The Makefile will check if a log contains FAIL at the end
+exit 0
@@ -0,0 +1,41 @@
+#!/bin/bash
+source ../utils.sh
+
+# Contiki directory
+CONTIKI=$1
+
+# Example code directory
+CODE_DIR=$CONTIKI/tests/08-native-runs/code-coap-dispatch-benchmark/
+CODE=coap-dispatch-benchmark
+
+rm -f $CODE.log $CODE.err
+
+# Run the benchmark with a linear walk over the resources, and with
+# hash indexes of growing size
+for HASH_SIZE in 0 16 64; do
+  echo "Running $CODE with COAP_RESOURCE_HASH_SIZE=$HASH_SIZE"
+  make -C $CODE_DIR TARGET=native clean > /dev/null
+  make -C $CODE_DIR TARGET=native COAP_RESOURCE_HASH_SIZE=$HASH_SIZE > make.log 2> make.err
+  timeout 120 $CODE_DIR/$CODE.native >> $CODE.log 2>> $CODE.err
+done
+
+if grep -q "=check-me= FAILED" $CODE.log || ! grep -q "=check-me= SUCCEEDED" $CODE.log ; then
+  echo "==== make.log ====" ; cat make.log;
+  echo "==== make.err ====" ; cat make.err;
+  echo "==== $CODE.log ====" ; cat $CODE.log;
+  echo "==== $CODE.err ====" ; cat $CODE.err;
+
+  printf "%-32s TEST FAIL\n" "$CODE" | tee $CODE.testlog;
+else
+  grep "benchmark\|lookups/s\|requests/s" $CODE.log
+  printf "%-32s TEST OK\n" "$CODE" | tee $CODE.testlog;
+fi
+
+rm make.log
+rm make.err
+rm $CODE.log
+rm $CODE.err
+
+# We do not want Make to stop -> Return 0
+# The Makefile will check if a log contains FAIL at the end
+exit 0
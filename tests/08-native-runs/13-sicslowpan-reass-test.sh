@@ -0,0 +1,44 @@
+#!/bin/bash
+source ../utils.sh
+
+# Contiki directory
+CONTIKI=$1
+
+# Example code directory
+CODE_DIR=$CONTIKI/tests/08-native-runs/code-sicslowpan-reass/
+CODE=sicslowpan-reass-test
+
+rm -f $CODE.log $CODE.err
+
+# Run the test with the default and with the in-place reassembly, with
+# and without fragment forwarding
+for FORWARDING in 0 1; do
+  for DIRECT in 0 1; do
+    echo "Running $CODE with REASS_DIRECT=$DIRECT FRAG_FORWARDING=$FORWARDING"
+    make -C $CODE_DIR TARGET=native clean > /dev/null
+    make -C $CODE_DIR TARGET=native REASS_DIRECT=$DIRECT \
+      FRAG_FORWARDING=$FORWARDING > make.log 2> make.err
+    timeout 120 $CODE_DIR/$CODE.native >> $CODE.log 2>> $CODE.err
+  done
+done
+
+if grep -q "=check-me= FAILED" $CODE.log || ! grep -q "=check-me= SUCCEEDED" $CODE.log ; then
+  echo "==== make.log ====" ; cat make.log;
+  echo "==== make.err ====" ; cat make.err;
+  echo "==== $CODE.log ====" ; cat $CODE.log;
+  echo "==== $CODE.err ====" ; cat $CODE.err;
+
+  printf "%-32s TEST FAIL\n" "$CODE" | tee $CODE.testlog;
+else
+  grep "Reassembly\|Fragmentation" $CODE.log
+  printf "%-32s TEST OK\n" "$CODE" | tee $CODE.testlog;
+fi
+
+rm make.log
+rm make.err
+rm $CODE.log
+rm $CODE.err
+
+# We do not want Make to stop -> Return 0
+# The Makefile will check if a log contains FAIL at the end
+exit 0
@@ -0,0 +1,220 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*---------------------------------------------------------------------------*/
+/**
+ * \file
+ *         Checks the uIP checksum against a byte-wise reference on random
+ *         buffers and packets, and reports its throughput
+ */
+/*---------------------------------------------------------------------------*/
+#include "contiki.h"
+#include "net/ipv6/uip.h"
+#include "lib/random.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+/*---------------------------------------------------------------------------*/
+#define RANDOM_BUFFERS     100000
+#define RANDOM_PACKETS     10000
+#define BENCHMARK_BYTES    (64UL * 1024 * 1024)
+/*---------------------------------------------------------------------------*/
+PROCESS(chksum_benchmark_process, "Checksum benchmark process");
+AUTOSTART_PROCESSES(&chksum_benchmark_process);
+/*---------------------------------------------------------------------------*/
+static uint8_t buf[UIP_BUFSIZE + 8];
+static volatile uint16_t sink;
+/*---------------------------------------------------------------------------*/
+static uint64_t
+now_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+/*---------------------------------------------------------------------------*/
+static void
+check(const char *descr, int success)
+{
+  printf("=check-me= %s - %s\n", success ? "SUCCEEDED" : "FAILED   ", descr);
+}
+/*---------------------------------------------------------------------------*/
+/* The original uIP checksum, one 16-bit word at a time */
+static uint16_t
+reference_chksum(uint16_t sum, const uint8_t *data, uint16_t len)
+{
+  uint16_t t;
+  const uint8_t *dataptr;
+  const uint8_t *last_byte;
+
+  dataptr = data;
+  last_byte = data + len - 1;
+
+  while(dataptr < last_byte) {
+    t = (dataptr[0] << 8) + dataptr[1];
+    sum += t;
+    if(sum < t) {
+      sum++;
+    }
+    dataptr += 2;
+  }
+
+  if(dataptr == last_byte) {
+    t = (dataptr[0] << 8) + 0;
+    sum += t;
+    if(sum < t) {
+      sum++;
+    }
+  }
+
+  return sum;
+}
+/*---------------------------------------------------------------------------*/
+static void
+fill_random(uint8_t *data, uint16_t len)
+{
+  uint16_t i;
+
+  for(i = 0; i < len; i++) {
+    data[i] = random_rand();
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Random lengths at random alignments, plus all-zero and all-ones data */
+static int
+check_buffers(void)
+{
+  uint32_t i;
+  uint16_t len;
+  uint16_t offset;
+
+  for(i = 0; i < RANDOM_BUFFERS; i++) {
+    len = random_rand() % (UIP_BUFSIZE + 1);
+    offset = random_rand() % 8;
+    switch(i % 8) {
+    case 0:
+      memset(buf + offset, 0, len);
+      break;
+    case 1:
+      memset(buf + offset, 0xff, len);
+      break;
+    default:
+      fill_random(buf + offset, len);
+      break;
+    }
+    if(uip_chksum((uint16_t *)(buf + offset), len) !=
+       uip_htons(reference_chksum(0, buf + offset, len))) {
+      printf("mismatch: len %u, offset %u\n", len, offset);
+      return 0;
+    }
+  }
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+/* UDP packets, whose checksum continues from the pseudo-header sum */
+static int
+check_packets(void)
+{
+  uint32_t i;
+  uint16_t len;
+  uint16_t sum;
+
+  for(i = 0; i < RANDOM_PACKETS; i++) {
+    len = UIP_UDPH_LEN + random_rand() % (UIP_BUFSIZE - UIP_IPH_LEN - UIP_UDPH_LEN);
+    fill_random(uip_buf, UIP_IPH_LEN + len);
+    UIP_IP_BUF->vtc = 0x60;
+    UIP_IP_BUF->proto = UIP_PROTO_UDP;
+    uipbuf_set_len_field(UIP_IP_BUF, len);
+    uip_len = UIP_IPH_LEN + len;
+    uip_ext_len = 0;
+
+    sum = len + UIP_PROTO_UDP;
+    sum = reference_chksum(sum, (uint8_t *)&UIP_IP_BUF->srcipaddr,
+                           2 * sizeof(uip_ipaddr_t));
+    sum = reference_chksum(sum, UIP_IP_PAYLOAD(0), len);
+    sum = (sum == 0) ? 0xffff : uip_htons(sum);
+
+    if(uip_udpchksum() != sum) {
+      printf("mismatch: UDP len %u\n", len);
+      return 0;
+    }
+  }
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static void
+benchmark(uint16_t len)
+{
+  unsigned long rounds;
+  unsigned long i;
+  uint64_t start;
+  uint64_t reference_ns;
+  uint64_t uip_ns;
+
+  fill_random(buf, len);
+  rounds = BENCHMARK_BYTES / len;
+
+  start = now_ns();
+  for(i = 0; i < rounds; i++) {
+    sink = reference_chksum(0, buf, len);
+  }
+  reference_ns = now_ns() - start;
+
+  start = now_ns();
+  for(i = 0; i < rounds; i++) {
+    sink = uip_chksum((uint16_t *)buf, len);
+  }
+  uip_ns = now_ns() - start;
+
+  printf("len %4u: reference %5lu MB/s, uip_chksum %5lu MB/s\n", len,
+         (unsigned long)(BENCHMARK_BYTES * 1000 / (reference_ns > 0 ? reference_ns : 1)),
+         (unsigned long)(BENCHMARK_BYTES * 1000 / (uip_ns > 0 ? uip_ns : 1)));
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(chksum_benchmark_process, ev, data)
+{
+  PROCESS_BEGIN();
+
+  printf("checksum benchmark, UIP_ARCH_CHKSUM_ADD=%d\n", UIP_ARCH_CHKSUM_ADD);
+
+  check("Buffer checksums match the reference", check_buffers());
+  check("UDP checksums match the reference", check_packets());
+
+  benchmark(UIP_IPH_LEN);
+  benchmark(128);
+  benchmark(512);
+  benchmark(1280);
+
+  exit(0);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
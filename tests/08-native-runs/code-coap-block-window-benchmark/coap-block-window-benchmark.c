@@ -0,0 +1,440 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*---------------------------------------------------------------------------*/
+/**
+ * \file
+ *         Pipelined blockwise transfer benchmark. Downloads a resource
+ *         over a simulated lossy multi-hop path with several window sizes,
+ *         and checks the blocks that arrive out of order.
+ */
+/*---------------------------------------------------------------------------*/
+#include "contiki.h"
+#include "coap-engine.h"
+#include "coap-block1.h"
+#include "coap-block-window.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+/*---------------------------------------------------------------------------*/
+#define IMAGE_SIZE         16384
+/* Percentage of the messages lost */
+#define LOSS               5
+/* One-way delay of the path, in ms */
+#define MIN_DELAY          300
+#define MAX_DELAY          700
+#define MAX_PENDING        64
+/* The port of the server, the client uses another one */
+#define SERVER_PORT        5683
+#define CLIENT_PORT        1
+/* The block after which a transfer is cancelled */
+#define CANCEL_AFTER       5
+/*---------------------------------------------------------------------------*/
+PROCESS(coap_block_window_benchmark_process, "CoAP block window benchmark process");
+AUTOSTART_PROCESSES(&coap_block_window_benchmark_process);
+/*---------------------------------------------------------------------------*/
+static void res_get_handler(coap_message_t *request, coap_message_t *response,
+                            uint8_t *buffer, uint16_t preferred_size,
+                            int32_t *offset);
+RESOURCE(res_image, "title=\"Image\"", res_get_handler, NULL, NULL, NULL);
+
+/* A message on its way */
+struct pending_message {
+  uint64_t time;
+  uint16_t src_port;
+  uint16_t len;
+  uint8_t data[COAP_MAX_PACKET_SIZE];
+};
+
+static struct pending_message pending[MAX_PENDING];
+static int num_pending;
+
+/* The simulated clock, in ms */
+static uint64_t now;
+
+/* What the client downloaded */
+static uint8_t image[IMAGE_SIZE];
+static uint32_t image_len;
+static int done;
+static int cancel_blocks;
+static coap_request_status_t final_status;
+/*---------------------------------------------------------------------------*/
+static uint8_t
+image_byte(uint32_t i)
+{
+  return (i * 31 + (i >> 8)) & 0xff;
+}
+/*---------------------------------------------------------------------------*/
+static void
+res_get_handler(coap_message_t *request, coap_message_t *response,
+                uint8_t *buffer, uint16_t preferred_size, int32_t *offset)
+{
+  int32_t i;
+  int32_t len;
+
+  if(*offset >= IMAGE_SIZE) {
+    coap_set_status_code(response, BAD_OPTION_4_02);
+    coap_set_payload(response, "BlockOutOfScope", 15);
+    return;
+  }
+  len = MIN(preferred_size, IMAGE_SIZE - *offset);
+  for(i = 0; i < len; i++) {
+    buffer[i] = image_byte(*offset + i);
+  }
+  coap_set_payload(response, buffer, len);
+  *offset += len;
+  if(*offset >= IMAGE_SIZE) {
+    *offset = -1;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+check(const char *descr, int success)
+{
+  printf("=check-me= %s - %s\n", success ? "SUCCEEDED" : "FAILED   ", descr);
+}
+/*---------------------------------------------------------------------------*/
+/*- Simulated clock ---------------------------------------------------------*/
+/*---------------------------------------------------------------------------*/
+static void
+test_timer_init(void)
+{
+}
+/*---------------------------------------------------------------------------*/
+static uint64_t
+test_timer_uptime(void)
+{
+  return now;
+}
+/*---------------------------------------------------------------------------*/
+static void
+test_timer_update(void)
+{
+}
+/*---------------------------------------------------------------------------*/
+const coap_timer_driver_t coap_timer_test_driver = {
+  .init = test_timer_init,
+  .uptime = test_timer_uptime,
+  .update = test_timer_update,
+};
+/*---------------------------------------------------------------------------*/
+/*- Test transport ----------------------------------------------------------*/
+/*---------------------------------------------------------------------------*/
+void
+coap_endpoint_copy(coap_endpoint_t *destination, const coap_endpoint_t *from)
+{
+  memcpy(destination, from, sizeof(coap_endpoint_t));
+}
+/*---------------------------------------------------------------------------*/
+int
+coap_endpoint_cmp(const coap_endpoint_t *e1, const coap_endpoint_t *e2)
+{
+  return e1->port == e2->port;
+}
+/*---------------------------------------------------------------------------*/
+void
+coap_endpoint_log(const coap_endpoint_t *ep)
+{
+}
+/*---------------------------------------------------------------------------*/
+void
+coap_endpoint_print(const coap_endpoint_t *ep)
+{
+}
+/*---------------------------------------------------------------------------*/
+int
+coap_endpoint_is_secure(const coap_endpoint_t *ep)
+{
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+void
+coap_transport_init(void)
+{
+}
+/*---------------------------------------------------------------------------*/
+/* Send the message over the simulated path, which may lose it, delay it
+ * and reorder it */
+int
+coap_sendto(const coap_endpoint_t *ep, const uint8_t *data, uint16_t length)
+{
+  struct pending_message *m;
+
+  if(rand() % 100 < LOSS || num_pending == MAX_PENDING) {
+    return length;
+  }
+  m = &pending[num_pending++];
+  m->time = now + MIN_DELAY + rand() % (MAX_DELAY - MIN_DELAY + 1);
+  /* Messages to the server come from the client and vice versa */
+  m->src_port = ep->port == SERVER_PORT ? CLIENT_PORT : SERVER_PORT;
+  m->len = length;
+  memcpy(m->data, data, length);
+  return length;
+}
+/*---------------------------------------------------------------------------*/
+static void
+deliver_messages(void)
+{
+  static struct pending_message m;
+  coap_endpoint_t ep;
+  int i;
+
+  memset(&ep, 0, sizeof(ep));
+  for(i = 0; i < num_pending;) {
+    if(pending[i].time > now) {
+      i++;
+      continue;
+    }
+    m = pending[i];
+    pending[i] = pending[--num_pending];
+    ep.port = m.src_port;
+    coap_receive(&ep, m.data, m.len);
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Run the simulation until *flag is set, or until nothing is left to do
+   or the deadline is reached */
+static void
+run_until(const int *flag, uint64_t deadline)
+{
+  uint64_t next;
+  int i;
+
+  while(!*flag && now < deadline) {
+    if(num_pending == 0 && !coap_timer_time_to_next_expiration()
+       && !coap_timer_run()) {
+      break;
+    }
+    next = now + coap_timer_time_to_next_expiration();
+    for(i = 0; i < num_pending; i++) {
+      if(pending[i].time < next) {
+        next = pending[i].time;
+      }
+    }
+    now = next;
+    deliver_messages();
+    while(coap_timer_run());
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+download_callback(coap_block_window_request_t *request, uint32_t offset,
+                  const uint8_t *data, uint16_t len)
+{
+  if(request->status == COAP_REQUEST_STATUS_MORE) {
+    if(offset + len <= IMAGE_SIZE) {
+      memcpy(image + offset, data, len);
+    }
+    if(offset + len > image_len) {
+      image_len = offset + len;
+    }
+  } else {
+    final_status = request->status;
+    done = 1;
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Download the image and return the time it took, in ms */
+static uint64_t
+run_download(coap_message_type_t type, uint8_t window)
+{
+  static coap_block_window_request_t request;
+  coap_transmission_stats_t stats;
+  coap_endpoint_t ep;
+  uint64_t start = now;
+  int success;
+  int i;
+
+  memset(&ep, 0, sizeof(ep));
+  ep.port = SERVER_PORT;
+  memset(image, 0, sizeof(image));
+  image_len = 0;
+  done = 0;
+  coap_reset_transmission_stats();
+
+  if(!coap_block_window_get(&request, &ep, "image", type, window,
+                            download_callback)) {
+    check("the download starts", 0);
+    return 0;
+  }
+  run_until(&done, UINT64_MAX);
+  /* Drop what is still on its way */
+  num_pending = 0;
+
+  coap_get_transmission_stats(&stats);
+  printf("%s window %u: %lu blocks in %lu.%lu s, %lu out of order, "
+         "%lu duplicates, %lu retransmitted\n",
+         type == COAP_TYPE_CON ? "CON" : "NON", window,
+         (unsigned long)request.blocks,
+         (unsigned long)((now - start) / 1000),
+         (unsigned long)((now - start) / 100 % 10),
+         (unsigned long)request.out_of_order,
+         (unsigned long)request.duplicates,
+         (unsigned long)(request.retransmissions + stats.retransmissions));
+
+  success = final_status == COAP_REQUEST_STATUS_FINISHED
+    && image_len == IMAGE_SIZE;
+  for(i = 0; i < IMAGE_SIZE; i++) {
+    success &= image[i] == image_byte(i);
+  }
+  check("the image is downloaded", success);
+  return now - start;
+}
+/*---------------------------------------------------------------------------*/
+static void
+cancel_callback(coap_block_window_request_t *request, uint32_t offset,
+                const uint8_t *data, uint16_t len)
+{
+  if(request->status == COAP_REQUEST_STATUS_MORE) {
+    if(++cancel_blocks == CANCEL_AFTER) {
+      coap_block_window_cancel(request);
+    }
+  } else {
+    /* The transfer was cancelled, it must not end */
+    done = 1;
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Cancel a pipelined transfer from its callback */
+static void
+check_cancel(void)
+{
+  static coap_block_window_request_t request;
+  coap_table_stats_t stats;
+  coap_endpoint_t ep;
+
+  memset(&ep, 0, sizeof(ep));
+  ep.port = SERVER_PORT;
+  done = 0;
+  cancel_blocks = 0;
+  if(!coap_block_window_get(&request, &ep, "image", COAP_TYPE_CON, 8,
+                            cancel_callback)) {
+    check("the transfer to cancel starts", 0);
+    return;
+  }
+  /* Until the late responses are in and their retransmissions over */
+  run_until(&done, now + 300 * 1000);
+  num_pending = 0;
+
+  coap_get_transaction_stats(&stats);
+  check("a transfer cancelled from its callback stops",
+        cancel_blocks == CANCEL_AFTER && !done && !request.active
+        && stats.used == 0);
+}
+/*---------------------------------------------------------------------------*/
+static void
+bench_downloads(coap_message_type_t type)
+{
+  uint64_t stop_and_wait = run_download(type, 1);
+  uint64_t pipelined = run_download(type, 4);
+
+  run_download(type, 8);
+  check("a window of four is more than twice as fast",
+        pipelined * 2 < stop_and_wait);
+}
+/*---------------------------------------------------------------------------*/
+static void
+check_tracker(void)
+{
+  coap_block_tracker_t tracker;
+
+  coap_block_tracker_init(&tracker);
+  check("blocks are tracked in any order",
+        coap_block_tracker_add(&tracker, 2, 1) == 1
+        && coap_block_tracker_add(&tracker, 3, 0) == 1
+        && coap_block_tracker_add(&tracker, 2, 1) == 0
+        && !coap_block_tracker_is_complete(&tracker)
+        && coap_block_tracker_add(&tracker, 0, 1) == 1
+        && tracker.base == 1
+        && coap_block_tracker_add(&tracker, 1, 1) == 1
+        && tracker.base == 4
+        && coap_block_tracker_is_complete(&tracker)
+        && coap_block_tracker_add(&tracker, 1, 1) == 0);
+
+  coap_block_tracker_init(&tracker);
+  check("blocks too far ahead are refused",
+        coap_block_tracker_add(&tracker, COAP_BLOCK_TRACKER_WINDOW, 1) == -1
+        && coap_block_tracker_add(&tracker, COAP_BLOCK_TRACKER_WINDOW - 1, 1) == 1);
+}
+/*---------------------------------------------------------------------------*/
+/* Upload three blocks in reverse order to the server side handler */
+static void
+check_block1_window(void)
+{
+  static uint8_t buffer[3 * 16];
+  static uint8_t target[3 * 16];
+  coap_block_tracker_t tracker;
+  coap_message_t request[1];
+  coap_message_t response[1];
+  size_t len = 0;
+  int results[3];
+  int num;
+  int i;
+
+  for(i = 0; i < sizeof(buffer); i++) {
+    buffer[i] = i;
+  }
+  coap_block_tracker_init(&tracker);
+  for(num = 2; num >= 0; num--) {
+    coap_init_message(request, COAP_TYPE_CON, COAP_PUT, 0);
+    coap_set_header_block1(request, num, num < 2, 16);
+    request->block1_offset = num * 16;
+    coap_set_payload(request, buffer + num * 16, 16);
+    coap_init_message(response, COAP_TYPE_ACK, CHANGED_2_04, 0);
+    results[num] = coap_block1_window_handler(request, response, &tracker,
+                                              target, &len, sizeof(target));
+  }
+  check("pipelined uploads complete with the last block in",
+        results[2] == 1 && results[1] == 1 && results[0] == 0
+        && len == sizeof(target) && memcmp(target, buffer, len) == 0);
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(coap_block_window_benchmark_process, ev, data)
+{
+  PROCESS_BEGIN();
+
+  printf("CoAP block window benchmark: %u bytes, %u-%u ms one way, %u%% loss\n",
+         IMAGE_SIZE, MIN_DELAY, MAX_DELAY, LOSS);
+
+  srand(1);
+  coap_engine_init();
+  coap_activate_resource(&res_image, "image");
+
+  check_tracker();
+  check_block1_window();
+  check_cancel();
+  bench_downloads(COAP_TYPE_CON);
+  bench_downloads(COAP_TYPE_NON);
+
+  printf("DONE\n");
+  exit(0);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
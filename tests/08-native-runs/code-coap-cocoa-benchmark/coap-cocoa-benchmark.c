@@ -0,0 +1,395 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*---------------------------------------------------------------------------*/
+/**
+ * \file
+ *         CoAP retransmission benchmark. Sends confirmable requests over
+ *         simulated lossy one-hop and six-hop paths and reports how often
+ *         they are retransmitted, with the default retransmission timeout
+ *         or with CoCoA.
+ */
+/*---------------------------------------------------------------------------*/
+#include "contiki.h"
+#include "coap-engine.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+/*---------------------------------------------------------------------------*/
+#define REQUESTS           400
+/* Percentage of the messages lost in each direction */
+#define LOSS               10
+#define MAX_PENDING        32
+/*---------------------------------------------------------------------------*/
+PROCESS(coap_cocoa_benchmark_process, "CoAP CoCoA benchmark process");
+AUTOSTART_PROCESSES(&coap_cocoa_benchmark_process);
+/*---------------------------------------------------------------------------*/
+/* A simulated path, identified by the port of its endpoint */
+struct path {
+  const char *name;
+  uint16_t port;
+  uint32_t min_rtt;
+  uint32_t max_rtt;
+  /* Bounds on the mean latency per request, in ms, with the default
+   * RTO and with CoCoA */
+  uint32_t max_latency[2];
+};
+
+/* CoCoA cuts the one-hop latency but makes the six-hop one worse: the
+ * weak samples of retransmitted requests push the learned RTO above the
+ * RTT, so a lost request waits longer before its retransmission. */
+static const struct path paths[] = {
+  { "1-hop", 1, 60, 140, { 1200, 300 } },
+  { "6-hop", 6, 3000, 5000, { 5500, 6500 } },
+};
+
+/* An ACK on its way back */
+struct pending_ack {
+  uint64_t time;
+  uint16_t mid;
+  uint16_t port;
+};
+
+static struct pending_ack pending[MAX_PENDING];
+static int num_pending;
+
+/* The simulated clock, in ms */
+static uint64_t now;
+
+/* The request in progress */
+static const struct path *current_path;
+static int ack_in_flight;
+static int done;
+static int completed;
+static int timeouts;
+static unsigned sent;
+static unsigned spurious;
+/*---------------------------------------------------------------------------*/
+static void
+check(const char *descr, int success)
+{
+  printf("=check-me= %s - %s\n", success ? "SUCCEEDED" : "FAILED   ", descr);
+}
+/*---------------------------------------------------------------------------*/
+/*- Simulated clock ---------------------------------------------------------*/
+/*---------------------------------------------------------------------------*/
+static void
+test_timer_init(void)
+{
+}
+/*---------------------------------------------------------------------------*/
+static uint64_t
+test_timer_uptime(void)
+{
+  return now;
+}
+/*---------------------------------------------------------------------------*/
+static void
+test_timer_update(void)
+{
+}
+/*---------------------------------------------------------------------------*/
+const coap_timer_driver_t coap_timer_test_driver = {
+  .init = test_timer_init,
+  .uptime = test_timer_uptime,
+  .update = test_timer_update,
+};
+/*---------------------------------------------------------------------------*/
+/*- Test transport ----------------------------------------------------------*/
+/*---------------------------------------------------------------------------*/
+void
+coap_endpoint_copy(coap_endpoint_t *destination, const coap_endpoint_t *from)
+{
+  memcpy(destination, from, sizeof(coap_endpoint_t));
+}
+/*---------------------------------------------------------------------------*/
+int
+coap_endpoint_cmp(const coap_endpoint_t *e1, const coap_endpoint_t *e2)
+{
+  return e1->port == e2->port;
+}
+/*---------------------------------------------------------------------------*/
+void
+coap_endpoint_log(const coap_endpoint_t *ep)
+{
+}
+/*---------------------------------------------------------------------------*/
+void
+coap_endpoint_print(const coap_endpoint_t *ep)
+{
+}
+/*---------------------------------------------------------------------------*/
+int
+coap_endpoint_is_secure(const coap_endpoint_t *ep)
+{
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+void
+coap_transport_init(void)
+{
+}
+/*---------------------------------------------------------------------------*/
+/* Send the request over the simulated path, which may lose it or its ACK */
+int
+coap_sendto(const coap_endpoint_t *ep, const uint8_t *data, uint16_t length)
+{
+  uint32_t rtt;
+
+  sent++;
+  if(ack_in_flight) {
+    /* The ACK of an earlier copy is on its way, this one is not needed */
+    spurious++;
+  }
+  /* Lose the request or its ACK */
+  if(rand() % 100 < LOSS || rand() % 100 < LOSS
+     || num_pending == MAX_PENDING) {
+    return length;
+  }
+  ack_in_flight = 1;
+  rtt = current_path->min_rtt
+    + rand() % (current_path->max_rtt - current_path->min_rtt + 1);
+  pending[num_pending].time = now + rtt;
+  pending[num_pending].mid = (data[2] << 8) | data[3];
+  pending[num_pending].port = ep->port;
+  num_pending++;
+  return length;
+}
+/*---------------------------------------------------------------------------*/
+static void
+deliver_acks(void)
+{
+  coap_endpoint_t ep;
+  uint8_t ack[4];
+  int i;
+
+  memset(&ep, 0, sizeof(ep));
+  for(i = 0; i < num_pending;) {
+    if(pending[i].time > now) {
+      i++;
+      continue;
+    }
+    ack[0] = (COAP_HEADER_VERSION_MASK & (1 << COAP_HEADER_VERSION_POSITION))
+      | (COAP_TYPE_ACK << COAP_HEADER_TYPE_POSITION);
+    ack[1] = 0;
+    ack[2] = pending[i].mid >> 8;
+    ack[3] = pending[i].mid;
+    ep.port = pending[i].port;
+    pending[i] = pending[--num_pending];
+    coap_receive(&ep, ack, sizeof(ack));
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+request_callback(void *data, coap_message_t *response)
+{
+  done = 1;
+  if(response != NULL) {
+    completed++;
+  } else {
+    timeouts++;
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Send a confirmable request and run the clock until it completes */
+static uint64_t
+run_request(const struct path *path)
+{
+  coap_message_t request[1];
+  coap_transaction_t *t;
+  coap_endpoint_t ep;
+  uint64_t start = now;
+  uint64_t next;
+  uint16_t mid;
+  int i;
+
+  memset(&ep, 0, sizeof(ep));
+  ep.port = path->port;
+  current_path = path;
+  mid = coap_get_mid();
+  ack_in_flight = 0;
+  done = 0;
+
+  coap_init_message(request, COAP_TYPE_CON, COAP_GET, mid);
+  coap_set_header_uri_path(request, "sensor");
+  t = coap_new_transaction(mid, &ep);
+  if(t == NULL) {
+    return 0;
+  }
+  t->callback = request_callback;
+  t->message_len = coap_serialize_message(request, t->message);
+  coap_send_transaction(t);
+
+  while(!done) {
+    next = now + coap_timer_time_to_next_expiration();
+    for(i = 0; i < num_pending; i++) {
+      if(pending[i].time < next) {
+        next = pending[i].time;
+      }
+    }
+    now = next;
+    deliver_acks();
+    while(coap_timer_run());
+  }
+  /* Late ACKs of the request find no transaction, drop them */
+  num_pending = 0;
+  return now - start;
+}
+/*---------------------------------------------------------------------------*/
+static void
+bench_path(const struct path *path)
+{
+  coap_transmission_stats_t stats;
+  uint64_t total = 0;
+  uint64_t latency;
+  uint64_t max = 0;
+  int i;
+
+  coap_reset_transmission_stats();
+  completed = timeouts = 0;
+  sent = spurious = 0;
+  for(i = 0; i < REQUESTS; i++) {
+    latency = run_request(path);
+    total += latency;
+    if(latency > max) {
+      max = latency;
+    }
+    /* Leave some idle time between requests */
+    now += 1000;
+  }
+  coap_get_transmission_stats(&stats);
+
+  printf("%s: %u requests, %lu.%lu%% retransmitted, %u spurious, "
+         "%d timeouts, %lu ms per request, %lu ms at most\n", path->name,
+         REQUESTS,
+         (unsigned long)(stats.retransmissions * 100 / stats.transmissions),
+         (unsigned long)(stats.retransmissions * 1000 / stats.transmissions % 10),
+         spurious, timeouts, (unsigned long)(total / REQUESTS),
+         (unsigned long)max);
+  printf("%s: initial RTO (ms)", path->name);
+  for(i = 0; i < COAP_RTO_STATS_BINS - 1; i++) {
+    printf(" <%lu:%lu", 250UL << i, (unsigned long)stats.rto[i]);
+  }
+  printf(" >=%lu:%lu\n", 250UL << (i - 1), (unsigned long)stats.rto[i]);
+
+  check("every request completes or times out",
+        completed + timeouts == REQUESTS && stats.timeouts == timeouts);
+  check("statistics count the transmissions",
+        stats.transmissions == REQUESTS
+        && stats.transmissions + stats.retransmissions == sent);
+  check("the latency per request is bounded",
+        total / REQUESTS < path->max_latency[COAP_WITH_COCOA ? 1 : 0]);
+}
+/*---------------------------------------------------------------------------*/
+#if COAP_WITH_COCOA
+static void
+check_estimator(void)
+{
+  coap_cocoa_state_t state;
+  coap_endpoint_t ep;
+  int success;
+  int i;
+
+  memset(&ep, 0, sizeof(ep));
+  ep.port = paths[0].port;
+  success = coap_cocoa_get_state(&ep, &state);
+  printf("%s: RTO %lu ms after %u strong and %u weak samples\n",
+         paths[0].name, (unsigned long)state.rto, state.strong_samples,
+         state.weak_samples);
+  check("the one-hop RTO is learned", success && state.strong_samples > 0
+        && state.rto < 1000);
+
+  /* The estimate of an idle endpoint ages towards the default */
+  now += 16 * state.rto + 1;
+  check("short RTOs age", coap_cocoa_get_state(&ep, &state)
+        && state.rto < 2000);
+
+  ep.port = paths[1].port;
+  success = coap_cocoa_get_state(&ep, &state);
+  printf("%s: RTO %lu ms after %u strong and %u weak samples\n",
+         paths[1].name, (unsigned long)state.rto, state.strong_samples,
+         state.weak_samples);
+  check("the six-hop RTO is learned", success && state.strong_samples > 0
+        && state.rto > COAP_COCOA_DEFAULT_RTO);
+
+  /* A first strong sample of 100 ms: SRTT 100, RTTVAR 50, RTO 300 ms,
+   * blended with the default */
+  ep.port = 9;
+  coap_cocoa_update(&ep, 100, 0);
+  check("strong samples update the RTO", coap_cocoa_get_state(&ep, &state)
+        && state.rto == (COAP_COCOA_DEFAULT_RTO + 300) / 2);
+  coap_cocoa_update(&ep, 100, COAP_COCOA_MAX_WEAK_RETRANSMIT + 1);
+  check("ambiguous samples are ignored", coap_cocoa_get_state(&ep, &state)
+        && state.strong_samples == 1 && state.weak_samples == 0);
+
+  check("the backoff depends on the initial RTO",
+        coap_cocoa_backoff(1000, 500) == 3000
+        && coap_cocoa_backoff(1000, 2000) == 2000
+        && coap_cocoa_backoff(1000, 4000) == 1500);
+
+  /* New endpoints replace the least recently used ones */
+  for(i = 0; i < COAP_COCOA_ENDPOINTS; i++) {
+    ep.port = 20 + i;
+    coap_cocoa_update(&ep, 100, 0);
+  }
+  success = 1;
+  for(i = 0; i < COAP_COCOA_ENDPOINTS; i++) {
+    ep.port = 20 + i;
+    success &= coap_cocoa_get_state(&ep, &state);
+  }
+  ep.port = 9;
+  success &= !coap_cocoa_get_state(&ep, &state);
+  check("the endpoint cache replaces the least recently used", success);
+}
+#endif /* COAP_WITH_COCOA */
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(coap_cocoa_benchmark_process, ev, data)
+{
+  int i;
+
+  PROCESS_BEGIN();
+
+  printf("CoAP retransmission benchmark: %s, %u%% loss\n",
+         COAP_WITH_COCOA ? "CoCoA" : "default RTO", LOSS);
+
+  srand(1);
+  coap_engine_init();
+  for(i = 0; i < sizeof(paths) / sizeof(paths[0]); i++) {
+    bench_path(&paths[i]);
+  }
+#if COAP_WITH_COCOA
+  check_estimator();
+#endif /* COAP_WITH_COCOA */
+
+  printf("DONE\n");
+  exit(0);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,217 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*---------------------------------------------------------------------------*/
+/**
+ * \file
+ *         CoAP request dispatch benchmark, which also checks that requests
+ *         reach the same resources as with a linear walk
+ */
+/*---------------------------------------------------------------------------*/
+#include "contiki.h"
+#include "coap-engine.h"
+#include "lib/random.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+/*---------------------------------------------------------------------------*/
+/* Resources of IPSO objects, as exposed by a gateway */
+#define NUM_OBJECTS        16
+#define NUM_INSTANCES      4
+#define NUM_RESOURCES      4
+#define NUM_LEAVES         (NUM_OBJECTS * NUM_INSTANCES * NUM_RESOURCES)
+#define PATH_LEN           24
+#define REQUESTS           200000
+/*---------------------------------------------------------------------------*/
+PROCESS(coap_dispatch_benchmark_process, "CoAP dispatch benchmark process");
+AUTOSTART_PROCESSES(&coap_dispatch_benchmark_process);
+/*---------------------------------------------------------------------------*/
+RESOURCE(res_leaf_template, "", NULL, NULL, NULL, NULL);
+static coap_resource_t leaves[NUM_LEAVES];
+static char leaf_paths[NUM_LEAVES][PATH_LEN];
+
+/* Sub-resource semantics: the first activated match wins */
+PARENT_RESOURCE(res_fw, "", NULL, NULL, NULL, NULL);
+RESOURCE(res_fw_state, "", NULL, NULL, NULL, NULL);
+RESOURCE(res_dev_name, "", NULL, NULL, NULL, NULL);
+PARENT_RESOURCE(res_dev, "", NULL, NULL, NULL, NULL);
+PARENT_RESOURCE(res_dev_sub, "", NULL, NULL, NULL, NULL);
+
+extern coap_resource_t res_well_known_core;
+/*---------------------------------------------------------------------------*/
+static uint64_t
+now_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+/*---------------------------------------------------------------------------*/
+static void
+check(const char *descr, int success)
+{
+  printf("=check-me= %s - %s\n", success ? "SUCCEEDED" : "FAILED   ", descr);
+}
+/*---------------------------------------------------------------------------*/
+static int
+dispatches_to(const char *path, const coap_resource_t *expected)
+{
+  return coap_get_resource_by_path(path, strlen(path)) == expected;
+}
+/*---------------------------------------------------------------------------*/
+static void
+activate_resources(void)
+{
+  int i;
+
+  for(i = 0; i < NUM_LEAVES; i++) {
+    leaves[i] = res_leaf_template;
+    snprintf(leaf_paths[i], PATH_LEN, "%u/%u/%u",
+             3300 + i / (NUM_INSTANCES * NUM_RESOURCES),
+             (i / NUM_RESOURCES) % NUM_INSTANCES,
+             5700 + i % NUM_RESOURCES);
+    coap_activate_resource(&leaves[i], leaf_paths[i]);
+  }
+
+  coap_activate_resource(&res_fw, "fw");
+  coap_activate_resource(&res_fw_state, "fw/state");
+  coap_activate_resource(&res_dev_name, "dev/name");
+  coap_activate_resource(&res_dev, "dev");
+  coap_activate_resource(&res_dev_sub, "dev/sub");
+}
+/*---------------------------------------------------------------------------*/
+static void
+check_dispatch(void)
+{
+  int i;
+  int success = 1;
+
+  for(i = 0; i < NUM_LEAVES; i++) {
+    success &= dispatches_to(leaf_paths[i], &leaves[i]);
+  }
+  check("every resource is found at its path", success);
+
+  check("unknown paths are not found",
+        dispatches_to("3300/0", NULL)
+        && dispatches_to("3300/0/5700/1", NULL)
+        && dispatches_to("9999/0/5700", NULL)
+        && dispatches_to("", NULL));
+
+  check("parents handle their sub-resources",
+        dispatches_to("fw", &res_fw)
+        && dispatches_to("fw/package", &res_fw)
+        && dispatches_to("fw/a/b/c", &res_fw)
+        && dispatches_to("fwx", NULL)
+        && dispatches_to("dev/other", &res_dev));
+
+  check("the first activated resource wins",
+        dispatches_to("fw/state", &res_fw)
+        && dispatches_to("dev/name", &res_dev_name)
+        && dispatches_to("dev/sub", &res_dev)
+        && dispatches_to("dev/sub/x", &res_dev));
+
+  check("the well-known core resource is found",
+        dispatches_to(".well-known/core", &res_well_known_core));
+}
+/*---------------------------------------------------------------------------*/
+/* Look up the paths of random resources */
+static void
+bench_lookups(void)
+{
+  uint64_t start, total;
+  unsigned found = 0;
+  int i;
+
+  start = now_ns();
+  for(i = 0; i < REQUESTS; i++) {
+    const char *path = leaf_paths[random_rand() % NUM_LEAVES];
+    found += coap_get_resource_by_path(path, strlen(path)) != NULL;
+  }
+  total = now_ns() - start;
+  printf("hash size %u: %lu lookups/s\n", COAP_RESOURCE_HASH_SIZE,
+         (unsigned long)(REQUESTS * 1000000000ULL / (total > 0 ? total : 1)));
+  check("lookups find their resource", found == REQUESTS);
+}
+/*---------------------------------------------------------------------------*/
+/* Parse requests for random resources and find the resource they are
+ * dispatched to, as the engine does */
+static void
+bench_requests(void)
+{
+  static uint8_t serialized[NUM_LEAVES][COAP_MAX_HEADER_SIZE];
+  static uint16_t serialized_len[NUM_LEAVES];
+  uint8_t buffer[COAP_MAX_HEADER_SIZE];
+  coap_message_t message[1];
+  uint64_t start, total;
+  unsigned found = 0;
+  const char *path;
+  int i;
+
+  for(i = 0; i < NUM_LEAVES; i++) {
+    coap_init_message(message, COAP_TYPE_CON, COAP_GET, i);
+    coap_set_header_uri_path(message, leaf_paths[i]);
+    serialized_len[i] = coap_serialize_message(message, serialized[i]);
+  }
+
+  start = now_ns();
+  for(i = 0; i < REQUESTS; i++) {
+    int index = random_rand() % NUM_LEAVES;
+    /* Parsing merges the Uri-Path options in place */
+    memcpy(buffer, serialized[index], serialized_len[index]);
+    if(coap_parse_message(message, buffer, serialized_len[index]) == NO_ERROR) {
+      int path_len = coap_get_header_uri_path(message, &path);
+      found += coap_get_resource_by_path(path, path_len) == &leaves[index];
+    }
+  }
+  total = now_ns() - start;
+  printf("hash size %u: %lu requests/s\n", COAP_RESOURCE_HASH_SIZE,
+         (unsigned long)(REQUESTS * 1000000000ULL / (total > 0 ? total : 1)));
+  check("requests are dispatched to their resource", found == REQUESTS);
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(coap_dispatch_benchmark_process, ev, data)
+{
+  PROCESS_BEGIN();
+
+  printf("CoAP dispatch benchmark: %u resources\n", NUM_LEAVES + 6);
+
+  coap_engine_init();
+  activate_resources();
+  check_dispatch();
+  bench_lookups();
+  bench_requests();
+
+  printf("DONE\n");
+  exit(0);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,267 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*---------------------------------------------------------------------------*/
+/**
+ * \file
+ *         CoAP observe notification benchmark, which also checks that
+ *         every observer gets the notification with its own token and
+ *         Observe value
+ */
+/*---------------------------------------------------------------------------*/
+#include "contiki.h"
+#include "coap-engine.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+/*---------------------------------------------------------------------------*/
+#define NUM_OBSERVERS      24
+#define CHECKED_ROUNDS     300
+#define ROUNDS             20000
+/*---------------------------------------------------------------------------*/
+PROCESS(coap_observe_benchmark_process, "CoAP observe benchmark process");
+AUTOSTART_PROCESSES(&coap_observe_benchmark_process);
+/*---------------------------------------------------------------------------*/
+static void res_get_handler(coap_message_t *request, coap_message_t *response,
+                            uint8_t *buffer, uint16_t preferred_size,
+                            int32_t *offset);
+EVENT_RESOURCE(res_sensor, "obs", res_get_handler, NULL, NULL, NULL, NULL);
+
+static unsigned handler_calls;
+static unsigned value;
+
+/* What the test transport received */
+static int is_checking;
+static unsigned received[NUM_OBSERVERS];
+static uint32_t last_observe[NUM_OBSERVERS];
+static unsigned errors;
+static unsigned sent;
+/*---------------------------------------------------------------------------*/
+static void
+res_get_handler(coap_message_t *request, coap_message_t *response,
+                uint8_t *buffer, uint16_t preferred_size, int32_t *offset)
+{
+  handler_calls++;
+  coap_set_header_content_format(response, TEXT_PLAIN);
+  coap_set_header_max_age(response, 30);
+  coap_set_payload(response, buffer,
+                   snprintf((char *)buffer, preferred_size,
+                            "sensor value %u", value));
+}
+/*---------------------------------------------------------------------------*/
+static uint64_t
+now_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+/*---------------------------------------------------------------------------*/
+static void
+check(const char *descr, int success)
+{
+  printf("=check-me= %s - %s\n", success ? "SUCCEEDED" : "FAILED   ", descr);
+}
+/*---------------------------------------------------------------------------*/
+/*- Test transport ----------------------------------------------------------*/
+/*---------------------------------------------------------------------------*/
+void
+coap_endpoint_copy(coap_endpoint_t *destination, const coap_endpoint_t *from)
+{
+  memcpy(destination, from, sizeof(coap_endpoint_t));
+}
+/*---------------------------------------------------------------------------*/
+int
+coap_endpoint_cmp(const coap_endpoint_t *e1, const coap_endpoint_t *e2)
+{
+  return e1->port == e2->port;
+}
+/*---------------------------------------------------------------------------*/
+void
+coap_endpoint_log(const coap_endpoint_t *ep)
+{
+}
+/*---------------------------------------------------------------------------*/
+void
+coap_endpoint_print(const coap_endpoint_t *ep)
+{
+}
+/*---------------------------------------------------------------------------*/
+int
+coap_endpoint_is_secure(const coap_endpoint_t *ep)
+{
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+void
+coap_transport_init(void)
+{
+}
+/*---------------------------------------------------------------------------*/
+/* Check each notification against the observer it is sent to */
+int
+coap_sendto(const coap_endpoint_t *ep, const uint8_t *data, uint16_t length)
+{
+  static uint8_t buffer[COAP_MAX_PACKET_SIZE];
+  coap_message_t message[1];
+  const uint8_t *payload;
+  char expected[32];
+  uint32_t observe;
+  int len;
+  int i = ep->port;
+
+  sent++;
+  if(!is_checking) {
+    return length;
+  }
+
+  memcpy(buffer, data, length);
+  if(i >= NUM_OBSERVERS
+     || coap_parse_message(message, buffer, length) != NO_ERROR
+     || message->type != COAP_TYPE_NON
+     || message->code != CONTENT_2_05
+     || message->token_len != 2
+     || message->token[0] != 0xab || message->token[1] != i
+     || !coap_get_header_observe(message, &observe)
+     || observe != last_observe[i] + 1
+     || message->content_format != TEXT_PLAIN
+     || message->max_age != 30) {
+    errors++;
+    return length;
+  }
+  len = snprintf(expected, sizeof(expected), "sensor value %u", value);
+  if(coap_get_payload(message, &payload) != len
+     || memcmp(payload, expected, len) != 0) {
+    errors++;
+    return length;
+  }
+  last_observe[i] = observe;
+  received[i]++;
+  return length;
+}
+/*---------------------------------------------------------------------------*/
+static void
+add_observers(void)
+{
+  coap_message_t request[1];
+  coap_message_t response[1];
+  coap_endpoint_t ep;
+  uint8_t token[2];
+  int i;
+
+  memset(&ep, 0, sizeof(ep));
+  for(i = 0; i < NUM_OBSERVERS; i++) {
+    ep.port = i;
+    token[0] = 0xab;
+    token[1] = i;
+    coap_init_message(request, COAP_TYPE_CON, COAP_GET, i);
+    coap_set_header_uri_path(request, "sensor");
+    coap_set_header_observe(request, 0);
+    coap_set_token(request, token, sizeof(token));
+    coap_set_src_endpoint(request, &ep);
+    coap_init_message(response, COAP_TYPE_ACK, CONTENT_2_05, i);
+    coap_observe_handler(&res_sensor, request, response);
+    /* The registration response carries the first Observe value */
+    coap_get_header_observe(response, &last_observe[i]);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+check_notifications(void)
+{
+  coap_observe_stats_t stats;
+  int success = 1;
+  int i;
+
+  is_checking = 1;
+  handler_calls = 0;
+  coap_observe_reset_stats();
+  for(value = 0; value < CHECKED_ROUNDS; value++) {
+    coap_notify_observers(&res_sensor);
+  }
+  is_checking = 0;
+
+  for(i = 0; i < NUM_OBSERVERS; i++) {
+    success &= received[i] == CHECKED_ROUNDS;
+  }
+  check("every observer gets every notification", success && errors == 0);
+  check("Observe values grow past one byte", last_observe[0] > 0xff);
+  check("the handler runs once per notification", handler_calls == CHECKED_ROUNDS);
+
+  coap_observe_get_stats(&stats);
+  check("statistics count the notifications",
+        stats.notifications == CHECKED_ROUNDS * NUM_OBSERVERS
+        && stats.renders == CHECKED_ROUNDS
+        && stats.bytes_saved > 0);
+}
+/*---------------------------------------------------------------------------*/
+static void
+bench_notifications(void)
+{
+  coap_observe_stats_t stats;
+  uint64_t start, total;
+  int round;
+
+  coap_observe_reset_stats();
+  sent = 0;
+  start = now_ns();
+  for(round = 0; round < ROUNDS; round++) {
+    coap_notify_observers(&res_sensor);
+  }
+  total = now_ns() - start;
+  coap_observe_get_stats(&stats);
+
+  printf("%u observers: %lu notifications/s, %lu bytes saved per notify\n",
+         NUM_OBSERVERS,
+         (unsigned long)((uint64_t)sent * 1000000000ULL / (total > 0 ? total : 1)),
+         (unsigned long)(stats.bytes_saved / ROUNDS));
+  check("every notification is sent", sent == ROUNDS * NUM_OBSERVERS
+        && stats.notifications == sent);
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(coap_observe_benchmark_process, ev, data)
+{
+  PROCESS_BEGIN();
+
+  printf("CoAP observe benchmark: %u observers\n", NUM_OBSERVERS);
+
+  coap_engine_init();
+  coap_activate_resource(&res_sensor, "sensor");
+  add_observers();
+  check_notifications();
+  bench_notifications();
+
+  printf("DONE\n");
+  exit(0);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,307 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*---------------------------------------------------------------------------*/
+/**
+ * \file
+ *         CoAP transaction and observer table benchmark, which also checks
+ *         the lookups by MID and by token
+ */
+/*---------------------------------------------------------------------------*/
+#include "contiki.h"
+#include "coap-engine.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+/*---------------------------------------------------------------------------*/
+#define NUM_TRANSACTIONS   COAP_MAX_OPEN_TRANSACTIONS
+#define NUM_OBSERVERS      768
+#define LOOKUPS            200000
+/* Spreads the MIDs of the transactions over the whole MID space */
+#define TEST_MID(i)        ((uint16_t)((i) * 7919))
+/*---------------------------------------------------------------------------*/
+PROCESS(coap_table_benchmark_process, "CoAP table benchmark process");
+AUTOSTART_PROCESSES(&coap_table_benchmark_process);
+/*---------------------------------------------------------------------------*/
+static void res_get_handler(coap_message_t *request, coap_message_t *response,
+                            uint8_t *buffer, uint16_t preferred_size,
+                            int32_t *offset);
+EVENT_RESOURCE(res_sensor, "obs", res_get_handler, NULL, NULL, NULL, NULL);
+
+/* The MID of the last notification sent to each observer */
+static uint16_t last_mid[NUM_OBSERVERS];
+static unsigned sent;
+/*---------------------------------------------------------------------------*/
+static void
+res_get_handler(coap_message_t *request, coap_message_t *response,
+                uint8_t *buffer, uint16_t preferred_size, int32_t *offset)
+{
+  coap_set_payload(response, "42", 2);
+}
+/*---------------------------------------------------------------------------*/
+static uint64_t
+now_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+/*---------------------------------------------------------------------------*/
+static unsigned long
+per_second(unsigned long count, uint64_t ns)
+{
+  return (unsigned long)((uint64_t)count * 1000000000ULL / (ns > 0 ? ns : 1));
+}
+/*---------------------------------------------------------------------------*/
+static void
+check(const char *descr, int success)
+{
+  printf("=check-me= %s - %s\n", success ? "SUCCEEDED" : "FAILED   ", descr);
+}
+/*---------------------------------------------------------------------------*/
+/*- Test transport ----------------------------------------------------------*/
+/*---------------------------------------------------------------------------*/
+void
+coap_endpoint_copy(coap_endpoint_t *destination, const coap_endpoint_t *from)
+{
+  memcpy(destination, from, sizeof(coap_endpoint_t));
+}
+/*---------------------------------------------------------------------------*/
+int
+coap_endpoint_cmp(const coap_endpoint_t *e1, const coap_endpoint_t *e2)
+{
+  return e1->port == e2->port;
+}
+/*---------------------------------------------------------------------------*/
+void
+coap_endpoint_log(const coap_endpoint_t *ep)
+{
+}
+/*---------------------------------------------------------------------------*/
+void
+coap_endpoint_print(const coap_endpoint_t *ep)
+{
+}
+/*---------------------------------------------------------------------------*/
+int
+coap_endpoint_is_secure(const coap_endpoint_t *ep)
+{
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+void
+coap_transport_init(void)
+{
+}
+/*---------------------------------------------------------------------------*/
+/* Record the MID of each notification */
+int
+coap_sendto(const coap_endpoint_t *ep, const uint8_t *data, uint16_t length)
+{
+  sent++;
+  if(ep->port < NUM_OBSERVERS && length >= 4) {
+    last_mid[ep->port] = (data[2] << 8) | data[3];
+  }
+  return length;
+}
+/*---------------------------------------------------------------------------*/
+static void
+set_token(uint8_t *token, int i)
+{
+  token[0] = 0xab;
+  token[1] = i >> 8;
+  token[2] = i;
+  token[3] = 0x5a;
+}
+/*---------------------------------------------------------------------------*/
+static void
+test_transactions(void)
+{
+  static coap_transaction_t *transactions[NUM_TRANSACTIONS];
+  coap_table_stats_t stats;
+  coap_endpoint_t ep;
+  uint64_t start, total;
+  int success;
+  int i;
+
+  memset(&ep, 0, sizeof(ep));
+  success = 1;
+  for(i = 0; i < NUM_TRANSACTIONS; i++) {
+    transactions[i] = coap_new_transaction(TEST_MID(i), &ep);
+    success &= transactions[i] != NULL;
+  }
+  success &= coap_new_transaction(TEST_MID(NUM_TRANSACTIONS), &ep) == NULL;
+  check("transactions fill the pool", success);
+
+  success = 1;
+  for(i = 0; i < NUM_TRANSACTIONS; i++) {
+    success &= coap_get_transaction_by_mid(TEST_MID(i)) == transactions[i];
+  }
+  success &= coap_get_transaction_by_mid(TEST_MID(NUM_TRANSACTIONS)) == NULL;
+  check("transactions are found by MID", success);
+
+  start = now_ns();
+  success = 1;
+  for(i = 0; i < LOOKUPS; i++) {
+    success &= coap_get_transaction_by_mid(TEST_MID(i % NUM_TRANSACTIONS)) != NULL;
+  }
+  total = now_ns() - start;
+  printf("%u transactions: %lu MID lookups/s\n", NUM_TRANSACTIONS,
+         per_second(LOOKUPS, total));
+  check("repeated lookups succeed", success);
+
+  coap_get_transaction_stats(&stats);
+  check("transaction statistics count the pool",
+        stats.used == NUM_TRANSACTIONS && stats.max_used == NUM_TRANSACTIONS
+        && stats.size == COAP_MAX_OPEN_TRANSACTIONS && stats.failures == 1);
+
+  for(i = 1; i < NUM_TRANSACTIONS; i += 2) {
+    coap_clear_transaction(transactions[i]);
+  }
+  success = 1;
+  for(i = 0; i < NUM_TRANSACTIONS; i++) {
+    success &= coap_get_transaction_by_mid(TEST_MID(i))
+      == (i % 2 ? NULL : transactions[i]);
+  }
+  check("cleared transactions are not found", success);
+
+  for(i = 0; i < NUM_TRANSACTIONS; i += 2) {
+    coap_clear_transaction(transactions[i]);
+  }
+  coap_get_transaction_stats(&stats);
+  check("cleared transactions return to the pool",
+        stats.used == 0 && stats.max_used == NUM_TRANSACTIONS);
+}
+/*---------------------------------------------------------------------------*/
+static void
+add_observers(void)
+{
+  coap_message_t request[1];
+  coap_message_t response[1];
+  coap_endpoint_t ep;
+  uint8_t token[4];
+  int i;
+
+  memset(&ep, 0, sizeof(ep));
+  for(i = 0; i < NUM_OBSERVERS; i++) {
+    ep.port = i;
+    set_token(token, i);
+    coap_init_message(request, COAP_TYPE_CON, COAP_GET, i);
+    coap_set_header_uri_path(request, "sensor");
+    coap_set_header_observe(request, 0);
+    coap_set_token(request, token, sizeof(token));
+    coap_set_src_endpoint(request, &ep);
+    coap_init_message(response, COAP_TYPE_ACK, CONTENT_2_05, i);
+    coap_observe_handler(&res_sensor, request, response);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+test_observers(void)
+{
+  coap_table_stats_t stats;
+  coap_endpoint_t ep;
+  uint8_t token[4];
+  uint64_t start, total;
+  int removed;
+  int i;
+
+  add_observers();
+  coap_observe_get_table_stats(&stats);
+  check("observers are added", stats.used == NUM_OBSERVERS
+        && stats.size == COAP_MAX_OBSERVERS && stats.failures == 0);
+
+  /* Give every observer a MID */
+  sent = 0;
+  coap_notify_observers(&res_sensor);
+  check("every observer is notified", sent == NUM_OBSERVERS);
+
+  /* Look up tokens and MIDs that belong to another endpoint, which finds
+   * nothing after the same comparisons as a successful removal */
+  memset(&ep, 0, sizeof(ep));
+  ep.port = NUM_OBSERVERS;
+  removed = 0;
+  start = now_ns();
+  for(i = 0; i < LOOKUPS; i++) {
+    set_token(token, i % NUM_OBSERVERS);
+    removed += coap_remove_observer_by_token(&ep, token, sizeof(token));
+  }
+  total = now_ns() - start;
+  printf("%u observers: %lu token lookups/s\n", NUM_OBSERVERS,
+         per_second(LOOKUPS, total));
+  start = now_ns();
+  for(i = 0; i < LOOKUPS; i++) {
+    removed += coap_remove_observer_by_mid(&ep, last_mid[i % NUM_OBSERVERS]);
+  }
+  total = now_ns() - start;
+  printf("%u observers: %lu MID lookups/s\n", NUM_OBSERVERS,
+         per_second(LOOKUPS, total));
+  check("observers of other endpoints are kept", removed == 0);
+
+  /* Remove half of the observers by token, the other half by MID */
+  removed = 0;
+  for(i = 0; i < NUM_OBSERVERS; i++) {
+    ep.port = i;
+    if(i % 2) {
+      set_token(token, i);
+      removed += coap_remove_observer_by_token(&ep, token, sizeof(token)) == 1;
+    } else {
+      removed += coap_remove_observer_by_mid(&ep, last_mid[i]) == 1;
+    }
+  }
+  coap_observe_get_table_stats(&stats);
+  check("observers are removed by token and by MID",
+        removed == NUM_OBSERVERS && stats.used == 0
+        && stats.max_used == NUM_OBSERVERS);
+
+  sent = 0;
+  coap_notify_observers(&res_sensor);
+  check("removed observers are not notified", sent == 0);
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(coap_table_benchmark_process, ev, data)
+{
+  PROCESS_BEGIN();
+
+  printf("CoAP table benchmark: COAP_TABLE_HASH_SIZE %u\n",
+         COAP_TABLE_HASH_SIZE);
+
+  coap_engine_init();
+  coap_activate_resource(&res_sensor, "sensor");
+  test_transactions();
+  test_observers();
+
+  printf("DONE\n");
+  exit(0);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
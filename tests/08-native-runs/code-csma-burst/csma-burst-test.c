@@ -0,0 +1,346 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*---------------------------------------------------------------------------*/
+/**
+ * \file
+ *         Sends frames through CSMA with bursts enabled, and checks the
+ *         frame pending bit of every frame that reaches the radio, and
+ *         that the frames are transmitted from their queuebuf
+ */
+/*---------------------------------------------------------------------------*/
+#include "contiki.h"
+#include "net/netstack.h"
+#include "net/packetbuf.h"
+#include "net/queuebuf.h"
+#include "net/mac/csma/csma.h"
+#include "net/mac/csma/csma-output.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+/*---------------------------------------------------------------------------*/
+#define MAX_FRAMES         16
+/* The frame pending and ack request bits of the frame control field */
+#define FCF_PENDING        0x10
+#define FCF_ACK_REQUEST    0x20
+/* How long all the frames of a check may take to go out */
+#define SEND_TIMEOUT       (5 * CLOCK_SECOND)
+/*---------------------------------------------------------------------------*/
+PROCESS(csma_burst_test_process, "CSMA burst test process");
+AUTOSTART_PROCESSES(&csma_burst_test_process);
+/*---------------------------------------------------------------------------*/
+static const linkaddr_t neighbor = { { 1, 2, 3, 4, 5, 6, 7, 8 } };
+
+/* The frames transmitted by the radio */
+static uint8_t frames[MAX_FRAMES][PACKETBUF_SIZE];
+static uint16_t frame_lens[MAX_FRAMES];
+/* Where the radio was handed each frame from */
+static const void *frame_ptrs[MAX_FRAMES];
+static int num_frames;
+/* The transmission whose ack is lost, none if negative */
+static int lost_ack;
+
+static uint8_t tx_buf[PACKETBUF_SIZE];
+static uint16_t tx_len;
+static uint8_t ack[CSMA_ACK_LEN];
+static int ack_pending;
+
+/* The frames that CSMA is done with */
+static int num_sent;
+/* The sent callbacks that saw the receiver of their frame */
+static int num_sent_to;
+static const linkaddr_t *receiver;
+/*---------------------------------------------------------------------------*/
+static void
+check(const char *descr, int success)
+{
+  printf("=check-me= %s - %s\n", success ? "SUCCEEDED" : "FAILED   ", descr);
+}
+/*---------------------------------------------------------------------------*/
+/* A radio that acknowledges each unicast frame right away */
+static int
+radio_prepare(const void *payload, unsigned short payload_len)
+{
+  if(num_frames < MAX_FRAMES) {
+    frame_ptrs[num_frames] = payload;
+  }
+  memcpy(tx_buf, payload, payload_len);
+  tx_len = payload_len;
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static int
+radio_transmit(unsigned short transmit_len)
+{
+  if(num_frames < MAX_FRAMES) {
+    memcpy(frames[num_frames], tx_buf, tx_len);
+    frame_lens[num_frames] = tx_len;
+  }
+  if((tx_buf[0] & FCF_ACK_REQUEST) && num_frames != lost_ack) {
+    ack[0] = FRAME802154_ACKFRAME;
+    ack[1] = 0;
+    ack[2] = tx_buf[2];
+    ack_pending = 1;
+  }
+  num_frames++;
+  return RADIO_TX_OK;
+}
+/*---------------------------------------------------------------------------*/
+static int
+radio_send(const void *payload, unsigned short payload_len)
+{
+  radio_prepare(payload, payload_len);
+  return radio_transmit(payload_len);
+}
+/*---------------------------------------------------------------------------*/
+static int
+radio_read(void *buf, unsigned short buf_len)
+{
+  if(!ack_pending || buf_len < CSMA_ACK_LEN) {
+    return 0;
+  }
+  ack_pending = 0;
+  memcpy(buf, ack, CSMA_ACK_LEN);
+  return CSMA_ACK_LEN;
+}
+/*---------------------------------------------------------------------------*/
+static int
+radio_pending_packet(void)
+{
+  return ack_pending;
+}
+/*---------------------------------------------------------------------------*/
+static int
+radio_zero(void)
+{
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static int
+radio_one(void)
+{
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static radio_result_t
+radio_get_value(radio_param_t param, radio_value_t *value)
+{
+  return RADIO_RESULT_NOT_SUPPORTED;
+}
+/*---------------------------------------------------------------------------*/
+static radio_result_t
+radio_set_value(radio_param_t param, radio_value_t value)
+{
+  return RADIO_RESULT_NOT_SUPPORTED;
+}
+/*---------------------------------------------------------------------------*/
+static radio_result_t
+radio_get_object(radio_param_t param, void *dest, size_t size)
+{
+  return RADIO_RESULT_NOT_SUPPORTED;
+}
+/*---------------------------------------------------------------------------*/
+static radio_result_t
+radio_set_object(radio_param_t param, const void *src, size_t size)
+{
+  return RADIO_RESULT_NOT_SUPPORTED;
+}
+/*---------------------------------------------------------------------------*/
+const struct radio_driver test_radio_driver = {
+  radio_zero,
+  radio_prepare,
+  radio_transmit,
+  radio_send,
+  radio_read,
+  radio_one,
+  radio_zero,
+  radio_pending_packet,
+  radio_zero,
+  radio_zero,
+  radio_get_value,
+  radio_set_value,
+  radio_get_object,
+  radio_set_object
+};
+/*---------------------------------------------------------------------------*/
+static void
+packet_sent(void *ptr, int status, int transmissions)
+{
+  num_sent++;
+  if(linkaddr_cmp(packetbuf_addr(PACKETBUF_ADDR_RECEIVER), receiver)) {
+    num_sent_to++;
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Queue count frames for addr, all before the first one goes out */
+static void
+send_frames(const linkaddr_t *addr, int count, int lost)
+{
+  int i;
+
+  num_frames = 0;
+  num_sent = 0;
+  num_sent_to = 0;
+  receiver = addr;
+  lost_ack = lost;
+  for(i = 0; i < count; i++) {
+    packetbuf_clear();
+    packetbuf_copyfrom("burst", 5);
+    packetbuf_set_addr(PACKETBUF_ADDR_RECEIVER, addr);
+    NETSTACK_MAC.send(packet_sent, NULL);
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* The frame pending bits of the frames transmitted, from the first one */
+static int
+pending_bits(void)
+{
+  int bits = 0;
+  int i;
+
+  for(i = 0; i < num_frames && i < MAX_FRAMES; i++) {
+    if(frames[i][0] & FCF_PENDING) {
+      bits |= 1 << i;
+    }
+  }
+  return bits;
+}
+/*---------------------------------------------------------------------------*/
+/* None of the frames was handed to the radio from packetbuf, and the
+   retransmission of lost, if any, from the same buffer as the first try */
+static int
+sent_from_queuebuf(int lost)
+{
+  const uint8_t *start = (const uint8_t *)packetbuf_hdrptr() - PACKETBUF_SIZE;
+  const uint8_t *end = (const uint8_t *)packetbuf_hdrptr() + PACKETBUF_SIZE;
+  int i;
+
+  for(i = 0; i < num_frames && i < MAX_FRAMES; i++) {
+    if((const uint8_t *)frame_ptrs[i] >= start &&
+       (const uint8_t *)frame_ptrs[i] < end) {
+      return 0;
+    }
+  }
+  return lost < 0 || frame_ptrs[lost] == frame_ptrs[lost + 1];
+}
+/*---------------------------------------------------------------------------*/
+/* The frame pending bit is reported by the framer on input */
+static int
+parsed_pending(int i)
+{
+  packetbuf_clear();
+  packetbuf_copyfrom(frames[i], frame_lens[i]);
+  if(NETSTACK_FRAMER.parse() < 0) {
+    return -1;
+  }
+  return packetbuf_attr(PACKETBUF_ATTR_PENDING);
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(csma_burst_test_process, ev, data)
+{
+  static struct etimer et;
+  static clock_time_t start;
+  static int step;
+  static const struct {
+    const char *descr;
+    int unicast;
+    int count;
+    int lost;
+    int frames;
+    int bits;
+  } steps[] = {
+    /* Bursts of up to four frames, the last of which announces nothing */
+    { "Queued unicast frames are sent in bursts", 1, 6, -1, 6, 0x17 },
+    { "Broadcast frames are not announced", 0, 3, -1, 3, 0 },
+    /* The second frame is retransmitted and starts a new burst */
+    { "A lost ack ends the burst", 1, 3, 1, 4, 0x07 },
+  };
+  const struct csma_burst_stats *stats;
+  static struct queuebuf_stats qstats;
+  static uint32_t allocations;
+  struct queuebuf *qb;
+
+  PROCESS_BEGIN();
+
+  printf("CSMA burst test: up to %u frames\n", CSMA_BURST_MAX_FRAMES);
+
+  for(step = 0; step < sizeof(steps) / sizeof(steps[0]); step++) {
+    queuebuf_get_stats(&qstats);
+    allocations = qstats.allocations;
+    send_frames(steps[step].unicast ? &neighbor : &linkaddr_null,
+                steps[step].count, steps[step].lost);
+    start = clock_time();
+    while(num_sent < steps[step].count &&
+          clock_time() - start < SEND_TIMEOUT) {
+      etimer_set(&et, 1);
+      PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&et));
+    }
+    check(steps[step].descr, num_sent == steps[step].count &&
+          num_frames == steps[step].frames &&
+          pending_bits() == steps[step].bits);
+    queuebuf_get_stats(&qstats);
+    check("The frames are sent from their queuebuf",
+          sent_from_queuebuf(steps[step].lost) &&
+          num_sent_to == steps[step].count &&
+          qstats.allocations - allocations == steps[step].count &&
+          qstats.in_use == 0);
+  }
+
+  stats = csma_output_burst_stats();
+  printf("CSMA bursts: %u, %u frames in bursts, %u aborted, longest %u\n",
+         stats->bursts, stats->burst_frames, stats->aborted, stats->longest);
+  check("Bursts are counted", stats->bursts == 4 &&
+        stats->burst_frames == 6 && stats->aborted == 1 &&
+        stats->longest == CSMA_BURST_MAX_FRAMES);
+
+  /* A shared queuebuf goes back to the pool with its last holder */
+  packetbuf_clear();
+  packetbuf_copyfrom("shared", 6);
+  qb = queuebuf_new_from_packetbuf();
+  check("A queuebuf is shared", qb != NULL && queuebuf_ref(qb) == qb);
+  queuebuf_free(qb);
+  queuebuf_get_stats(&qstats);
+  check("A shared queuebuf stays allocated", qstats.in_use == 1 &&
+        memcmp(queuebuf_dataptr(qb), "shared", 6) == 0);
+  queuebuf_free(qb);
+  queuebuf_get_stats(&qstats);
+  check("A queuebuf is freed with its last reference",
+        qstats.in_use == 0 && queuebuf_ref(qb) == NULL);
+  printf("CSMA queuebufs: %lu allocations, %lu references, at most %u\n",
+         (unsigned long)qstats.allocations,
+         (unsigned long)qstats.references, qstats.max_in_use);
+
+  check("The frame pending bit is parsed",
+        parsed_pending(0) == 1 && parsed_pending(3) == 0);
+
+  exit(0);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,235 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*---------------------------------------------------------------------------*/
+/**
+ * \file
+ *         Event timer set/stop/expire throughput, and a check that timers
+ *         expire in time, and in order with the heap
+ */
+/*---------------------------------------------------------------------------*/
+#include "contiki.h"
+#include "lib/random.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+/*---------------------------------------------------------------------------*/
+#define MAX_TIMERS         5000
+#define SET_STOP_OPS       50000
+#define EXPIRE_OPS         10000
+#define ORDER_TIMERS       50
+/*---------------------------------------------------------------------------*/
+PROCESS(etimer_benchmark_process, "Etimer benchmark process");
+AUTOSTART_PROCESSES(&etimer_benchmark_process);
+/*---------------------------------------------------------------------------*/
+static struct etimer timers[MAX_TIMERS];
+static const int timer_counts[] = { 10, 100, 1000, MAX_TIMERS };
+static struct ctimer ctimers[2];
+static int stale_callbacks;
+/*---------------------------------------------------------------------------*/
+/* The native clock ticks in milliseconds, too coarse for small batches */
+static uint64_t
+now_us(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+/*---------------------------------------------------------------------------*/
+static unsigned long
+ops_per_second(unsigned long ops, uint64_t elapsed_us)
+{
+  return (unsigned long)(ops * 1000000ULL / (elapsed_us > 0 ? elapsed_us : 1));
+}
+/*---------------------------------------------------------------------------*/
+static void
+check(const char *descr, int success)
+{
+  printf("=check-me= %s - %s\n", success ? "SUCCEEDED" : "FAILED   ", descr);
+}
+/*---------------------------------------------------------------------------*/
+static void
+stale_callback(void *ptr)
+{
+  stale_callbacks++;
+}
+/*---------------------------------------------------------------------------*/
+/* Stops the other ctimer, whose event may already be queued, and reuses
+   its memory for a ctimer that looks due */
+static void
+stop_callback(void *ptr)
+{
+  struct ctimer *other = ptr;
+
+  ctimer_stop(other);
+  memset(other, 0, sizeof(*other));
+  other->f = stale_callback;
+#if ETIMER_WITH_HEAP
+  other->pending = 1;
+#endif /* ETIMER_WITH_HEAP */
+}
+/*---------------------------------------------------------------------------*/
+static uint64_t
+set_timers(int n, clock_time_t interval)
+{
+  uint64_t start;
+  int i;
+
+  start = now_us();
+  for(i = 0; i < n; i++) {
+    /* Far enough in the future not to expire during the benchmark */
+    etimer_set(&timers[i], interval + random_rand() % CLOCK_SECOND);
+  }
+  return now_us() - start;
+}
+/*---------------------------------------------------------------------------*/
+static uint64_t
+stop_timers(int n)
+{
+  uint64_t start;
+  int i;
+
+  start = now_us();
+  for(i = 0; i < n; i++) {
+    etimer_stop(&timers[i]);
+  }
+  return now_us() - start;
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(etimer_benchmark_process, ev, data)
+{
+  static int c;
+  static int n;
+  static int r;
+  static int rounds;
+  static int set_rounds;
+  static int fired;
+  static int in_time;
+  static int in_order;
+  static struct etimer unset_timer;
+  static struct etimer garbage_timer;
+  static struct etimer *first;
+  static clock_time_t last;
+  static uint64_t start;
+  static uint64_t set_time;
+  static uint64_t stop_time;
+  static uint64_t expire_time;
+  int i;
+
+  PROCESS_BEGIN();
+
+  printf("Etimer benchmark (%s)\n", ETIMER_WITH_HEAP ? "heap" : "list");
+
+  /* Timers must never expire before their expiration time. The heap
+     also delivers them in order, while the list posts the timers that
+     expired since the last poll in list order. */
+  set_timers(ORDER_TIMERS, CLOCK_SECOND / 10);
+  in_time = in_order = 1;
+  last = 0;
+  for(fired = 0; fired < ORDER_TIMERS; fired++) {
+    PROCESS_WAIT_EVENT_UNTIL(ev == PROCESS_EVENT_TIMER);
+    if(!etimer_expired(data) ||
+       !timer_expired(&((struct etimer *)data)->timer)) {
+      in_time = 0;
+    }
+    if(fired > 0 && etimer_expiration_time(data) < last) {
+      in_order = 0;
+    }
+    last = etimer_expiration_time(data);
+  }
+  check("Timers expire in time", in_time && !etimer_pending());
+#if ETIMER_WITH_HEAP
+  check("Timers expire in order", in_order);
+#endif /* ETIMER_WITH_HEAP */
+
+  /* Stopping a timer that was never set */
+  memset(&unset_timer, 0, sizeof(unset_timer));
+  etimer_stop(&unset_timer);
+  check("Stopping an unset timer leaves the others alone",
+        etimer_expired(&unset_timer) && !etimer_pending());
+
+  /* Setting a timer that was never set, whatever its memory holds */
+  memset(&garbage_timer, 0xa5, sizeof(garbage_timer));
+  etimer_set(&garbage_timer, CLOCK_SECOND / 10);
+  etimer_set(&timers[0], CLOCK_SECOND / 20);
+  PROCESS_WAIT_EVENT_UNTIL(ev == PROCESS_EVENT_TIMER);
+  first = data;
+  PROCESS_WAIT_EVENT_UNTIL(ev == PROCESS_EVENT_TIMER);
+  check("Setting a timer with garbage in it leaves the others alone",
+        first == &timers[0] && data == &garbage_timer && !etimer_pending());
+
+  /* Ctimers stopped after their etimer expired must not be called back */
+  ctimer_set(&ctimers[0], 0, stop_callback, &ctimers[1]);
+  ctimer_set(&ctimers[1], 0, stop_callback, &ctimers[0]);
+  etimer_set(&timers[0], CLOCK_SECOND / 10);
+  PROCESS_WAIT_EVENT_UNTIL(ev == PROCESS_EVENT_TIMER);
+  check("Stopped ctimers are not called back", stale_callbacks == 0);
+
+  for(c = 0; c < sizeof(timer_counts) / sizeof(timer_counts[0]); c++) {
+    n = timer_counts[c];
+
+    /* Setting and stopping pending timers */
+    set_rounds = SET_STOP_OPS / n;
+    set_time = stop_time = 0;
+    for(r = 0; r < set_rounds; r++) {
+      set_time += set_timers(n, 3600 * CLOCK_SECOND);
+      /* Set them again while they are pending */
+      set_time += set_timers(n, 3600 * CLOCK_SECOND);
+      stop_time += stop_timers(n);
+    }
+    check("Stopped timers are not pending", !etimer_pending());
+
+    /* Expiring timers, including the event delivery */
+    rounds = EXPIRE_OPS / n > 0 ? EXPIRE_OPS / n : 1;
+    expire_time = 0;
+    for(r = 0; r < rounds; r++) {
+      start = now_us();
+      for(i = 0; i < n; i++) {
+        etimer_set(&timers[i], 0);
+      }
+      for(fired = 0; fired < n; fired++) {
+        PROCESS_WAIT_EVENT_UNTIL(ev == PROCESS_EVENT_TIMER);
+      }
+      expire_time += now_us() - start;
+    }
+    check("Expired timers are not pending", !etimer_pending());
+
+    printf("%4d timers: set %lu/s, stop %lu/s, expire %lu/s\n", n,
+           ops_per_second(2UL * set_rounds * n, set_time),
+           ops_per_second((unsigned long)set_rounds * n, stop_time),
+           ops_per_second((unsigned long)rounds * n, expire_time));
+  }
+
+  exit(0);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,226 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*---------------------------------------------------------------------------*/
+/*---------------------------------------------------------------------------*/
+/**
+ * \file
+ *         Randomized heapmem alloc/free stress test, reporting throughput,
+ *         worst-case operation time and fragmentation
+ */
+/*---------------------------------------------------------------------------*/
+#include "contiki.h"
+#include "lib/heapmem.h"
+#include "lib/random.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+/*---------------------------------------------------------------------------*/
+#define MAX_OBJECTS        96
+#define STRESS_OPS         200000
+#define SMALL_MAX          128
+#define LARGE_MAX          1024
+/*---------------------------------------------------------------------------*/
+PROCESS(heapmem_benchmark_process, "Heapmem benchmark process");
+AUTOSTART_PROCESSES(&heapmem_benchmark_process);
+/*---------------------------------------------------------------------------*/
+static struct {
+  uint8_t *ptr;
+  size_t size;
+} objects[MAX_OBJECTS];
+/*---------------------------------------------------------------------------*/
+/* The native clock ticks in milliseconds, too coarse for single operations */
+static uint64_t
+now_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+/*---------------------------------------------------------------------------*/
+static void
+check(const char *descr, int success)
+{
+  printf("=check-me= %s - %s\n", success ? "SUCCEEDED" : "FAILED   ", descr);
+}
+/*---------------------------------------------------------------------------*/
+/* Mostly small, short-lived buffers, with the odd large one */
+static size_t
+random_size(void)
+{
+  if(random_rand() % 8 == 0) {
+    return 1 + random_rand() % LARGE_MAX;
+  }
+  return 1 + random_rand() % SMALL_MAX;
+}
+/*---------------------------------------------------------------------------*/
+/* Each object is filled with a pattern derived from its slot, so that
+   overlapping objects are detected when they are freed. */
+static int
+object_intact(int i)
+{
+  size_t j;
+
+  for(j = 0; j < objects[i].size; j++) {
+    if(objects[i].ptr[j] != (uint8_t)(i + j)) {
+      return 0;
+    }
+  }
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static void
+fill_object(int i, size_t from)
+{
+  size_t j;
+
+  for(j = from; j < objects[i].size; j++) {
+    objects[i].ptr[j] = (uint8_t)(i + j);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static int
+stats_consistent(void)
+{
+  heapmem_stats_t stats;
+
+  heapmem_stats(&stats);
+  return stats.allocated + stats.overhead + stats.available ==
+    HEAPMEM_CONF_ARENA_SIZE && stats.largest_free <= stats.available;
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(heapmem_benchmark_process, ev, data)
+{
+  heapmem_stats_t stats;
+  unsigned long allocs, frees, reallocs, failures;
+  unsigned long frag_sum, frag_samples;
+  uint64_t start, t, total, worst;
+  size_t size;
+  uint8_t *ptr;
+  int intact, consistent;
+  int i, op;
+
+  PROCESS_BEGIN();
+
+  printf("Heapmem benchmark (%s)\n", HEAPMEM_CONF_TLSF ? "tlsf" : "first-fit");
+
+  random_init(0x1234);
+  memset(objects, 0, sizeof(objects));
+  allocs = frees = reallocs = failures = 0;
+  frag_sum = frag_samples = 0;
+  total = worst = 0;
+  intact = consistent = 1;
+
+  for(op = 0; op < STRESS_OPS; op++) {
+    i = random_rand() % MAX_OBJECTS;
+
+    if(objects[i].ptr == NULL) {
+      size = random_size();
+      start = now_ns();
+      ptr = heapmem_alloc(size);
+      t = now_ns() - start;
+      allocs++;
+      if(ptr == NULL) {
+        failures++;
+      } else {
+        objects[i].ptr = ptr;
+        objects[i].size = size;
+        fill_object(i, 0);
+      }
+    } else if(random_rand() % 4 == 0) {
+      size = random_size();
+      intact &= object_intact(i);
+      start = now_ns();
+      ptr = heapmem_realloc(objects[i].ptr, size);
+      t = now_ns() - start;
+      reallocs++;
+      if(ptr == NULL) {
+        failures++;
+      } else {
+        objects[i].ptr = ptr;
+        if(size < objects[i].size) {
+          objects[i].size = size;
+        }
+        intact &= object_intact(i);
+        objects[i].size = size;
+        fill_object(i, 0);
+      }
+    } else {
+      intact &= object_intact(i);
+      start = now_ns();
+      heapmem_free(objects[i].ptr);
+      t = now_ns() - start;
+      frees++;
+      objects[i].ptr = NULL;
+    }
+
+    total += t;
+    if(t > worst) {
+      worst = t;
+    }
+
+    if(op % 1000 == 0) {
+      consistent &= stats_consistent();
+      heapmem_stats(&stats);
+      frag_sum += stats.fragmentation;
+      frag_samples++;
+    }
+  }
+
+  heapmem_stats(&stats);
+  printf("%lu allocs, %lu reallocs, %lu frees, %lu failed\n",
+         allocs, reallocs, frees, failures);
+  printf("%lu ops/s, average %lu ns, worst %lu ns\n",
+         (unsigned long)(STRESS_OPS * 1000000000ULL / (total > 0 ? total : 1)),
+         (unsigned long)(total / STRESS_OPS), (unsigned long)worst);
+  printf("fragmentation: average %lu%%, final %u%%, largest free %lu of %lu, %lu free chunks\n",
+         frag_sum / frag_samples, stats.fragmentation,
+         (unsigned long)stats.largest_free, (unsigned long)stats.available,
+         (unsigned long)stats.free_chunks);
+
+  check("Objects do not overlap", intact);
+  check("Statistics account for the whole arena", consistent);
+
+  for(i = 0; i < MAX_OBJECTS; i++) {
+    if(objects[i].ptr != NULL) {
+      intact &= object_intact(i);
+      heapmem_free(objects[i].ptr);
+    }
+  }
+  heapmem_stats(&stats);
+  check("All memory is released", intact && stats.allocated == 0 &&
+        stats_consistent());
+
+  exit(0);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,478 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*---------------------------------------------------------------------------*/
+/**
+ * \file
+ *         Updates the LwM2M firmware object from a Package URI and with
+ *         Package blocks pushed out of order, and checks the package that
+ *         reaches the writer
+ */
+/*---------------------------------------------------------------------------*/
+#include "contiki.h"
+#include "coap-engine.h"
+#include "lwm2m-engine.h"
+#include "lwm2m-firmware.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+/*---------------------------------------------------------------------------*/
+#define PACKAGE_SIZE       4096
+#define PUSH_BLOCK_SIZE    64
+#define PUSH_WINDOW        8
+/* One-way delay between the device and the firmware server, in ms */
+#define MIN_DELAY          100
+#define MAX_DELAY          300
+#define MAX_PENDING        64
+/* Simulated time given to each download, in ms */
+#define RUN_TIME           300000
+/* The firmware server, the device as its client, and the LwM2M server */
+#define SERVER_PORT        5683
+#define CLIENT_PORT        1
+#define LWM2M_SERVER_PORT  2
+
+/* The values of the State and Update Result resources */
+#define STATE_IDLE         1
+#define STATE_DOWNLOADED   3
+#define RESULT_DEFAULT     0
+#define RESULT_NO_STORAGE  2
+/*---------------------------------------------------------------------------*/
+PROCESS(lwm2m_firmware_test_process, "LwM2M firmware test process");
+AUTOSTART_PROCESSES(&lwm2m_firmware_test_process);
+/*---------------------------------------------------------------------------*/
+static void res_get_handler(coap_message_t *request, coap_message_t *response,
+                            uint8_t *buffer, uint16_t preferred_size,
+                            int32_t *offset);
+RESOURCE(res_package, "title=\"Package\"", res_get_handler, NULL, NULL, NULL);
+
+/* A message on its way */
+struct pending_message {
+  uint64_t time;
+  uint16_t src_port;
+  uint16_t len;
+  uint8_t data[COAP_MAX_PACKET_SIZE];
+};
+
+static struct pending_message pending[MAX_PENDING];
+static int num_pending;
+
+/* The simulated clock, in ms */
+static uint64_t now;
+
+/* What the firmware object stored */
+static uint8_t package[PACKAGE_SIZE];
+static uint32_t package_len;
+static uint32_t writes;
+/* The write that fails, none if zero */
+static uint32_t failing_write;
+
+/* The last response to the LwM2M server */
+static coap_status_t last_code;
+static char last_payload[16];
+/*---------------------------------------------------------------------------*/
+static uint8_t
+package_byte(uint32_t i)
+{
+  return (i * 7 + (i >> 8)) & 0xff;
+}
+/*---------------------------------------------------------------------------*/
+static void
+res_get_handler(coap_message_t *request, coap_message_t *response,
+                uint8_t *buffer, uint16_t preferred_size, int32_t *offset)
+{
+  int32_t i;
+  int32_t len;
+
+  if(*offset >= PACKAGE_SIZE) {
+    coap_set_status_code(response, BAD_OPTION_4_02);
+    coap_set_payload(response, "BlockOutOfScope", 15);
+    return;
+  }
+  len = MIN(preferred_size, PACKAGE_SIZE - *offset);
+  for(i = 0; i < len; i++) {
+    buffer[i] = package_byte(*offset + i);
+  }
+  coap_set_payload(response, buffer, len);
+  *offset += len;
+  if(*offset >= PACKAGE_SIZE) {
+    *offset = -1;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static int
+package_writer(uint32_t offset, const uint8_t *data, uint16_t len)
+{
+  if(++writes == failing_write || offset + len > PACKAGE_SIZE) {
+    return 0;
+  }
+  memcpy(&package[offset], data, len);
+  if(offset + len > package_len) {
+    package_len = offset + len;
+  }
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static int
+package_is_complete(void)
+{
+  uint32_t i;
+
+  if(package_len != PACKAGE_SIZE) {
+    return 0;
+  }
+  for(i = 0; i < PACKAGE_SIZE; i++) {
+    if(package[i] != package_byte(i)) {
+      return 0;
+    }
+  }
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static void
+check(const char *descr, int success)
+{
+  printf("=check-me= %s - %s\n", success ? "SUCCEEDED" : "FAILED   ", descr);
+}
+/*---------------------------------------------------------------------------*/
+/*- Simulated clock ---------------------------------------------------------*/
+/*---------------------------------------------------------------------------*/
+static void
+test_timer_init(void)
+{
+}
+/*---------------------------------------------------------------------------*/
+static uint64_t
+test_timer_uptime(void)
+{
+  return now;
+}
+/*---------------------------------------------------------------------------*/
+static void
+test_timer_update(void)
+{
+}
+/*---------------------------------------------------------------------------*/
+const coap_timer_driver_t coap_timer_test_driver = {
+  .init = test_timer_init,
+  .uptime = test_timer_uptime,
+  .update = test_timer_update,
+};
+/*---------------------------------------------------------------------------*/
+/*- Test transport ----------------------------------------------------------*/
+/*---------------------------------------------------------------------------*/
+void
+coap_endpoint_copy(coap_endpoint_t *destination, const coap_endpoint_t *from)
+{
+  memcpy(destination, from, sizeof(coap_endpoint_t));
+}
+/*---------------------------------------------------------------------------*/
+int
+coap_endpoint_cmp(const coap_endpoint_t *e1, const coap_endpoint_t *e2)
+{
+  return e1->port == e2->port;
+}
+/*---------------------------------------------------------------------------*/
+void
+coap_endpoint_log(const coap_endpoint_t *ep)
+{
+}
+/*---------------------------------------------------------------------------*/
+void
+coap_endpoint_print(const coap_endpoint_t *ep)
+{
+}
+/*---------------------------------------------------------------------------*/
+int
+coap_endpoint_is_secure(const coap_endpoint_t *ep)
+{
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+/* Only the port of coap://[address]:port matters here */
+int
+coap_endpoint_parse(const char *text, size_t size, coap_endpoint_t *ep)
+{
+  const char *port;
+
+  memset(ep, 0, sizeof(coap_endpoint_t));
+  port = memchr(text, ']', size);
+  if(port == NULL || port + 1 >= text + size || port[1] != ':') {
+    ep->port = SERVER_PORT;
+  } else {
+    ep->port = atoi(port + 2);
+  }
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+void
+coap_transport_init(void)
+{
+}
+/*---------------------------------------------------------------------------*/
+/* Responses to the LwM2M server are kept for the test. Messages between
+ * the device and the firmware server are delayed and may be reordered. */
+int
+coap_sendto(const coap_endpoint_t *ep, const uint8_t *data, uint16_t length)
+{
+  static coap_message_t message[1];
+  struct pending_message *m;
+  const uint8_t *payload;
+  int len;
+
+  if(ep->port == LWM2M_SERVER_PORT) {
+    if(coap_parse_message(message, (uint8_t *)data, length) == NO_ERROR) {
+      last_code = message->code;
+      len = coap_get_payload(message, &payload);
+      len = MIN(len, sizeof(last_payload) - 1);
+      memcpy(last_payload, payload, len);
+      last_payload[len] = '\0';
+    }
+    return length;
+  }
+  if(num_pending == MAX_PENDING) {
+    return length;
+  }
+  m = &pending[num_pending++];
+  m->time = now + MIN_DELAY + rand() % (MAX_DELAY - MIN_DELAY + 1);
+  /* Messages to the firmware server come from the device and vice versa */
+  m->src_port = ep->port == SERVER_PORT ? CLIENT_PORT : SERVER_PORT;
+  m->len = length;
+  memcpy(m->data, data, length);
+  return length;
+}
+/*---------------------------------------------------------------------------*/
+static void
+deliver_messages(void)
+{
+  static struct pending_message m;
+  coap_endpoint_t ep;
+  int i;
+
+  memset(&ep, 0, sizeof(ep));
+  for(i = 0; i < num_pending;) {
+    if(pending[i].time > now) {
+      i++;
+      continue;
+    }
+    m = pending[i];
+    pending[i] = pending[--num_pending];
+    ep.port = m.src_port;
+    coap_receive(&ep, m.data, m.len);
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Run the simulation for a while, the CoAP engine has periodic timers */
+static void
+run(uint64_t duration)
+{
+  uint64_t deadline = now + duration;
+  uint64_t next;
+  int i;
+
+  while(now < deadline) {
+    next = coap_timer_time_to_next_expiration();
+    next = next > 0 ? MIN(deadline, now + next) : deadline;
+    for(i = 0; i < num_pending; i++) {
+      if(pending[i].time < next) {
+        next = pending[i].time;
+      }
+    }
+    now = next;
+    deliver_messages();
+    while(coap_timer_run());
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* A request of the LwM2M server, with a Block1 option if size is not 0 */
+static coap_status_t
+lwm2m_request(coap_method_t method, const char *path, const void *payload,
+              uint16_t len, uint32_t num, uint8_t more, uint16_t size)
+{
+  static uint16_t mid;
+  coap_message_t request[1];
+  uint8_t buffer[COAP_MAX_PACKET_SIZE];
+  coap_endpoint_t ep;
+
+  memset(&ep, 0, sizeof(ep));
+  ep.port = LWM2M_SERVER_PORT;
+  coap_init_message(request, COAP_TYPE_CON, method, ++mid);
+  coap_set_header_uri_path(request, path);
+  if(size > 0) {
+    coap_set_header_block1(request, num, more, size);
+  }
+  if(payload != NULL) {
+    coap_set_payload(request, payload, len);
+  }
+  last_code = 0;
+  coap_receive(&ep, buffer, coap_serialize_message(request, buffer));
+  return last_code;
+}
+/*---------------------------------------------------------------------------*/
+static int
+read_resource(const char *path)
+{
+  if(lwm2m_request(COAP_GET, path, NULL, 0, 0, 0, 0) != CONTENT_2_05) {
+    return -1;
+  }
+  return atoi(last_payload);
+}
+/*---------------------------------------------------------------------------*/
+static void
+reset_package(uint32_t fail_at)
+{
+  memset(package, 0, sizeof(package));
+  package_len = 0;
+  writes = 0;
+  failing_write = fail_at;
+}
+/*---------------------------------------------------------------------------*/
+static void
+check_package_uri(void)
+{
+  static const char uri[] = "coap://[fd00::1]:5683/package";
+
+  reset_package(0);
+  check("the Package URI is accepted",
+        lwm2m_request(COAP_PUT, "5/0/1", uri, strlen(uri), 0, 0, 0)
+        == CHANGED_2_04);
+  run(RUN_TIME);
+  check("the package is downloaded from the Package URI",
+        package_is_complete() && read_resource("5/0/3") == STATE_DOWNLOADED
+        && read_resource("5/0/5") == RESULT_DEFAULT);
+
+  /* The writer fails halfway, the download must stop there */
+  reset_package(PACKAGE_SIZE / COAP_MAX_BLOCK_SIZE / 2);
+  lwm2m_request(COAP_PUT, "5/0/1", uri, strlen(uri), 0, 0, 0);
+  run(RUN_TIME);
+  check("a download that cannot be stored fails",
+        writes == failing_write && read_resource("5/0/3") == STATE_IDLE
+        && read_resource("5/0/5") == RESULT_NO_STORAGE);
+}
+/*---------------------------------------------------------------------------*/
+static void
+check_package_push(void)
+{
+  uint8_t block[PUSH_BLOCK_SIZE];
+  uint32_t num_blocks = PACKAGE_SIZE / PUSH_BLOCK_SIZE;
+  uint32_t order[PACKAGE_SIZE / PUSH_BLOCK_SIZE];
+  uint32_t i, j, tmp;
+  int changed = 1;
+
+  /* The server pipelines a window of blocks, which arrive in any order,
+     the first one included */
+  for(i = 0; i < num_blocks; i++) {
+    order[i] = i;
+  }
+  for(i = 0; i < num_blocks; i++) {
+    j = i - i % PUSH_WINDOW + rand() % PUSH_WINDOW;
+    tmp = order[i];
+    order[i] = order[j];
+    order[j] = tmp;
+  }
+
+  reset_package(0);
+  for(i = 0; i < num_blocks; i++) {
+    for(j = 0; j < PUSH_BLOCK_SIZE; j++) {
+      block[j] = package_byte(order[i] * PUSH_BLOCK_SIZE + j);
+    }
+    changed &= lwm2m_request(COAP_PUT, "5/0/0", block, sizeof(block),
+                             order[i], order[i] < num_blocks - 1,
+                             PUSH_BLOCK_SIZE) == CHANGED_2_04;
+    if(i < num_blocks - 1 && read_resource("5/0/3") == STATE_DOWNLOADED) {
+      changed = 0;
+    }
+  }
+  check("a package pushed out of order is stored",
+        changed && package_is_complete()
+        && read_resource("5/0/3") == STATE_DOWNLOADED
+        && read_resource("5/0/5") == RESULT_DEFAULT);
+}
+/*---------------------------------------------------------------------------*/
+/* Push a block of the package, or of another one if mask is not 0 */
+static coap_status_t
+push_block(uint32_t num, uint8_t mask)
+{
+  uint8_t block[PUSH_BLOCK_SIZE];
+  uint32_t num_blocks = PACKAGE_SIZE / PUSH_BLOCK_SIZE;
+  uint32_t i;
+
+  for(i = 0; i < PUSH_BLOCK_SIZE; i++) {
+    block[i] = package_byte(num * PUSH_BLOCK_SIZE + i) ^ mask;
+  }
+  return lwm2m_request(COAP_PUT, "5/0/0", block, sizeof(block),
+                       num, num < num_blocks - 1, PUSH_BLOCK_SIZE);
+}
+/*---------------------------------------------------------------------------*/
+static void
+check_package_restart(void)
+{
+  uint32_t num_blocks = PACKAGE_SIZE / PUSH_BLOCK_SIZE;
+  uint32_t i;
+  int changed = 1;
+
+  /* The server gives up on another package halfway, and pushes the
+     package from its first block again */
+  reset_package(0);
+  for(i = 0; i < num_blocks / 2; i++) {
+    changed &= push_block(i, 0xff) == CHANGED_2_04;
+  }
+  for(i = 0; i < num_blocks; i++) {
+    changed &= push_block(i, 0) == CHANGED_2_04;
+    if(i < num_blocks - 1 && read_resource("5/0/3") == STATE_DOWNLOADED) {
+      changed = 0;
+    }
+  }
+  check("a push restarted from the first block replaces the package",
+        changed && package_is_complete()
+        && read_resource("5/0/3") == STATE_DOWNLOADED
+        && read_resource("5/0/5") == RESULT_DEFAULT);
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(lwm2m_firmware_test_process, ev, data)
+{
+  PROCESS_BEGIN();
+
+  printf("LwM2M firmware test: %u bytes\n", PACKAGE_SIZE);
+
+  srand(1);
+  lwm2m_engine_init();
+  lwm2m_firmware_init();
+  lwm2m_firmware_set_writer(package_writer);
+  coap_activate_resource(&res_package, "package");
+
+  check_package_uri();
+  check_package_push();
+  check_package_restart();
+
+  printf("DONE\n");
+  exit(0);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
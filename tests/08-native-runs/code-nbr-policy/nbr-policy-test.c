@@ -0,0 +1,252 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*---------------------------------------------------------------------------*/
+/**
+ * \file
+ *         Checks the link-quality and the RPL eviction policies of the
+ *         neighbor table
+ */
+/*---------------------------------------------------------------------------*/
+#include "contiki.h"
+#include "net/nbr-table.h"
+#include "net/link-stats.h"
+#include "net/mac/mac.h"
+#include "net/routing/rpl-lite/rpl.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+/*---------------------------------------------------------------------------*/
+#define NUM_ADDRS             16
+/* The rank of the DAG: neighbors with a lower rank are parents */
+#define TEST_DAG_RANK              768
+/*---------------------------------------------------------------------------*/
+PROCESS(nbr_policy_test_process, "nbr-table policy test process");
+AUTOSTART_PROCESSES(&nbr_policy_test_process);
+/*---------------------------------------------------------------------------*/
+extern rpl_of_t rpl_mrhof;
+
+static linkaddr_t addrs[NUM_ADDRS];
+/*---------------------------------------------------------------------------*/
+static void
+check(const char *descr, int success)
+{
+  printf("=check-me= %s - %s\n", success ? "SUCCEEDED" : "FAILED   ", descr);
+}
+/*---------------------------------------------------------------------------*/
+static int
+known(int i)
+{
+  return link_stats_from_lladdr(&addrs[i]) != NULL
+    || nbr_table_get_from_lladdr(rpl_neighbors, &addrs[i]) != NULL;
+}
+/*---------------------------------------------------------------------------*/
+/* Use the neighbors, from the least to the most recently used. The first
+ * ones are the candidates of the policies. */
+static void
+use_in_order(const int *order, int len)
+{
+  int i;
+
+  for(i = 0; i < len; i++) {
+    known(order[i]);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static struct link_stats *
+get_stats(int i)
+{
+  return (struct link_stats *)link_stats_from_lladdr(&addrs[i]);
+}
+/*---------------------------------------------------------------------------*/
+static rpl_nbr_t *
+get_rpl_nbr(int i)
+{
+  return rpl_neighbor_get_from_lladdr((uip_lladdr_t *)&addrs[i]);
+}
+/*---------------------------------------------------------------------------*/
+/* Add a neighbor known to RPL with the given rank, and with fresh link
+ * statistics if asked. Returns 0 if the table refused it. */
+static int
+add_neighbor(int i, rpl_rank_t rank, int with_stats,
+             nbr_table_reason_t reason, void *data)
+{
+  rpl_nbr_t *nbr;
+
+  nbr = nbr_table_add_lladdr(rpl_neighbors, &addrs[i], reason, data);
+  if(nbr == NULL) {
+    return 0;
+  }
+  nbr->rank = rank;
+  if(with_stats) {
+    link_stats_packet_sent(&addrs[i], MAC_TX_OK, 4);
+    get_stats(i)->etx = 2 * LINK_STATS_ETX_DIVISOR;
+  }
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static void
+check_link_stats_policy(void)
+{
+  static const int order1[] = { 0, 1, 2, 4, 3, 5, 6, 7 };
+  static const int order2[] = { 0, 1, 2, 3, 5, 6, 7, 8 };
+  static const int order3[] = { 0, 1, 3, 5, 6, 7, 8, 9 };
+  int i;
+
+  nbr_table_set_policy(&link_stats_nbr_policy);
+
+  for(i = 0; i < NBR_TABLE_MAX_NEIGHBORS; i++) {
+    add_neighbor(i, 2 * TEST_DAG_RANK, i != 4, NBR_TABLE_REASON_UNDEFINED, NULL);
+  }
+
+  /* No statistics at all count as the worst link */
+  get_stats(2)->etx = 5 * LINK_STATS_ETX_DIVISOR;
+  use_in_order(order1, NBR_TABLE_MAX_NEIGHBORS);
+  add_neighbor(8, 2 * TEST_DAG_RANK, 1, NBR_TABLE_REASON_LINK_STATS, NULL);
+  check("Link-stats evicts neighbors without statistics first",
+        known(8) && !known(4) && known(2));
+
+  /* Then the highest ETX among the least recently used */
+  get_stats(6)->etx = 16 * LINK_STATS_ETX_DIVISOR;
+  use_in_order(order2, NBR_TABLE_MAX_NEIGHBORS);
+  add_neighbor(9, 2 * TEST_DAG_RANK, 1, NBR_TABLE_REASON_LINK_STATS, NULL);
+  check("Link-stats evicts the worst link among the candidates",
+        known(9) && !known(2) && known(6));
+
+  /* Stale statistics count as worse than any ETX */
+  get_stats(3)->freshness = 0;
+  get_stats(1)->etx = 5 * LINK_STATS_ETX_DIVISOR;
+  use_in_order(order3, NBR_TABLE_MAX_NEIGHBORS);
+  add_neighbor(10, 2 * TEST_DAG_RANK, 1, NBR_TABLE_REASON_LINK_STATS, NULL);
+  check("Link-stats evicts stale links first",
+        known(10) && !known(3) && known(1));
+}
+/*---------------------------------------------------------------------------*/
+static void
+check_rpl_policy(void)
+{
+  static const int order1[] = { 0, 1, 5, 6, 7, 8, 9, 10 };
+  static const int order2[] = { 0, 1, 6, 7, 8, 9, 10, 11 };
+  static const int order3[] = { 0, 6, 7, 8, 9, 10, 11, 12 };
+  static const int order4[] = { 0, 6, 8, 9, 10, 11, 12, 13 };
+  rpl_dio_t dio;
+  nbr_table_stats_t stats;
+  uint32_t failures;
+  int i;
+
+  nbr_table_set_policy(&rpl_nbr_policy);
+
+  curr_instance.used = 1;
+  curr_instance.instance_id = RPL_DEFAULT_INSTANCE;
+  curr_instance.min_hoprankinc = RPL_MIN_HOPRANKINC;
+  curr_instance.of = &rpl_mrhof;
+  curr_instance.dag.rank = TEST_DAG_RANK;
+
+  for(i = 0; i < NUM_ADDRS; i++) {
+    if(get_stats(i) != NULL) {
+      get_stats(i)->etx = 2 * LINK_STATS_ETX_DIVISOR;
+      get_stats(i)->freshness = 4;
+    }
+  }
+
+  /* A neighbor unknown to RPL goes first */
+  nbr_table_remove(rpl_neighbors, get_rpl_nbr(5));
+  get_rpl_nbr(0)->rank = 4 * TEST_DAG_RANK;
+  use_in_order(order1, NBR_TABLE_MAX_NEIGHBORS);
+  add_neighbor(11, 2 * TEST_DAG_RANK, 1, NBR_TABLE_REASON_LINK_STATS, NULL);
+  check("RPL evicts neighbors it does not know first",
+        known(11) && !known(5) && known(0));
+
+  /* Then the worst rank among the candidates */
+  get_rpl_nbr(0)->rank = 2 * TEST_DAG_RANK;
+  get_rpl_nbr(1)->rank = 4 * TEST_DAG_RANK;
+  get_rpl_nbr(6)->rank = TEST_DAG_RANK / 2;
+  get_rpl_nbr(7)->rank = 3 * TEST_DAG_RANK;
+  use_in_order(order2, NBR_TABLE_MAX_NEIGHBORS);
+  add_neighbor(12, 2 * TEST_DAG_RANK, 1, NBR_TABLE_REASON_IPV6_ND_AUTOFILL, NULL);
+  check("RPL evicts the worst rank among the candidates",
+        known(12) && !known(1) && known(0));
+
+  /* A DIO sender replaces a neighbor only if clearly better */
+  nbr_table_get_stats(&stats);
+  failures = stats.failures;
+  dio.instance_id = curr_instance.instance_id;
+  dio.rank = rpl_neighbor_rank_via_nbr(get_rpl_nbr(7)) - curr_instance.min_hoprankinc;
+  use_in_order(order3, NBR_TABLE_MAX_NEIGHBORS);
+  i = add_neighbor(13, dio.rank, 1, NBR_TABLE_REASON_RPL_DIO, &dio);
+  nbr_table_get_stats(&stats);
+  check("RPL refuses a DIO sender that is not clearly better",
+        !i && stats.failures == failures + 1 && known(7));
+  dio.rank = TEST_DAG_RANK / 2;
+  use_in_order(order3, NBR_TABLE_MAX_NEIGHBORS);
+  check("RPL takes a DIO sender that is clearly better",
+        add_neighbor(13, dio.rank, 1, NBR_TABLE_REASON_RPL_DIO, &dio)
+        && !known(7));
+
+  /* Only RPL itself may push out a parent */
+  get_rpl_nbr(0)->rank = TEST_DAG_RANK / 3;
+  get_rpl_nbr(6)->rank = TEST_DAG_RANK / 2;
+  get_rpl_nbr(8)->rank = TEST_DAG_RANK / 3;
+  get_rpl_nbr(9)->rank = TEST_DAG_RANK / 2;
+  use_in_order(order4, NBR_TABLE_MAX_NEIGHBORS);
+  check("RPL keeps parents from other additions",
+        !add_neighbor(14, 2 * TEST_DAG_RANK, 1, NBR_TABLE_REASON_LINK_STATS, NULL)
+        && known(0) && known(6) && known(8) && known(9));
+  use_in_order(order4, NBR_TABLE_MAX_NEIGHBORS);
+  check("RPL evicts a parent for a DIS sender",
+        add_neighbor(14, 2 * TEST_DAG_RANK, 1, NBR_TABLE_REASON_RPL_DIS, NULL)
+        && !known(6) && known(9));
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(nbr_policy_test_process, ev, data)
+{
+  nbr_table_stats_t stats;
+  int i;
+
+  PROCESS_BEGIN();
+
+  for(i = 0; i < NUM_ADDRS; i++) {
+    addrs[i].u8[0] = 0x12;
+    addrs[i].u8[LINKADDR_SIZE - 1] = i + 1;
+  }
+
+  check_link_stats_policy();
+  check_rpl_policy();
+
+  nbr_table_get_stats(&stats);
+  printf("nbr-table: %lu link-stats evictions, %lu RPL evictions, %lu failures\n",
+         (unsigned long)stats.evictions[NBR_TABLE_REASON_LINK_STATS],
+         (unsigned long)(stats.evictions[NBR_TABLE_REASON_RPL_DIO]
+                         + stats.evictions[NBR_TABLE_REASON_RPL_DIS]
+                         + stats.evictions[NBR_TABLE_REASON_IPV6_ND_AUTOFILL]),
+         (unsigned long)stats.failures);
+
+  exit(0);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,261 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*---------------------------------------------------------------------------*/
+/**
+ * \file
+ *         nbr-table lookup benchmark, which also checks that lookups stay
+ *         correct as neighbors are evicted and replaced
+ */
+/*---------------------------------------------------------------------------*/
+#include "contiki.h"
+#include "net/nbr-table.h"
+#include "lib/random.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+/*---------------------------------------------------------------------------*/
+#define LOOKUPS            200000
+#define CHURN_OPS          20000
+#define EVICTIONS          20000
+/*---------------------------------------------------------------------------*/
+PROCESS(nbr_table_benchmark_process, "nbr-table benchmark process");
+AUTOSTART_PROCESSES(&nbr_table_benchmark_process);
+/*---------------------------------------------------------------------------*/
+struct nbr {
+  linkaddr_t addr;
+};
+NBR_TABLE(struct nbr, nbrs);
+
+/* The address that each item of the table is expected to hold */
+static linkaddr_t expected[NBR_TABLE_MAX_NEIGHBORS];
+/*---------------------------------------------------------------------------*/
+static uint64_t
+now_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+/*---------------------------------------------------------------------------*/
+static void
+check(const char *descr, int success)
+{
+  printf("=check-me= %s - %s\n", success ? "SUCCEEDED" : "FAILED   ", descr);
+}
+/*---------------------------------------------------------------------------*/
+/* Addresses that share a prefix, as in a real network */
+static void
+random_addr(linkaddr_t *addr)
+{
+  int i;
+
+  for(i = 0; i < LINKADDR_SIZE; i++) {
+    addr->u8[i] = i < LINKADDR_SIZE - 3 ? 0x12 : random_rand();
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Add a neighbor that is not yet in the table */
+static struct nbr *
+add_new(void)
+{
+  linkaddr_t addr;
+  struct nbr *n;
+
+  do {
+    random_addr(&addr);
+  } while(nbr_table_get_from_lladdr(nbrs, &addr) != NULL);
+
+  n = nbr_table_add_lladdr(nbrs, &addr, NBR_TABLE_REASON_UNDEFINED, NULL);
+  if(n != NULL) {
+    linkaddr_copy(&n->addr, &addr);
+    linkaddr_copy(&expected[n - (struct nbr *)nbrs->data], &addr);
+  }
+  return n;
+}
+/*---------------------------------------------------------------------------*/
+/* Every neighbor is found at its own item */
+static int
+table_consistent(void)
+{
+  struct nbr *n;
+  int i;
+
+  for(i = 0; i < NBR_TABLE_MAX_NEIGHBORS; i++) {
+    n = nbr_table_get_from_lladdr(nbrs, &expected[i]);
+    if(n != (struct nbr *)nbrs->data + i ||
+       !linkaddr_cmp(&n->addr, &expected[i])) {
+      return 0;
+    }
+  }
+  return 1;
+}
+#if NBR_TABLE_LRU
+/*---------------------------------------------------------------------------*/
+/* Add neighbors to the full table, each evicting one */
+static int
+bench_evictions(const nbr_table_policy_t *policy)
+{
+  uint64_t start, total;
+  int success = 1;
+  int op;
+
+  nbr_table_set_policy(policy);
+  start = now_ns();
+  for(op = 0; op < EVICTIONS; op++) {
+    success &= add_new() != NULL;
+  }
+  total = now_ns() - start;
+  printf("%s: %lu evictions/s\n", policy->name,
+         (unsigned long)(EVICTIONS * 1000000000ULL / (total > 0 ? total : 1)));
+  return success;
+}
+/*---------------------------------------------------------------------------*/
+/* Use all neighbors but one, in index order */
+static void
+use_all_but(int skipped)
+{
+  int i;
+
+  for(i = 0; i < NBR_TABLE_MAX_NEIGHBORS; i++) {
+    if(i != skipped) {
+      nbr_table_get_from_lladdr(nbrs, &expected[i]);
+    }
+  }
+}
+#endif /* NBR_TABLE_LRU */
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(nbr_table_benchmark_process, ev, data)
+{
+  static linkaddr_t misses[64];
+  uint64_t start, total;
+  unsigned long found;
+  struct nbr *n;
+  linkaddr_t evicted;
+  int consistent;
+  int i, op;
+#if NBR_TABLE_LRU
+  nbr_table_stats_t stats;
+  int first;
+#endif /* NBR_TABLE_LRU */
+
+  PROCESS_BEGIN();
+
+  printf("nbr-table benchmark (%u neighbors, %s%s)\n", NBR_TABLE_MAX_NEIGHBORS,
+         NBR_TABLE_HASH ? "hash" : "list", NBR_TABLE_LRU ? ", lru" : "");
+
+  random_init(0x1234);
+  nbr_table_register(nbrs, NULL);
+
+  consistent = 1;
+  for(i = 0; i < NBR_TABLE_MAX_NEIGHBORS; i++) {
+    consistent &= add_new() != NULL;
+  }
+  check("The table fills up", consistent);
+  check("Neighbors are found after filling", table_consistent());
+
+  for(i = 0; i < 64; i++) {
+    do {
+      random_addr(&misses[i]);
+    } while(nbr_table_get_from_lladdr(nbrs, &misses[i]) != NULL);
+  }
+
+  /* Half of the lookups are for neighbors not in the table */
+  found = 0;
+  start = now_ns();
+  for(op = 0; op < LOOKUPS; op++) {
+    if(op & 1) {
+      found += nbr_table_get_from_lladdr(nbrs, &misses[op & 63]) != NULL;
+    } else {
+      found += nbr_table_get_from_lladdr(nbrs,
+                 &expected[(op >> 1) % NBR_TABLE_MAX_NEIGHBORS]) != NULL;
+    }
+  }
+  total = now_ns() - start;
+  printf("%lu lookups/s\n",
+         (unsigned long)(LOOKUPS * 1000000000ULL / (total > 0 ? total : 1)));
+  check("Lookups find the neighbors and only them", found == LOOKUPS / 2);
+
+  /* Replace neighbors: a removed entry is the one evicted for the next */
+  consistent = 1;
+  for(op = 0; op < CHURN_OPS; op++) {
+    i = random_rand() % NBR_TABLE_MAX_NEIGHBORS;
+    linkaddr_copy(&evicted, &expected[i]);
+    nbr_table_remove(nbrs, (struct nbr *)nbrs->data + i);
+    n = add_new();
+    consistent &= n == (struct nbr *)nbrs->data + i;
+    consistent &= nbr_table_get_from_lladdr(nbrs, &evicted) == NULL;
+    if(op % 100 == 0) {
+      consistent &= table_consistent();
+    }
+  }
+  check("Neighbors are found after evictions", consistent &&
+        table_consistent());
+
+#if NBR_TABLE_LRU
+  /* Evict from the full table, by fewest tables and by recency */
+  consistent = bench_evictions(&nbr_table_policy_least_used);
+  consistent &= bench_evictions(&nbr_table_policy_lru);
+  check("Neighbors are evicted from the full table", consistent &&
+        table_consistent());
+
+  i = random_rand() % NBR_TABLE_MAX_NEIGHBORS;
+  use_all_but(i);
+  linkaddr_copy(&evicted, &expected[i]);
+  n = add_new();
+  check("LRU evicts the least recently used neighbor",
+        n == (struct nbr *)nbrs->data + i &&
+        nbr_table_get_from_lladdr(nbrs, &evicted) == NULL);
+
+  /* A locked neighbor is skipped, even when least recently used */
+  i = random_rand() % NBR_TABLE_MAX_NEIGHBORS;
+  first = i == 0 ? 1 : 0;
+  nbr_table_lock(nbrs, (struct nbr *)nbrs->data + i);
+  use_all_but(i);
+  n = add_new();
+  check("LRU skips locked neighbors",
+        n == (struct nbr *)nbrs->data + first &&
+        nbr_table_get_from_lladdr(nbrs, &expected[i]) != NULL);
+  nbr_table_unlock(nbrs, (struct nbr *)nbrs->data + i);
+
+  nbr_table_get_stats(&stats);
+  check("Evictions are counted by reason",
+        stats.evictions[NBR_TABLE_REASON_UNDEFINED] >= 2 * EVICTIONS + 2 &&
+        stats.evictions[NBR_TABLE_REASON_MAC] == 0 &&
+        stats.locked_evictions == 0 && stats.failures == 0);
+  check("Neighbors are found after LRU evictions", table_consistent());
+#endif /* NBR_TABLE_LRU */
+
+  exit(0);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
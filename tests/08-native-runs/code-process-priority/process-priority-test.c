@@ -0,0 +1,253 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*---------------------------------------------------------------------------*/
+/**
+ * \file
+ *         Checks the order in which the scheduler dispatches events and
+ *         polls, with and without process priority levels, and the count
+ *         of the events dropped on a full queue
+ */
+/*---------------------------------------------------------------------------*/
+#include "contiki.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+/*---------------------------------------------------------------------------*/
+#define MID_PRIORITY  1
+/*---------------------------------------------------------------------------*/
+PROCESS(process_priority_test_process, "Process priority test process");
+PROCESS(low_process, "Low priority process");
+PROCESS(mid_process, "Mid priority process");
+PROCESS(high_process, "High priority process");
+PROCESS(spin_process, "Self-polling process");
+AUTOSTART_PROCESSES(&process_priority_test_process);
+/*---------------------------------------------------------------------------*/
+static process_event_t test_event;
+/* What the processes received, in order: lowercase for events, followed
+   by their data if any, uppercase for polls */
+static char received[32];
+static int received_len;
+static int spinning;
+static unsigned spin_polls;
+/*---------------------------------------------------------------------------*/
+static void
+check(const char *descr, int success)
+{
+  printf("=check-me= %s - %s\n", success ? "SUCCEEDED" : "FAILED   ", descr);
+}
+/*---------------------------------------------------------------------------*/
+static void
+record(char tag, process_event_t ev, process_data_t data)
+{
+  if(received_len + 2 >= sizeof(received)) {
+    return;
+  }
+  if(ev == PROCESS_EVENT_POLL) {
+    received[received_len++] = tag - 'a' + 'A';
+  } else if(ev == test_event) {
+    received[received_len++] = tag;
+    if(data != NULL) {
+      received[received_len++] = '0' + (int)(uintptr_t)data;
+    }
+  }
+  received[received_len] = '\0';
+}
+/*---------------------------------------------------------------------------*/
+static void
+reset_received(void)
+{
+  received_len = 0;
+  received[0] = '\0';
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(low_process, ev, data)
+{
+  PROCESS_BEGIN();
+  while(1) {
+    PROCESS_YIELD();
+    record('l', ev, data);
+  }
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(mid_process, ev, data)
+{
+  PROCESS_BEGIN();
+  while(1) {
+    PROCESS_YIELD();
+    record('m', ev, data);
+  }
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(high_process, ev, data)
+{
+  PROCESS_BEGIN();
+  while(1) {
+    PROCESS_YIELD();
+    record('h', ev, data);
+  }
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
+/* Polls itself for as long as it is asked to */
+PROCESS_THREAD(spin_process, ev, data)
+{
+  PROCESS_BEGIN();
+  while(1) {
+    PROCESS_YIELD();
+    if(ev == PROCESS_EVENT_POLL && spinning) {
+      spin_polls++;
+      process_poll(PROCESS_CURRENT());
+    }
+  }
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(process_priority_test_process, ev, data)
+{
+  static struct etimer et;
+  static unsigned long dropped;
+  static int posted;
+  static int full;
+  int i;
+
+  PROCESS_BEGIN();
+
+  printf("Process priority test (%u levels)\n", PROCESS_PRIORITY_LEVELS);
+
+  test_event = process_alloc_event();
+
+  /* Started from the highest to the lowest, so that the process list
+     goes from the lowest to the highest */
+  process_start(&high_process, NULL);
+  process_start(&mid_process, NULL);
+  process_start(&low_process, NULL);
+  process_start(&spin_process, NULL);
+  process_set_priority(&high_process, PROCESS_PRIORITY_HIGH);
+  process_set_priority(&mid_process, MID_PRIORITY);
+
+  /* Events: by priority, then in the order of posting */
+  reset_received();
+  process_post(&low_process, test_event, (process_data_t)1);
+  process_post(&low_process, test_event, (process_data_t)2);
+  process_post(&mid_process, test_event, NULL);
+  process_post(&high_process, test_event, NULL);
+  process_post(PROCESS_CURRENT(), test_event, NULL);
+  PROCESS_WAIT_EVENT_UNTIL(ev == test_event);
+#if PROCESS_PRIORITY_LEVELS > 1
+  check("Events go by priority, then first in first out",
+        strcmp(received, "hml1l2") == 0);
+#else /* PROCESS_PRIORITY_LEVELS > 1 */
+  check("Events go first in first out", strcmp(received, "l1l2mh") == 0);
+#endif /* PROCESS_PRIORITY_LEVELS > 1 */
+
+  /* Polls: by priority, each process once, before the next event */
+  reset_received();
+  process_poll(&low_process);
+  process_poll(&high_process);
+  process_poll(&mid_process);
+  process_poll(&low_process);
+  process_post(PROCESS_CURRENT(), test_event, NULL);
+  PROCESS_WAIT_EVENT_UNTIL(ev == test_event);
+#if PROCESS_PRIORITY_LEVELS > 1
+  check("Polls go by priority, once per process",
+        strcmp(received, "HML") == 0);
+#else /* PROCESS_PRIORITY_LEVELS > 1 */
+  check("Polls go in process list order, once per process",
+        strcmp(received, "LMH") == 0);
+#endif /* PROCESS_PRIORITY_LEVELS > 1 */
+
+#if PROCESS_PRIORITY_LEVELS > 1
+  /* A pending poll follows the process to its new priority */
+  reset_received();
+  process_poll(&mid_process);
+  process_poll(&low_process);
+  process_set_priority(&low_process, PROCESS_PRIORITY_HIGH);
+  process_post(PROCESS_CURRENT(), test_event, NULL);
+  PROCESS_WAIT_EVENT_UNTIL(ev == test_event);
+  process_set_priority(&low_process, PROCESS_PRIORITY_NORMAL);
+  check("A pending poll follows a priority change",
+        strcmp(received, "LM") == 0);
+#endif /* PROCESS_PRIORITY_LEVELS > 1 */
+
+  /* An exited process loses its pending poll, and is polled again
+     once restarted */
+  reset_received();
+  process_poll(&mid_process);
+  process_poll(&low_process);
+  process_exit(&mid_process);
+  process_post(PROCESS_CURRENT(), test_event, NULL);
+  PROCESS_WAIT_EVENT_UNTIL(ev == test_event);
+  process_start(&mid_process, NULL);
+  process_poll(&mid_process);
+  process_poll(&high_process);
+  process_post(PROCESS_CURRENT(), test_event, NULL);
+  PROCESS_WAIT_EVENT_UNTIL(ev == test_event);
+#if PROCESS_PRIORITY_LEVELS > 1
+  check("Exited processes are not polled", strcmp(received, "LHM") == 0);
+#else /* PROCESS_PRIORITY_LEVELS > 1 */
+  check("Exited processes are not polled", strcmp(received, "LMH") == 0);
+#endif /* PROCESS_PRIORITY_LEVELS > 1 */
+
+  /* A process that keeps polling itself does not hold events back */
+  spinning = 1;
+  spin_polls = 0;
+  process_poll(&spin_process);
+  process_post(PROCESS_CURRENT(), test_event, NULL);
+  PROCESS_WAIT_EVENT_UNTIL(ev == test_event);
+  spinning = 0;
+  check("Self-polling does not starve events", spin_polls <= 2);
+
+  /* Events posted to a full queue are counted */
+  dropped = process_events_dropped;
+  posted = 0;
+  for(i = 0; i < PROCESS_CONF_NUMEVENTS + 2; i++) {
+    if(process_post(&low_process, PROCESS_EVENT_CONTINUE, NULL) == PROCESS_ERR_OK) {
+      posted++;
+    }
+  }
+  full = PROCESS_CONF_NUMEVENTS + 2 - posted;
+  check("Events posted to a full queue are counted",
+        full >= 2 && process_events_dropped - dropped == full &&
+        process_maxevents == PROCESS_CONF_NUMEVENTS);
+
+  /* Let the queue drain: a timer needs no room in it */
+  etimer_set(&et, 1);
+  PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&et));
+
+  printf("%u levels: %lu events dropped, at most %u queued\n",
+         PROCESS_PRIORITY_LEVELS, process_events_dropped,
+         (unsigned)process_maxevents);
+
+  exit(0);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
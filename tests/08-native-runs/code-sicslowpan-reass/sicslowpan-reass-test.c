@@ -0,0 +1,587 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*---------------------------------------------------------------------------*/
+/**
+ * \file
+ *         Feeds the fragments of a datagram to 6LoWPAN out of order, with
+ *         duplicates and with fragments at the edge of the reassembly
+ *         buffer, and checks the datagram that comes out. Also checks the
+ *         fragments that 6LoWPAN sends, and those it forwards without
+ *         reassembling them.
+ */
+/*---------------------------------------------------------------------------*/
+#include "contiki.h"
+#include "net/ipv6/uip.h"
+#include "net/ipv6/uip-ds6.h"
+#include "net/ipv6/uip-ds6-nbr.h"
+#include "net/ipv6/sicslowpan.h"
+#include "net/packetbuf.h"
+#include "net/netstack.h"
+#include "net/queuebuf.h"
+#include "lib/random.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+/*---------------------------------------------------------------------------*/
+#define DATAGRAM_LEN       1024
+/* Datagram bytes carried by each fragment, a multiple of 8 */
+#define FRAGMENT_LEN       96
+#define NUM_FRAGN          ((DATAGRAM_LEN - 1) / FRAGMENT_LEN)
+#define RANDOM_ROUNDS      100
+/* Room for the frames sent by the MAC driver of the test */
+#define MAC_PAYLOAD        100
+#define MAX_FRAMES         16
+#define MAX_TRANSMISSIONS  5
+/*---------------------------------------------------------------------------*/
+PROCESS(sicslowpan_reass_test_process, "6LoWPAN reassembly test process");
+AUTOSTART_PROCESSES(&sicslowpan_reass_test_process);
+/*---------------------------------------------------------------------------*/
+static uint8_t datagram[DATAGRAM_LEN];
+static uint8_t delivered[UIP_BUFSIZE];
+static uint16_t delivered_len;
+static int deliveries;
+static uint16_t tag;
+static const linkaddr_t sender = { { 1, 2, 3, 4, 5, 6, 7, 8 } };
+#if SICSLOWPAN_FRAG_FORWARDING
+/* The next hop of routed datagrams */
+static const linkaddr_t nexthop = { { 2, 2, 2, 2, 2, 2, 2, 2 } };
+#endif /* SICSLOWPAN_FRAG_FORWARDING */
+
+/* The frames sent, and whether each kept the attributes of the datagram */
+static uint8_t frames[MAX_FRAMES][PACKETBUF_SIZE];
+static uint16_t frame_lens[MAX_FRAMES];
+static linkaddr_t frame_receivers[MAX_FRAMES];
+static int num_frames;
+static int frames_with_attrs;
+/*---------------------------------------------------------------------------*/
+/* A MAC driver that keeps the frames, and then modifies packetbuf like a
+   framer would */
+static void
+mac_send(mac_callback_t sent, void *ptr)
+{
+  if(num_frames < MAX_FRAMES) {
+    memcpy(frames[num_frames], packetbuf_dataptr(), packetbuf_datalen());
+    frame_lens[num_frames] = packetbuf_datalen();
+    linkaddr_copy(&frame_receivers[num_frames],
+                  packetbuf_addr(PACKETBUF_ADDR_RECEIVER));
+    num_frames++;
+  }
+  if(!linkaddr_cmp(packetbuf_addr(PACKETBUF_ADDR_RECEIVER), &linkaddr_null) &&
+     packetbuf_attr(PACKETBUF_ATTR_MAX_MAC_TRANSMISSIONS)
+     == MAX_TRANSMISSIONS) {
+    frames_with_attrs++;
+  }
+  packetbuf_hdralloc(16);
+  memset(packetbuf_hdrptr(), 0xff, 16);
+  packetbuf_set_attr(PACKETBUF_ATTR_MAX_MAC_TRANSMISSIONS, 0);
+  packetbuf_set_addr(PACKETBUF_ADDR_RECEIVER, &linkaddr_null);
+  mac_call_sent_callback(sent, ptr, MAC_TX_OK, 1);
+}
+/*---------------------------------------------------------------------------*/
+static void
+mac_init(void)
+{
+}
+/*---------------------------------------------------------------------------*/
+static void
+mac_input(void)
+{
+}
+/*---------------------------------------------------------------------------*/
+static int
+mac_on_off(void)
+{
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static int
+mac_max_payload(void)
+{
+  return MAC_PAYLOAD;
+}
+/*---------------------------------------------------------------------------*/
+const struct mac_driver test_mac_driver = {
+  "test-mac",
+  mac_init,
+  mac_send,
+  mac_input,
+  mac_on_off,
+  mac_on_off,
+  mac_max_payload,
+};
+/*---------------------------------------------------------------------------*/
+static void
+check(const char *descr, int success)
+{
+  printf("=check-me= %s - %s\n", success ? "SUCCEEDED" : "FAILED   ", descr);
+}
+/*---------------------------------------------------------------------------*/
+/* Reassembled datagrams end up here instead of in uIP */
+static enum netstack_ip_action
+capture_input(void)
+{
+  memcpy(delivered, uip_buf, uip_len);
+  delivered_len = uip_len;
+  deliveries++;
+  return NETSTACK_IP_DROP;
+}
+static struct netstack_ip_packet_processor capture = {
+  .process_input = capture_input
+};
+/*---------------------------------------------------------------------------*/
+/* A new datagram without upper layer header, and a new tag for it */
+static void
+new_datagram(void)
+{
+  int i;
+
+  memset(datagram, 0, UIP_IPH_LEN);
+  datagram[0] = 0x60;
+  datagram[4] = (DATAGRAM_LEN - UIP_IPH_LEN) >> 8;
+  datagram[5] = (DATAGRAM_LEN - UIP_IPH_LEN) & 0xff;
+  datagram[6] = UIP_PROTO_NONE;
+  datagram[7] = 64;
+  datagram[8] = datagram[24] = 0xfe;
+  datagram[9] = datagram[25] = 0x80;
+  datagram[23] = 1;
+  datagram[39] = 2;
+  for(i = UIP_IPH_LEN; i < DATAGRAM_LEN; i++) {
+    datagram[i] = random_rand();
+  }
+  tag++;
+  deliveries = 0;
+}
+/*---------------------------------------------------------------------------*/
+static void
+input_frame(const uint8_t *frame, int len)
+{
+  packetbuf_clear();
+  packetbuf_copyfrom(frame, len);
+  packetbuf_set_addr(PACKETBUF_ADDR_SENDER, &sender);
+  packetbuf_set_addr(PACKETBUF_ADDR_RECEIVER, &linkaddr_node_addr);
+  sicslowpan_driver.input();
+}
+/*---------------------------------------------------------------------------*/
+/* The first fragment, with an uncompressed IPv6 header */
+static void
+input_frag1(void)
+{
+  uint8_t frame[SICSLOWPAN_FRAG1_HDR_LEN + 1 + FRAGMENT_LEN];
+
+  frame[0] = SICSLOWPAN_DISPATCH_FRAG1 | (DATAGRAM_LEN >> 8);
+  frame[1] = DATAGRAM_LEN & 0xff;
+  frame[2] = tag >> 8;
+  frame[3] = tag & 0xff;
+  frame[4] = SICSLOWPAN_DISPATCH_IPV6;
+  memcpy(&frame[5], datagram, FRAGMENT_LEN);
+  input_frame(frame, sizeof(frame));
+}
+/*---------------------------------------------------------------------------*/
+/* A subsequent fragment of a datagram of the given size, with len bytes
+   of the datagram from offset. Bytes past the end of the datagram are
+   zero. */
+static void
+input_fragn_sized(uint16_t size, uint16_t offset, uint16_t len)
+{
+  uint8_t frame[SICSLOWPAN_FRAGN_HDR_LEN + FRAGMENT_LEN];
+
+  frame[0] = SICSLOWPAN_DISPATCH_FRAGN | (size >> 8);
+  frame[1] = size & 0xff;
+  frame[2] = tag >> 8;
+  frame[3] = tag & 0xff;
+  frame[4] = offset >> 3;
+  memset(&frame[5], 0, len);
+  if(offset < DATAGRAM_LEN) {
+    memcpy(&frame[5], &datagram[offset], MIN(len, DATAGRAM_LEN - offset));
+  }
+  input_frame(frame, SICSLOWPAN_FRAGN_HDR_LEN + len);
+}
+/*---------------------------------------------------------------------------*/
+static void
+input_fragn(uint16_t offset, uint16_t len)
+{
+  input_fragn_sized(DATAGRAM_LEN, offset, len);
+}
+/*---------------------------------------------------------------------------*/
+/* Subsequent fragment i, from 0 to NUM_FRAGN - 1 */
+static void
+input_fragment(int i)
+{
+  uint16_t offset = (i + 1) * FRAGMENT_LEN;
+
+  input_fragn(offset, MIN(FRAGMENT_LEN, DATAGRAM_LEN - offset));
+}
+/*---------------------------------------------------------------------------*/
+static int
+delivered_once(void)
+{
+  return deliveries == 1 && delivered_len == DATAGRAM_LEN &&
+    memcmp(delivered, datagram, DATAGRAM_LEN) == 0;
+}
+/*---------------------------------------------------------------------------*/
+static int
+check_in_order(void)
+{
+  int i;
+
+  new_datagram();
+  input_frag1();
+  for(i = 0; i < NUM_FRAGN; i++) {
+    input_fragment(i);
+  }
+  return delivered_once();
+}
+/*---------------------------------------------------------------------------*/
+static int
+check_reverse_order(void)
+{
+  int i;
+
+  new_datagram();
+  input_frag1();
+  for(i = NUM_FRAGN - 1; i >= 0; i--) {
+    input_fragment(i);
+  }
+  return delivered_once();
+}
+/*---------------------------------------------------------------------------*/
+#if SICSLOWPAN_REASS_DIRECT
+/* Fragments in random order, each possibly followed by a retransmission
+   of one that was received already. The fragment buffers count every
+   fragment towards the datagram length, retransmissions included, so
+   this only holds with the in-place reassembly. */
+static int
+check_duplicates(void)
+{
+  int order[NUM_FRAGN];
+  int r, i, j, tmp;
+
+  for(r = 0; r < RANDOM_ROUNDS; r++) {
+    new_datagram();
+    for(i = 0; i < NUM_FRAGN; i++) {
+      order[i] = i;
+    }
+    for(i = NUM_FRAGN - 1; i > 0; i--) {
+      j = random_rand() % (i + 1);
+      tmp = order[i];
+      order[i] = order[j];
+      order[j] = tmp;
+    }
+    input_frag1();
+    for(i = 0; i < NUM_FRAGN; i++) {
+      input_fragment(order[i]);
+      if(i < NUM_FRAGN - 1 && random_rand() % 2) {
+        input_fragment(order[random_rand() % (i + 1)]);
+      }
+    }
+    if(!delivered_once()) {
+      return 0;
+    }
+  }
+  return 1;
+}
+#endif /* SICSLOWPAN_REASS_DIRECT */
+/*---------------------------------------------------------------------------*/
+/* An empty fragment right at the end of the reassembly buffer, and one
+   that runs past it, are dropped without harming the datagram */
+static int
+check_boundaries(void)
+{
+  const struct sicslowpan_reass_stats *stats = sicslowpan_get_reass_stats();
+  uint16_t dropped;
+  int i;
+
+  new_datagram();
+  dropped = stats->dropped;
+  input_frag1();
+  input_fragn(UIP_BUFSIZE, 0);
+  input_fragn(UIP_BUFSIZE - 8, 16);
+  for(i = 0; i < NUM_FRAGN; i++) {
+    input_fragment(i);
+  }
+  return delivered_once() && stats->dropped == dropped + 2;
+}
+/*---------------------------------------------------------------------------*/
+#if SICSLOWPAN_REASS_DIRECT
+/* Fragments that claim another datagram size are dropped, and fragments
+   overlapping each other at different offsets count their bytes once.
+   Neither may complete the datagram before all of it was received, nor
+   make it longer than announced by the first fragment. */
+static int
+check_overlaps(void)
+{
+  const struct sicslowpan_reass_stats *stats = sicslowpan_get_reass_stats();
+  uint16_t dropped;
+  uint16_t offset;
+  int i;
+
+  new_datagram();
+  dropped = stats->dropped;
+  input_frag1();
+  for(offset = FRAGMENT_LEN; offset < DATAGRAM_LEN - 8; offset += 8) {
+    input_fragn_sized(0x7ff, offset, 8);
+  }
+  input_fragn_sized(2 * FRAGMENT_LEN, FRAGMENT_LEN, FRAGMENT_LEN);
+  if(deliveries != 0 ||
+     stats->dropped != dropped + (DATAGRAM_LEN - 8 - FRAGMENT_LEN) / 8 + 1) {
+    return 0;
+  }
+
+  /* Fragments sliding over the second one, eight bytes apart */
+  for(i = 0; i < DATAGRAM_LEN / 8; i++) {
+    input_fragn(FRAGMENT_LEN + (i % (FRAGMENT_LEN / 8)) * 8, FRAGMENT_LEN);
+  }
+  if(deliveries != 0) {
+    return 0;
+  }
+
+  for(i = 0; i < NUM_FRAGN; i++) {
+    input_fragment(i);
+  }
+  return delivered_once();
+}
+#endif /* SICSLOWPAN_REASS_DIRECT */
+/*---------------------------------------------------------------------------*/
+/* Send the datagram to the sender, through the MAC driver of the test */
+static int
+output_datagram(void)
+{
+  memcpy(uip_buf, datagram, DATAGRAM_LEN);
+  uip_len = DATAGRAM_LEN;
+  uipbuf_clear_attr();
+  uipbuf_set_attr(UIPBUF_ATTR_MAX_MAC_TRANSMISSIONS, MAX_TRANSMISSIONS);
+  num_frames = 0;
+  frames_with_attrs = 0;
+  return sicslowpan_driver.output(&sender) && num_frames > 1 &&
+    num_frames < MAX_FRAMES && frames_with_attrs == num_frames;
+}
+/*---------------------------------------------------------------------------*/
+/* The fragments sent are reassembled into the datagram */
+static int
+check_round_trip(void)
+{
+  int i;
+
+  new_datagram();
+  if(!output_datagram()) {
+    return 0;
+  }
+  for(i = 0; i < num_frames; i++) {
+    input_frame(frames[i], frame_lens[i]);
+  }
+  return delivered_once();
+}
+/*---------------------------------------------------------------------------*/
+/* Fragmenting takes no queuebuf of its own, so a datagram goes out as
+   long as the MAC layer can queue each of its fragments */
+static int
+check_free_queuebufs(void)
+{
+  struct queuebuf *held[QUEUEBUF_NUM];
+  int fragments = num_frames;
+  int n = 0;
+  int success;
+
+  packetbuf_clear();
+  while(queuebuf_numfree() > fragments) {
+    held[n++] = queuebuf_new_from_packetbuf();
+  }
+  new_datagram();
+  success = output_datagram() && num_frames == fragments;
+  while(n > 0) {
+    queuebuf_free(held[--n]);
+  }
+  return success;
+}
+/*---------------------------------------------------------------------------*/
+#if SICSLOWPAN_FRAG_FORWARDING
+/* Make the datagram a UDP one that is routed through this node, with a
+   Hop-by-Hop header holding a RPL option if hbh is set */
+static void
+route_datagram(int hbh)
+{
+  static const uint8_t rpl_option[8] = {
+    UIP_PROTO_UDP, 0, UIP_EXT_HDR_OPT_RPL, 4, 0, 0x1e, 0, 0
+  };
+
+  datagram[6] = UIP_PROTO_UDP;
+  datagram[8] = datagram[24] = 0x20;
+  datagram[9] = datagram[25] = 0x01;
+  if(hbh) {
+    datagram[6] = UIP_PROTO_HBHO;
+    memcpy(&datagram[UIP_IPH_LEN], rpl_option, sizeof(rpl_option));
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* The next hop is the default router */
+static void
+add_nexthop(void)
+{
+  uip_ipaddr_t ipaddr;
+
+  uip_ip6addr(&ipaddr, 0xfe80, 0, 0, 0, 0x0002, 0x0202, 0x0202, 0x0202);
+  uip_ds6_nbr_add(&ipaddr, (const uip_lladdr_t *)&nexthop, 1,
+                  NBR_REACHABLE, NBR_TABLE_REASON_UNDEFINED, NULL);
+  uip_ds6_defrt_add(&ipaddr, 0);
+}
+/*---------------------------------------------------------------------------*/
+/* The subsequent fragments go on as they are, with a new tag, and
+   retransmissions of a fragment are not forwarded again */
+static int
+check_forwarding(void)
+{
+  const struct sicslowpan_reass_stats *stats = sicslowpan_get_reass_stats();
+  uint16_t forwarded = stats->forwarded;
+  uint16_t out_tag;
+  int i;
+
+  new_datagram();
+  route_datagram(0);
+  num_frames = 0;
+  input_frag1();
+  for(i = 0; i < NUM_FRAGN; i++) {
+    input_fragment(i);
+    input_fragment(i / 2);
+  }
+  if(deliveries != 0 || stats->forwarded != forwarded + 1 ||
+     num_frames != 1 + NUM_FRAGN ||
+     !linkaddr_cmp(&frame_receivers[0], &nexthop)) {
+    return 0;
+  }
+  out_tag = (frames[0][2] << 8) | frames[0][3];
+  for(i = 0; i < NUM_FRAGN; i++) {
+    if(!linkaddr_cmp(&frame_receivers[i + 1], &nexthop) ||
+       ((frames[i + 1][2] << 8) | frames[i + 1][3]) != out_tag ||
+       frames[i + 1][4] != (i + 1) * FRAGMENT_LEN / 8 ||
+       memcmp(&frames[i + 1][SICSLOWPAN_FRAGN_HDR_LEN],
+              &datagram[(i + 1) * FRAGMENT_LEN],
+              frame_lens[i + 1] - SICSLOWPAN_FRAGN_HDR_LEN) != 0) {
+      return 0;
+    }
+  }
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+/* A datagram whose Hop-by-Hop header cannot be updated here is
+   reassembled, for uip_process() to deal with */
+static int
+check_update_failure(void)
+{
+  int i;
+
+  new_datagram();
+  route_datagram(1);
+  num_frames = 0;
+  input_frag1();
+  for(i = 0; i < NUM_FRAGN; i++) {
+    input_fragment(i);
+  }
+  return num_frames == 0 && delivered_once();
+}
+/*---------------------------------------------------------------------------*/
+/* With the only forwarding entry taken, a datagram is reassembled and
+   the one being forwarded keeps its entry */
+static int
+check_full_table(void)
+{
+  static uint8_t first[DATAGRAM_LEN];
+  uint16_t first_tag;
+  int i;
+
+  new_datagram();
+  route_datagram(0);
+  num_frames = 0;
+  input_frag1();
+  memcpy(first, datagram, DATAGRAM_LEN);
+  first_tag = tag;
+
+  new_datagram();
+  route_datagram(0);
+  input_frag1();
+  for(i = 0; i < NUM_FRAGN; i++) {
+    input_fragment(i);
+  }
+  if(num_frames != 1 || !delivered_once()) {
+    return 0;
+  }
+
+  memcpy(datagram, first, DATAGRAM_LEN);
+  tag = first_tag;
+  for(i = 0; i < NUM_FRAGN; i++) {
+    input_fragment(i);
+  }
+  return num_frames == 1 + NUM_FRAGN;
+}
+#endif /* SICSLOWPAN_FRAG_FORWARDING */
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(sicslowpan_reass_test_process, ev, data)
+{
+  PROCESS_BEGIN();
+
+  printf("Reassembly test (%s%s)\n",
+         SICSLOWPAN_REASS_DIRECT ? "in place" : "fragment buffers",
+         SICSLOWPAN_FRAG_FORWARDING ? ", forwarding" : "");
+
+  netstack_ip_packet_processor_add(&capture);
+
+  check("In-order fragments are reassembled", check_in_order());
+  check("Reversed fragments are reassembled", check_reverse_order());
+#if SICSLOWPAN_REASS_DIRECT
+  check("Retransmitted fragments are ignored", check_duplicates());
+#endif /* SICSLOWPAN_REASS_DIRECT */
+  check("Fragments out of the buffer are dropped", check_boundaries());
+#if SICSLOWPAN_REASS_DIRECT
+  check("Resized and overlapping fragments do not complete the datagram",
+        check_overlaps());
+#endif /* SICSLOWPAN_REASS_DIRECT */
+  check("Sent fragments keep their attributes and are reassembled",
+        check_round_trip());
+  printf("Fragmentation: %d fragments of %u bytes\n",
+         num_frames, DATAGRAM_LEN);
+  check("A datagram is sent with one free queuebuf per fragment",
+        check_free_queuebufs());
+#if SICSLOWPAN_FRAG_FORWARDING
+  add_nexthop();
+  check("Routed fragments are forwarded once each", check_forwarding());
+  check("Datagrams that cannot be forwarded are reassembled",
+        check_update_failure());
+  check("Datagrams beyond the forwarding entries are reassembled",
+        check_full_table());
+#endif /* SICSLOWPAN_FRAG_FORWARDING */
+
+  printf("Reassembly stats: completed %u, dropped %u\n",
+         sicslowpan_get_reass_stats()->completed,
+         sicslowpan_get_reass_stats()->dropped);
+
+  exit(0);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
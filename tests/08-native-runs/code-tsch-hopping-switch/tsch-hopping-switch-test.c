@@ -0,0 +1,271 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*---------------------------------------------------------------------------*/
+/**
+ * \file
+ *         Checks network-wide TSCH hopping sequence switches: their
+ *         announcement, their relay in EBs and the switch itself, and the
+ *         channel quality that children report in EBs
+ */
+/*---------------------------------------------------------------------------*/
+#include "contiki.h"
+#include "net/mac/tsch/tsch.h"
+#include "net/mac/framer/frame802154e-ie.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+/*---------------------------------------------------------------------------*/
+#define SLOT_LENGTH   (RTIMER_SECOND / 100)
+/*---------------------------------------------------------------------------*/
+PROCESS(tsch_hopping_switch_test_process, "TSCH hopping switch test process");
+AUTOSTART_PROCESSES(&tsch_hopping_switch_test_process);
+/*---------------------------------------------------------------------------*/
+/* The state of TSCH that the switch and the reports use, as in tsch.c */
+int tsch_is_associated;
+struct tsch_asn_t tsch_current_asn;
+rtimer_clock_t tsch_timing[tsch_ts_elements_count];
+uint8_t tsch_hopping_sequence[TSCH_HOPPING_SEQUENCE_MAX_LEN];
+struct tsch_asn_divisor_t tsch_hopping_sequence_length;
+
+/* The neighbors TSCH knows */
+static struct tsch_neighbor children[2];
+static const linkaddr_t child_addr[2] = {
+  { { 1, 0, 0, 0, 0, 0, 0, 1 } },
+  { { 1, 0, 0, 0, 0, 0, 0, 2 } }
+};
+static const linkaddr_t stranger_addr = { { 1, 0, 0, 0, 0, 0, 0, 3 } };
+
+static const uint8_t default_sequence[] = { 15, 20, 25, 26 };
+static const uint8_t new_sequence[] = { 11, 14, 17, 20, 23, 26 };
+/*---------------------------------------------------------------------------*/
+int
+tsch_get_lock(void)
+{
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+void
+tsch_release_lock(void)
+{
+}
+/*---------------------------------------------------------------------------*/
+struct tsch_neighbor *
+tsch_queue_get_nbr(const linkaddr_t *addr)
+{
+  int i;
+
+  for(i = 0; i < 2; i++) {
+    if(linkaddr_cmp(addr, &child_addr[i])) {
+      return &children[i];
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+struct tsch_neighbor *
+tsch_queue_get_time_source(void)
+{
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+static void
+check(const char *descr, int success)
+{
+  printf("=check-me= %s - %s\n", success ? "SUCCEEDED" : "FAILED   ", descr);
+}
+/*---------------------------------------------------------------------------*/
+static int
+uses_sequence(const uint8_t *sequence, uint8_t len)
+{
+  return tsch_hopping_sequence_length.val == len &&
+         memcmp(tsch_hopping_sequence, sequence, len) == 0;
+}
+/*---------------------------------------------------------------------------*/
+/* An EB as built by a node that knows a pending switch: its current
+ * hopping sequence, and the announced one */
+static int
+create_eb_ies(uint8_t *buf, int len, const struct tsch_hopping_sequence_switch *next)
+{
+  struct ieee802154_ies ies;
+  uint8_t *p = buf;
+  int ie_len;
+
+  memset(&ies, 0, sizeof(ies));
+  ies.ie_channel_hopping_sequence_id = 1;
+  ies.ie_hopping_sequence_len = tsch_hopping_sequence_length.val;
+  memcpy(ies.ie_hopping_sequence_list, tsch_hopping_sequence,
+         ies.ie_hopping_sequence_len);
+  ies.ie_next_hopping_sequence_asn = next->asn;
+  ies.ie_next_hopping_sequence_len = next->len;
+  memcpy(ies.ie_next_hopping_sequence_list, next->sequence, next->len);
+  ies.ie_channel_quality_nodes = tsch_stats_get_network_nodes();
+  ies.ie_channel_quality_first_channel = TSCH_STATS_FIRST_CHANNEL;
+  ies.ie_channel_quality_len = 2;
+  ies.ie_channel_quality[0] = 255;
+  ies.ie_channel_quality[1] = 0;
+
+  p += frame80215e_create_ie_header_list_termination_1(p, len, &ies);
+  /* The MLME IE goes in front of its sub-IEs, once they are known */
+  p += 2;
+  ie_len = frame80215e_create_ie_tsch_channel_hopping_sequence(p, buf + len - p, &ies);
+  if(ie_len < 0) {
+    return -1;
+  }
+  p += ie_len;
+  ie_len = frame80215e_create_ie_tsch_next_hopping_sequence(p, buf + len - p, &ies);
+  if(ie_len < 0) {
+    return -1;
+  }
+  p += ie_len;
+  ie_len = frame80215e_create_ie_tsch_channel_quality(p, buf + len - p, &ies);
+  if(ie_len < 0) {
+    return -1;
+  }
+  p += ie_len;
+  ies.ie_mlme_len = p - buf - 4;
+  frame80215e_create_ie_mlme(buf + 2, 2, &ies);
+  return p - buf;
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(tsch_hopping_switch_test_process, ev, data)
+{
+  static uint8_t eb[128];
+  static struct ieee802154_ies ies;
+  static struct tsch_hopping_sequence_switch announced;
+  const struct tsch_hopping_sequence_switch *next;
+  struct tsch_asn_t asn;
+  uint8_t busy[] = { 0, 0 };
+  uint8_t mixed[] = { 255, 0 };
+  int eb_len;
+
+  PROCESS_BEGIN();
+
+  tsch_timing[tsch_ts_timeslot_length] = SLOT_LENGTH;
+  memcpy(tsch_hopping_sequence, default_sequence, sizeof(default_sequence));
+  TSCH_ASN_DIVISOR_INIT(tsch_hopping_sequence_length, sizeof(default_sequence));
+  TSCH_ASN_INIT(tsch_current_asn, 0, 1000);
+
+  /* The coordinator announces a switch */
+  check("A switch is not announced before associating",
+        !tsch_announce_hopping_sequence(new_sequence, sizeof(new_sequence)));
+  tsch_is_associated = 1;
+  next = tsch_get_next_hopping_sequence();
+  check("A switch is announced", next == NULL &&
+        tsch_announce_hopping_sequence(new_sequence, sizeof(new_sequence)));
+  next = tsch_get_next_hopping_sequence();
+  asn = tsch_current_asn;
+  TSCH_ASN_INC(asn, TSCH_CLOCK_TO_SLOTS((uint32_t)TSCH_HOPPING_SEQUENCE_SWITCH_DELAY,
+                                        SLOT_LENGTH));
+  check("The switch is scheduled TSCH_HOPPING_SEQUENCE_SWITCH_DELAY ahead",
+        next != NULL && next->len == sizeof(new_sequence) &&
+        TSCH_ASN_DIFF(next->asn, asn) == 0 &&
+        memcmp(next->sequence, new_sequence, sizeof(new_sequence)) == 0);
+  announced = *next;
+
+  /* The announcement travels in EBs */
+  tsch_stats_init();
+  eb_len = create_eb_ies(eb, sizeof(eb), &announced);
+  memset(&ies, 0, sizeof(ies));
+  check("The announcement is parsed from an EB", eb_len > 0 &&
+        frame802154e_parse_information_elements(eb, eb_len, &ies) == eb_len &&
+        ies.ie_next_hopping_sequence_len == announced.len &&
+        TSCH_ASN_DIFF(ies.ie_next_hopping_sequence_asn, announced.asn) == 0 &&
+        memcmp(ies.ie_next_hopping_sequence_list, new_sequence,
+               sizeof(new_sequence)) == 0 &&
+        ies.ie_hopping_sequence_len == sizeof(default_sequence) &&
+        ies.ie_channel_quality_nodes == 1 && ies.ie_channel_quality_len == 2);
+
+  /* A node that has no pending switch learns it from the EB */
+  check("A pending switch is not relayed again",
+        !tsch_check_next_hopping_sequence(&ies, &tsch_current_asn));
+  tsch_set_next_hopping_sequence(NULL, 0, NULL);
+  check("A switch is learnt from an EB",
+        tsch_get_next_hopping_sequence() == NULL &&
+        tsch_check_next_hopping_sequence(&ies, &tsch_current_asn));
+  tsch_set_next_hopping_sequence(ies.ie_next_hopping_sequence_list,
+                                 ies.ie_next_hopping_sequence_len,
+                                 &ies.ie_next_hopping_sequence_asn);
+
+  /* All nodes switch in the same timeslot */
+  tsch_current_asn = announced.asn;
+  TSCH_ASN_DEC(tsch_current_asn, 1);
+  tsch_update_hopping_sequence();
+  check("The sequence is kept until the switch",
+        uses_sequence(default_sequence, sizeof(default_sequence)) &&
+        tsch_get_next_hopping_sequence() != NULL);
+  TSCH_ASN_INC(tsch_current_asn, 1);
+  tsch_update_hopping_sequence();
+  check("The sequence is switched at the announced ASN",
+        uses_sequence(new_sequence, sizeof(new_sequence)) &&
+        tsch_get_next_hopping_sequence() == NULL);
+
+  /* An EB built before the switch but received after it, e.g. by a node
+   * that joins late, carries the sequence the network switched to */
+  TSCH_ASN_INC(tsch_current_asn, 1);
+  memset(&ies, 0, sizeof(ies));
+  memcpy(tsch_hopping_sequence, default_sequence, sizeof(default_sequence));
+  TSCH_ASN_DIVISOR_INIT(tsch_hopping_sequence_length, sizeof(default_sequence));
+  eb_len = create_eb_ies(eb, sizeof(eb), &announced);
+  frame802154e_parse_information_elements(eb, eb_len, &ies);
+  check("An outdated EB is corrected from the announcement",
+        !tsch_check_next_hopping_sequence(&ies, &tsch_current_asn) &&
+        ies.ie_channel_hopping_sequence_id == 1 &&
+        ies.ie_hopping_sequence_len == sizeof(new_sequence) &&
+        memcmp(ies.ie_hopping_sequence_list, new_sequence,
+               sizeof(new_sequence)) == 0);
+  check("EBs carry the hopping sequence", TSCH_PACKET_EB_WITH_HOPPING_SEQUENCE);
+
+  /* The channel quality of a sub-tree counts each of its nodes once */
+  tsch_stats.channel_free_ewma[0] = TSCH_STATS_BINARY_SCALING_FACTOR;
+  tsch_stats.channel_free_ewma[1] = TSCH_STATS_BINARY_SCALING_FACTOR;
+  tsch_stats_channel_report_input(&stranger_addr, 100, TSCH_STATS_FIRST_CHANNEL,
+                                  busy, sizeof(busy));
+  check("Reports from nodes that are not neighbors are ignored",
+        tsch_stats_get_network_nodes() == 1 &&
+        tsch_stats_get_network_channel_free(0) == TSCH_STATS_BINARY_SCALING_FACTOR);
+  tsch_stats_channel_report_input(&child_addr[0], 1, TSCH_STATS_FIRST_CHANNEL,
+                                  busy, sizeof(busy));
+  tsch_stats_channel_report_input(&child_addr[1], 6, TSCH_STATS_FIRST_CHANNEL,
+                                  mixed, sizeof(mixed));
+  printf("TSCH channel free: %u %u of %u, %u nodes\n",
+         tsch_stats_get_network_channel_free(0),
+         tsch_stats_get_network_channel_free(1),
+         TSCH_STATS_BINARY_SCALING_FACTOR, tsch_stats_get_network_nodes());
+  check("The sub-tree sizes add up", tsch_stats_get_network_nodes() == 8);
+  check("Reports are weighted by the size of their sub-tree",
+        tsch_stats_get_network_channel_free(0) ==
+        7 * TSCH_STATS_BINARY_SCALING_FACTOR / 8 &&
+        tsch_stats_get_network_channel_free(1) ==
+        TSCH_STATS_BINARY_SCALING_FACTOR / 8);
+
+  exit(0);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
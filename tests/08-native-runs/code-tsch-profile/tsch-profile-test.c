@@ -0,0 +1,152 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*---------------------------------------------------------------------------*/
+/**
+ * \file
+ *         Checks the TSCH slot timing profiler against timeslots simulated
+ *         with busy waits on the native rtimer
+ */
+/*---------------------------------------------------------------------------*/
+#include "contiki.h"
+#include "net/mac/tsch/tsch-profile.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+/*---------------------------------------------------------------------------*/
+#define SLOT_LENGTH   (RTIMER_SECOND / 100)
+#define PACKET_TIME   (RTIMER_SECOND / 500)
+#define OVERRUN_TIME  (SLOT_LENGTH + RTIMER_SECOND / 500)
+#define NUM_SLOTS     24
+#define OVERRUN_EVERY 6
+/*---------------------------------------------------------------------------*/
+PROCESS(tsch_profile_test_process, "TSCH profile test process");
+/* Drains the profiler, as in TSCH */
+PROCESS(tsch_pending_events_process, "pending events process");
+AUTOSTART_PROCESSES(&tsch_profile_test_process, &tsch_pending_events_process);
+/*---------------------------------------------------------------------------*/
+static unsigned polls;
+/*---------------------------------------------------------------------------*/
+static void
+check(const char *descr, int success)
+{
+  printf("=check-me= %s - %s\n", success ? "SUCCEEDED" : "FAILED   ", descr);
+}
+/*---------------------------------------------------------------------------*/
+static void
+busy_wait(rtimer_clock_t duration)
+{
+  rtimer_clock_t start = RTIMER_NOW();
+  while(RTIMER_CLOCK_LT(RTIMER_NOW(), start + duration));
+}
+/*---------------------------------------------------------------------------*/
+/* A timeslot that selects a packet, transmits it, and looks up the next
+ * link. Some of them take longer than the timeslot. */
+static void
+run_slot(int overrun)
+{
+  TSCH_PROFILE_SLOT_START(RTIMER_NOW(), SLOT_LENGTH);
+  TSCH_PROFILE_START(tsch_profile_packet);
+  busy_wait(PACKET_TIME);
+  TSCH_PROFILE_END(tsch_profile_packet);
+  TSCH_PROFILE_START(tsch_profile_radio_prepare);
+  busy_wait(overrun ? OVERRUN_TIME : 0);
+  TSCH_PROFILE_END(tsch_profile_radio_prepare);
+  TSCH_PROFILE_START(tsch_profile_schedule);
+  TSCH_PROFILE_END(tsch_profile_schedule);
+  TSCH_PROFILE_SLOT_END();
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(tsch_pending_events_process, ev, data)
+{
+  PROCESS_BEGIN();
+  while(1) {
+    PROCESS_YIELD_UNTIL(ev == PROCESS_EVENT_POLL);
+    polls++;
+    tsch_profile_process_pending();
+  }
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(tsch_profile_test_process, ev, data)
+{
+  static const struct tsch_profile_stats *stats;
+  static int i;
+
+  PROCESS_BEGIN();
+
+  tsch_profile_init();
+
+  for(i = 0; i < NUM_SLOTS; i++) {
+    run_slot(i % OVERRUN_EVERY == OVERRUN_EVERY - 1);
+    /* Let the pending events process run between slots */
+    PROCESS_PAUSE();
+  }
+
+  check("pending events process polled", polls > 0);
+  stats = tsch_profile_get_stats();
+  tsch_profile_print();
+  check("all slots recorded", stats->slot.count == NUM_SLOTS
+        && stats->dropped == 0);
+  check("overruns counted", stats->overruns == NUM_SLOTS / OVERRUN_EVERY);
+  check("phases counted",
+        stats->phases[tsch_profile_packet].count == NUM_SLOTS
+        && stats->phases[tsch_profile_radio_prepare].count == NUM_SLOTS
+        && stats->phases[tsch_profile_schedule].count == NUM_SLOTS
+        && stats->phases[tsch_profile_tx_security].count == 0);
+  check("phase min/max",
+        stats->phases[tsch_profile_packet].min >= PACKET_TIME
+        && stats->phases[tsch_profile_radio_prepare].max >= OVERRUN_TIME
+        && stats->slot.max > SLOT_LENGTH);
+  check("phase average",
+        stats->phases[tsch_profile_packet].total / NUM_SLOTS
+        >= stats->phases[tsch_profile_packet].min
+        && stats->phases[tsch_profile_packet].total / NUM_SLOTS
+        <= stats->phases[tsch_profile_packet].max);
+
+  /* Slots recorded without draining the queue are dropped, not
+   * overwritten */
+  tsch_profile_reset();
+  for(i = 0; i < TSCH_PROFILE_QUEUE_LEN + 4; i++) {
+    run_slot(0);
+  }
+  stats = tsch_profile_get_stats();
+  check("full queue drops slots",
+        stats->slot.count == TSCH_PROFILE_QUEUE_LEN - 1
+        && stats->dropped == 5);
+
+  tsch_profile_reset();
+  stats = tsch_profile_get_stats();
+  check("reset", stats->slot.count == 0 && stats->overruns == 0
+        && stats->dropped == 0);
+
+  printf("=check-me= DONE\n");
+  exit(0);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
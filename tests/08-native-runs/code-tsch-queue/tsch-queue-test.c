@@ -0,0 +1,250 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*---------------------------------------------------------------------------*/
+/**
+ * \file
+ *         Checks the priority classes and the deadlines of the TSCH
+ *         neighbor queues
+ */
+/*---------------------------------------------------------------------------*/
+#include "contiki.h"
+#include "net/mac/tsch/tsch.h"
+#include "net/packetbuf.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+/*---------------------------------------------------------------------------*/
+#define DATA_PRIORITY 0
+#define HIGH_PRIORITY 1
+/*---------------------------------------------------------------------------*/
+PROCESS(tsch_queue_test_process, "TSCH queue test process");
+AUTOSTART_PROCESSES(&tsch_queue_test_process);
+/*---------------------------------------------------------------------------*/
+/* The state of TSCH that the queues use, as in tsch.c */
+const linkaddr_t tsch_broadcast_address = { { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff } };
+const linkaddr_t tsch_eb_address = { { 0, 0, 0, 0, 0, 0, 0, 0 } };
+int tsch_is_coordinator;
+struct tsch_asn_t tsch_current_asn;
+
+PROCESS(tsch_pending_events_process, "pending events process");
+
+static const linkaddr_t addr_a = { { 1, 0, 0, 0, 0, 0, 0, 1 } };
+static const linkaddr_t addr_b = { { 1, 0, 0, 0, 0, 0, 0, 2 } };
+
+/* A dedicated Tx link: no backoff */
+static struct tsch_link tx_link = { .link_options = LINK_OPTION_TX };
+
+static int sent_status;
+static int sent_count;
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(tsch_pending_events_process, ev, data)
+{
+  PROCESS_BEGIN();
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
+int
+tsch_get_lock(void)
+{
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+void
+tsch_release_lock(void)
+{
+}
+/*---------------------------------------------------------------------------*/
+int
+tsch_is_locked(void)
+{
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+void
+tsch_set_ka_timeout(uint32_t timeout)
+{
+}
+/*---------------------------------------------------------------------------*/
+static void
+check(const char *descr, int success)
+{
+  printf("=check-me= %s - %s\n", success ? "SUCCEEDED" : "FAILED   ", descr);
+}
+/*---------------------------------------------------------------------------*/
+static void
+packet_sent(void *ptr, int status, int transmissions)
+{
+  sent_status = status;
+  sent_count++;
+}
+/*---------------------------------------------------------------------------*/
+static struct tsch_packet *
+add_packet(const linkaddr_t *addr, uint8_t priority, uint16_t deadline)
+{
+  packetbuf_clear();
+  packetbuf_set_datalen(10);
+  packetbuf_set_attr(PACKETBUF_ATTR_TSCH_PRIORITY, priority);
+  packetbuf_set_attr(PACKETBUF_ATTR_TSCH_DEADLINE, deadline);
+  return tsch_queue_add_packet(addr, 3, packet_sent, NULL);
+}
+/*---------------------------------------------------------------------------*/
+/* What the slot operation does with the packet it picks: send it,
+ * then free it once it has left the queue */
+static int
+send_packet(struct tsch_neighbor *n, struct tsch_packet *p, uint8_t status)
+{
+  int in_queue;
+
+  p->transmissions++;
+  in_queue = tsch_queue_packet_sent(n, p, &tx_link, status);
+  if(!in_queue) {
+    tsch_queue_free_packet(p);
+  }
+  return in_queue;
+}
+/*---------------------------------------------------------------------------*/
+static void
+check_classes(void)
+{
+  struct tsch_neighbor *n;
+  struct tsch_packet *data1, *data2, *high, *control;
+
+  data1 = add_packet(&addr_a, DATA_PRIORITY, 0);
+  data2 = add_packet(&addr_a, DATA_PRIORITY, 0);
+  control = add_packet(&addr_a, TSCH_QUEUE_CONTROL_PRIORITY, 0);
+  high = add_packet(&addr_a, HIGH_PRIORITY, 0);
+  n = tsch_queue_get_nbr(&addr_a);
+  check("Packets are queued", data1 != NULL && data2 != NULL
+        && control != NULL && high != NULL
+        && tsch_queue_packet_count(&addr_a) == 4);
+
+  check("Highest class goes first",
+        tsch_queue_get_packet_for_nbr(n, &tx_link) == control);
+  send_packet(n, control, MAC_TX_OK);
+  check("Next class goes next",
+        tsch_queue_get_packet_for_nbr(n, &tx_link) == high);
+  send_packet(n, high, MAC_TX_OK);
+  check("A class is FIFO",
+        tsch_queue_get_packet_for_nbr(n, &tx_link) == data1);
+
+  /* A control packet arrives while the data packet is in the air: the
+   * data packet, not the control one, leaves the queue */
+  control = add_packet(&addr_a, TSCH_QUEUE_CONTROL_PRIORITY, 0);
+  send_packet(n, data1, MAC_TX_OK);
+  check("Sent packet leaves its own class",
+        tsch_queue_packet_count(&addr_a) == 2
+        && tsch_queue_get_packet_for_nbr(n, &tx_link) == control);
+
+  /* Same for a packet dropped after its last transmission */
+  check("Failed packet stays", send_packet(n, control, MAC_TX_NOACK) == 1);
+  high = add_packet(&addr_a, HIGH_PRIORITY, 0);
+  control->transmissions = control->max_transmissions - 1;
+  send_packet(n, control, MAC_TX_NOACK);
+  check("Dropped packet leaves its own class",
+        tsch_queue_packet_count(&addr_a) == 2
+        && tsch_queue_get_packet_for_nbr(n, &tx_link) == high);
+  send_packet(n, high, MAC_TX_OK);
+  check("Last packet is the data one",
+        tsch_queue_get_packet_for_nbr(n, &tx_link) == data2);
+
+  /* Between neighbors, the highest class wins over the list order */
+  control = add_packet(&addr_b, TSCH_QUEUE_CONTROL_PRIORITY, 0);
+  n = NULL;
+  check("Neighbor with the highest class goes first",
+        tsch_queue_get_unicast_packet_for_any(&n, &tx_link) == control
+        && n == tsch_queue_get_nbr(&addr_b));
+  send_packet(n, control, MAC_TX_OK);
+  n = NULL;
+  check("Then the other neighbor",
+        tsch_queue_get_unicast_packet_for_any(&n, &tx_link) == data2
+        && n == tsch_queue_get_nbr(&addr_a));
+  send_packet(n, data2, MAC_TX_OK);
+  check("Queues are empty", tsch_queue_global_packet_count() == 0);
+}
+/*---------------------------------------------------------------------------*/
+static void
+check_deadlines(void)
+{
+  struct tsch_neighbor *n;
+  struct tsch_packet *stale, *fresh;
+
+  stale = add_packet(&addr_a, HIGH_PRIORITY, 5);
+  fresh = add_packet(&addr_a, DATA_PRIORITY, 0);
+  n = tsch_queue_get_nbr(&addr_a);
+  TSCH_ASN_INC(tsch_current_asn, 5);
+  check("Packet at its deadline is sent",
+        tsch_queue_get_packet_for_nbr(n, &tx_link) == stale);
+
+  TSCH_ASN_INC(tsch_current_asn, 1);
+  check("Packet past its deadline is skipped",
+        tsch_queue_get_packet_for_nbr(n, &tx_link) == fresh);
+  check("Skipped packet stays until dropped",
+        tsch_queue_packet_count(&addr_a) == 2);
+
+  sent_count = 0;
+  tsch_queue_drop_stale_packets();
+  check("Stale packet is dropped", tsch_queue_packet_count(&addr_a) == 1
+        && sent_count == 1 && sent_status == MAC_TX_ERR);
+  check("Stale drop is counted", tsch_stats.queue[HIGH_PRIORITY].stale == 1
+        && tsch_stats.queue[HIGH_PRIORITY].max_delay == 6);
+
+  sent_count = 0;
+  tsch_queue_drop_stale_packets();
+  check("Fresh packet is kept", tsch_queue_packet_count(&addr_a) == 1
+        && sent_count == 0);
+  send_packet(n, fresh, MAC_TX_OK);
+  check("Dequeued packets are counted",
+        tsch_stats.queue[DATA_PRIORITY].dequeued == 3
+        && tsch_stats.queue[HIGH_PRIORITY].dequeued == 3
+        && tsch_stats.queue[TSCH_QUEUE_CONTROL_PRIORITY].dequeued == 3
+        && tsch_stats.queue[DATA_PRIORITY].stale == 0);
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(tsch_queue_test_process, ev, data)
+{
+  int i;
+
+  PROCESS_BEGIN();
+
+  tsch_queue_init();
+
+  check_classes();
+  check_deadlines();
+
+  for(i = 0; i < TSCH_QUEUE_NUM_PRIORITIES; i++) {
+    printf("TSCH queue priority %d: %lu dequeued, %lu stale, %lu max delay\n",
+           i, (unsigned long)tsch_stats.queue[i].dequeued,
+           (unsigned long)tsch_stats.queue[i].stale,
+           (unsigned long)tsch_stats.queue[i].max_delay);
+  }
+
+  exit(0);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,316 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*---------------------------------------------------------------------------*/
+/**
+ * \file
+ *         Checks the timeslot-sorted link index of the TSCH schedule
+ *         against a scan of the links of every slotframe, as links and
+ *         slotframes come and go
+ */
+/*---------------------------------------------------------------------------*/
+#include "contiki.h"
+#include "net/mac/tsch/tsch.h"
+#include "lib/random.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+/*---------------------------------------------------------------------------*/
+#define NUM_NEIGHBORS 3
+/*---------------------------------------------------------------------------*/
+PROCESS(tsch_schedule_test_process, "TSCH schedule test process");
+AUTOSTART_PROCESSES(&tsch_schedule_test_process);
+/*---------------------------------------------------------------------------*/
+/* The state of TSCH that the schedule and the queues use, as in tsch.c */
+const linkaddr_t tsch_broadcast_address = { { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff } };
+const linkaddr_t tsch_eb_address = { { 0, 0, 0, 0, 0, 0, 0, 0 } };
+int tsch_is_coordinator;
+struct tsch_asn_t tsch_current_asn;
+struct tsch_link *current_link;
+
+static const linkaddr_t neighbors[NUM_NEIGHBORS] = {
+  { { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff } },
+  { { 1, 0, 0, 0, 0, 0, 0, 1 } },
+  { { 1, 0, 0, 0, 0, 0, 0, 2 } }
+};
+static const uint8_t link_options[] = {
+  LINK_OPTION_TX, LINK_OPTION_RX, LINK_OPTION_TX | LINK_OPTION_RX,
+  LINK_OPTION_TX | LINK_OPTION_RX | LINK_OPTION_SHARED
+};
+
+static unsigned lookups;
+/*---------------------------------------------------------------------------*/
+int
+tsch_get_lock(void)
+{
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+void
+tsch_release_lock(void)
+{
+}
+/*---------------------------------------------------------------------------*/
+int
+tsch_is_locked(void)
+{
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+void
+tsch_set_ka_timeout(uint32_t timeout)
+{
+}
+/*---------------------------------------------------------------------------*/
+static void
+check(const char *descr, int success)
+{
+  printf("=check-me= %s - %s\n", success ? "SUCCEEDED" : "FAILED   ", descr);
+}
+/*---------------------------------------------------------------------------*/
+/* The next active link as found by scanning all links, as the schedule
+ * did before it had a sorted index */
+static struct tsch_link *
+scan_next_active_link(struct tsch_asn_t *asn, uint16_t *time_offset,
+                      struct tsch_link **backup_link)
+{
+  uint16_t time_to_curr_best = 0;
+  struct tsch_link *curr_best = NULL;
+  struct tsch_link *curr_backup = NULL;
+  struct tsch_slotframe *sf;
+
+  for(sf = tsch_schedule_slotframe_head(); sf != NULL;
+      sf = tsch_schedule_slotframe_next(sf)) {
+    uint16_t timeslot = TSCH_ASN_MOD(*asn, sf->size);
+    struct tsch_link *l;
+    for(l = list_head(sf->links_list); l != NULL; l = list_item_next(l)) {
+      uint16_t time_to_timeslot =
+        l->timeslot > timeslot ?
+        l->timeslot - timeslot :
+        sf->size.val + l->timeslot - timeslot;
+      if(curr_best == NULL || time_to_timeslot < time_to_curr_best) {
+        time_to_curr_best = time_to_timeslot;
+        curr_best = l;
+        curr_backup = NULL;
+      } else if(time_to_timeslot == time_to_curr_best) {
+        struct tsch_link *new_best = NULL;
+        if((curr_best->link_options & LINK_OPTION_TX) == (l->link_options & LINK_OPTION_TX)) {
+          if(l->slotframe_handle < curr_best->slotframe_handle) {
+            new_best = l;
+          }
+        } else if(l->link_options & LINK_OPTION_TX) {
+          new_best = l;
+        }
+        if(curr_backup == NULL) {
+          if(new_best != l && (l->link_options & LINK_OPTION_RX)) {
+            curr_backup = l;
+          }
+          if(new_best != curr_best && (curr_best->link_options & LINK_OPTION_RX)) {
+            curr_backup = curr_best;
+          }
+        }
+        if(new_best != NULL) {
+          curr_best = new_best;
+        }
+      }
+    }
+  }
+  *time_offset = time_to_curr_best;
+  *backup_link = curr_backup;
+  return curr_best;
+}
+/*---------------------------------------------------------------------------*/
+/* Compares the indexed and the scanned lookups over a whole hyperperiod
+ * of the given slotframe sizes. Returns the number of mismatches. */
+static int
+compare_next_active_links(uint32_t hyperperiod)
+{
+  struct tsch_asn_t asn;
+  uint32_t i;
+  int mismatches = 0;
+
+  TSCH_ASN_INIT(asn, 0, 0);
+  for(i = 0; i < hyperperiod; i++) {
+    uint16_t offset, expected_offset;
+    struct tsch_link *backup, *expected_backup;
+    struct tsch_link *l = tsch_schedule_get_next_active_link(&asn, &offset, &backup);
+    struct tsch_link *expected = scan_next_active_link(&asn, &expected_offset,
+                                                       &expected_backup);
+    if(l != expected || backup != expected_backup
+       || (expected != NULL && offset != expected_offset)) {
+      mismatches++;
+    }
+    lookups++;
+    TSCH_ASN_INC(asn, 1);
+  }
+  return mismatches;
+}
+/*---------------------------------------------------------------------------*/
+/* Compares the indexed and the scanned links of every timeslot of every
+ * slotframe. Returns the number of mismatches. */
+static int
+compare_links_by_timeslot(void)
+{
+  struct tsch_slotframe *sf;
+  int mismatches = 0;
+
+  for(sf = tsch_schedule_slotframe_head(); sf != NULL;
+      sf = tsch_schedule_slotframe_next(sf)) {
+    uint16_t timeslot;
+    for(timeslot = 0; timeslot < sf->size.val; timeslot++) {
+      struct tsch_link *expected = NULL;
+      struct tsch_link *l;
+      for(l = list_head(sf->links_list); l != NULL; l = list_item_next(l)) {
+        if(l->timeslot == timeslot) {
+          expected = l;
+        }
+      }
+      if(tsch_schedule_get_link_by_timeslot(sf, timeslot) != expected) {
+        mismatches++;
+      }
+    }
+  }
+  return mismatches;
+}
+/*---------------------------------------------------------------------------*/
+static void
+add_random_links(struct tsch_slotframe *sf, int count)
+{
+  while(count-- > 0) {
+    tsch_schedule_add_link(sf,
+                           link_options[random_rand() % sizeof(link_options)],
+                           LINK_TYPE_NORMAL,
+                           &neighbors[random_rand() % NUM_NEIGHBORS],
+                           random_rand() % sf->size.val,
+                           random_rand() % 16);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+remove_random_links(struct tsch_slotframe *sf, int count)
+{
+  while(count-- > 0) {
+    tsch_schedule_remove_link_by_timeslot(sf, random_rand() % sf->size.val);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static int
+count_links(void)
+{
+  struct tsch_slotframe *sf;
+  int count = 0;
+
+  for(sf = tsch_schedule_slotframe_head(); sf != NULL;
+      sf = tsch_schedule_slotframe_next(sf)) {
+    count += list_length(sf->links_list);
+  }
+  return count;
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(tsch_schedule_test_process, ev, data)
+{
+  struct tsch_slotframe *sf1, *sf2, *sf3, *sf4;
+  struct tsch_asn_t asn;
+  uint16_t offset;
+  struct tsch_link *backup;
+  int links;
+
+  PROCESS_BEGIN();
+
+  random_init(0x5eed);
+  tsch_queue_init();
+  tsch_schedule_init();
+
+  /* Slotframe handles out of list order, so that handle ties are not
+   * settled by the list order */
+  sf2 = tsch_schedule_add_slotframe(2, 7);
+  sf1 = tsch_schedule_add_slotframe(1, 11);
+  sf3 = tsch_schedule_add_slotframe(3, 13);
+  check("Slotframes are added", sf1 != NULL && sf2 != NULL && sf3 != NULL);
+
+  add_random_links(sf2, 4);
+  add_random_links(sf1, 6);
+  add_random_links(sf3, 8);
+  links = count_links();
+  check("Links by timeslot match", compare_links_by_timeslot() == 0);
+  check("Next links match across slotframes",
+        compare_next_active_links(7 * 11 * 13) == 0);
+
+  /* Links added to the first slotframes move the others in the index */
+  add_random_links(sf2, 3);
+  add_random_links(sf1, 3);
+  check("Links by timeslot match after adding",
+        compare_links_by_timeslot() == 0);
+  check("Next links match after adding",
+        compare_next_active_links(7 * 11 * 13) == 0);
+
+  remove_random_links(sf1, 6);
+  remove_random_links(sf2, 3);
+  check("Links by timeslot match after removing",
+        compare_links_by_timeslot() == 0);
+  check("Next links match after removing",
+        compare_next_active_links(7 * 11 * 13) == 0);
+
+  /* Removing a slotframe in the middle of the list */
+  check("Middle slotframe is removed", tsch_schedule_remove_slotframe(sf1));
+  sf4 = tsch_schedule_add_slotframe(4, 5);
+  add_random_links(sf4, 3);
+  add_random_links(sf2, 2);
+  check("Links by timeslot match after removing a slotframe",
+        compare_links_by_timeslot() == 0);
+  check("Next links match after removing a slotframe",
+        compare_next_active_links(7 * 5 * 13) == 0);
+
+  /* Emptying a slotframe leaves it without a next link */
+  while(list_head(sf3->links_list) != NULL) {
+    tsch_schedule_remove_link(sf3, list_head(sf3->links_list));
+  }
+  check("Links by timeslot match with an empty slotframe",
+        compare_links_by_timeslot() == 0);
+  check("Next links match with an empty slotframe",
+        compare_next_active_links(7 * 5 * 13) == 0);
+
+  check("All slotframes are removed", tsch_schedule_remove_all_slotframes());
+  TSCH_ASN_INIT(asn, 0, 0);
+  check("Empty schedule has no next link",
+        tsch_schedule_get_next_active_link(&asn, &offset, &backup) == NULL
+        && backup == NULL);
+
+  /* The minimal schedule after a full removal */
+  tsch_schedule_create_minimal();
+  check("Minimal schedule has a link in every slotframe",
+        tsch_schedule_get_next_active_link(&asn, &offset, &backup) != NULL
+        && offset == TSCH_SCHEDULE_DEFAULT_LENGTH);
+
+  printf("TSCH schedule: %u lookups, %d links in 3 slotframes\n",
+         lookups, links);
+
+  exit(0);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,450 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*---------------------------------------------------------------------------*/
+/**
+ * \file
+ *         Checks the hash index of the source routing nodes against a scan
+ *         of the node list, and the source routing headers built at the
+ *         root, fresh or from the cache, against the routes of a model of
+ *         the graph
+ */
+/*---------------------------------------------------------------------------*/
+#include "contiki.h"
+#include "net/ipv6/uip-sr.h"
+#include "net/ipv6/uipbuf.h"
+#include "net/routing/routing.h"
+#include "net/routing/rpl-lite/rpl.h"
+#include "lib/random.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+/*---------------------------------------------------------------------------*/
+#define NUM_NODES             20
+#define NUM_ROUNDS            300
+#define PAYLOAD_LEN           24
+/* Parents in the model of the graph */
+#define ROOT                  -1
+#define NO_PARENT             -2
+/*---------------------------------------------------------------------------*/
+PROCESS(uip_sr_test_process, "uip-sr test process");
+AUTOSTART_PROCESSES(&uip_sr_test_process);
+/*---------------------------------------------------------------------------*/
+static uip_ipaddr_t addrs[NUM_NODES];
+/* The graph as it should be: which nodes are known, and their parents */
+static uint8_t present[NUM_NODES];
+static int parent[NUM_NODES];
+static uint8_t root_present;
+
+static unsigned lookups;
+static unsigned routes;
+static unsigned cached_routes;
+/*---------------------------------------------------------------------------*/
+static void
+check(const char *descr, int success)
+{
+  printf("=check-me= %s - %s\n", success ? "SUCCEEDED" : "FAILED   ", descr);
+}
+/*---------------------------------------------------------------------------*/
+static const uip_ipaddr_t *
+parent_addr(int p)
+{
+  return p == ROOT ? &curr_instance.dag.dag_id : &addrs[p];
+}
+/*---------------------------------------------------------------------------*/
+/* Fills path with the node and its ancestors, up to the child of the root.
+ * Returns their number, 0 if the node is not reachable from the root. */
+static int
+model_path(int i, int *path)
+{
+  int depth = 0;
+
+  while(i >= 0 && depth < NUM_NODES) {
+    path[depth++] = i;
+    i = parent[i];
+  }
+  return i == ROOT ? depth : 0;
+}
+/*---------------------------------------------------------------------------*/
+static int
+model_reachable(int i)
+{
+  int path[NUM_NODES];
+  return model_path(i, path) > 0;
+}
+/*---------------------------------------------------------------------------*/
+static int
+model_num_nodes(void)
+{
+  int i;
+  int n = root_present;
+
+  for(i = 0; i < NUM_NODES; i++) {
+    n += present[i];
+  }
+  return n;
+}
+/*---------------------------------------------------------------------------*/
+/* Parents always come before their children in addrs, there are no loops */
+static int
+update(int i, int p)
+{
+  int old_parent;
+
+  if(uip_sr_update_node(NULL, &addrs[i], parent_addr(p),
+                        UIP_SR_INFINITE_LIFETIME) == NULL) {
+    return 0;
+  }
+  if(p == ROOT) {
+    root_present = 1;
+  } else if(!present[p]) {
+    present[p] = 1;
+    parent[p] = NO_PARENT;
+  }
+  if(!present[i]) {
+    present[i] = 1;
+    parent[i] = NO_PARENT;
+  }
+  old_parent = parent[i];
+  /* A node does not take a parent that would make it unreachable */
+  if(model_reachable(i)) {
+    parent[i] = p;
+    if(!model_reachable(i)) {
+      parent[i] = old_parent;
+    }
+  } else {
+    parent[i] = p;
+  }
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static int
+is_leaf(int i)
+{
+  int j;
+
+  for(j = 0; j < NUM_NODES; j++) {
+    if(present[j] && parent[j] == i) {
+      return 0;
+    }
+  }
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+/* Expires the link of a node without children, and waits for its removal */
+static void
+expire(int i)
+{
+  uip_sr_expire_parent(NULL, &addrs[i], parent_addr(parent[i]));
+  uip_sr_periodic(UIP_SR_REMOVAL_DELAY);
+  uip_sr_periodic(UIP_SR_REMOVAL_DELAY);
+  present[i] = 0;
+}
+/*---------------------------------------------------------------------------*/
+static uip_sr_node_t *
+scan_node(const uip_ipaddr_t *addr)
+{
+  uip_sr_node_t *node;
+  uip_ipaddr_t node_addr;
+
+  for(node = uip_sr_node_head(); node != NULL; node = uip_sr_node_next(node)) {
+    NETSTACK_ROUTING.get_sr_node_ipaddr(&node_addr, node);
+    if(uip_ipaddr_cmp(&node_addr, addr)) {
+      return node;
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+/* Checks that every lookup finds what a scan of the node list finds, and
+ * that the nodes are those of the model */
+static int
+index_matches(void)
+{
+  uip_sr_node_t *node;
+  uip_ipaddr_t other;
+  int listed = 0;
+  int i;
+
+  for(node = uip_sr_node_head(); node != NULL; node = uip_sr_node_next(node)) {
+    listed++;
+  }
+  if(listed != uip_sr_num_nodes() || listed != model_num_nodes()) {
+    return 0;
+  }
+  if(uip_sr_get_node(NULL, &curr_instance.dag.dag_id)
+     != scan_node(&curr_instance.dag.dag_id)) {
+    return 0;
+  }
+  for(i = 0; i < NUM_NODES; i++) {
+    node = uip_sr_get_node(NULL, &addrs[i]);
+    lookups++;
+    if(node != scan_node(&addrs[i]) || (node != NULL) != present[i]) {
+      return 0;
+    }
+    /* Same link identifier, other prefix */
+    uip_ip6addr(&other, 0xfd01, 0, 0, 0, 0, 0, 0, 0);
+    memcpy(&other.u8[8], &addrs[i].u8[8], 8);
+    if(uip_sr_get_node(NULL, &other) != NULL) {
+      return 0;
+    }
+  }
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static void
+build_packet(int i, uint8_t proto)
+{
+  int k;
+
+  uipbuf_clear();
+  memset(uip_buf, 0, UIP_IPH_LEN);
+  UIP_IP_BUF->vtc = 0x60;
+  UIP_IP_BUF->proto = proto;
+  UIP_IP_BUF->ttl = 64;
+  uip_ipaddr_copy(&UIP_IP_BUF->srcipaddr, &curr_instance.dag.dag_id);
+  uip_ipaddr_copy(&UIP_IP_BUF->destipaddr, &addrs[i]);
+  for(k = 0; k < PAYLOAD_LEN; k++) {
+    uip_buf[UIP_IPH_LEN + k] = i + k;
+  }
+  uip_len = UIP_IPH_LEN + PAYLOAD_LEN;
+  uipbuf_set_len_field(UIP_IP_BUF, PAYLOAD_LEN);
+}
+/*---------------------------------------------------------------------------*/
+/* Decodes the source routing header in uip_buf (RFC 6554) and compares it
+ * with the route to node i in the model */
+static int
+srh_matches(int i, uint8_t proto)
+{
+  int path[NUM_NODES];
+  int depth;
+  uint8_t *rh = UIP_IP_PAYLOAD(0);
+  uint8_t *hop;
+  unsigned ext_len;
+  uint8_t cmpri, cmpre, pad;
+  uip_ipaddr_t addr;
+  int size;
+  int k;
+
+  depth = model_path(i, path);
+  ext_len = (rh[1] + 1) * 8;
+  if(UIP_IP_BUF->proto != UIP_PROTO_ROUTING
+     || rh[0] != proto
+     || rh[2] != RPL_RH_TYPE_SRH
+     || rh[3] != depth - 1
+     || uip_len != UIP_IPH_LEN + ext_len + PAYLOAD_LEN
+     || uipbuf_get_len_field(UIP_IP_BUF) != ext_len + PAYLOAD_LEN
+     || !uip_ipaddr_cmp(&UIP_IP_BUF->destipaddr, &addrs[path[depth - 1]])) {
+    return 0;
+  }
+
+  /* The hops after the first one, down to the destination */
+  cmpri = rh[4] >> 4;
+  cmpre = rh[4] & 0x0f;
+  pad = rh[5] >> 4;
+  hop = rh + RPL_RH_LEN + RPL_SRH_LEN;
+  for(k = depth - 2; k >= 0; k--) {
+    size = 16 - (k == 0 ? cmpre : cmpri);
+    uip_ipaddr_copy(&addr, &UIP_IP_BUF->destipaddr);
+    memcpy(&addr.u8[16 - size], hop, size);
+    if(!uip_ipaddr_cmp(&addr, &addrs[path[k]])) {
+      return 0;
+    }
+    hop += size;
+  }
+  if(hop + pad != rh + ext_len) {
+    return 0;
+  }
+
+  for(k = 0; k < PAYLOAD_LEN; k++) {
+    if(rh[ext_len + k] != (uint8_t)(i + k)) {
+      return 0;
+    }
+  }
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+/* Routes a packet to node i and checks its source routing header. Returns
+ * the length of the header, 0 if there is none, -1 on error. */
+static int
+route(int i, uint8_t proto)
+{
+  uip_ipaddr_t next_hop;
+  uint8_t len;
+  int cached;
+
+  build_packet(i, proto);
+  cached = uip_sr_srh_cache_lookup(NULL, &addrs[i], &next_hop, &len) != NULL;
+  if(!model_reachable(i)) {
+    /* Unreachable nodes get no header, cached or not */
+    return cached || NETSTACK_ROUTING.ext_header_update() != 0 ? -1 : 0;
+  }
+  if(NETSTACK_ROUTING.ext_header_update() != 1 || !srh_matches(i, proto)) {
+    return -1;
+  }
+  routes++;
+  cached_routes += cached;
+  return uip_ext_len;
+}
+/*---------------------------------------------------------------------------*/
+/* Routes two packets to every node, the second one with the header cached
+ * for the first one, unless it is too long to be cached */
+static int
+routes_match(void)
+{
+  uip_ipaddr_t next_hop;
+  uint8_t len;
+  int ext_len;
+  int i;
+
+  for(i = 0; i < NUM_NODES; i++) {
+    if(!present[i]) {
+      continue;
+    }
+    ext_len = route(i, UIP_PROTO_UDP);
+    if(ext_len < 0) {
+      return 0;
+    }
+    if(ext_len > 0 && ext_len <= UIP_SR_SRH_CACHE_MAX_LEN
+       && uip_sr_srh_cache_lookup(NULL, &addrs[i], &next_hop, &len) == NULL) {
+      return 0;
+    }
+    if(route(i, UIP_PROTO_TCP) != ext_len) {
+      return 0;
+    }
+  }
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static int
+num_cached(void)
+{
+  uip_ipaddr_t next_hop;
+  uint8_t len;
+  int n = 0;
+  int i;
+
+  for(i = 0; i < NUM_NODES; i++) {
+    n += uip_sr_srh_cache_lookup(NULL, &addrs[i], &next_hop, &len) != NULL;
+  }
+  return n;
+}
+/*---------------------------------------------------------------------------*/
+static void
+check_cache_invalidation(void)
+{
+  int routes_ok;
+  int cached;
+
+  /* 0 and 1 under the root, 2 under 0, 3 under 2 */
+  update(0, ROOT);
+  update(1, ROOT);
+  update(2, 0);
+  update(3, 2);
+  routes_ok = routes_match();
+  cached = num_cached();
+  check("Headers are built and cached", routes_ok && cached > 0);
+
+  update(3, 2);
+  check("Refreshing a link keeps the cache", num_cached() == cached);
+
+  update(3, 1);
+  check("A parent change empties the cache", num_cached() == 0);
+  check("Headers follow a parent change", routes_match());
+
+  routes_match();
+  expire(3);
+  check("A node removal empties the cache", num_cached() == 0);
+}
+/*---------------------------------------------------------------------------*/
+static void
+check_random_graphs(void)
+{
+  int index_ok = 1;
+  int routes_ok = 1;
+  int round;
+  int i;
+  int p;
+
+  for(round = 0; round < NUM_ROUNDS; round++) {
+    i = random_rand() % NUM_NODES;
+    if(random_rand() % 4 == 0) {
+      if(present[i] && parent[i] != NO_PARENT && is_leaf(i)) {
+        expire(i);
+      }
+    } else {
+      p = i == 0 || random_rand() % 4 == 0 ? ROOT : random_rand() % i;
+      update(i, p);
+    }
+    index_ok = index_ok && index_matches();
+    routes_ok = routes_ok && routes_match();
+  }
+  check("Lookups find what a scan finds", index_ok);
+  check("Headers follow the routes of the graph", routes_ok);
+
+  uip_sr_free_all();
+  memset(present, 0, sizeof(present));
+  root_present = 0;
+  check("Lookups find nothing after freeing all nodes", index_matches());
+  check("Freeing all nodes empties the cache", num_cached() == 0);
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(uip_sr_test_process, ev, data)
+{
+  int i;
+
+  PROCESS_BEGIN();
+
+  printf("uip-sr test\n");
+
+  random_init(0x5eed);
+
+  NETSTACK_ROUTING.root_start();
+  check("The node is the root", NETSTACK_ROUTING.node_is_root());
+
+  /* Link identifiers that differ in one or in three bytes, so that the
+     headers compress to different lengths */
+  for(i = 0; i < NUM_NODES; i++) {
+    memcpy(&addrs[i], &curr_instance.dag.dag_id, 8);
+    uip_ip6addr_u8(&addrs[i], addrs[i].u8[0], addrs[i].u8[1], addrs[i].u8[2],
+                   addrs[i].u8[3], addrs[i].u8[4], addrs[i].u8[5],
+                   addrs[i].u8[6], addrs[i].u8[7],
+                   0x02, 0, 0, 0, 0, i % 3 == 0 ? 0x42 : 0, i % 5 == 0 ? 0x17 : 0, i);
+  }
+
+  check_cache_invalidation();
+  check_random_graphs();
+
+  printf("uip-sr: %u lookups, %u source routes, %u from the cache\n",
+         lookups, routes, cached_routes);
+
+  exit(0);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/